@@ -0,0 +1,198 @@
+// Login storm benchmark for the auth pipeline.
+//
+// One io_context thread stands in for the server's I/O threads and runs a
+// 1 ms ticker whose lateness shows how long the thread was blocked. N
+// logins are then verified, first inline on that thread (the KDF blocks
+// it) and then through AuthPipeline with 1..W workers. Reports logins per
+// second and the worst ticker lag for each, followed by a reconnect pass
+// that presents the issued session tokens and skips the KDF.
+//
+// Usage: auth_pipeline_bench [--logins N] [--workers W] [--scrypt-n N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "server/auth_pipeline.h"
+
+using namespace chat;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    int logins = 200;
+    int workers = 4;
+    uint64_t scrypt_n = 16384;
+};
+
+struct Result {
+    double seconds = 0.0;
+    double max_lag_ms = 0.0;
+    std::vector<std::string> tokens;
+};
+
+Options parseArgs(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--logins") options.logins = std::stoi(value);
+        else if (flag == "--workers") options.workers = std::stoi(value);
+        else if (flag == "--scrypt-n") options.scrypt_n = std::stoull(value);
+        else std::cerr << "Ignoring unknown option " << flag << std::endl;
+    }
+    return options;
+}
+
+/**
+ * Timer that re-arms every millisecond on the I/O thread and records how
+ * late it fired
+ */
+class Ticker {
+public:
+    explicit Ticker(boost::asio::io_context& io_context) : timer_(io_context) {}
+
+    void start() {
+        running_ = true;
+        arm();
+    }
+
+    void stop() { running_ = false; }
+    double maxLagMs() const { return max_lag_ms_.load(); }
+
+private:
+    void arm() {
+        due_ = Clock::now() + std::chrono::milliseconds(1);
+        timer_.expires_at(due_);
+        timer_.async_wait([this](const boost::system::error_code& ec) {
+            if (ec || !running_) {
+                return;
+            }
+            double lag = std::chrono::duration<double, std::milli>(Clock::now() - due_).count();
+            if (lag > max_lag_ms_.load()) {
+                max_lag_ms_.store(lag);
+            }
+            arm();
+        });
+    }
+
+    boost::asio::steady_timer timer_;
+    Clock::time_point due_;
+    std::atomic<bool> running_{false};
+    std::atomic<double> max_lag_ms_{0.0};
+};
+
+// Run requests against a fresh I/O thread; submit is called on that thread
+// once per login and must call done() on it when the login completes
+template <typename Submit>
+Result runScenario(int logins, Submit submit) {
+    boost::asio::io_context io_context;
+    auto guard = boost::asio::make_work_guard(io_context);
+    Ticker ticker(io_context);
+    std::thread io_thread([&io_context]() { io_context.run(); });
+
+    Result result;
+    std::promise<void> finished;
+    int completed = 0;
+    auto done = [&](const AuthPipeline::Result& login) {
+        result.tokens.push_back(login.token);
+        if (++completed == logins) {
+            finished.set_value();
+        }
+    };
+
+    // Logins arrive through the reactor one at a time, as requests on
+    // separate connections would, so the ticker gets its turn in between
+    boost::asio::steady_timer feeder(io_context);
+    int fed = 0;
+    std::function<void()> feed = [&]() {
+        feeder.expires_at(Clock::now());
+        feeder.async_wait([&](const boost::system::error_code&) {
+            submit(io_context, fed, done);
+            if (++fed < logins) {
+                feed();
+            }
+        });
+    };
+
+    auto start = Clock::now();
+    boost::asio::post(io_context, [&]() {
+        ticker.start();
+        feed();
+    });
+    finished.get_future().wait();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.max_lag_ms = ticker.maxLagMs();
+
+    boost::asio::post(io_context, [&ticker]() { ticker.stop(); });
+    guard.reset();
+    io_context.stop();
+    io_thread.join();
+    return result;
+}
+
+void report(const std::string& label, const Result& result, int logins) {
+    std::cout << label << ": " << static_cast<uint64_t>(logins / result.seconds) << " logins/s, "
+              << "worst I/O thread stall " << result.max_lag_ms << " ms" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseArgs(argc, argv);
+    std::cout << "logins=" << options.logins << " workers=1.." << options.workers
+              << " scrypt_n=" << options.scrypt_n
+              << " hardware_threads=" << std::thread::hardware_concurrency() << std::endl;
+
+    PasswordHasher::Params params;
+    params.n = options.scrypt_n;
+    auto hash = PasswordHasher::hash("secret", params);
+    if (!hash) {
+        std::cerr << "Benchmark failed: cannot hash passwords in this build" << std::endl;
+        return 1;
+    }
+    auto lookup = [&hash](const std::string&) -> std::optional<AuthPipeline::Credential> {
+        return AuthPipeline::Credential{"u-bench", *hash};
+    };
+
+    auto inline_result = runScenario(options.logins,
+        [&](boost::asio::io_context&, int, auto& done) {
+            AuthPipeline::Result login;
+            login.status = PasswordHasher::verify("secret", *hash) ? AuthPipeline::Status::OK
+                                                                     : AuthPipeline::Status::INVALID;
+            done(login);
+        });
+    report("inline on I/O thread", inline_result, options.logins);
+
+    for (int workers = 1; workers <= options.workers; workers *= 2) {
+        AuthPipeline::Options pipeline_options;
+        pipeline_options.workers = static_cast<std::size_t>(workers);
+        pipeline_options.max_queued = static_cast<std::size_t>(options.logins);
+        AuthPipeline pipeline(pipeline_options, lookup);
+        pipeline.start();
+
+        auto result = runScenario(options.logins,
+            [&](boost::asio::io_context& io_context, int, auto& done) {
+                pipeline.submit(io_context.get_executor(), {"bench", "secret", ""}, done);
+            });
+        report("pipeline, " + std::to_string(workers) + " workers", result, options.logins);
+
+        if (workers * 2 > options.workers) {
+            auto reconnect = runScenario(options.logins,
+                [&](boost::asio::io_context& io_context, int i, auto& done) {
+                    pipeline.submit(io_context.get_executor(), {"bench", "", result.tokens[i]}, done);
+                });
+            report("reconnect with tokens", reconnect, options.logins);
+            std::cout << "token cache hits: " << pipeline.stats().cache_hits << "/" << options.logins << std::endl;
+        }
+    }
+    return 0;
+}
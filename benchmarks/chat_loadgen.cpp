@@ -0,0 +1,361 @@
+// Loopback load generator comparing TcpConnection transports.
+//
+// Starts an echo server on 127.0.0.1 for each selected transport, connects
+// N clients over the Asio reactor and measures round-trip throughput while
+// each client keeps a fixed window of frames in flight. Heap allocations
+// per round trip are counted as well. With --session coroutine (builds
+// with ENABLE_COROUTINES) the server side runs on CoroSession instead of
+// TcpConnection callbacks, pipelining up to the window.
+//
+// Usage: chat_loadgen [--transport asio|io_uring|both] [--clients N]
+//                     [--messages M] [--size BYTES] [--window W] [--threads T]
+//                     [--session callback|coroutine]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "common/coro_session.h"
+#include "common/tcp_connection.h"
+#include "common/transport.h"
+
+#ifdef WITH_COROUTINES
+#include <boost/asio/use_awaitable.hpp>
+#endif
+
+using boost::asio::ip::tcp;
+using namespace chat_app;
+
+// Every heap allocation in the process, clients included. Kept out of
+// line so GCC does not pair the inlined malloc/free with new/delete.
+static std::atomic<uint64_t> g_allocations{0};
+
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+struct Options {
+    std::string transport = "both";
+    int clients = 50;
+    int messages = 10000;   // Per client
+    std::size_t size = 128;
+    int window = 32;
+    int threads = 2;
+    std::string session = "callback";
+};
+
+struct Result {
+    double seconds = 0.0;
+    uint64_t frames = 0;
+    uint64_t allocations = 0;
+    IoUringTransport::Stats uring_stats;
+};
+
+Options parseArgs(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--transport") options.transport = value;
+        else if (flag == "--clients") options.clients = std::stoi(value);
+        else if (flag == "--messages") options.messages = std::stoi(value);
+        else if (flag == "--size") options.size = static_cast<std::size_t>(std::stoul(value));
+        else if (flag == "--window") options.window = std::stoi(value);
+        else if (flag == "--threads") options.threads = std::stoi(value);
+        else if (flag == "--session") options.session = value;
+        else std::cerr << "Ignoring unknown option " << flag << std::endl;
+    }
+    return options;
+}
+
+/**
+ * Echo server: every frame received is sent straight back
+ */
+class EchoServer {
+public:
+    EchoServer(boost::asio::io_context& io_context, std::shared_ptr<IoUringTransport> transport)
+        : io_context_(io_context),
+          acceptor_(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          transport_(std::move(transport)) {
+        accept();
+    }
+
+    tcp::endpoint endpoint() const { return acceptor_.local_endpoint(); }
+
+    void stop() {
+        boost::system::error_code ignored;
+        acceptor_.close(ignored);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& connection : connections_) {
+            connection->stop();
+        }
+        connections_.clear();
+    }
+
+private:
+    void accept() {
+        auto connection = std::make_shared<TcpConnection>(io_context_);
+        acceptor_.async_accept(connection->socket(), [this, connection](boost::system::error_code ec) {
+            if (ec) {
+                return;
+            }
+            connection->socket().set_option(tcp::no_delay(true));
+            std::weak_ptr<TcpConnection> weak = connection;
+            connection->setMessageCallback([weak](const std::vector<char>& body, uint16_t type, uint16_t flags) {
+                if (auto self = weak.lock()) {
+                    self->send(body, type, flags);
+                }
+            });
+            if (transport_) {
+                connection->useIoUring(transport_);
+            }
+            connection->start();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                connections_.push_back(connection);
+            }
+            accept();
+        });
+    }
+
+    boost::asio::io_context& io_context_;
+    tcp::acceptor acceptor_;
+    std::shared_ptr<IoUringTransport> transport_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<TcpConnection>> connections_;
+};
+
+#ifdef WITH_COROUTINES
+/**
+ * Echo server on coroutine sessions
+ */
+class CoroEchoServer {
+public:
+    CoroEchoServer(boost::asio::io_context& io_context, std::size_t max_in_flight, bool strands)
+        : io_context_(io_context),
+          acceptor_(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          max_in_flight_(max_in_flight),
+          strands_(strands) {
+        accept();
+    }
+
+    tcp::endpoint endpoint() const { return acceptor_.local_endpoint(); }
+
+    void stop() {
+        boost::system::error_code ignored;
+        acceptor_.close(ignored);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& session : sessions_) {
+            session->close();
+        }
+        sessions_.clear();
+    }
+
+private:
+    void accept() {
+        // A session needs its own strand only when several threads run the context
+        boost::asio::any_io_executor executor = io_context_.get_executor();
+        if (strands_) {
+            executor = boost::asio::make_strand(io_context_);
+        }
+        acceptor_.async_accept(executor, [this](boost::system::error_code ec, tcp::socket socket) {
+            if (ec) {
+                return;
+            }
+            socket.set_option(tcp::no_delay(true));
+            auto session = CoroSession::create(std::move(socket), CoroSession::Options{max_in_flight_});
+            session->start([](CoroSession& session, CoroSession::Frame& frame) -> CoroSession::Awaitable<void> {
+                co_await session.write(frame.type, frame.flags, boost::asio::buffer(frame.body));
+            });
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                sessions_.push_back(std::move(session));
+            }
+            accept();
+        });
+    }
+
+    boost::asio::io_context& io_context_;
+    tcp::acceptor acceptor_;
+    std::size_t max_in_flight_;
+    bool strands_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<CoroSession>> sessions_;
+};
+#endif
+
+Result runScenario(const Options& options, TransportBackend backend) {
+    std::shared_ptr<IoUringTransport> transport;
+    if (backend == TransportBackend::IO_URING) {
+        transport = IoUringTransport::create(IoUringTransport::Options());
+        if (!transport) {
+            throw std::runtime_error("io_uring transport unavailable");
+        }
+    }
+
+    boost::asio::io_context server_context;
+    boost::asio::io_context client_context;
+    auto server_guard = boost::asio::make_work_guard(server_context);
+    auto client_guard = boost::asio::make_work_guard(client_context);
+    std::unique_ptr<EchoServer> callback_server;
+#ifdef WITH_COROUTINES
+    std::unique_ptr<CoroEchoServer> coro_server;
+#endif
+    tcp::endpoint endpoint;
+    if (options.session == "coroutine") {
+#ifdef WITH_COROUTINES
+        if (transport) {
+            throw std::runtime_error("coroutine sessions run on the Asio reactor only");
+        }
+        coro_server = std::make_unique<CoroEchoServer>(server_context, static_cast<std::size_t>(options.window),
+                                                       options.threads > 1);
+        endpoint = coro_server->endpoint();
+#else
+        throw std::runtime_error("built without ENABLE_COROUTINES");
+#endif
+    } else {
+        callback_server = std::make_unique<EchoServer>(server_context, transport);
+        endpoint = callback_server->endpoint();
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.threads; ++i) {
+        threads.emplace_back([&server_context]() { server_context.run(); });
+        threads.emplace_back([&client_context]() { client_context.run(); });
+    }
+
+    auto payload = std::make_shared<const std::vector<char>>(options.size, 'x');
+    const uint64_t total = static_cast<uint64_t>(options.clients) * options.messages;
+    std::atomic<uint64_t> received{0};
+    std::mutex done_mutex;
+    std::condition_variable done;
+
+    std::vector<std::shared_ptr<TcpConnection>> clients;
+    std::vector<std::unique_ptr<std::atomic<int>>> sent;
+    for (int i = 0; i < options.clients; ++i) {
+        auto client = std::make_shared<TcpConnection>(client_context);
+        client->socket().connect(endpoint);
+        client->socket().set_option(tcp::no_delay(true));
+        sent.push_back(std::make_unique<std::atomic<int>>(0));
+        clients.push_back(client);
+    }
+
+    uint64_t allocations_before = g_allocations.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+        TcpConnection* client = clients[i].get();
+        std::atomic<int>* client_sent = sent[i].get();
+        client->setMessageCallback([&, client, client_sent](const std::vector<char>&, uint16_t, uint16_t) {
+            if (client_sent->fetch_add(1) < options.messages) {
+                client->send(payload, 1);
+            }
+            if (received.fetch_add(1) + 1 == total) {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                done.notify_all();
+            }
+        });
+        client->start();
+        for (int w = 0; w < options.window && client_sent->fetch_add(1) < options.messages; ++w) {
+            client->send(payload, 1);
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done.wait(lock, [&]() { return received.load() >= total; });
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    Result result;
+    result.seconds = std::chrono::duration<double>(elapsed).count();
+    result.frames = received.load();
+    result.allocations = g_allocations.load(std::memory_order_relaxed) - allocations_before;
+    if (transport) {
+        result.uring_stats = transport->stats();
+    }
+
+    // Join the io threads before closing sockets from this thread
+    server_guard.reset();
+    client_guard.reset();
+    server_context.stop();
+    client_context.stop();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& client : clients) {
+        client->stop();
+    }
+    if (callback_server) {
+        callback_server->stop();
+    }
+#ifdef WITH_COROUTINES
+    if (coro_server) {
+        coro_server->stop();
+    }
+#endif
+    if (transport) {
+        transport->stop();
+    }
+    return result;
+}
+
+void report(TransportBackend backend, const Result& result) {
+    std::cout << transportBackendName(backend) << ": "
+              << result.frames << " round trips in " << result.seconds << " s, "
+              << static_cast<uint64_t>(result.frames / result.seconds) << " msg/s, "
+              << static_cast<double>(result.allocations) / static_cast<double>(result.frames) << " allocations/frame";
+    if (backend == TransportBackend::IO_URING) {
+        std::cout << ", " << result.uring_stats.submit_calls << " submits for "
+                  << result.uring_stats.frames_sent << " frames ("
+                  << result.uring_stats.zero_copy_sends << " zero-copy)";
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseArgs(argc, argv);
+    std::cout << "clients=" << options.clients << " messages=" << options.messages
+              << " size=" << options.size << " window=" << options.window
+              << " threads=" << options.threads << " session=" << options.session << std::endl;
+
+    std::vector<TransportBackend> backends;
+    if (options.transport == "both") {
+        backends = {TransportBackend::ASIO, TransportBackend::IO_URING};
+    } else {
+        backends = {parseTransportBackend(options.transport)};
+    }
+
+    for (auto backend : backends) {
+        try {
+            report(backend, runScenario(options, backend));
+        } catch (const std::exception& e) {
+            std::cout << transportBackendName(backend) << ": skipped (" << e.what() << ")" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Content filter throughput.
+//
+// Screens generated chat messages against a generated blocklist, once
+// with a case-folded std::string::find per term (O(terms x length) per
+// message) and once with the compiled PatternMatcher. A small share of
+// the messages contain a blocked term. Reports messages per second and
+// the per-message cost of each.
+//
+// Usage: content_filter_bench [--terms N] [--messages M] [--length L]
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "server/content_filter.h"
+
+using namespace chat;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::size_t terms = 5000;
+    std::size_t messages = 20000;
+    std::size_t length = 160;
+};
+
+Options parseArgs(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--terms") options.terms = std::stoul(value);
+        else if (flag == "--messages") options.messages = std::stoul(value);
+        else if (flag == "--length") options.length = std::stoul(value);
+        else std::cerr << "Ignoring unknown option " << flag << std::endl;
+    }
+    return options;
+}
+
+std::string randomWord(std::mt19937& random, std::size_t min_length, std::size_t max_length) {
+    std::size_t length = min_length + random() % (max_length - min_length + 1);
+    std::string word;
+    for (std::size_t i = 0; i < length; ++i) {
+        word.push_back(static_cast<char>('a' + random() % 26));
+    }
+    return word;
+}
+
+std::string lower(std::string text) {
+    for (char& c : text) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return text;
+}
+
+template <typename Check>
+void run(const std::string& label, const std::vector<std::string>& messages, Check&& check) {
+    std::size_t hits = 0;
+    auto start = Clock::now();
+    for (const auto& message : messages) {
+        hits += check(message) ? 1 : 0;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << label << ": " << static_cast<uint64_t>(messages.size() / seconds) << " msg/s, "
+              << static_cast<uint64_t>(seconds * 1e9 / messages.size()) << " ns/msg, " << hits << " hits"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseArgs(argc, argv);
+    std::cout << "terms=" << options.terms << " messages=" << options.messages << " length="
+              << options.length << std::endl;
+
+    std::mt19937 random(42);
+    std::vector<std::string> terms;
+    for (std::size_t i = 0; i < options.terms; ++i) {
+        terms.push_back(randomWord(random, 5, 12));
+    }
+    std::vector<std::string> messages;
+    for (std::size_t i = 0; i < options.messages; ++i) {
+        std::string text;
+        while (text.size() < options.length) {
+            text += (random() % 50 == 0) ? terms[random() % terms.size()] : randomWord(random, 2, 8);
+            text += ' ';
+        }
+        messages.push_back(std::move(text));
+    }
+
+    auto start = Clock::now();
+    auto matcher = PatternMatcher::compile(terms, false);
+    auto compile_ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    std::cout << "compiled " << matcher->terms().size() << " terms into " << matcher->stateCount()
+              << " states in " << compile_ms << " ms" << std::endl;
+
+    run("find per term ", messages, [&terms](const std::string& message) {
+        std::string text = lower(message);
+        for (const auto& term : terms) {
+            if (text.find(term) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    });
+    run("PatternMatcher", messages, [&matcher](const std::string& message) {
+        return matcher->contains(message);
+    });
+    return 0;
+}
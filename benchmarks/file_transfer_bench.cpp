@@ -0,0 +1,150 @@
+// File download benchmark over loopback.
+//
+// Serves one file to a client as FILE_TRANSFER data frames, once with
+// TcpConnection::sendFile (sendfile from the page cache) and once by
+// reading each chunk into a buffer and sending it as a normal frame, as
+// message bodies are sent today. Reports throughput and the growth of
+// the process's peak RSS for each; the file is written once up front, so
+// both runs read it from the page cache.
+//
+// Usage: file_transfer_bench [--size-mb N] [--chunk-kb K] [--rounds R]
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "common/message.h"
+#include "common/shared_file.h"
+#include "common/tcp_connection.h"
+
+using boost::asio::ip::tcp;
+using namespace chat_app;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr uint16_t FILE_TRANSFER = static_cast<uint16_t>(MessageType::FILE_TRANSFER);
+
+struct Options {
+    uint64_t size_mb = 512;
+    uint32_t chunk_kb = 512;
+    int rounds = 3;
+};
+
+Options parseArgs(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--size-mb") options.size_mb = std::stoull(value);
+        else if (flag == "--chunk-kb") options.chunk_kb = static_cast<uint32_t>(std::stoul(value));
+        else if (flag == "--rounds") options.rounds = std::stoi(value);
+        else std::cerr << "Ignoring unknown option " << flag << std::endl;
+    }
+    return options;
+}
+
+long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Read frames until size body bytes arrived; returns the frame count
+uint64_t drain(tcp::socket& socket, uint64_t size) {
+    std::vector<char> buffer(1 << 20);
+    uint64_t received = 0;
+    uint64_t frames = 0;
+    while (received < size) {
+        std::array<char, HEADER_SIZE> header_buffer;
+        boost::asio::read(socket, boost::asio::buffer(header_buffer));
+        MessageHeader header;
+        header.decodeFromBuffer(header_buffer);
+        uint32_t body_size = header.getBodySize();
+        boost::asio::read(socket, boost::asio::buffer(buffer.data(), body_size));
+        received += body_size;
+        ++frames;
+    }
+    return frames;
+}
+
+void run(const std::string& label, const std::string& path, const Options& options, bool zero_copy) {
+    boost::asio::io_context io_context;
+    auto guard = boost::asio::make_work_guard(io_context);
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    boost::asio::io_context client_context;
+    tcp::socket client(client_context);
+    client.connect(acceptor.local_endpoint());
+    auto connection = std::make_shared<TcpConnection>(io_context);
+    acceptor.accept(connection->socket());
+    connection->start();
+    std::thread io_thread([&io_context]() { io_context.run(); });
+
+    auto file = SharedFile::open(path);
+    uint32_t chunk = options.chunk_kb * 1024;
+    long rss_before = peakRssKb();
+    auto start = Clock::now();
+    for (int round = 0; round < options.rounds; ++round) {
+        // Queue one round on the io thread, then read it on this one
+        boost::asio::post(io_context, [&]() {
+            std::vector<char> buffer;
+            for (uint64_t offset = 0; offset < file->size(); offset += chunk) {
+                uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(chunk, file->size() - offset));
+                if (zero_copy) {
+                    connection->sendFile({}, file, offset, length, FILE_TRANSFER, MessageFlags::BINARY);
+                } else {
+                    buffer.resize(length);
+                    file->read(offset, buffer.data(), length);
+                    connection->send(buffer, FILE_TRANSFER, MessageFlags::BINARY);
+                }
+            }
+        });
+        drain(client, file->size());
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    double megabytes = static_cast<double>(file->size()) * options.rounds / (1 << 20);
+
+    std::cout << label << ": " << static_cast<uint64_t>(megabytes / seconds) << " MB/s, "
+              << "peak RSS +" << (peakRssKb() - rss_before) / 1024 << " MB" << std::endl;
+
+    boost::asio::post(io_context, [connection]() { connection->stop(); });
+    guard.reset();
+    io_thread.join();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseArgs(argc, argv);
+    std::cout << "size=" << options.size_mb << "MB chunk=" << options.chunk_kb << "KB rounds="
+              << options.rounds << std::endl;
+
+    std::string path = "/tmp/file_transfer_bench." + std::to_string(::getpid());
+    {
+        std::ofstream out(path, std::ios::binary);
+        std::vector<char> block(1 << 20, 'x');
+        for (uint64_t i = 0; i < options.size_mb; ++i) {
+            out.write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+    }
+
+    try {
+        // Zero-copy first: the copying run grows the peak RSS for good
+        run("sendfile      ", path, options, true);
+        run("read + send   ", path, options, false);
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        std::remove(path.c_str());
+        return 1;
+    }
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,323 @@
+// Reconnect storm benchmark over loopback.
+//
+// Starts a server behind ConnectionAdmission whose authentication costs a
+// fixed amount of CPU (like a password hash), then has N clients connect
+// and send AUTH_REQUEST at the same moment, as after a server restart.
+// Refused clients wait for the retry_after_ms hint in the AUTH_RESPONSE
+// and reconnect. Reports the time until every client is authenticated and
+// the per-client time to service, once with the pending-auth queue
+// unbounded and once bounded.
+//
+// Usage: reconnect_storm_bench [--clients N] [--pending P] [--auth-us U]
+//                              [--threads T] [--retry-ms R]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "common/message.h"
+#include "common/tcp_connection.h"
+#include "server/connection_admission.h"
+
+using boost::asio::ip::tcp;
+using namespace chat_app;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr uint16_t AUTH_REQUEST = static_cast<uint16_t>(MessageType::AUTH_REQUEST);
+constexpr uint16_t AUTH_RESPONSE = static_cast<uint16_t>(MessageType::AUTH_RESPONSE);
+
+struct Options {
+    int clients = 2000;
+    int pending = 64;       // Bounded pending-auth queue
+    int auth_us = 200;      // CPU per authentication
+    int threads = 2;        // Server threads
+    int retry_ms = 50;      // Base retry hint
+};
+
+struct Result {
+    double seconds = 0.0;
+    int served = 0;
+    uint64_t attempts = 0;
+    chat::ConnectionAdmission::Stats stats;
+    std::vector<double> latencies_ms;  // Storm start to authenticated, per client
+};
+
+Options parseArgs(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--clients") options.clients = std::stoi(value);
+        else if (flag == "--pending") options.pending = std::stoi(value);
+        else if (flag == "--auth-us") options.auth_us = std::stoi(value);
+        else if (flag == "--threads") options.threads = std::stoi(value);
+        else if (flag == "--retry-ms") options.retry_ms = std::stoi(value);
+        else std::cerr << "Ignoring unknown option " << flag << std::endl;
+    }
+    return options;
+}
+
+void burnCpu(std::chrono::microseconds duration) {
+    auto until = Clock::now() + duration;
+    while (Clock::now() < until) {
+    }
+}
+
+/**
+ * Server that authenticates every AUTH_REQUEST after a fixed CPU cost
+ * and keeps the connection (and its admission ticket) until stopped
+ */
+class AuthServer {
+public:
+    AuthServer(boost::asio::io_context& accept_context, boost::asio::io_context& io_context,
+               chat::ConnectionAdmission::Options options, std::chrono::microseconds auth_cost)
+        : io_context_(io_context),
+          auth_cost_(auth_cost),
+          admission_(accept_context, io_context, options,
+                     [this](tcp::socket socket, chat::ConnectionAdmission::TicketPtr ticket) {
+                         admit(std::move(socket), std::move(ticket));
+                     }) {
+        if (!admission_.start(tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))) {
+            throw std::runtime_error("failed to listen");
+        }
+    }
+
+    tcp::endpoint endpoint() const { return admission_.localEndpoint(); }
+    chat::ConnectionAdmission::Stats stats() const { return admission_.stats(); }
+
+    void stop() {
+        admission_.stop();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& session : sessions_) {
+            session.first->setMessageCallback(nullptr);
+            session.first->stop();
+        }
+        sessions_.clear();
+    }
+
+private:
+    void admit(tcp::socket socket, chat::ConnectionAdmission::TicketPtr ticket) {
+        auto connection = std::make_shared<TcpConnection>(io_context_);
+        connection->socket() = std::move(socket);
+        TcpConnection* raw = connection.get();
+        chat::ConnectionAdmission::Ticket* raw_ticket = ticket.get();
+        connection->setMessageCallback([this, raw, raw_ticket](const std::vector<char>&, uint16_t type, uint16_t) {
+            if (type != AUTH_REQUEST || raw_ticket->isAuthenticated()) {
+                return;
+            }
+            burnCpu(auth_cost_);
+            raw_ticket->authenticated();
+            std::string body = R"({"success":true})";
+            raw->send(std::vector<char>(body.begin(), body.end()), AUTH_RESPONSE, MessageFlags::JSON);
+        });
+        connection->start();
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.emplace_back(std::move(connection), std::move(ticket));
+    }
+
+    boost::asio::io_context& io_context_;
+    std::chrono::microseconds auth_cost_;
+    chat::ConnectionAdmission admission_;
+    std::mutex mutex_;
+    std::vector<std::pair<std::shared_ptr<TcpConnection>, chat::ConnectionAdmission::TicketPtr>> sessions_;
+};
+
+/**
+ * One client: connect, authenticate, and on refusal retry after the hint
+ */
+class StormClient : public std::enable_shared_from_this<StormClient> {
+public:
+    StormClient(boost::asio::io_context& io_context, tcp::endpoint endpoint, Clock::time_point start,
+                std::function<void(double)> served)
+        : io_context_(io_context), endpoint_(endpoint), start_(start),
+          retry_timer_(io_context), served_(std::move(served)) {}
+
+    void connect() {
+        attempts_.fetch_add(1, std::memory_order_relaxed);
+        connection_ = std::make_shared<TcpConnection>(io_context_);
+        auto self = shared_from_this();
+        connection_->socket().async_connect(endpoint_, [self](const boost::system::error_code& ec) {
+            if (ec) {
+                self->retry(std::chrono::milliseconds(100));
+                return;
+            }
+            self->authenticate();
+        });
+    }
+
+    uint64_t attempts() const { return attempts_.load(std::memory_order_relaxed); }
+
+    void stop() {
+        if (connection_) {
+            connection_->setMessageCallback(nullptr);
+            connection_->setErrorCallback(nullptr);
+            connection_->stop();
+        }
+    }
+
+private:
+    void authenticate() {
+        std::weak_ptr<StormClient> weak = shared_from_this();
+        connection_->setMessageCallback([weak](const std::vector<char>& body, uint16_t type, uint16_t) {
+            auto self = weak.lock();
+            if (!self || type != AUTH_RESPONSE) {
+                return;
+            }
+            if (auto retry_after = chat::ConnectionAdmission::retryAfter(body)) {
+                self->retry(*retry_after);
+                return;
+            }
+            self->served_(std::chrono::duration<double, std::milli>(Clock::now() - self->start_).count());
+        });
+        // The server closes refused connections; that is expected here
+        connection_->setErrorCallback([](const boost::system::error_code&) {});
+        connection_->start();
+        std::string body = R"({"username":"storm","password":"secret"})";
+        connection_->send(std::vector<char>(body.begin(), body.end()), AUTH_REQUEST, MessageFlags::JSON);
+    }
+
+    void retry(std::chrono::milliseconds delay) {
+        auto self = shared_from_this();
+        boost::asio::post(io_context_, [self, delay]() {
+            self->stop();
+            self->retry_timer_.expires_after(delay);
+            self->retry_timer_.async_wait([self](const boost::system::error_code& ec) {
+                if (!ec) {
+                    self->connect();
+                }
+            });
+        });
+    }
+
+    boost::asio::io_context& io_context_;
+    tcp::endpoint endpoint_;
+    Clock::time_point start_;
+    boost::asio::steady_timer retry_timer_;
+    std::function<void(double)> served_;
+    std::shared_ptr<TcpConnection> connection_;
+    std::atomic<uint64_t> attempts_{0};
+};
+
+Result runScenario(const Options& options, std::size_t max_pending) {
+    chat::ConnectionAdmission::Options admission_options;
+    admission_options.max_connections = static_cast<std::size_t>(options.clients);
+    admission_options.max_pending_auth = max_pending;
+    admission_options.auth_timeout = std::chrono::minutes(5);
+    admission_options.retry_after = std::chrono::milliseconds(options.retry_ms);
+
+    boost::asio::io_context accept_context;
+    boost::asio::io_context server_context;
+    boost::asio::io_context client_context;
+    auto accept_guard = boost::asio::make_work_guard(accept_context);
+    auto server_guard = boost::asio::make_work_guard(server_context);
+    auto client_guard = boost::asio::make_work_guard(client_context);
+    AuthServer server(accept_context, server_context, admission_options,
+                      std::chrono::microseconds(options.auth_us));
+
+    std::vector<std::thread> threads;
+    threads.emplace_back([&accept_context]() { accept_context.run(); });
+    for (int i = 0; i < options.threads; ++i) {
+        threads.emplace_back([&server_context]() { server_context.run(); });
+    }
+    for (int i = 0; i < 2; ++i) {
+        threads.emplace_back([&client_context]() { client_context.run(); });
+    }
+
+    Result result;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    auto start = Clock::now();
+    std::vector<std::shared_ptr<StormClient>> clients;
+    for (int i = 0; i < options.clients; ++i) {
+        clients.push_back(std::make_shared<StormClient>(client_context, server.endpoint(), start,
+            [&](double latency_ms) {
+                std::lock_guard<std::mutex> lock(mutex);
+                result.latencies_ms.push_back(latency_ms);
+                if (++result.served == options.clients) {
+                    done.notify_all();
+                }
+            }));
+    }
+    boost::asio::post(client_context, [&clients]() {
+        for (auto& client : clients) {
+            client->connect();
+        }
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return result.served == options.clients; });
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.stats = server.stats();
+
+    boost::asio::post(client_context, [&clients]() {
+        for (auto& client : clients) {
+            client->stop();
+        }
+    });
+    for (auto& client : clients) {
+        result.attempts += client->attempts();
+    }
+    boost::asio::post(server_context, [&server]() { server.stop(); });
+    accept_guard.reset();
+    server_guard.reset();
+    client_guard.reset();
+    accept_context.stop();
+    server_context.stop();
+    client_context.stop();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return result;
+}
+
+double percentile(std::vector<double>& values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void report(const std::string& label, Result& result) {
+    std::cout << label << ": " << result.served << " clients served in " << result.seconds << " s, "
+              << "p50 " << percentile(result.latencies_ms, 0.50) << " ms, "
+              << "p99 " << percentile(result.latencies_ms, 0.99) << " ms, "
+              << result.attempts << " connects, "
+              << result.stats.rejected_pending << " refused, "
+              << result.stats.accept_batches << " accept batches (largest " << result.stats.largest_batch << ")"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseArgs(argc, argv);
+    std::cout << "clients=" << options.clients << " pending=" << options.pending
+              << " auth_us=" << options.auth_us << " threads=" << options.threads
+              << " retry_ms=" << options.retry_ms << std::endl;
+
+    try {
+        Result unbounded = runScenario(options, static_cast<std::size_t>(options.clients));
+        report("unbounded pending", unbounded);
+        Result bounded = runScenario(options, static_cast<std::size_t>(std::max(1, options.pending)));
+        report("bounded pending  ", bounded);
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
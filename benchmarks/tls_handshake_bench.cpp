@@ -0,0 +1,245 @@
+// TLS handshake rate benchmark over loopback.
+//
+// Generates a throwaway self-signed certificate, starts a TLS echo server
+// and opens connections that each perform a handshake and one ping/pong
+// round trip. Runs once with full handshakes and once with session
+// resumption so the cost of a reconnect storm can be compared.
+//
+// Usage: tls_handshake_bench [--connections N] [--concurrency C] [--ktls 0|1]
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "common/tcp_connection.h"
+#include "common/tls_context.h"
+
+using boost::asio::ip::tcp;
+using namespace chat_app;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    int connections = 2000;
+    int concurrency = 16;
+    bool ktls = true;
+};
+
+struct Result {
+    double seconds = 0.0;
+    int completed = 0;
+    int resumed = 0;
+    int ktls = 0;
+};
+
+Options parseArgs(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--connections") options.connections = std::stoi(value);
+        else if (flag == "--concurrency") options.concurrency = std::stoi(value);
+        else if (flag == "--ktls") options.ktls = value != "0";
+        else std::cerr << "Ignoring unknown option " << flag << std::endl;
+    }
+    return options;
+}
+
+// Write a P-256 key and a matching self-signed certificate
+bool writeSelfSignedCert(const fs::path& cert_path, const fs::path& key_path) {
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    if (!key || !cert) {
+        return false;
+    }
+
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    bool ok = X509_sign(cert, key, EVP_sha256()) > 0;
+
+    FILE* cert_file = std::fopen(cert_path.c_str(), "w");
+    FILE* key_file = std::fopen(key_path.c_str(), "w");
+    ok = ok && cert_file && key_file &&
+         PEM_write_X509(cert_file, cert) == 1 &&
+         PEM_write_PrivateKey(key_file, key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+    if (cert_file) std::fclose(cert_file);
+    if (key_file) std::fclose(key_file);
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+/**
+ * TLS echo server built on TcpConnection
+ */
+class TlsEchoServer {
+public:
+    TlsEchoServer(boost::asio::io_context& io_context, std::shared_ptr<TlsContext> context)
+        : io_context_(io_context),
+          acceptor_(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          context_(std::move(context)) {
+        accept();
+    }
+
+    tcp::endpoint endpoint() const { return acceptor_.local_endpoint(); }
+
+    void stop() {
+        boost::system::error_code ignored;
+        acceptor_.close(ignored);
+    }
+
+private:
+    void accept() {
+        auto connection = std::make_shared<TcpConnection>(io_context_);
+        acceptor_.async_accept(connection->socket(), [this, connection](boost::system::error_code ec) {
+            if (ec) {
+                return;
+            }
+            TcpConnection* raw = connection.get();
+            connection->setMessageCallback([raw](const std::vector<char>& body, uint16_t type, uint16_t flags) {
+                raw->send(body, type, flags);
+            });
+            connection->useTls(context_);
+            connection->start();
+            accept();
+        });
+    }
+
+    boost::asio::io_context& io_context_;
+    tcp::acceptor acceptor_;
+    std::shared_ptr<TlsContext> context_;
+};
+
+Result runScenario(const Options& options, const fs::path& cert, const fs::path& key, bool resumption) {
+    TlsContext::Options server_options;
+    server_options.cert_file = cert.string();
+    server_options.key_file = key.string();
+    server_options.enable_ktls = options.ktls;
+    server_options.enable_resumption = resumption;
+    auto server_context = TlsContext::create(TlsRole::SERVER, server_options);
+
+    TlsContext::Options client_options;
+    client_options.enable_ktls = options.ktls;
+    client_options.enable_resumption = resumption;
+    auto client_context = TlsContext::create(TlsRole::CLIENT, client_options);
+    if (!server_context || !client_context) {
+        throw std::runtime_error("failed to create TLS contexts");
+    }
+
+    boost::asio::io_context io_context;
+    auto guard = boost::asio::make_work_guard(io_context);
+    TlsEchoServer server(io_context, server_context);
+    std::thread io_thread([&io_context]() { io_context.run(); });
+
+    const std::string peer = "127.0.0.1:" + std::to_string(server.endpoint().port());
+    auto ping = std::make_shared<const std::vector<char>>(32, 'p');
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    int in_flight = 0;
+    Result result;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.connections; ++i) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return in_flight < options.concurrency; });
+            ++in_flight;
+        }
+
+        auto client = std::make_shared<TcpConnection>(io_context);
+        client->socket().connect(server.endpoint());
+        TcpConnection* raw = client.get();
+        auto finish = [&, raw](bool ok) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                ++result.completed;
+                result.resumed += raw->tlsStream()->sessionReused() ? 1 : 0;
+                result.ktls += raw->tlsStream()->isKtlsSend() ? 1 : 0;
+            }
+            --in_flight;
+            cv.notify_all();
+        };
+        client->setMessageCallback([&io_context, client, finish](const std::vector<char>&, uint16_t, uint16_t) {
+            finish(true);
+            // Break the self-reference outside of the callback invocation
+            boost::asio::post(io_context, [client]() {
+                client->setErrorCallback(nullptr);
+                client->setMessageCallback(nullptr);
+                client->stop();
+            });
+        });
+        client->setErrorCallback([finish](const boost::system::error_code& ec) {
+            std::cerr << "client error: " << ec.message() << std::endl;
+            finish(false);
+        });
+        client->useTls(client_context, peer);
+        client->start();
+        client->send(ping, 1);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return in_flight == 0; });
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    server.stop();
+    guard.reset();
+    io_context.stop();
+    io_thread.join();
+    return result;
+}
+
+void report(const char* label, const Result& result) {
+    std::cout << label << ": " << result.completed << " handshakes in " << result.seconds << " s, "
+              << static_cast<int>(result.completed / result.seconds) << " handshakes/s, "
+              << result.resumed << " resumed, " << result.ktls << " with kTLS send" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options = parseArgs(argc, argv);
+
+    fs::path dir = fs::temp_directory_path() / ("chat_tls_bench_" + std::to_string(::getpid()));
+    fs::create_directories(dir);
+    fs::path cert = dir / "server.crt";
+    fs::path key = dir / "server.key";
+    if (!writeSelfSignedCert(cert, key)) {
+        std::cerr << "Failed to generate self-signed certificate" << std::endl;
+        return 1;
+    }
+
+    int status = 0;
+    try {
+        report("full handshake", runScenario(options, cert, key, false));
+        report("resumption    ", runScenario(options, cert, key, true));
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        status = 1;
+    }
+
+    fs::remove_all(dir);
+    return status;
+}
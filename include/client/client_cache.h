@@ -0,0 +1,108 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common/chat_message.h"
+#include "common/delta_sync.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace chat { class ConfigLoader; }
+
+namespace chat_app {
+
+/**
+ * Persistent client-side cache of the user's rooms, their members and
+ * the recent messages of each conversation, in a local SQLite file.
+ *
+ * Messages are keyed by (conversation, sequence), the server-assigned
+ * position that sorts them, and only the newest messages_per_conversation
+ * are kept. On startup the UI is filled from the cache without a round
+ * trip; the client then sends SYNC with syncRequest(), the roster digest
+ * and the sequence each conversation is complete up to, and stores what
+ * comes back: a ROSTER only if rooms changed, and the messages after each
+ * cursor. A returning user with little new traffic transfers almost
+ * nothing.
+ *
+ * The cache belongs to one user; open() with a different user id
+ * empties it.
+ */
+class ClientCache {
+public:
+    struct Options {
+        std::string path = "data/client_cache.db";      // CLIENT_CACHE_PATH
+        std::size_t messages_per_conversation = 200;    // CLIENT_CACHE_MESSAGES
+
+        static Options fromConfig(const chat::ConfigLoader& config);
+    };
+
+    explicit ClientCache(Options options);
+    ~ClientCache();
+
+    ClientCache(const ClientCache&) = delete;
+    ClientCache& operator=(const ClientCache&) = delete;
+
+    // Open (creating tables if needed) for user_id; false on error
+    bool open(const std::string& user_id);
+    void close();
+    bool isOpen() const;
+
+    Roster roster();
+
+    // Replace the cached rooms and members with a ROSTER from the server
+    bool replaceRoster(const Roster& roster);
+
+    // Store sequenced messages (sequence 0 is skipped) and drop the ones
+    // that fall out of each conversation's window
+    bool storeMessages(const std::vector<ChatMessage>& messages);
+
+    // Newest limit messages of a conversation, oldest first
+    std::vector<ChatMessage> recentMessages(const std::string& conversation, std::size_t limit);
+
+    // Per conversation, the highest sequence with nothing missing below it
+    // in the cache. A message stored past a gap (delivered live while
+    // older ones were lost) does not move the cursor, so the gap is
+    // replayed on the next SYNC.
+    SyncCursors cursors();
+
+    // SYNC body for the current cache contents
+    SyncRequest syncRequest();
+
+    // Drop a conversation whose replay was truncated; its history is
+    // refetched instead of leaving a gap below the new messages
+    bool forgetConversation(const std::string& conversation);
+
+private:
+    enum Statement {
+        BEGIN,
+        COMMIT,
+        ROLLBACK,
+        SELECT_OWNER,
+        UPSERT_OWNER,
+        DELETE_ROOMS,
+        DELETE_MEMBERS,
+        INSERT_ROOM,
+        INSERT_MEMBER,
+        SELECT_ROOMS,
+        SELECT_MEMBERS,
+        UPSERT_MESSAGE,
+        PRUNE_MESSAGES,
+        SELECT_RECENT,
+        SELECT_CURSORS,
+        DELETE_CONVERSATION,
+        STATEMENT_COUNT
+    };
+
+    bool exec(const char* sql);
+    bool step(Statement statement);
+    bool ownCache(const std::string& user_id);
+
+    Options options_;
+    sqlite3* db_ = nullptr;
+    sqlite3_stmt* statements_[STATEMENT_COUNT] = {};
+    mutable std::mutex mutex_;
+};
+
+} // namespace chat_app
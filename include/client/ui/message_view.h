@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common/chat_message.h"
+
+struct _win_st;  // ncurses WINDOW
+
+namespace chat { class ConfigLoader; }
+
+namespace chat_app {
+
+/**
+ * Virtualized message pane for the console UI.
+ *
+ * Network threads post() messages; they are only queued. Once per frame
+ * tick the UI thread calls frame(), which lays out the queued batch into
+ * a bounded ring of wrapped lines and compares the rows that should be
+ * visible with what is on screen. Only rows that differ are returned.
+ * When new lines arrive at the bottom, the frame scrolls the window
+ * first, so a busy room costs the new rows per tick and not a repaint.
+ * Work per frame is bounded by the window height plus the batch, and a
+ * batch is capped at the scrollback size, so CPU stays flat however fast
+ * messages arrive and input is read between ticks.
+ *
+ * While the user is scrolled back the view stays anchored on the lines
+ * they are reading and counts unseen lines instead of redrawing.
+ */
+class MessageView {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::size_t scrollback_lines = 5000;             // CLIENT_SCROLLBACK_LINES
+        std::chrono::milliseconds frame_interval{33};    // 1000 / CLIENT_FRAME_RATE
+
+        static Options fromConfig(const chat::ConfigLoader& config);
+    };
+
+    // One row to (re)draw
+    struct Row {
+        int index = 0;
+        std::string text;
+    };
+
+    struct Frame {
+        int scroll = 0;             // Scroll the window up this many rows before drawing
+        std::vector<Row> rows;      // Rows that changed, top to bottom
+
+        bool empty() const { return scroll == 0 && rows.empty(); }
+    };
+
+    struct Stats {
+        uint64_t posted = 0;        // Messages queued by post()
+        uint64_t dropped = 0;       // Queued messages discarded before layout (older than the scrollback)
+        uint64_t frames = 0;
+        uint64_t rows_drawn = 0;
+    };
+
+    explicit MessageView(Options options);
+
+    MessageView(const MessageView&) = delete;
+    MessageView& operator=(const MessageView&) = delete;
+
+    // Any thread: queue a message for the next frame
+    void post(const ChatMessage& message);
+
+    // UI thread: window size in cells; the next frame redraws every row
+    void resize(int width, int height);
+
+    // UI thread: negative scrolls towards older lines
+    void scrollBy(int lines);
+    void scrollToBottom();
+
+    // UI thread, once per tick: lay out queued messages and return what
+    // changed on screen
+    Frame frame(Clock::time_point now = Clock::now());
+
+    // Time left until the next frame is due (an input timeout)
+    std::chrono::milliseconds untilNextFrame(Clock::time_point now = Clock::now()) const;
+
+    // Lines that arrived while scrolled back
+    std::size_t unseen() const { return unseen_; }
+    bool following() const { return offset_ == 0; }
+    std::size_t lineCount() const { return lines_.size(); }
+
+    Stats stats() const;
+
+    // "[HH:MM] sender: content"
+    static std::string format(const ChatMessage& message);
+
+    // Wrap text to width columns (UTF-8 aware), breaking at spaces where
+    // possible; continuation lines are indented
+    static std::vector<std::string> wrap(const std::string& text, int width);
+
+    // Apply a frame to a curses window; the caller does doupdate()
+    static void render(_win_st* window, const Frame& frame);
+
+private:
+    struct Entry {
+        std::string text;
+        std::size_t line_count = 0;   // Lines it occupies at the current width
+    };
+
+    void appendLines(Entry& entry);
+    void trim();
+
+    Options options_;
+
+    std::mutex pending_mutex_;
+    std::deque<std::string> pending_;   // Formatted, not laid out
+
+    // UI thread state
+    std::deque<Entry> entries_;         // Laid-out messages backing lines_, oldest first
+    std::deque<std::string> lines_;     // Ring of wrapped lines, oldest first
+    std::vector<std::string> screen_;   // What each row shows now
+    std::size_t offset_ = 0;            // Lines between the bottom row and the newest line
+    std::size_t unseen_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    Clock::time_point last_frame_{};
+
+    std::atomic<uint64_t> posted_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> rows_drawn_{0};
+};
+
+} // namespace chat_app
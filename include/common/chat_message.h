@@ -2,6 +2,8 @@
 #include <string>
 #include <chrono>
 #include <optional>
+#include <vector>
+#include <cstdint>
 #include <nlohmann/json.hpp>
 
 namespace chat_app {
@@ -21,6 +23,7 @@ struct ChatMessage {
     std::optional<std::string> room_id;            // Room ID if it's a room message (nullptr for direct messages)
     std::optional<std::string> recipient_id;       // Recipient user ID for direct messages
     uint8_t message_type = 0;                      // Type of message (using compact uint8_t)
+    uint64_t sequence = 0;                         // Position in its conversation (0 = not assigned)
     
     // Constructors
     ChatMessage() = default;
@@ -32,38 +35,61 @@ struct ChatMessage {
         std::string content_text,
         uint8_t type = 0
     ) : sender_id(std::move(sender)),
-        recipient_id(std::move(recipient)),
         content(std::move(content_text)),
-        message_type(type),
-        timestamp(std::chrono::system_clock::now()) {
+        timestamp(std::chrono::system_clock::now()),
+        recipient_id(std::move(recipient)),
+        message_type(type) {
         // Generate random UUID or use a library like uuid-dev
         message_id = generateUUID();
     }
     
-    // Constructor for room messages
-    ChatMessage(
+    // Factory for room messages (a second constructor with the same
+    // parameter list as the direct-message one cannot be overloaded)
+    static ChatMessage forRoom(
         std::string sender,
         std::string room,
         std::string content_text,
         uint8_t type = 0
-    ) : sender_id(std::move(sender)), 
-        room_id(std::move(room)),
-        content(std::move(content_text)),
-        message_type(type),
-        timestamp(std::chrono::system_clock::now()) {
-        message_id = generateUUID();
+    ) {
+        ChatMessage msg;
+        msg.sender_id = std::move(sender);
+        msg.room_id = std::move(room);
+        msg.content = std::move(content_text);
+        msg.message_type = type;
+        msg.timestamp = std::chrono::system_clock::now();
+        msg.message_id = generateUUID();
+        return msg;
     }
     
     // JSON serialization/deserialization
     nlohmann::json toJson() const;
     static ChatMessage fromJson(const nlohmann::json& json);
     
+    // Compact binary serialization (length-prefixed fields, network byte order).
+    // fromBinary throws std::runtime_error on truncated or malformed input.
+    std::vector<char> toBinary() const;
+    static ChatMessage fromBinary(const char* data, std::size_t size);
+    
     // Generate a random UUID (simplified implementation)
     static std::string generateUUID();
     
     // Helper methods
     bool isRoomMessage() const { return room_id.has_value(); }
     bool isDirectMessage() const { return recipient_id.has_value(); }
+    
+    // Key that sequence numbers count in: the room id, or for a direct
+    // message "dm:<length of a>:<a>:<b>" with both user ids sorted, so
+    // either side names the same conversation and ids containing ':'
+    // cannot pass for one another
+    std::string conversationId() const {
+        if (room_id.has_value()) {
+            return room_id.value();
+        }
+        const std::string& recipient = recipient_id.value_or("");
+        const std::string& first = sender_id < recipient ? sender_id : recipient;
+        const std::string& second = sender_id < recipient ? recipient : sender_id;
+        return "dm:" + std::to_string(first.size()) + ":" + first + ":" + second;
+    }
 };
 
 // JSON serialization support for nlohmann::json
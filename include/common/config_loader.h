@@ -7,6 +7,11 @@
 #include <sstream>
 #include <optional>
 #include <filesystem>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace chat {
 
@@ -18,43 +23,102 @@ enum class LogLevel {
     ERROR
 };
 
+/**
+ * Immutable, parsed-once view of the configuration file.
+ * Frequently read limits are decoded into typed fields so hot paths
+ * never touch the string map; everything else is available raw and
+ * pre-parsed as integers where possible.
+ */
+struct ConfigSnapshot {
+    std::unordered_map<std::string, std::string> values;    // Raw key/value pairs
+    std::unordered_map<std::string, long long> int_values;  // Keys whose value parsed as an integer
+    uint64_t version = 0;                                    // Incremented on every reload
+
+    // Typed values for common settings
+    int server_port = 8080;
+    int max_connections = 100;
+    int connection_timeout = 60;
+    int thread_pool_size = 0;
+    int autosave_interval = 300;
+    int message_queue_size = 1000;
+    int message_history_limit = 100;
+    bool enable_ssl = false;
+    bool enable_console_log = true;
+    LogLevel log_level = LogLevel::INFO;
+
+    // Whether a key has a different value (or presence) in another snapshot
+    bool differs(const ConfigSnapshot& other, const std::string& key) const;
+};
+
 class ConfigLoader {
 public:
+    using SnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
+    using ChangeCallback = std::function<void(const ConfigSnapshot& previous, const ConfigSnapshot& current)>;
+    using SubscriptionId = uint64_t;
+
     // Constructor loads config from the specified file
     explicit ConfigLoader(const std::string& config_file_path);
-    
-    // Reload configuration from file
+
+    // Reload configuration from file. A new snapshot is published only if
+    // the file could be read; readers never observe a partially built one.
     bool reload();
-    
+
+    // Current snapshot; the reference stays valid for the loader's lifetime.
+    // Costs one atomic pointer load, safe to call from any thread.
+    const ConfigSnapshot& current() const { return *current_.load(std::memory_order_acquire); }
+
+    // Current snapshot as a shared pointer, for callers that keep it around
+    SnapshotPtr snapshot() const;
+
+    // Get notified after every successful reload (called on the reloading thread)
+    SubscriptionId subscribe(ChangeCallback callback);
+    void unsubscribe(SubscriptionId id);
+
     // Get config values of different types with default fallbacks
     std::string getString(const std::string& key, const std::string& default_value = "") const;
     int getInt(const std::string& key, int default_value = 0) const;
     bool getBool(const std::string& key, bool default_value = false) const;
     double getFloat(const std::string& key, double default_value = 0.0) const;
-    
+
     // Specific getters for common configuration values
-    int getServerPort() const { return getInt("SERVER_PORT", 8080); }
-    int getAutosaveInterval() const { return getInt("AUTOSAVE_INTERVAL", 300); }
-    LogLevel getLogLevel() const;
-    
+    int getServerPort() const { return current().server_port; }
+    int getAutosaveInterval() const { return current().autosave_interval; }
+    LogLevel getLogLevel() const { return current().log_level; }
+
     // Check if a key exists
     bool hasKey(const std::string& key) const;
-    
+
+    // Path of the file this loader reads
+    const std::string& getConfigFilePath() const { return config_file_path_; }
+
     // Dump all configuration values (useful for debugging)
     void dumpConfig(std::ostream& out = std::cout) const;
 
+    // Convert string to LogLevel
+    static LogLevel stringToLogLevel(const std::string& level_str);
+
 private:
     std::string config_file_path_;
-    std::unordered_map<std::string, std::string> config_values_;
-    
+
+    // Published snapshot. Superseded snapshots are retained (reloads are
+    // rare) so plain references handed out by current() never dangle.
+    std::atomic<const ConfigSnapshot*> current_{nullptr};
+    std::vector<SnapshotPtr> published_;
+    mutable std::mutex reload_mutex_;
+
+    // Change subscribers
+    std::mutex subscriber_mutex_;
+    std::vector<std::pair<SubscriptionId, std::shared_ptr<ChangeCallback>>> subscribers_;
+    SubscriptionId next_subscription_id_ = 1;
+
     // Parse a single line from the config file
-    void parseLine(const std::string& line);
-    
-    // Convert string to LogLevel
-    LogLevel stringToLogLevel(const std::string& level_str) const;
-    
+    void parseLine(const std::string& line, std::unordered_map<std::string, std::string>& values) const;
+
+    // Decode typed fields of a freshly parsed snapshot
+    void buildTypedValues(ConfigSnapshot& snapshot) const;
+
     // Trim whitespace from a string
-    std::string trim(const std::string& str) const;
+    static std::string trim(const std::string& str);
 };
 
-} // namespace chat
\ No newline at end of file
+} // namespace chat
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include "common/config_loader.h"
+
+namespace chat {
+
+/**
+ * Watches the configuration file with inotify and reloads the
+ * ConfigLoader when it changes. The parent directory is watched so
+ * editors that save by writing a temp file and renaming it are
+ * picked up too. Bursts of events are debounced into one reload.
+ * Linux only; start() returns false elsewhere.
+ *
+ * Other files loaded at runtime (such as the content filter blocklist)
+ * can be watched the same way with their own reload callback.
+ */
+class ConfigWatcher {
+public:
+    // Returns true if the file was applied
+    using ReloadCallback = std::function<bool()>;
+
+    explicit ConfigWatcher(ConfigLoader& loader,
+                           std::chrono::milliseconds debounce = std::chrono::milliseconds(200));
+    ConfigWatcher(std::string path, ReloadCallback reload,
+                  std::chrono::milliseconds debounce = std::chrono::milliseconds(200));
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    // Start the watcher thread
+    bool start();
+
+    // Stop and join the watcher thread
+    void stop();
+
+    // Number of reloads triggered by file changes
+    uint64_t reloadCount() const { return reload_count_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    std::string path_;
+    ReloadCallback reload_;
+    std::chrono::milliseconds debounce_;
+    int inotify_fd_ = -1;
+    int watch_fd_ = -1;
+    int stop_fd_ = -1;
+    std::thread thread_;
+    std::atomic<uint64_t> reload_count_{0};
+};
+
+} // namespace chat
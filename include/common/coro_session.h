@@ -0,0 +1,139 @@
+#pragma once
+
+#ifdef WITH_COROUTINES
+
+#include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "common/protocol.h"
+
+namespace chat_app {
+
+/**
+ * Connection driven by C++20 coroutines (Asio awaitables) instead of the
+ * callback chain of TcpConnection.
+ *
+ * Frames are read by worker coroutines that live as long as the session:
+ * each reads a frame into its own reused Frame and awaits the handler for
+ * it, so no per-frame closures, frames or buffers are created. Handler
+ * coroutine frames come from Asio's per-thread recycling allocator. A
+ * handler is a coroutine, so a multi-step flow (authenticate, then load
+ * history, then reply) is written as straight-line code.
+ *
+ * With max_in_flight workers, up to that many handlers run concurrently:
+ * while one awaits I/O the next worker reads the following frame, so a
+ * client can pipeline requests. Frames are read in order, one worker at a
+ * time; replies are written in completion order, never interleaved.
+ *
+ * Coroutines run on the socket's executor. When the io_context runs on
+ * several threads, create the socket on a strand (make_strand) so a
+ * session's coroutines never run concurrently; a strand costs a couple of
+ * allocations per operation, so single-threaded contexts go without.
+ */
+class CoroSession : public std::enable_shared_from_this<CoroSession> {
+public:
+    template <typename T>
+    using Awaitable = boost::asio::awaitable<T>;
+
+    struct Frame {
+        uint16_t type = 0;
+        uint16_t flags = 0;
+        std::vector<char> body;  // Reused; valid until the handler returns
+    };
+
+    using Handler = std::function<Awaitable<void>(CoroSession& session, Frame& frame)>;
+    using CloseCallback = std::function<void(const boost::system::error_code&)>;
+
+    struct Options {
+        std::size_t max_in_flight = 1;  // Concurrent handlers (1 = one request at a time)
+    };
+
+    struct Stats {
+        uint64_t frames_read = 0;
+        uint64_t frames_written = 0;
+        uint64_t peak_in_flight = 0;
+    };
+
+    static std::shared_ptr<CoroSession> create(boost::asio::ip::tcp::socket socket);
+    static std::shared_ptr<CoroSession> create(boost::asio::ip::tcp::socket socket, Options options);
+
+    CoroSession(const CoroSession&) = delete;
+    CoroSession& operator=(const CoroSession&) = delete;
+
+    // Start the workers; on_close is called once reading fails and every
+    // handler has finished
+    void start(Handler handler, CloseCallback on_close = nullptr);
+
+    // Read one frame directly, for flows that run before start() (e.g. a
+    // handshake). Must not be used once the workers run.
+    Awaitable<boost::system::error_code> readFrame(Frame& frame);
+
+    // Write one frame; body must stay valid until this completes
+    Awaitable<boost::system::error_code> write(uint16_t type, uint16_t flags, boost::asio::const_buffer body);
+
+    // Close the socket; pending reads and writes complete with errors
+    void close();
+
+    boost::asio::ip::tcp::socket& socket() { return socket_; }
+    boost::asio::any_io_executor executor() { return socket_.get_executor(); }
+    Stats stats() const;
+
+private:
+    struct Worker {
+        explicit Worker(const boost::asio::any_io_executor& executor) : turn(executor) {}
+
+        Frame frame;
+        boost::asio::steady_timer turn;  // Signalled when the read turn is handed over
+    };
+
+    CoroSession(boost::asio::ip::tcp::socket socket, Options options);
+
+    Awaitable<void> work(std::shared_ptr<CoroSession> self, Worker& worker);
+
+    // Read turn: one worker reads at a time, the others queue in order.
+    // The uncontended case stays out of a coroutine call.
+    bool tryAcquireReadTurn();
+    Awaitable<bool> queueForReadTurn(Worker& worker);
+    void releaseReadTurn();
+
+    // Validate a received header and size the frame for its body
+    bool decodeHeader(Frame& frame);
+
+    // Park the calling coroutine until signal(); callers re-check their
+    // condition, since one signal wakes every waiter
+    Awaitable<void> wait(boost::asio::steady_timer& signal);
+    static void signal(boost::asio::steady_timer& signal);
+
+    boost::asio::ip::tcp::socket socket_;
+    Options options_;
+    Handler handler_;
+    CloseCallback on_close_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<Worker*> turn_queue_;  // Ring of workers waiting to read
+    std::size_t turn_head_ = 0;
+    std::size_t turn_waiting_ = 0;
+    bool reading_ = false;
+    bool closed_ = false;
+    boost::system::error_code close_error_;
+    std::size_t running_workers_ = 0;
+    std::size_t in_flight_ = 0;
+
+    std::array<char, HEADER_SIZE> read_header_;
+    std::array<char, HEADER_SIZE> write_header_;
+    bool writing_ = false;
+    boost::asio::steady_timer write_done_;  // Signalled when a write finishes
+
+    std::atomic<uint64_t> frames_read_{0};
+    std::atomic<uint64_t> frames_written_{0};
+    std::atomic<uint64_t> peak_in_flight_{0};
+};
+
+} // namespace chat_app
+
+#endif // WITH_COROUTINES
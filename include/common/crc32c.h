@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace chat_app {
+
+/**
+ * CRC-32C (Castagnoli) checksum used to validate data at rest
+ * (message log records, state snapshots). Pass the previous result as
+ * crc to checksum data in pieces; start with 0.
+ */
+uint32_t crc32c(uint32_t crc, const void* data, std::size_t size);
+
+} // namespace chat_app
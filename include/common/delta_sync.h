@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chat_app {
+
+/**
+ * A room as the client caches it
+ */
+struct RosterRoom {
+    std::string room_id;
+    std::string name;
+    std::vector<std::string> members;   // User ids, any order
+};
+
+using Roster = std::vector<RosterRoom>;
+
+// Conversation (ChatMessage::conversationId) -> sequence held with no gap below it
+using SyncCursors = std::unordered_map<std::string, uint64_t>;
+
+/**
+ * Bodies of the SYNC / ROSTER exchange after login.
+ *
+ * The client sends SYNC with a digest of the rooms and members it has
+ * cached and, per conversation, the sequence it holds every message up
+ * to. The server compares the digest with the same digest over the
+ * user's current rooms and sends ROSTER only when they differ, then
+ * replays messages after the cursors exactly as for RESUME. A client whose cache is
+ * current gets nothing back but what it missed.
+ */
+struct SyncRequest {
+    uint64_t roster_digest = 0;     // 0 = nothing cached
+    SyncCursors cursors;
+
+    std::vector<char> encode() const;
+    static std::optional<SyncRequest> decode(const std::vector<char>& body);
+};
+
+// Order-independent digest of rooms and their members; 0 for no rooms
+uint64_t rosterDigest(const Roster& roster);
+
+// ROSTER body
+std::vector<char> encodeRoster(const Roster& roster);
+std::optional<Roster> decodeRoster(const std::vector<char>& body);
+
+} // namespace chat_app
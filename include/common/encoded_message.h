@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "common/chat_message.h"
+
+namespace chat_app {
+
+/**
+ * Wire encodings a ChatMessage body can be sent in
+ */
+enum class MessageEncoding : uint8_t {
+    JSON = 0,        // UTF-8 JSON document (MessageFlags::JSON)
+    BINARY = 1,      // ChatMessage::toBinary layout (MessageFlags::BINARY)
+    COMPRESSED = 2   // Deflated binary layout (MessageFlags::BINARY | COMPRESSED)
+};
+
+constexpr std::size_t MESSAGE_ENCODING_COUNT = 3;
+
+/**
+ * Serialize-once wrapper around a ChatMessage.
+ * Each encoding is computed lazily by the first consumer and the resulting
+ * bytes are shared (never copied) with every later consumer: recipient
+ * connections, the history ring and storage. Cached bodies are immutable;
+ * modifying the message drops them so the next consumer re-encodes.
+ *
+ * encoded() is safe to call concurrently from any thread. modify() must not
+ * run concurrently with readers of message().
+ */
+class EncodedMessage {
+public:
+    using Body = std::shared_ptr<const std::vector<char>>;
+
+    explicit EncodedMessage(ChatMessage message);
+
+    EncodedMessage(const EncodedMessage&) = delete;
+    EncodedMessage& operator=(const EncodedMessage&) = delete;
+
+    // Access the underlying message
+    const ChatMessage& message() const { return message_; }
+
+    // Get the encoded body, encoding it on first use
+    Body encoded(MessageEncoding encoding) const;
+    Body json() const { return encoded(MessageEncoding::JSON); }
+    Body binary() const { return encoded(MessageEncoding::BINARY); }
+    Body compressed() const { return encoded(MessageEncoding::COMPRESSED); }
+
+    // Header flags describing a body produced by encoded()
+    static uint16_t flagsFor(MessageEncoding encoding);
+
+    // Decode a body received with the given header flags
+    static ChatMessage decode(const std::vector<char>& body, uint16_t flags);
+
+    // Mutate the message and invalidate every cached encoding
+    template <typename Mutator>
+    void modify(Mutator&& mutator) {
+        std::lock_guard<std::mutex> lock(encode_mutex_);
+        mutator(message_);
+        for (auto& slot : cache_) {
+            std::atomic_store(&slot, Body());
+        }
+    }
+
+    // Number of times an encoding was actually computed (cache misses)
+    uint64_t encodeCount() const { return encode_count_.load(std::memory_order_relaxed); }
+
+private:
+    Body encodeUncached(MessageEncoding encoding) const;
+
+    ChatMessage message_;
+    mutable std::array<Body, MESSAGE_ENCODING_COUNT> cache_;
+    mutable std::mutex encode_mutex_;
+    mutable std::atomic<uint64_t> encode_count_{0};
+};
+
+using SharedEncodedMessage = std::shared_ptr<EncodedMessage>;
+
+// Convenience factory
+inline SharedEncodedMessage makeEncodedMessage(ChatMessage message) {
+    return std::make_shared<EncodedMessage>(std::move(message));
+}
+
+} // namespace chat_app
@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/system/error_code.hpp>
+#include "common/protocol.h"
+
+namespace chat { class ConfigLoader; }
+
+namespace chat_app {
+
+/**
+ * io_uring based socket transport shared by many TcpConnections.
+ * One completion thread owns the ring and:
+ * - keeps a multishot receive armed per socket, reading into a
+ *   kernel-provided buffer ring (no per-read buffer allocation)
+ * - collects sends queued from any thread and submits them for all
+ *   connections in a single io_uring_submit per loop iteration
+ * - uses SEND_ZC for frames whose body exceeds the zero-copy threshold
+ *
+ * Only compiled in when liburing is found (WITH_LIBURING); otherwise
+ * create() returns nullptr and callers stay on the Asio reactor.
+ */
+class IoUringTransport {
+public:
+    using SharedBody = std::shared_ptr<const std::vector<char>>;
+    using DataHandler = std::function<void(const char*, std::size_t)>;
+    using CloseHandler = std::function<void(const boost::system::error_code&)>;
+
+    struct Options {
+        unsigned queue_depth = 4096;              // Submission queue entries
+        unsigned buffer_count = 1024;             // Provided receive buffers (power of two)
+        unsigned buffer_size = 16 * 1024;         // Size of each receive buffer
+        std::size_t zero_copy_threshold = 64 * 1024; // SEND_ZC for bodies this large (0 = never)
+
+        // Read IO_URING_* keys from the server configuration
+        static Options fromConfig(const chat::ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t submit_calls = 0;       // io_uring_submit invocations
+        uint64_t frames_sent = 0;        // Frames handed to the kernel
+        uint64_t zero_copy_sends = 0;    // Sends that used SEND_ZC
+        uint64_t recv_completions = 0;   // Multishot receive completions
+    };
+
+    // Create and start a transport; returns nullptr if io_uring is not
+    // compiled in or the kernel rejects the ring setup
+    static std::shared_ptr<IoUringTransport> create(const Options& options);
+
+    // Whether this build was compiled with liburing
+    static bool isCompiledIn();
+
+    ~IoUringTransport();
+
+    IoUringTransport(const IoUringTransport&) = delete;
+    IoUringTransport& operator=(const IoUringTransport&) = delete;
+
+    // Start receiving on a connected socket. The transport duplicates the
+    // descriptor, so the caller keeps ownership of fd. Returns a handle
+    // used for send()/detach(), or -1 on failure. Handlers run on the
+    // completion thread.
+    int attach(int fd, DataHandler on_data, CloseHandler on_close);
+
+    // Stop all I/O for a handle; no handler is invoked afterwards
+    void detach(int handle);
+
+    // Queue a frame; safe to call from any thread
+    void send(int handle, const std::array<char, HEADER_SIZE>& header, SharedBody body);
+
+    // Stop the completion thread
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Impl;
+    explicit IoUringTransport(std::unique_ptr<Impl> impl);
+
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace chat_app
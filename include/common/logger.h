@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "common/config_loader.h"
+
+// Statements below this level are compiled out entirely
+// (0 = TRACE ... 4 = ERROR). Override with -DCHATAPP_LOG_MIN_LEVEL=n.
+#ifndef CHATAPP_LOG_MIN_LEVEL
+#define CHATAPP_LOG_MIN_LEVEL 0
+#endif
+
+// Logging macros. The format must be a string literal using "{}"
+// placeholders; arguments are captured in binary and formatted later
+// by the flusher thread. Disabled levels cost one relaxed atomic load.
+#define CHAT_LOG(level, ...)                                                              \
+    do {                                                                                  \
+        if constexpr (static_cast<int>(level) >= CHATAPP_LOG_MIN_LEVEL) {                 \
+            if (::chat::Logger::enabled(level)) {                                         \
+                ::chat::Logger::instance().log(level, __FILE__, __LINE__, __VA_ARGS__);   \
+            }                                                                             \
+        }                                                                                 \
+    } while (0)
+
+#define CHAT_LOG_TRACE(...) CHAT_LOG(::chat::LogLevel::TRACE, __VA_ARGS__)
+#define CHAT_LOG_DEBUG(...) CHAT_LOG(::chat::LogLevel::DEBUG, __VA_ARGS__)
+#define CHAT_LOG_INFO(...) CHAT_LOG(::chat::LogLevel::INFO, __VA_ARGS__)
+#define CHAT_LOG_WARN(...) CHAT_LOG(::chat::LogLevel::WARN, __VA_ARGS__)
+#define CHAT_LOG_ERROR(...) CHAT_LOG(::chat::LogLevel::ERROR, __VA_ARGS__)
+
+namespace chat {
+
+/**
+ * Asynchronous logger.
+ *
+ * Each thread that logs gets its own single-producer ring of fixed-size
+ * records, so the calling thread never takes a lock or touches a file:
+ * it stores a timestamp, the format pointer and its arguments in binary
+ * form and returns. A background thread drains all rings, expands the
+ * "{}" placeholders and writes batches to LOG_FILE (and the console if
+ * enabled). When a ring is full the record is dropped and counted
+ * rather than blocking the producer.
+ *
+ * Before start() and after stop(), records are formatted and written to
+ * stderr synchronously, so tools and tests need no setup.
+ */
+class Logger {
+public:
+    struct Options {
+        std::string file_path = "logs/server.log";
+        bool console = true;
+        LogLevel level = LogLevel::INFO;
+        std::size_t ring_slots = 4096;                        // Records per thread, power of two
+        std::chrono::milliseconds flush_interval{50};         // Maximum delay before a record is written
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t written = 0;   // Records written by the flusher
+        uint64_t dropped = 0;   // Records discarded because a ring was full
+    };
+
+    static Logger& instance();
+
+    // Runtime level check; compile-time filtering happens in CHAT_LOG
+    static bool enabled(LogLevel level) {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    static void setLevel(LogLevel level) { level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+    static LogLevel level() { return static_cast<LogLevel>(level_.load(std::memory_order_relaxed)); }
+
+    // Open the log file and start the flusher thread
+    bool start(const Options& options);
+
+    // Drain every ring, close the file and return to synchronous stderr output
+    void stop();
+
+    // Wait until everything logged before this call has been written
+    void flush();
+
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+    Stats stats() const;
+
+    // Capture a record; use the CHAT_LOG_* macros instead of calling this directly
+    template <std::size_t N, typename... Args>
+    void log(LogLevel level, const char* file, int line, const char (&format)[N], const Args&... args) {
+        Record record;
+        record.level = static_cast<uint8_t>(level);
+        record.line = static_cast<uint32_t>(line);
+        record.file = file;
+        record.format = format;
+        record.timestamp_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        (encodeArg(record, args), ...);
+        submit(record);
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+private:
+    // Argument type tags in the record payload
+    enum class ArgType : uint8_t {
+        INT,
+        UINT,
+        DOUBLE,
+        BOOL,
+        CHAR,
+        STRING,
+        POINTER
+    };
+
+    static constexpr std::size_t RECORD_SIZE = 256;
+    static constexpr std::size_t HEADER_BYTES = 32;
+    static constexpr std::size_t PAYLOAD_SIZE = RECORD_SIZE - HEADER_BYTES;
+
+    // One fixed-size ring slot
+    struct Record {
+        uint64_t timestamp_ns = 0;
+        const char* format = nullptr;
+        const char* file = nullptr;
+        uint32_t line = 0;
+        uint8_t level = 0;
+        uint8_t truncated = 0;
+        uint16_t payload_size = 0;
+        char payload[PAYLOAD_SIZE];
+    };
+    static_assert(sizeof(Record) == RECORD_SIZE, "Log records must fill one ring slot exactly");
+
+    struct ThreadBuffer;
+
+    Logger() = default;
+    ~Logger();
+
+    template <typename T>
+    static void encodeArg(Record& record, const T& value) {
+        using Value = std::decay_t<T>;
+        if constexpr (std::is_same_v<Value, bool>) {
+            encodeScalar(record, ArgType::BOOL, static_cast<uint8_t>(value));
+        } else if constexpr (std::is_same_v<Value, char>) {
+            encodeScalar(record, ArgType::CHAR, value);
+        } else if constexpr (std::is_enum_v<Value>) {
+            encodeScalar(record, ArgType::INT, static_cast<int64_t>(value));
+        } else if constexpr (std::is_integral_v<Value> && std::is_signed_v<Value>) {
+            encodeScalar(record, ArgType::INT, static_cast<int64_t>(value));
+        } else if constexpr (std::is_integral_v<Value>) {
+            encodeScalar(record, ArgType::UINT, static_cast<uint64_t>(value));
+        } else if constexpr (std::is_floating_point_v<Value>) {
+            encodeScalar(record, ArgType::DOUBLE, static_cast<double>(value));
+        } else if constexpr (std::is_array_v<T>) {
+            encodeString(record, std::string_view(value));
+        } else if constexpr (std::is_same_v<Value, const char*> || std::is_same_v<Value, char*>) {
+            encodeString(record, value ? std::string_view(value) : std::string_view("(null)"));
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            encodeString(record, std::string_view(value));
+        } else if constexpr (std::is_pointer_v<Value>) {
+            encodeScalar(record, ArgType::POINTER, reinterpret_cast<uintptr_t>(value));
+        } else {
+            static_assert(std::is_convertible_v<const T&, std::string_view>,
+                          "Unsupported log argument type; convert it to a string first");
+        }
+    }
+
+    template <typename Scalar>
+    static void encodeScalar(Record& record, ArgType type, Scalar value) {
+        if (record.payload_size + 1 + sizeof(Scalar) > PAYLOAD_SIZE) {
+            record.truncated = 1;
+            return;
+        }
+        char* out = record.payload + record.payload_size;
+        *out = static_cast<char>(type);
+        std::memcpy(out + 1, &value, sizeof(Scalar));
+        record.payload_size = static_cast<uint16_t>(record.payload_size + 1 + sizeof(Scalar));
+    }
+
+    static void encodeString(Record& record, std::string_view value);
+
+    // Format a captured record into a log line
+    static void formatRecord(const Record& record, uint32_t thread_id, std::string& out);
+
+    void submit(const Record& record);
+    ThreadBuffer& threadBuffer();
+    void run();
+    std::size_t drain(std::string& batch);
+    void write(const std::string& batch);
+
+    static std::atomic<int> level_;
+
+    Options options_;
+    std::atomic<bool> running_{false};
+    std::FILE* file_ = nullptr;
+    std::thread flusher_;
+
+    std::mutex buffers_mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    uint32_t next_thread_id_ = 1;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<bool> wake_requested_{false};
+    uint64_t flush_generation_ = 0;
+    std::condition_variable flushed_cv_;
+    uint64_t flushed_generation_ = 0;
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::mutex sync_mutex_;
+};
+
+} // namespace chat
@@ -27,7 +27,24 @@ enum class MessageType {
     JOIN_ROOM,          // Request to join a chat room
     LEAVE_ROOM,         // Request to leave a chat room
     CREATE_ROOM,        // Request to create a chat room
-    ERROR              // Error message
+    ERROR,             // Error message
+    PRESENCE_SUMMARY,  // Aggregated typing/read state for a room (server to client)
+    CLUSTER_HELLO,     // Inter-node link handshake
+    CLUSTER_DIRECTORY, // Inter-node user location and room interest updates
+    ROOM_HANDOFF,      // Room state moving to its new owner node
+    ROOM_HANDOFF_ACK,  // New owner confirms a room handoff
+    ROOM_APPEND,       // Room message forwarded to the owner node
+    ROOM_MEMBER,       // Room membership change forwarded to the owner node
+    LOG_APPEND,        // Message log records replicated to a follower node
+    LOG_ACK,           // Follower confirms log records are durable
+    DELIVERY_ACK,      // Client's cumulative per-conversation acks for sequenced messages
+    RESUME,            // Client's last-seen sequence per conversation after a reconnect
+    NOTIFICATION_SUMMARY, // Unread counts and mentions per room, sent after login (server to client)
+    SYNC,              // Client's cached roster digest and per-conversation high-water marks after login
+    ROSTER,            // The user's rooms and members, sent when the client's cached roster is stale
+    STREAM_OPEN,       // Gateway binds a stream id to a logical user; echoed back with the result
+    STREAM_CLOSE,      // Gateway or server ends a stream
+    STREAM_CREDIT      // Gateway lets the server send a stream more frames
 };
 
 /**
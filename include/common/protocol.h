@@ -1,8 +1,11 @@
-pragma once
+#pragma once
 #include <cstdint>
 #include <boost/asio.hpp>
 #include <array>
 #include <string>
+#include <vector>
+#include <functional>
+#include <optional>
 
 namespace chat_app {
 
@@ -55,6 +58,31 @@ private:
     uint32_t body_size_ = 0;
 };
 
+/**
+ * Incremental decoder turning a raw byte stream into framed messages.
+ * Used by transports that receive into their own buffers (io_uring)
+ * instead of issuing exact-size header and body reads.
+ */
+class FrameParser {
+public:
+    using FrameCallback = std::function<void(const std::vector<char>&, uint16_t, uint16_t)>;
+    
+    // Feed received bytes, invoking the callback for every completed frame.
+    // Returns false if an invalid header was seen; the stream is then unusable.
+    bool consume(const char* data, std::size_t size, const FrameCallback& callback);
+    
+    // Discard any partially received frame
+    void reset();
+
+private:
+    std::array<char, HEADER_SIZE> header_buffer_;
+    std::size_t header_bytes_ = 0;
+    bool have_header_ = false;
+    MessageHeader header_;
+    std::vector<char> body_;
+    std::size_t body_bytes_ = 0;
+};
+
 /**
  * Common flag definitions for protocol
  */
@@ -67,6 +95,29 @@ namespace MessageFlags {
     constexpr uint16_t BINARY     = 0x0020;   // Body is binary data
     constexpr uint16_t FRAGMENT   = 0x0040;   // Message is a fragment of a larger message
     constexpr uint16_t LAST_FRAG  = 0x0080;   // Last fragment in a message
+    constexpr uint16_t FORWARDED  = 0x0100;   // Relayed by another cluster node
+    constexpr uint16_t TRACED     = 0x0200;   // Trace this frame through the server (when tracing is on)
+    constexpr uint16_t MULTIPLEXED = 0x0400;  // Body starts with a StreamExtension (gateway connections)
 }
 
+/**
+ * Stream tag at the start of a MULTIPLEXED frame's body: a uint16 count
+ * followed by that many uint32 stream ids (network byte order). The rest
+ * of the body is the payload, meant for every listed stream, so a gateway
+ * carrying many logical users gets one frame for all of them.
+ */
+struct StreamExtension {
+    std::vector<uint32_t> streams;
+    
+    // Most stream ids one frame can carry with a payload of this size
+    static std::size_t capacity(std::size_t payload_size);
+    
+    // Extension followed by the payload
+    std::vector<char> encode(const char* payload, std::size_t size) const;
+    
+    // Parse the extension; returns the payload offset, or nullopt if the
+    // body is too short or lists no streams
+    static std::optional<std::size_t> decode(const std::vector<char>& body, StreamExtension& out);
+};
+
 } // namespace chat_app
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace chat_app {
+
+/**
+ * Read-only file descriptor shared by everything that sends from the
+ * file (queued frames, a download in progress); closed with the last
+ * reference. The file is never read into memory by this class.
+ */
+class SharedFile {
+public:
+    // nullptr if the file cannot be opened
+    static std::shared_ptr<const SharedFile> open(const std::string& path);
+
+    ~SharedFile();
+
+    SharedFile(const SharedFile&) = delete;
+    SharedFile& operator=(const SharedFile&) = delete;
+
+    int fd() const { return fd_; }
+    uint64_t size() const { return size_; }
+
+    // Read up to size bytes at offset; returns the count read, or -1
+    long read(uint64_t offset, char* data, std::size_t size) const;
+
+private:
+    SharedFile(int fd, uint64_t size) : fd_(fd), size_(size) {}
+
+    int fd_;
+    uint64_t size_;
+};
+
+} // namespace chat_app
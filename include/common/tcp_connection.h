@@ -1,5 +1,6 @@
 #pragma once
 #include <boost/asio.hpp>
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <deque>
@@ -7,9 +8,27 @@
 #include <functional>
 #include <mutex>
 #include "common/protocol.h"
+#include "common/io_uring_transport.h"
+#include "common/shared_file.h"
+#include "common/tls_stream.h"
+#include "common/trace.h"
 
 namespace chat_app {
 
+/**
+ * What to do with an incoming frame, decided from its header alone
+ */
+struct FrameVerdict {
+    enum Action {
+        ACCEPT,     // Read and deliver the frame
+        DELAY,      // Stop reading for `delay`, then deliver it (backpressure)
+        REJECT      // Read the body and drop the frame
+    };
+    
+    Action action = ACCEPT;
+    std::chrono::milliseconds delay{0};
+};
+
 /**
  * Class representing a TCP connection using Boost.Asio
  * This is the base class for both client and server connections
@@ -18,6 +37,8 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 public:
     using MessageCallback = std::function<void(const std::vector<char>&, uint16_t, uint16_t)>;
     using ErrorCallback = std::function<void(const boost::system::error_code&)>;
+    using SharedBody = std::shared_ptr<const std::vector<char>>;
+    using FrameFilter = std::function<FrameVerdict(uint16_t type, uint32_t body_size)>;
     
     TcpConnection(boost::asio::io_context& io_context);
     virtual ~TcpConnection();
@@ -25,6 +46,17 @@ public:
     // Socket access
     boost::asio::ip::tcp::socket& socket();
     
+    // Route this connection's I/O through a shared io_uring transport
+    // instead of the Asio reactor; must be called before start()
+    void useIoUring(std::shared_ptr<IoUringTransport> transport);
+    
+    // Encrypt this connection with TLS; the handshake runs in start().
+    // peer ("host:port") keys client-side session resumption.
+    void useTls(std::shared_ptr<TlsContext> context, const std::string& peer = "");
+    
+    // TLS state (nullptr when the connection is plain TCP)
+    const TlsStream* tlsStream() const { return tls_stream_.get(); }
+    
     // Start connection
     void start();
     
@@ -34,10 +66,31 @@ public:
     // Send a message
     bool send(const std::vector<char>& data, uint16_t type, uint16_t flags = 0);
     
+    // Send a pre-encoded body that may be shared with other connections
+    // (e.g. a broadcast frame from EncodedMessage); the bytes are not copied
+    bool send(SharedBody body, uint16_t type, uint16_t flags = 0);
+    
+    // Send a frame whose body is prefix followed by length bytes of file
+    // from offset. On a plain or kTLS socket the file bytes go from the
+    // page cache to the socket with sendfile(2); otherwise they are read
+    // in bounded chunks as they are written. The file must not shrink
+    // while queued.
+    bool sendFile(std::vector<char> prefix, std::shared_ptr<const SharedFile> file,
+                  uint64_t offset, uint32_t length, uint16_t type, uint16_t flags = 0);
+    
     // Set callbacks
     void setMessageCallback(MessageCallback callback);
     void setErrorCallback(ErrorCallback callback);
     
+    // Inspect each frame header before its body is read (e.g. rate
+    // limiting). With the io_uring transport frames arrive whole, so
+    // DELAY is treated as REJECT there.
+    void setFrameFilter(FrameFilter filter);
+    
+    // False when reads cannot be held back (io_uring); a filter should
+    // reject instead of returning DELAY
+    bool canPauseReads() const { return !uring_transport_; }
+    
     // Connection status
     bool isConnected() const;
     std::string getRemoteAddress() const;
@@ -52,11 +105,45 @@ protected:
     // Callback handlers
     void handleReadHeader(const boost::system::error_code& error);
     void handleReadBody(const boost::system::error_code& error);
+    void readFrameBody(uint32_t body_size);
+    void deliverFrame(const std::vector<char>& body);
     void handleWrite(const boost::system::error_code& error);
     
+    // Record write spans for traced messages in the finished batch
+    void traceWrites();
+    
+    // Send the file part of the frame the last write ended with
+    void writeFileRange();
+    void finishFileRange(const boost::system::error_code& error);
+    
     // Error handling
     void handleError(const boost::system::error_code& error);
     
+    // Bytes delivered by the io_uring transport
+    void handleTransportData(const char* data, std::size_t size);
+    
+    // TLS handshake completion
+    void handleHandshake(const boost::system::error_code& error);
+    
+    // Read/write through TLS when enabled, the raw socket otherwise
+    template <typename Buffers, typename Handler>
+    void asyncReadExactly(const Buffers& buffers, Handler&& handler) {
+        if (tls_stream_) {
+            boost::asio::async_read(*tls_stream_, buffers, std::forward<Handler>(handler));
+        } else {
+            boost::asio::async_read(socket_, buffers, std::forward<Handler>(handler));
+        }
+    }
+    
+    template <typename Buffers, typename Handler>
+    void asyncWriteAll(const Buffers& buffers, Handler&& handler) {
+        if (tls_stream_) {
+            boost::asio::async_write(*tls_stream_, buffers, std::forward<Handler>(handler));
+        } else {
+            boost::asio::async_write(socket_, buffers, std::forward<Handler>(handler));
+        }
+    }
+    
     // Member variables
     boost::asio::io_context& io_context_;
     boost::asio::ip::tcp::socket socket_;
@@ -65,20 +152,48 @@ protected:
     std::array<char, HEADER_SIZE> read_header_buffer_;
     std::vector<char> read_body_buffer_;
     MessageHeader current_header_;
+    bool discard_body_ = false;                 // Current frame was rejected by the filter
+    uint64_t trace_id_ = 0;                     // Current frame is sampled for tracing
+    uint64_t read_started_ns_ = 0;
+    boost::asio::steady_timer read_pause_timer_;  // Delays reading of a throttled frame
     
     // Write queue
+    struct FileRange {
+        std::shared_ptr<const SharedFile> file;
+        uint64_t offset = 0;
+        uint32_t length = 0;
+    };
+    
     struct OutgoingMessage {
-        std::vector<char> header_buffer;
-        std::vector<char> body;
+        std::array<char, HEADER_SIZE> header_buffer;
+        SharedBody body;
+        FileRange file;     // Sent after body when file is set
+        uint64_t trace_id = 0;      // Sent while handling a traced frame
+        uint64_t enqueued_ns = 0;
     };
     
     std::deque<OutgoingMessage> write_queue_;
     bool write_in_progress_;
+    std::size_t write_batch_size_ = 0;  // Queued messages covered by the current write
+    bool handshake_complete_ = true;    // Writes are held back until TLS is up
+    FileRange file_in_flight_;          // Rest of the file part being written
+    std::vector<char> file_chunk_;      // Copy buffer when sendfile cannot be used
     std::mutex write_mutex_;
     
+    // Optional io_uring transport (nullptr = Asio reactor)
+    std::shared_ptr<IoUringTransport> uring_transport_;
+    int uring_handle_ = -1;
+    FrameParser uring_parser_;
+    
+    // Optional TLS layer
+    std::shared_ptr<TlsContext> tls_context_;
+    std::string tls_peer_;
+    std::unique_ptr<TlsStream> tls_stream_;
+    
     // Callbacks
     MessageCallback message_callback_;
     ErrorCallback error_callback_;
+    FrameFilter frame_filter_;
     bool is_connected_;
 };
 
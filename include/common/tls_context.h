@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// OpenSSL types, kept opaque so this header does not require OpenSSL
+struct ssl_ctx_st;
+struct ssl_st;
+struct ssl_session_st;
+
+namespace chat { class ConfigLoader; }
+
+namespace chat_app {
+
+/**
+ * Which side of the TLS handshake a connection plays
+ */
+enum class TlsRole {
+    SERVER,
+    CLIENT
+};
+
+/**
+ * Shared TLS configuration (wraps an OpenSSL SSL_CTX).
+ * Server contexts keep a session cache and issue session tickets so
+ * reconnecting clients resume with an abbreviated handshake. Client
+ * contexts remember the latest session per peer and offer it on the
+ * next connect. When kernel TLS is enabled and available, the record
+ * layer is pushed into the kernel after the handshake.
+ */
+class TlsContext {
+public:
+    struct Options {
+        std::string cert_file;                 // PEM certificate chain (server)
+        std::string key_file;                  // PEM private key (server)
+        std::string ca_file;                   // Trust store for peer verification
+        bool verify_peer = false;              // Require a valid peer certificate
+        bool enable_ktls = true;               // Offload records to kernel TLS if possible
+        bool enable_resumption = true;         // Session cache + tickets
+        std::size_t session_cache_size = 20480; // Cached sessions (server and client)
+        long session_timeout = 7200;           // Session lifetime in seconds
+        int num_tickets = 2;                   // TLS 1.3 tickets issued per handshake
+
+        // Read CERT_FILE, KEY_FILE and SSL_* keys from the configuration
+        static Options fromConfig(const chat::ConfigLoader& config);
+    };
+
+    // Create a context; returns nullptr (and logs) if OpenSSL support is
+    // missing or the certificate/key cannot be loaded
+    static std::shared_ptr<TlsContext> create(TlsRole role, const Options& options);
+
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    TlsRole role() const { return role_; }
+    const Options& options() const { return options_; }
+
+    // Create a new SSL object for one connection (caller frees it)
+    ssl_st* newSsl() const;
+
+    // Client session cache keyed by peer ("host:port")
+    void storeSession(const std::string& peer, ssl_session_st* session);
+    ssl_session_st* findSession(const std::string& peer) const;  // Caller must free
+
+private:
+    TlsContext(TlsRole role, const Options& options);
+
+    TlsRole role_;
+    Options options_;
+    ssl_ctx_st* ctx_ = nullptr;
+
+    // LRU of resumable client sessions
+    mutable std::mutex session_mutex_;
+    std::list<std::string> session_order_;
+    std::unordered_map<std::string, std::pair<std::shared_ptr<ssl_session_st>,
+                                              std::list<std::string>::iterator>> sessions_;
+};
+
+} // namespace chat_app
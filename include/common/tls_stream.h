@@ -0,0 +1,171 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include "common/tls_context.h"
+
+namespace chat_app {
+
+/**
+ * TLS layer over a connected TCP socket, usable with boost::asio::async_read
+ * and async_write (models AsyncReadStream/AsyncWriteStream).
+ *
+ * OpenSSL talks to the socket directly through a socket BIO rather than
+ * Asio's memory BIOs, which is what lets it switch the connection to
+ * kernel TLS after the handshake. With kTLS send active, writes bypass
+ * OpenSSL entirely and go to the socket as plain gather writes that the
+ * kernel encrypts; otherwise SSL_read/SSL_write are driven by socket
+ * readiness waits. The socket is put in non-blocking mode.
+ */
+class TlsStream {
+public:
+    using executor_type = boost::asio::ip::tcp::socket::executor_type;
+
+    // peer identifies the server for client-side session resumption
+    TlsStream(boost::asio::ip::tcp::socket& socket,
+              std::shared_ptr<TlsContext> context,
+              std::string peer = "");
+    ~TlsStream();
+
+    TlsStream(const TlsStream&) = delete;
+    TlsStream& operator=(const TlsStream&) = delete;
+
+    executor_type get_executor() { return socket_.get_executor(); }
+
+    // Perform the TLS handshake for the context's role
+    template <typename Handler>
+    void async_handshake(Handler&& handler) {
+        boost::system::error_code ec;
+        IoStatus status = doHandshake(ec);
+        if (status == IoStatus::WANT_READ || status == IoStatus::WANT_WRITE) {
+            wait(status, [this, h = std::forward<Handler>(handler)](
+                    const boost::system::error_code& wait_ec) mutable {
+                if (wait_ec) {
+                    h(wait_ec);
+                    return;
+                }
+                async_handshake(std::move(h));
+            });
+            return;
+        }
+        boost::asio::post(socket_.get_executor(), [h = std::forward<Handler>(handler), ec]() mutable {
+            h(ec);
+        });
+    }
+
+    // Read some decrypted bytes into the first non-empty buffer
+    template <typename MutableBufferSequence, typename ReadHandler>
+    void async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler) {
+        boost::asio::mutable_buffer buffer = firstBuffer<boost::asio::mutable_buffer>(buffers);
+        std::size_t transferred = 0;
+        boost::system::error_code ec;
+        IoStatus status = buffer.size() == 0 ? IoStatus::DONE
+                                             : doRead(buffer.data(), buffer.size(), transferred, ec);
+        if (status == IoStatus::WANT_READ || status == IoStatus::WANT_WRITE) {
+            wait(status, [this, buffers, h = std::forward<ReadHandler>(handler)](
+                    const boost::system::error_code& wait_ec) mutable {
+                if (wait_ec) {
+                    h(wait_ec, 0);
+                    return;
+                }
+                async_read_some(buffers, std::move(h));
+            });
+            return;
+        }
+        boost::asio::post(socket_.get_executor(), [h = std::forward<ReadHandler>(handler), ec, transferred]() mutable {
+            h(ec, transferred);
+        });
+    }
+
+    // Write some bytes from the buffer sequence
+    template <typename ConstBufferSequence, typename WriteHandler>
+    void async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler) {
+        if (ktls_send_) {
+            // Kernel encrypts: hand the whole gather list straight to the socket
+            socket_.async_write_some(buffers, std::forward<WriteHandler>(handler));
+            return;
+        }
+
+        // Coalesce small gather lists (frame header + body) so they share
+        // one TLS record instead of paying for a record each
+        boost::asio::const_buffer buffer = firstBuffer<boost::asio::const_buffer>(buffers);
+        std::size_t total = boost::asio::buffer_size(buffers);
+        if (total > buffer.size() && total <= MAX_COALESCED_WRITE) {
+            write_scratch_.resize(total);
+            boost::asio::buffer_copy(boost::asio::buffer(write_scratch_), buffers);
+            buffer = boost::asio::buffer(write_scratch_);
+        }
+        std::size_t transferred = 0;
+        boost::system::error_code ec;
+        IoStatus status = buffer.size() == 0 ? IoStatus::DONE
+                                             : doWrite(buffer.data(), buffer.size(), transferred, ec);
+        if (status == IoStatus::WANT_READ || status == IoStatus::WANT_WRITE) {
+            wait(status, [this, buffers, h = std::forward<WriteHandler>(handler)](
+                    const boost::system::error_code& wait_ec) mutable {
+                if (wait_ec) {
+                    h(wait_ec, 0);
+                    return;
+                }
+                async_write_some(buffers, std::move(h));
+            });
+            return;
+        }
+        boost::asio::post(socket_.get_executor(), [h = std::forward<WriteHandler>(handler), ec, transferred]() mutable {
+            h(ec, transferred);
+        });
+    }
+
+    // Send close_notify (best effort, non-blocking)
+    void shutdown();
+
+    // Handshake results
+    bool sessionReused() const;
+    bool isKtlsSend() const { return ktls_send_; }
+    bool isKtlsRecv() const { return ktls_recv_; }
+    const std::string& peer() const { return peer_; }
+
+private:
+    enum class IoStatus { DONE, WANT_READ, WANT_WRITE, FAILED };
+    
+    // Largest gather list copied into one record (TLS max plaintext)
+    static constexpr std::size_t MAX_COALESCED_WRITE = 16 * 1024;
+
+    IoStatus doHandshake(boost::system::error_code& ec);
+    IoStatus doRead(void* data, std::size_t size, std::size_t& transferred, boost::system::error_code& ec);
+    IoStatus doWrite(const void* data, std::size_t size, std::size_t& transferred, boost::system::error_code& ec);
+    IoStatus translate(int result, boost::system::error_code& ec);
+
+    template <typename WaitHandler>
+    void wait(IoStatus status, WaitHandler&& handler) {
+        socket_.async_wait(status == IoStatus::WANT_WRITE
+                               ? boost::asio::ip::tcp::socket::wait_write
+                               : boost::asio::ip::tcp::socket::wait_read,
+                           std::forward<WaitHandler>(handler));
+    }
+
+    template <typename Buffer, typename BufferSequence>
+    static Buffer firstBuffer(const BufferSequence& buffers) {
+        auto end = boost::asio::buffer_sequence_end(buffers);
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); it != end; ++it) {
+            Buffer buffer(*it);
+            if (buffer.size() != 0) {
+                return buffer;
+            }
+        }
+        return Buffer();
+    }
+
+    boost::asio::ip::tcp::socket& socket_;
+    std::shared_ptr<TlsContext> context_;
+    std::string peer_;
+    ssl_st* ssl_ = nullptr;
+    std::mutex ssl_mutex_;  // Reads and writes may run on different threads
+    std::vector<char> write_scratch_;  // Only one write is in flight at a time
+    bool ktls_send_ = false;
+    bool ktls_recv_ = false;
+};
+
+} // namespace chat_app
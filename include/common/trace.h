@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "common/config_loader.h"
+
+namespace chat {
+
+/**
+ * Pipeline stages a traced frame passes through
+ */
+enum class TraceStage : uint8_t {
+    READ,       // Header read to body read (includes throttling delays)
+    DISPATCH,   // Message callback of the receiving connection
+    DECODE,     // Body to ChatMessage
+    ROUTE,      // Recipient lookup and fan-out
+    STORE,      // Persistence
+    ENQUEUE,    // Frame queued on an outgoing connection
+    WRITE       // Queued frame to write completion
+};
+
+const char* traceStageName(TraceStage stage);
+
+/**
+ * Sampled per-message latency tracing.
+ *
+ * When sampling is on, one frame in sample_rate (and every frame a
+ * client sends with MessageFlags::TRACED) gets a trace id as its header
+ * is read. The id is made current on the reading thread while the frame
+ * is dispatched, so TraceSpan scopes in decode/route/store code and the
+ * sends it causes are attributed to it without passing it around; work
+ * handed to another thread carries it with TraceContext.
+ *
+ * Spans are steady_clock intervals written to one ring of fixed slots
+ * claimed with a fetch_add, so recording never blocks and the oldest
+ * spans are overwritten when it wraps. The ring is reached through a
+ * plain atomic pointer; a ring replaced by start() is freed only once no
+ * record() call is in progress. exportChromeTrace() writes them
+ * as Chrome trace JSON (chrome://tracing, Perfetto). With sampling off
+ * each hook costs one branch: a relaxed load in the connection, a
+ * thread-local read in TraceSpan.
+ */
+class Tracer {
+public:
+    struct Options {
+        uint32_t sample_rate = 0;             // Trace one frame in N; 0 = off
+        std::size_t ring_slots = 65536;       // Spans kept, power of two
+        std::string file_path = "logs/trace.json";
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Span {
+        uint64_t trace_id = 0;
+        TraceStage stage = TraceStage::READ;
+        uint32_t thread_id = 0;
+        uint64_t start_ns = 0;   // steady_clock
+        uint64_t end_ns = 0;
+    };
+
+    struct Stats {
+        uint64_t traces = 0;        // Frames sampled
+        uint64_t spans = 0;         // Spans recorded
+        uint64_t overwritten = 0;   // Spans lost to ring wrap-around
+    };
+
+    static Tracer& instance();
+
+    // Whether frames are being sampled
+    static bool active() { return active_.load(std::memory_order_relaxed); }
+
+    // Trace of the frame being handled on this thread (0 = none)
+    static uint64_t current() { return current_trace_; }
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Start sampling with a fresh ring; spans from an earlier run are dropped
+    void start(const Options& options);
+
+    // Stop sampling; recorded spans stay available for export
+    void stop();
+
+    // Trace id for an incoming frame, or 0 if it is not sampled
+    uint64_t sample(uint16_t flags);
+
+    void record(uint64_t trace_id, TraceStage stage, uint64_t start_ns, uint64_t end_ns);
+
+    // Spans in the ring, oldest first
+    std::vector<Span> spans() const;
+
+    void exportChromeTrace(std::ostream& out) const;
+
+    // Export to Options::file_path
+    bool writeChromeTrace() const;
+
+    const Options& options() const { return options_; }
+    Stats stats() const;
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+private:
+    friend class TraceContext;
+
+    struct Ring;
+
+    Tracer() = default;
+    ~Tracer();
+
+    // Free replaced rings if no record() call can still be using one
+    void reclaimLocked();
+
+    static uint32_t threadId();
+
+    static std::atomic<bool> active_;
+    static inline thread_local uint64_t current_trace_ = 0;
+
+    Options options_;
+    mutable std::mutex mutex_;                     // Serializes start() with readers of the ring
+    std::unique_ptr<Ring> current_;                // Owns ring_
+    std::vector<std::unique_ptr<Ring>> retired_;   // Replaced, not yet freed
+    std::atomic<Ring*> ring_{nullptr};
+    std::atomic<uint64_t> recording_{0};           // record() calls in progress
+    std::atomic<uint64_t> next_trace_{1};
+    std::atomic<uint64_t> traces_{0};
+};
+
+/**
+ * Makes a trace current on this thread for its lifetime
+ */
+class TraceContext {
+public:
+    explicit TraceContext(uint64_t trace_id) : previous_(Tracer::current_trace_) {
+        Tracer::current_trace_ = trace_id;
+    }
+
+    ~TraceContext() { Tracer::current_trace_ = previous_; }
+
+    TraceContext(const TraceContext&) = delete;
+    TraceContext& operator=(const TraceContext&) = delete;
+
+private:
+    uint64_t previous_;
+};
+
+/**
+ * Records a stage of the current trace from construction to destruction;
+ * does nothing when the thread is not handling a traced frame
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(TraceStage stage) : trace_id_(Tracer::current()), stage_(stage) {
+        if (trace_id_) {
+            start_ns_ = Tracer::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (trace_id_) {
+            Tracer::instance().record(trace_id_, stage_, start_ns_, Tracer::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    uint64_t trace_id_;
+    TraceStage stage_;
+    uint64_t start_ns_ = 0;
+};
+
+} // namespace chat
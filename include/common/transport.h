@@ -0,0 +1,36 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string>
+
+namespace chat_app {
+
+/**
+ * Socket I/O backends a TcpConnection can run on
+ */
+enum class TransportBackend {
+    ASIO,       // Boost.Asio reactor (epoll), always available
+    IO_URING    // Linux io_uring, requires liburing at build time
+};
+
+// Parse the TRANSPORT_BACKEND config value, defaulting to ASIO
+inline TransportBackend parseTransportBackend(const std::string& name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+
+    if (lower == "io_uring" || lower == "iouring" || lower == "uring") {
+        return TransportBackend::IO_URING;
+    }
+    if (!lower.empty() && lower != "asio" && lower != "epoll") {
+        std::cerr << "Warning: Unknown transport backend '" << name << "', defaulting to asio" << std::endl;
+    }
+    return TransportBackend::ASIO;
+}
+
+inline const char* transportBackendName(TransportBackend backend) {
+    return backend == TransportBackend::IO_URING ? "io_uring" : "asio";
+}
+
+} // namespace chat_app
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <optional>
 #include <chrono>
@@ -18,6 +19,17 @@ enum class UserStatus {
     DO_NOT_DISTURB = 3
 };
 
+/**
+ * Dirty bits for User fields changed since the last save
+ */
+namespace UserFields {
+    constexpr uint8_t STATUS    = 0x01;   // status
+    constexpr uint8_t PROFILE   = 0x02;   // display_name, email, avatar_url
+    constexpr uint8_t LAST_SEEN = 0x04;   // last_seen
+    constexpr uint8_t ROOMS     = 0x08;   // room_ids
+    constexpr uint8_t ALL       = 0x0F;   // New user: write everything
+}
+
 /**
  * Lightweight struct for user representation
  * Optimized for JSON serialization/deserialization and memory efficiency
@@ -37,6 +49,10 @@ struct User {
     // Vector of room IDs this user belongs to
     std::vector<std::string> room_ids;
     
+    // UserFields changed since the last save; set by the setters below
+    // (assigning fields directly bypasses tracking) and not serialized
+    uint8_t dirty_fields = 0;
+    
     // Constructors
     User() = default;
     
@@ -60,11 +76,48 @@ struct User {
         return display_name.value_or(username); 
     }
     
+    // Tracked setters
+    void setStatus(UserStatus user_status) {
+        if (status != user_status) {
+            status = user_status;
+            dirty_fields |= UserFields::STATUS;
+        }
+    }
+    
+    void setDisplayName(std::optional<std::string> name) {
+        if (display_name != name) {
+            display_name = std::move(name);
+            dirty_fields |= UserFields::PROFILE;
+        }
+    }
+    
+    void setEmail(std::optional<std::string> address) {
+        if (email != address) {
+            email = std::move(address);
+            dirty_fields |= UserFields::PROFILE;
+        }
+    }
+    
+    void setAvatarUrl(std::optional<std::string> url) {
+        if (avatar_url != url) {
+            avatar_url = std::move(url);
+            dirty_fields |= UserFields::PROFILE;
+        }
+    }
+    
+    void setLastSeen(std::chrono::system_clock::time_point time) {
+        last_seen = time;
+        dirty_fields |= UserFields::LAST_SEEN;
+    }
+    
+    bool isDirty() const { return dirty_fields != 0; }
+    
     // Add user to a room
     void addToRoom(const std::string& room_id) {
         // Check if room_id already exists in the vector
         if (std::find(room_ids.begin(), room_ids.end(), room_id) == room_ids.end()) {
             room_ids.push_back(room_id);
+            dirty_fields |= UserFields::ROOMS;
         }
     }
     
@@ -73,6 +126,7 @@ struct User {
         auto it = std::find(room_ids.begin(), room_ids.end(), room_id);
         if (it != room_ids.end()) {
             room_ids.erase(it);
+            dirty_fields |= UserFields::ROOMS;
         }
     }
     
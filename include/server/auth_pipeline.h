@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+#include "common/config_loader.h"
+
+namespace chat {
+
+/**
+ * Password hashing with scrypt, a memory-hard KDF.
+ *
+ * Hashes are stored self-describing as scrypt$N$r$p$<salt hex>$<key hex>,
+ * so the cost can be raised later without invalidating existing hashes.
+ * Needs OpenSSL; without it hash() fails and verify() rejects everything.
+ */
+class PasswordHasher {
+public:
+    struct Params {
+        uint64_t n = 16384;  // CPU/memory cost (power of two); 128 * n * r bytes of memory
+        uint32_t r = 8;      // Block size
+        uint32_t p = 1;      // Parallelism
+    };
+
+    static std::optional<std::string> hash(const std::string& password);
+    static std::optional<std::string> hash(const std::string& password, const Params& params);
+
+    // Constant-time comparison against a stored hash
+    static bool verify(const std::string& password, const std::string& encoded);
+};
+
+/**
+ * Session tokens of recently authenticated users, least recently used
+ * first out. A client that reconnects with a cached token skips the KDF.
+ * Thread-safe.
+ */
+class SessionTokenCache {
+public:
+    SessionTokenCache(std::size_t capacity, std::chrono::seconds ttl);
+
+    // New random token for the user
+    std::string issue(const std::string& user_id);
+
+    // User of a live token; refreshes its position but not its expiry
+    std::optional<std::string> lookup(const std::string& token);
+
+    void revoke(const std::string& token);
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        std::string token;
+        std::string user_id;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::size_t capacity_;
+    std::chrono::seconds ttl_;
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_;  // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+/**
+ * Verifies AUTH_REQUEST credentials away from the io_context threads.
+ *
+ * Password checks run the KDF on a fixed pool of worker threads behind a
+ * bounded queue, so a login storm costs CPU on the pool instead of
+ * stalling message routing; when the queue is full the request completes
+ * with BUSY at once and the client can be refused with a retry hint.
+ * Requests carrying a cached session token are answered without touching
+ * the pool. Completions are posted to the executor given with each
+ * request, normally the connection's, so they run where the connection
+ * lives.
+ */
+class AuthPipeline {
+public:
+    struct Options {
+        std::size_t workers = 2;                 // AUTH_WORKERS (0 = half the hardware threads)
+        std::size_t max_queued = 256;            // AUTH_QUEUE_SIZE
+        std::size_t token_cache_size = 10000;    // AUTH_TOKEN_CACHE_SIZE
+        std::chrono::seconds token_ttl{86400};   // AUTH_TOKEN_TTL
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Credential {
+        std::string user_id;
+        std::string password_hash;  // PasswordHasher encoding
+    };
+
+    // Called on the worker threads, so it must be thread-safe
+    using CredentialLookup = std::function<std::optional<Credential>(const std::string& username)>;
+
+    struct Request {
+        std::string username;
+        std::string password;
+        std::string token;  // Session token from an earlier login, if any
+    };
+
+    enum class Status {
+        OK,
+        INVALID,  // Unknown user, wrong password or expired token
+        BUSY      // Queue full or pipeline stopped; retry later
+    };
+
+    struct Result {
+        Status status = Status::INVALID;
+        std::string user_id;
+        std::string token;        // Token to present on the next connect
+        bool from_cache = false;  // Token accepted without the KDF
+    };
+
+    using Completion = std::function<void(const Result& result)>;
+
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t cache_hits = 0;     // Answered from the token cache
+        uint64_t verified = 0;       // KDF runs
+        uint64_t succeeded = 0;
+        uint64_t failed = 0;
+        uint64_t rejected_busy = 0;
+        uint64_t queued = 0;         // Waiting for a worker now
+        uint64_t peak_queued = 0;
+    };
+
+    AuthPipeline(Options options, CredentialLookup lookup);
+    ~AuthPipeline();
+
+    AuthPipeline(const AuthPipeline&) = delete;
+    AuthPipeline& operator=(const AuthPipeline&) = delete;
+
+    void start();
+
+    // Join the workers; queued requests complete with BUSY
+    void stop();
+
+    // Verify a request; completion is posted to executor
+    void submit(const boost::asio::any_io_executor& executor, Request request, Completion completion);
+
+    // Forget a token, e.g. on logout
+    void revoke(const std::string& token) { tokens_.revoke(token); }
+
+    Stats stats() const;
+
+private:
+    struct Job {
+        boost::asio::any_io_executor executor;
+        Request request;
+        Completion completion;
+    };
+
+    void workerLoop();
+    Result verify(const Request& request);
+    static void complete(Job& job, Result result);
+
+    Options options_;
+    CredentialLookup lookup_;
+    SessionTokenCache tokens_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Job> queue_;
+    bool running_ = false;
+    std::vector<std::thread> workers_;
+
+    std::atomic<uint64_t> submitted_{0};
+    std::atomic<uint64_t> cache_hits_{0};
+    std::atomic<uint64_t> verified_{0};
+    std::atomic<uint64_t> succeeded_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> rejected_busy_{0};
+    std::atomic<uint64_t> queued_{0};
+    std::atomic<uint64_t> peak_queued_{0};
+};
+
+} // namespace chat
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+#include "common/config_loader.h"
+#include "common/encoded_message.h"
+#include "common/tcp_connection.h"
+#include "server/node_directory.h"
+
+namespace chat {
+
+/**
+ * Address of another chat_server instance in the cluster
+ */
+struct NodeInfo {
+    std::string node_id;
+    std::string host;
+    uint16_t port = 0;
+
+    // Parse "id@host:port"; returns false on malformed input
+    static bool parse(const std::string& text, NodeInfo& out);
+};
+
+/**
+ * Links chat_server instances into a cluster.
+ *
+ * Every node keeps one persistent outbound TcpConnection per peer for
+ * sending and accepts the peers' outbound connections for receiving, so
+ * each direction of a pair has its own ordered stream and no connect
+ * races. Frames use the normal MessageHeader framing:
+ *
+ * - CLUSTER_HELLO names the sending node when a link comes up.
+ * - CLUSTER_DIRECTORY carries batched user online/offline and room
+ *   interest changes; the first one on a link is a full snapshot.
+ * - Forwarded chat messages keep their message type and carry the
+ *   FORWARDED flag with a shared binary body, so a node never forwards
+ *   them again.
+ *
+ * Direct messages go to the node the recipient is connected to; room
+ * messages go once to each node that has members in the room, which
+ * then fans out locally. Frames for a peer that is reconnecting are
+ * queued (bounded) and sent when the link is back.
+ */
+class ClusterManager {
+public:
+    struct Options {
+        std::string node_id;                                   // Empty = clustering disabled
+        std::string listen_address = "0.0.0.0";
+        uint16_t listen_port = 0;                              // 0 = pick an ephemeral port
+        std::vector<NodeInfo> peers;
+        std::chrono::milliseconds reconnect_interval{1000};
+        std::chrono::milliseconds directory_flush_interval{10};
+        std::size_t max_pending_frames = 10000;                // Per peer, while disconnected
+
+        bool enabled() const { return !node_id.empty(); }
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t forwarded = 0;          // Chat frames sent to peers
+        uint64_t received = 0;           // Chat frames received from peers
+        uint64_t dropped = 0;            // Frames discarded (unknown peer or queue full)
+        uint64_t directory_updates = 0;  // Directory frames broadcast
+    };
+
+    // Delivers a message forwarded by another node to local recipients
+    using DeliveryHandler = std::function<void(const chat_app::SharedEncodedMessage& message,
+                                               const std::string& from_node)>;
+    // Notified when a peer's inbound link comes up or goes away
+    using MembershipCallback = std::function<void(const std::string& node_id, bool up)>;
+    // Handles an inter-node frame type registered by another component
+    using FrameHandler = std::function<void(const std::string& from_node, const std::vector<char>& body,
+                                            uint16_t flags)>;
+
+    ClusterManager(boost::asio::io_context& io_context, Options options, DeliveryHandler delivery);
+    ~ClusterManager();
+
+    ClusterManager(const ClusterManager&) = delete;
+    ClusterManager& operator=(const ClusterManager&) = delete;
+
+    // Listen for peers and connect to the configured ones
+    bool start();
+    void stop();
+
+    const std::string& nodeId() const { return options_.node_id; }
+    uint16_t listenPort() const { return listen_port_; }
+    NodeDirectory& directory() { return directory_; }
+    const NodeDirectory& directory() const { return directory_; }
+
+    // Add or remove a peer at runtime
+    void addPeer(const NodeInfo& peer);
+    void removePeer(const std::string& node_id);
+
+    // Called when a peer becomes reachable (it said hello and its address
+    // is known) and when it goes away
+    void setMembershipCallback(MembershipCallback callback);
+
+    // Route inbound frames of a message type to a handler (e.g. room handoff)
+    void setFrameHandler(uint16_t type, FrameHandler handler);
+
+    // Send a frame to a peer, queueing it while the link is down.
+    // Returns false if the node is not a known peer.
+    bool sendToNode(const std::string& node_id, chat_app::TcpConnection::SharedBody body,
+                    uint16_t type, uint16_t flags = 0);
+
+    // Local presence, announced to peers in batches
+    void userOnline(const std::string& user_id);
+    void userOffline(const std::string& user_id);
+    void roomMemberJoined(const std::string& room_id);
+    void roomMemberLeft(const std::string& room_id);
+
+    // Forward a direct message if its recipient is on another node.
+    // Returns false when the recipient is local or unknown.
+    bool forwardDirect(const chat_app::SharedEncodedMessage& message);
+
+    // Send one copy of a room message to every other node with members
+    // in the room; returns the number of nodes it was sent to
+    std::size_t forwardToRoom(const chat_app::SharedEncodedMessage& message);
+
+    // Peers whose outbound link is currently up
+    std::vector<std::string> connectedPeers() const;
+
+    Stats stats() const;
+
+private:
+    struct PendingFrame {
+        chat_app::TcpConnection::SharedBody body;
+        uint16_t type;
+        uint16_t flags;
+    };
+
+    // Outbound link to one peer
+    struct PeerLink {
+        NodeInfo peer;
+        std::shared_ptr<chat_app::TcpConnection> connection;
+        bool connected = false;
+        bool removed = false;
+        std::deque<PendingFrame> pending;
+        std::unique_ptr<boost::asio::steady_timer> retry_timer;
+    };
+
+    // Inbound link from one peer; node_id is known after CLUSTER_HELLO
+    struct InboundLink {
+        std::shared_ptr<chat_app::TcpConnection> connection;
+        std::string node_id;
+    };
+
+    void doAccept();
+    void connect(const std::shared_ptr<PeerLink>& link);
+    void scheduleReconnect(const std::shared_ptr<PeerLink>& link);
+    void onLinkUp(const std::shared_ptr<PeerLink>& link);
+    void onInboundFrame(chat_app::TcpConnection* connection, const std::vector<char>& body,
+                        uint16_t type, uint16_t flags);
+    void onInboundClosed(chat_app::TcpConnection* connection);
+    void applyDirectoryUpdate(const std::string& node_id, const std::vector<char>& body);
+
+    // Whether a peer's hello arrived on some inbound link (mutex_ held)
+    bool hasInboundLocked(const std::string& node_id) const;
+
+    // Queue or send a frame to a peer (called with mutex_ held)
+    bool sendLocked(const std::string& node_id, chat_app::TcpConnection::SharedBody body,
+                    uint16_t type, uint16_t flags);
+
+    void scheduleDirectoryFlush();
+    void flushDirectory();
+    chat_app::TcpConnection::SharedBody buildSnapshot() const;
+
+    boost::asio::io_context& io_context_;
+    Options options_;
+    DeliveryHandler delivery_;
+    MembershipCallback membership_callback_;
+    std::unordered_map<uint16_t, FrameHandler> frame_handlers_;
+    NodeDirectory directory_;
+
+    boost::asio::ip::tcp::acceptor acceptor_;
+    uint16_t listen_port_ = 0;
+    boost::asio::steady_timer directory_timer_;
+    std::atomic<bool> running_{false};
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<PeerLink>> peers_;
+    std::unordered_map<chat_app::TcpConnection*, InboundLink> inbound_;
+
+    // Local state announced to peers, counted per session/member so a
+    // user with two connections goes offline only when both close.
+    // pending_* hold unsent changes (true = online/joined).
+    std::unordered_map<std::string, std::size_t> local_users_;
+    std::unordered_map<std::string, std::size_t> local_room_members_;
+    std::map<std::string, bool> pending_users_;
+    std::map<std::string, bool> pending_rooms_;
+    bool directory_flush_scheduled_ = false;
+
+    std::atomic<uint64_t> forwarded_{0};
+    std::atomic<uint64_t> received_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> directory_updates_{0};
+};
+
+} // namespace chat
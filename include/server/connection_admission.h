@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <boost/asio.hpp>
+#include "common/config_loader.h"
+
+namespace chat {
+
+/**
+ * Accept loop with admission control for the client listener.
+ *
+ * The acceptor runs on its own io_context (normally a dedicated thread)
+ * and creates sockets on the server's io_context, so a reconnect storm
+ * does not queue behind message traffic or the other way round. Each
+ * wakeup drains up to accept_batch ready connections with non-blocking
+ * accepts instead of one accept per event loop round trip.
+ *
+ * A connection is admitted only while authenticated plus pending
+ * connections stay under MAX_CONNECTIONS and the pending-auth queue has
+ * room. Anything else is refused straight from the accept loop without
+ * creating a session: it gets a single AUTH_RESPONSE carrying a jittered
+ * retry_after_ms hint, and is closed. Hints are handed out as successive
+ * slots after the current pending queue drains, one per authentication
+ * the server can complete (estimated from how long admitted connections
+ * take to authenticate), so a storm of refused clients returns spread
+ * out at the pace the server can serve instead of hammering the listener.
+ * Admitted connections hold a Ticket; a ticket that is not marked
+ * authenticated within the auth timeout fires its timeout handler.
+ */
+class ConnectionAdmission {
+public:
+    struct Options {
+        std::size_t max_connections = 100;            // MAX_CONNECTIONS
+        std::size_t max_pending_auth = 64;            // Accepted but not yet authenticated
+        std::size_t accept_batch = 64;                // Accepts per wakeup
+        std::chrono::milliseconds auth_timeout{10000};
+        std::chrono::milliseconds retry_after{1000};  // Shortest back-off hint for refused clients
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t accepted = 0;          // Sockets accepted
+        uint64_t admitted = 0;          // Handed to the server
+        uint64_t rejected_full = 0;     // Refused: MAX_CONNECTIONS reached
+        uint64_t rejected_pending = 0;  // Refused: pending-auth queue full
+        uint64_t authenticated = 0;
+        uint64_t auth_timeouts = 0;
+        uint64_t accept_batches = 0;    // Wakeups of the accept loop
+        uint64_t largest_batch = 0;
+        uint64_t active = 0;            // Authenticated connections now
+        uint64_t pending = 0;           // Admitted, awaiting authentication now
+    };
+
+    /**
+     * Admission slot of one connection. Releasing the last reference
+     * frees the slot, so the session should hold it for its lifetime.
+     */
+    class Ticket {
+    public:
+        ~Ticket();
+
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+        // Move from the pending-auth queue to the active connections
+        void authenticated();
+        bool isAuthenticated() const { return authenticated_.load(std::memory_order_acquire); }
+
+        // Called on the socket's io_context if authentication takes too
+        // long; the server normally closes the connection there. May be
+        // installed from any thread, also after the ticket was handed off
+        void onAuthTimeout(std::function<void()> handler);
+
+    private:
+        friend class ConnectionAdmission;
+        struct Counters;
+
+        Ticket(std::shared_ptr<Counters> counters, boost::asio::io_context& io_context);
+
+        std::shared_ptr<Counters> counters_;
+        std::chrono::steady_clock::time_point admitted_at_;
+        boost::asio::steady_timer timer_;
+        std::mutex mutex_;  // Guards timeout_handler_
+        std::function<void()> timeout_handler_;
+        std::atomic<bool> authenticated_{false};
+    };
+
+    using TicketPtr = std::shared_ptr<Ticket>;
+    using AdmitHandler = std::function<void(boost::asio::ip::tcp::socket socket, TicketPtr ticket)>;
+
+    ConnectionAdmission(boost::asio::io_context& accept_context, boost::asio::io_context& socket_context,
+                        Options options, AdmitHandler handler);
+    ~ConnectionAdmission();
+
+    ConnectionAdmission(const ConnectionAdmission&) = delete;
+    ConnectionAdmission& operator=(const ConnectionAdmission&) = delete;
+
+    // Bind and start accepting; false if the endpoint cannot be used
+    bool start(const boost::asio::ip::tcp::endpoint& endpoint);
+    // Stops accepting; the acceptor is closed on the accept io_context,
+    // so this may be called from any thread
+    void stop();
+
+    boost::asio::ip::tcp::endpoint localEndpoint() const;
+    Stats stats() const;
+
+    // AUTH_RESPONSE body sent to a refused client
+    static std::vector<char> busyResponse(std::chrono::milliseconds retry_after);
+
+    // Back-off hint in an AUTH_RESPONSE body, if it carries one
+    static std::optional<std::chrono::milliseconds> retryAfter(const std::vector<char>& body);
+
+private:
+    void asyncAccept();
+    void handleAccepted(boost::asio::ip::tcp::socket socket);
+    void reject(boost::asio::ip::tcp::socket& socket, bool full);
+    std::chrono::milliseconds retryHint(bool full);
+
+    boost::asio::io_context& accept_context_;
+    boost::asio::io_context& socket_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    boost::asio::steady_timer retry_timer_;  // Backs off after accept errors (e.g. EMFILE)
+    Options options_;
+    AdmitHandler handler_;
+    std::shared_ptr<Ticket::Counters> counters_;
+    std::atomic<bool> running_{false};
+
+    // Return time handed to the last refused client (accept loop only)
+    std::chrono::steady_clock::time_point next_retry_slot_;
+};
+
+} // namespace chat
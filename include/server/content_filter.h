@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/chat_message.h"
+#include "common/config_loader.h"
+#include "common/config_watcher.h"
+
+namespace chat {
+
+/**
+ * Multi-pattern matcher compiled from a term list (Aho-Corasick).
+ *
+ * The automaton is compiled into a dense transition table over byte
+ * classes: bytes that occur in no term share one class, and ASCII
+ * letters are folded to one class per letter, so matching is case
+ * insensitive for ASCII. Scanning is one table lookup per input byte
+ * however many terms there are. With whole_words a term only matches
+ * where it is not part of a longer word; bytes >= 0x80 count as word
+ * characters so UTF-8 words are not split.
+ *
+ * Immutable once compiled; share it between threads freely.
+ */
+class PatternMatcher {
+public:
+    struct Match {
+        std::size_t term;    // Index into terms()
+        std::size_t offset;  // Start in the scanned text
+        std::size_t length;
+    };
+
+    // Empty terms are skipped and duplicates (after case folding) kept once
+    static std::shared_ptr<const PatternMatcher> compile(const std::vector<std::string>& terms, bool whole_words);
+
+    // Call visitor(const Match&) for every match in order of its end;
+    // overlapping matches are all reported. Stops when visitor returns false.
+    template <typename Visitor>
+    void scan(std::string_view text, Visitor&& visitor) const;
+
+    bool contains(std::string_view text) const {
+        bool found = false;
+        scan(text, [&found](const Match&) { found = true; return false; });
+        return found;
+    }
+
+    const std::vector<std::string>& terms() const { return terms_; }
+    std::size_t stateCount() const { return output_.size(); }
+
+private:
+    static constexpr uint32_t NO_OUTPUT = UINT32_MAX;
+
+    static bool isWordByte(unsigned char byte) {
+        return byte >= 0x80 || (byte >= '0' && byte <= '9') || ((byte | 0x20) >= 'a' && (byte | 0x20) <= 'z') ||
+               byte == '_';
+    }
+
+    bool atBoundary(std::string_view text, std::size_t offset, std::size_t length) const;
+
+    std::vector<std::string> terms_;
+    bool whole_words_ = false;
+    uint32_t class_count_ = 1;
+    std::array<uint8_t, 256> byte_class_{};
+    std::vector<uint32_t> next_;    // state * class_count_ + class -> state
+    std::vector<uint32_t> output_;  // Term ending at the state, or NO_OUTPUT
+    std::vector<uint32_t> suffix_;  // Next state down the failure chain with an output
+    std::vector<uint8_t> accepts_;  // The state or its failure chain has an output
+};
+
+template <typename Visitor>
+void PatternMatcher::scan(std::string_view text, Visitor&& visitor) const {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    const uint32_t* next = next_.data();
+    uint32_t state = 0;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        state = next[state * class_count_ + byte_class_[bytes[i]]];
+        if (!accepts_[state]) {
+            continue;
+        }
+        for (uint32_t s = output_[state] != NO_OUTPUT ? state : suffix_[state]; s != 0; s = suffix_[s]) {
+            std::size_t length = terms_[output_[s]].size();
+            std::size_t offset = i + 1 - length;
+            if (whole_words_ && !atBoundary(text, offset, length)) {
+                continue;
+            }
+            if (!visitor(Match{output_[s], offset, length})) {
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * Blocklist screening of message content on the ingress path.
+ *
+ * The blocklist file holds one term per line; blank lines and lines
+ * starting with # are ignored. It is compiled once into a PatternMatcher
+ * and swapped in atomically, so load() and the file watcher can replace
+ * it while messages are being filtered. A blocklist that fails to load
+ * leaves the previous one in place.
+ *
+ * filter() runs inline before a message is routed: with REJECT a
+ * matching message is dropped, with MASK every matched term is replaced
+ * by '*' and the message goes on.
+ */
+class ContentFilter {
+public:
+    enum class Action {
+        REJECT,  // Drop the message
+        MASK     // Replace matched terms with '*'
+    };
+
+    enum class Verdict {
+        PASS,
+        MASKED,
+        REJECTED
+    };
+
+    struct Options {
+        std::string blocklist_path;  // CONTENT_FILTER_FILE; empty = disabled
+        Action action = Action::REJECT;
+        bool whole_words = true;     // CONTENT_FILTER_WHOLE_WORDS
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t checked = 0;
+        uint64_t rejected = 0;
+        uint64_t masked = 0;
+        uint64_t reloads = 0;
+        uint64_t reload_failures = 0;
+    };
+
+    explicit ContentFilter(Options options);
+    ~ContentFilter();
+
+    ContentFilter(const ContentFilter&) = delete;
+    ContentFilter& operator=(const ContentFilter&) = delete;
+
+    // (Re)compile the blocklist file; false keeps the current one
+    bool load();
+
+    // Reload whenever the blocklist file changes on disk
+    bool watch();
+    void stop();
+
+    // Screen message.content, masking it in place with Action::MASK
+    Verdict filter(chat_app::ChatMessage& message) const;
+
+    std::size_t termCount() const;
+    Stats stats() const;
+
+    static std::vector<std::string> readBlocklist(std::istream& in);
+
+private:
+    Options options_;
+    std::shared_ptr<const PatternMatcher> matcher_;  // Swapped with std::atomic_store
+    std::unique_ptr<ConfigWatcher> watcher_;
+
+    mutable std::atomic<uint64_t> checked_{0};
+    mutable std::atomic<uint64_t> rejected_{0};
+    mutable std::atomic<uint64_t> masked_{0};
+    std::atomic<uint64_t> reloads_{0};
+    std::atomic<uint64_t> reload_failures_{0};
+};
+
+} // namespace chat
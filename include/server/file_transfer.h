@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json_fwd.hpp>
+#include "common/config_loader.h"
+#include "common/shared_file.h"
+#include "common/tcp_connection.h"
+
+namespace chat {
+
+/**
+ * Content-addressed attachment storage on disk.
+ *
+ * Uploads are spooled chunk by chunk to a part file under uploads/ and
+ * hashed (SHA-256) as they arrive, so no file is ever held in memory and
+ * an interrupted upload resumes from the bytes already on disk. A
+ * finished upload is renamed to objects/<sha256>; if that object already
+ * exists the upload is dropped instead, so identical attachments are
+ * stored once. The hash is the file id used to download.
+ *
+ * Needs OpenSSL for SHA-256; without it uploads cannot be finished.
+ */
+class FileStore {
+public:
+    struct Options {
+        std::string directory = "data/files";       // FILE_STORE_DIR
+        uint64_t max_file_size = 1024ull << 20;     // FILE_MAX_SIZE_MB
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct FileInfo {
+        std::string file_id;  // SHA-256, hex
+        uint64_t size = 0;
+        bool deduplicated = false;  // An identical file was already stored
+    };
+
+    struct Stats {
+        uint64_t uploads_started = 0;
+        uint64_t uploads_resumed = 0;
+        uint64_t uploads_completed = 0;
+        uint64_t deduplicated = 0;       // Completed uploads that matched a stored file
+        uint64_t bytes_received = 0;
+        uint64_t bytes_deduplicated = 0;  // Bytes not stored twice
+    };
+
+    /**
+     * An upload in progress; only one connection can hold a given upload.
+     * Releasing it keeps the part file for a later resume.
+     */
+    class Upload {
+    public:
+        ~Upload();
+
+        Upload(const Upload&) = delete;
+        Upload& operator=(const Upload&) = delete;
+
+        const std::string& id() const { return id_; }
+        uint64_t size() const { return size_; }
+        uint64_t offset() const { return offset_; }  // Bytes received so far
+        bool isComplete() const { return offset_ == size_; }
+
+    private:
+        friend class FileStore;
+        struct Hash;
+
+        Upload(FileStore& store, std::string id, uint64_t size, int fd);
+
+        FileStore& store_;
+        std::string id_;
+        uint64_t size_;
+        uint64_t offset_ = 0;
+        int fd_;
+        std::unique_ptr<Hash> hash_;
+    };
+
+    explicit FileStore(Options options);
+    ~FileStore();
+
+    FileStore(const FileStore&) = delete;
+    FileStore& operator=(const FileStore&) = delete;
+
+    // Create the directories
+    bool open();
+
+    // nullptr if size is over the limit or the part file cannot be created
+    std::shared_ptr<Upload> beginUpload(uint64_t size);
+
+    // Continue an upload of the given size from its part file; nullptr if
+    // it is unknown, does not match or is held by another connection
+    std::shared_ptr<Upload> resumeUpload(const std::string& upload_id, uint64_t size);
+
+    // Append a chunk; offset must equal upload.offset()
+    bool write(Upload& upload, uint64_t offset, const char* data, std::size_t size);
+
+    // Store a complete upload under its hash; the upload is closed
+    std::optional<FileInfo> finishUpload(Upload& upload);
+
+    std::optional<FileInfo> find(const std::string& file_id) const;
+    std::shared_ptr<const chat_app::SharedFile> openFile(const std::string& file_id) const;
+
+    Stats stats() const;
+
+private:
+    std::string objectPath(const std::string& file_id) const;
+    std::string partPath(const std::string& upload_id) const;
+    void release(const std::string& upload_id);
+
+    Options options_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Upload*> active_;  // Uploads held by a connection
+
+    std::atomic<uint64_t> uploads_started_{0};
+    std::atomic<uint64_t> uploads_resumed_{0};
+    std::atomic<uint64_t> uploads_completed_{0};
+    std::atomic<uint64_t> deduplicated_{0};
+    std::atomic<uint64_t> bytes_received_{0};
+    std::atomic<uint64_t> bytes_deduplicated_{0};
+};
+
+/**
+ * FILE_TRANSFER frames between clients and the FileStore.
+ *
+ * Control frames carry JSON (MessageFlags::JSON) with an "op":
+ *   upload    {size, sha256?, upload_id?}  start, or resume with upload_id;
+ *             a sha256 that is already stored completes at once
+ *   download  {file_id, offset?, length?}  a byte range, default the rest
+ * answered with upload_ready {upload_id, offset}, upload_complete
+ * {file_id, size, deduplicated}, download_ready {file_id, size, offset,
+ * length} or error {error}.
+ *
+ * Data frames are MessageFlags::BINARY | FRAGMENT (plus LAST_FRAG on the
+ * last one) with an 8-byte big-endian file offset before the bytes. An
+ * upload completes with its last byte. Download data is queued as file
+ * ranges that TcpConnection sends with sendfile, so served files are not
+ * read into memory; a large download occupies the connection until it
+ * is sent, so clients fetch big files in ranges.
+ */
+class FileTransferService {
+public:
+    // Per-connection state, owned by the session
+    struct Transfer {
+        std::shared_ptr<FileStore::Upload> upload;
+    };
+
+    static constexpr std::size_t DATA_PREFIX_SIZE = 8;
+
+    explicit FileTransferService(FileStore& store, uint32_t chunk_size = 512 * 1024);
+
+    void handleFrame(chat_app::TcpConnection& connection, Transfer& transfer,
+                     const std::vector<char>& body, uint16_t flags);
+
+    // Data frame prefix for a chunk at offset
+    static std::vector<char> encodeDataPrefix(uint64_t offset);
+    static std::optional<uint64_t> decodeDataPrefix(const std::vector<char>& body);
+
+private:
+    void handleUpload(chat_app::TcpConnection& connection, Transfer& transfer, const nlohmann::json& request);
+    void handleDownload(chat_app::TcpConnection& connection, const nlohmann::json& request);
+    void handleData(chat_app::TcpConnection& connection, Transfer& transfer, const std::vector<char>& body);
+
+    FileStore& store_;
+    uint32_t chunk_size_;
+};
+
+} // namespace chat
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "common/message.h"
+#include "common/tcp_connection.h"
+
+namespace chat {
+
+// Wire value of a message type, for frame headers and handler tables
+constexpr uint16_t frameType(chat_app::MessageType type) {
+    return static_cast<uint16_t>(type);
+}
+
+// A JSON control body, shareable between the frames it is sent in
+inline chat_app::TcpConnection::SharedBody jsonBody(const nlohmann::json& json) {
+    std::string text = json.dump();
+    return std::make_shared<const std::vector<char>>(text.begin(), text.end());
+}
+
+} // namespace chat
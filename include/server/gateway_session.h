@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/config_loader.h"
+#include "common/tcp_connection.h"
+
+namespace chat {
+
+/**
+ * Many logical users (bot identities, bridged accounts) over one
+ * authenticated gateway connection.
+ *
+ * The gateway binds each user to a stream id with STREAM_OPEN
+ * {"stream": n, "user_id": "..."}; the server echoes it with "ok" and
+ * the stream's initial credit. Frames for a stream keep their normal
+ * message type and flags, add MessageFlags::MULTIPLEXED and start with
+ * a StreamExtension naming the stream. Frames the gateway sends name
+ * exactly one stream; frames the server sends name every stream on
+ * the connection the body is for, so fan-out of a room message to
+ * co-located users costs one frame per gateway, not one per user.
+ *
+ * Flow control is per stream: each server-to-gateway frame uses one
+ * credit from every stream it names, and STREAM_CREDIT {"stream": n,
+ * "credit": k} adds more. Frames for a stream without credit wait in a
+ * bounded per-stream queue (oldest dropped), so one slow bot never holds
+ * up the others on the same connection.
+ */
+class GatewaySession {
+public:
+    struct Options {
+        std::size_t max_streams = 10000;     // GATEWAY_MAX_STREAMS: logical users per connection
+        uint32_t initial_credit = 64;        // GATEWAY_STREAM_CREDIT: frames sent before the gateway grants more
+        std::size_t max_queued = 256;        // GATEWAY_STREAM_QUEUE: frames held per stream without credit
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t streams = 0;           // Open now
+        uint64_t frames_in = 0;         // Stream frames received
+        uint64_t frames_out = 0;        // Frames sent (a batch counts once)
+        uint64_t deliveries = 0;        // Stream deliveries those frames covered
+        uint64_t queued = 0;            // Deliveries that waited for credit
+        uint64_t dropped = 0;           // Deliveries dropped from a full queue
+        uint64_t rejected = 0;          // Malformed frames and refused streams
+    };
+
+    // Sends a frame on the gateway connection
+    using FrameSink = std::function<bool(chat_app::TcpConnection::SharedBody body, uint16_t type, uint16_t flags)>;
+    // A frame sent by a logical user, extension removed
+    using FrameHandler = std::function<void(const std::string& user_id, const std::vector<char>& body,
+                                            uint16_t type, uint16_t flags)>;
+    // Whether the gateway may act as this user
+    using StreamAuthorizer = std::function<bool(const std::string& user_id)>;
+    // A logical user came online (true) or went offline on this gateway
+    using StreamCallback = std::function<void(const std::string& user_id, bool open)>;
+
+    GatewaySession(std::string gateway_id, Options options, FrameSink sink, FrameHandler handler,
+                   StreamAuthorizer authorize = nullptr, StreamCallback on_stream = nullptr);
+
+    GatewaySession(const GatewaySession&) = delete;
+    GatewaySession& operator=(const GatewaySession&) = delete;
+
+    // Feed a frame received on the gateway connection after it authenticated
+    void handleFrame(const std::vector<char>& body, uint16_t type, uint16_t flags);
+
+    // Send a body to users on this gateway: one frame for every stream
+    // with credit, the rest queued. Returns the users it was sent or
+    // queued for; the others have no stream here and are appended to
+    // missing, if given.
+    std::size_t deliver(const std::vector<std::string>& user_ids, chat_app::TcpConnection::SharedBody body,
+                        uint16_t type, uint16_t flags = 0, std::vector<std::string>* missing = nullptr);
+
+    // Close every stream (the connection went away)
+    void close();
+
+    const std::string& gatewayId() const { return gateway_id_; }
+    bool hasUser(const std::string& user_id) const;
+    std::vector<std::string> users() const;
+    Stats stats() const;
+
+private:
+    struct Pending {
+        chat_app::TcpConnection::SharedBody body;
+        uint16_t type;
+        uint16_t flags;
+    };
+
+    struct Stream {
+        std::string user_id;
+        uint32_t credit = 0;
+        std::deque<Pending> queue;
+    };
+
+    void openStream(const std::vector<char>& body);
+    void closeStream(const std::vector<char>& body);
+    void addCredit(const std::vector<char>& body);
+
+    // Send body to the streams as few frames as possible (mutex_ held)
+    void sendLocked(const std::vector<uint32_t>& streams, const Pending& frame);
+    void reply(uint16_t type, const std::string& json);
+
+    std::string gateway_id_;
+    Options options_;
+    FrameSink sink_;
+    FrameHandler handler_;
+    StreamAuthorizer authorize_;
+    StreamCallback on_stream_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, Stream> streams_;
+    std::unordered_map<std::string, uint32_t> stream_of_user_;
+
+    std::atomic<uint64_t> frames_in_{0};
+    std::atomic<uint64_t> frames_out_{0};
+    std::atomic<uint64_t> deliveries_{0};
+    std::atomic<uint64_t> queued_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> rejected_{0};
+};
+
+/**
+ * Which gateway carries each logical user, for the router's fan-out
+ */
+class GatewayRegistry {
+public:
+    // Call from the session's StreamCallback
+    void streamChanged(const std::shared_ptr<GatewaySession>& session, const std::string& user_id, bool open);
+
+    // Forget every user of a closed session
+    void remove(const std::shared_ptr<GatewaySession>& session);
+
+    std::shared_ptr<GatewaySession> find(const std::string& user_id) const;
+
+    // Deliver to every recipient carried by a gateway, one batch per
+    // gateway; returns the recipients that are not, including those whose
+    // stream closed before the batch reached it, for normal delivery
+    std::vector<std::string> fanOut(const std::vector<std::string>& recipients,
+                                    chat_app::TcpConnection::SharedBody body, uint16_t type, uint16_t flags = 0) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::weak_ptr<GatewaySession>> users_;
+};
+
+} // namespace chat
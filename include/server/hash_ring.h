@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace chat {
+
+/**
+ * Consistent hash ring mapping keys (room ids) to nodes.
+ * Each node is placed at many virtual points so load stays even with
+ * few nodes, and adding or removing a node only moves the keys on the
+ * arcs it gains or loses (about 1/N of them) instead of reshuffling
+ * everything. Not thread-safe; owners guard it with their own lock.
+ */
+class HashRing {
+public:
+    explicit HashRing(std::size_t virtual_nodes = 128);
+
+    // Returns false if the node was already present / not present
+    bool addNode(const std::string& node_id);
+    bool removeNode(const std::string& node_id);
+    bool hasNode(const std::string& node_id) const;
+
+    // Node owning a key; empty when the ring has no nodes
+    const std::string& ownerOf(std::string_view key) const;
+
+    const std::vector<std::string>& nodes() const { return nodes_; }
+    std::size_t size() const { return nodes_.size(); }
+
+    // 64-bit FNV-1a with a final avalanche mix
+    static uint64_t hash(std::string_view key);
+
+private:
+    void rebuild();
+
+    std::size_t virtual_nodes_;
+    std::vector<std::string> nodes_;                       // Sorted node ids
+    std::vector<std::pair<uint64_t, uint32_t>> points_;    // (point, index into nodes_), sorted
+};
+
+} // namespace chat
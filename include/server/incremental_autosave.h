@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include "common/config_loader.h"
+#include "common/user.h"
+
+namespace chat {
+
+// A user to persist with the fields that changed
+struct UserChange {
+    chat_app::User user;
+    uint8_t fields = 0;  // chat_app::UserFields bits
+};
+
+// Latest membership state of a (room, user) pair
+struct MembershipChange {
+    std::string room_id;
+    std::string user_id;
+    bool joined = false;
+};
+
+// A user's read-up-to watermark in a room (ChatMessage::sequence)
+struct ReadPositionChange {
+    std::string room_id;
+    std::string user_id;
+    uint64_t position = 0;
+};
+
+// A room message that mentions a user; stored until the user reads past it
+struct Mention {
+    std::string room_id;
+    std::string user_id;     // Mentioned user
+    std::string message_id;
+    std::string sender_id;
+    uint64_t position = 0;   // ChatMessage::sequence, as in read receipts
+};
+
+// Everything changed since the previous autosave; written as one transaction
+struct ChangeBatch {
+    std::vector<UserChange> users;
+    std::vector<std::string> removed_users;
+    std::vector<MembershipChange> memberships;
+    std::vector<Mention> mentions;
+    std::vector<ReadPositionChange> read_positions;  // Applied after mentions, dropping the ones read
+
+    bool empty() const { return size() == 0; }
+    std::size_t size() const {
+        return users.size() + removed_users.size() + memberships.size() + mentions.size() + read_positions.size();
+    }
+};
+
+/**
+ * Change journal plus periodic writer that saves only what changed.
+ * Owners of the user and room tables report changes as they happen
+ * (the ids and dirty bits are recorded, not copies of the data); every
+ * AUTOSAVE_INTERVAL a background thread takes the journal, reads the
+ * current state of just those users through the resolver and hands the
+ * batch to the persister as one transaction. Save cost scales with the
+ * number of changes, not the population. A failed save puts its changes
+ * back into the journal for the next attempt.
+ */
+class IncrementalAutosave {
+public:
+    struct Options {
+        std::chrono::milliseconds interval{300 * 1000};
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t saves = 0;              // Non-empty batches written
+        uint64_t users_written = 0;
+        uint64_t memberships_written = 0;
+        uint64_t failures = 0;
+        uint64_t last_batch = 0;         // Changes in the most recent batch
+        uint64_t last_duration_ms = 0;
+    };
+
+    // Current state of a user, or nullopt if it no longer exists
+    using UserResolver = std::function<std::optional<chat_app::User>(const std::string& user_id)>;
+    // Write a batch atomically; false leaves it queued
+    using Persister = std::function<bool(const ChangeBatch& batch)>;
+
+    IncrementalAutosave(boost::asio::io_context& io_context, Options options,
+                        UserResolver resolver, Persister persister);
+    ~IncrementalAutosave();
+
+    IncrementalAutosave(const IncrementalAutosave&) = delete;
+    IncrementalAutosave& operator=(const IncrementalAutosave&) = delete;
+
+    void start();
+    // Writes whatever is still journaled before returning
+    void stop();
+
+    // Journal a user's dirty fields and clear them; call with the lock
+    // that guards the user held
+    void userChanged(chat_app::User& user);
+    void userChanged(const std::string& user_id, uint8_t fields);
+    void userRemoved(const std::string& user_id);
+    void membershipChanged(const std::string& room_id, const std::string& user_id, bool joined);
+    void mentionAdded(const Mention& mention);
+    void readPositionChanged(const std::string& room_id, const std::string& user_id, uint64_t position);
+
+    // Save on the calling thread (e.g. at shutdown)
+    bool saveNow();
+
+    std::size_t pendingChanges() const;
+    Stats stats() const;
+
+private:
+    struct Journal {
+        std::unordered_map<std::string, uint8_t> users;                    // user_id -> UserFields
+        std::unordered_set<std::string> removed_users;
+        std::map<std::pair<std::string, std::string>, bool> memberships;  // (room, user) -> joined
+        std::vector<Mention> mentions;
+        std::map<std::pair<std::string, std::string>, uint64_t> read_positions;  // (room, user) -> position
+
+        bool empty() const {
+            return users.empty() && removed_users.empty() && memberships.empty() && mentions.empty() &&
+                   read_positions.empty();
+        }
+    };
+
+    void scheduleTimer();
+    void workerLoop();
+    void requeue(Journal&& journal);
+
+    // Only touched on its own strand
+    boost::asio::steady_timer timer_;
+    Options options_;
+    UserResolver resolver_;
+    Persister persister_;
+
+    mutable std::mutex journal_mutex_;
+    Journal journal_;
+
+    // Serializes saves from the worker and saveNow()
+    std::mutex save_mutex_;
+
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
+    bool requested_ = false;
+    bool running_ = false;
+    std::thread worker_;
+
+    std::atomic<uint64_t> saves_{0};
+    std::atomic<uint64_t> users_written_{0};
+    std::atomic<uint64_t> memberships_written_{0};
+    std::atomic<uint64_t> failures_{0};
+    std::atomic<uint64_t> last_batch_{0};
+    std::atomic<uint64_t> last_duration_ms_{0};
+};
+
+} // namespace chat
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/config_loader.h"
+#include "common/encoded_message.h"
+
+namespace chat {
+
+class ClusterManager;
+
+/**
+ * Append-only, segmented message log; the durability layer for chat
+ * messages. Every record gets a sequence number and a CRC-32C, and is
+ * written to the tail segment by one writer thread that batches
+ * everything queued while the previous batch was syncing (group commit):
+ * one write and one fdatasync cover many messages.
+ *
+ * Segments are preallocated files mapped read-only, so reads of recent
+ * records come straight from the page cache without syscalls. On open
+ * the log is replayed to the last record with a valid CRC and sequence;
+ * a torn write at the tail is discarded and zeroed on disk, so later
+ * appends can never end next to stale bytes.
+ *
+ * With a follower node configured, each synced batch is also sent over
+ * the cluster link and a message is acknowledged only once the follower
+ * has made it durable too. A follower applies LOG_APPEND frames to its
+ * own log with the leader's sequence numbers, strictly in order: a frame
+ * that skips a sequence is answered with the sequence it needs next, and
+ * the leader resends from its log. The leader also resends everything
+ * unacknowledged when acks stop for replica_retry (lost frames, a
+ * dropped link), and reports a message as not replicated once it has
+ * waited replica_timeout.
+ *
+ * Queryable stores (the DATABASE_PATH database) are materialized from
+ * the log with read() and may release segments they have applied.
+ */
+class MessageLog {
+public:
+    struct Options {
+        std::string directory = "data/log";
+        std::size_t segment_bytes = 64 * 1024 * 1024;  // Preallocated size of each segment
+        std::size_t max_batch_bytes = 1024 * 1024;     // Bytes written per group commit
+        bool sync = true;                              // fdatasync each batch
+        std::string follower_node;                     // Cluster node replicating the log; empty for none
+        std::chrono::milliseconds replica_retry{1000};     // Resend unacknowledged records after this long
+        std::chrono::milliseconds replica_timeout{10000};  // Report a record unreplicated after this long
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t appended = 0;      // Records written locally
+        uint64_t batches = 0;       // Group commits (one write + sync each)
+        uint64_t replicated = 0;    // Records acknowledged by the follower
+        uint64_t unreplicated = 0;  // Records reported before the follower confirmed them
+        uint64_t resends = 0;       // Times the follower was sent records again
+        uint64_t failed = 0;        // Records whose write failed
+    };
+
+    // Called once a record is durable (and replicated when a follower is
+    // configured), from the writer thread or the cluster io thread.
+    // durable is false if the write failed or the follower did not
+    // confirm the record in time.
+    using AckCallback = std::function<void(uint64_t sequence, bool durable)>;
+
+    // Visits one record; return false to stop
+    using RecordVisitor = std::function<bool(uint64_t sequence, const char* data, std::size_t size)>;
+
+    explicit MessageLog(Options options);
+    ~MessageLog();
+
+    MessageLog(const MessageLog&) = delete;
+    MessageLog& operator=(const MessageLog&) = delete;
+
+    // Recover existing segments and start the writer thread
+    bool open();
+    void close();
+
+    // Replicate to options.follower_node and accept LOG_APPEND frames
+    // from a leader; call before open() and ClusterManager::start()
+    void attachCluster(ClusterManager& cluster);
+
+    // Queue a record; returns its sequence number (0 if the log is closed)
+    uint64_t append(const chat_app::SharedEncodedMessage& message, AckCallback on_durable = nullptr);
+    uint64_t append(chat_app::EncodedMessage::Body payload, AckCallback on_durable = nullptr);
+
+    // Read up to max_records durable records starting at from_sequence;
+    // returns the number visited
+    std::size_t read(uint64_t from_sequence, std::size_t max_records, const RecordVisitor& visitor) const;
+
+    // Delete segments holding only records below sequence (already
+    // materialized elsewhere)
+    void releaseBefore(uint64_t sequence);
+
+    uint64_t lastSequence() const;
+    uint64_t durableSequence() const { return durable_sequence_.load(std::memory_order_acquire); }
+    uint64_t firstSequence() const;
+    Stats stats() const;
+
+private:
+    struct Segment;
+
+    // A record waiting for the writer thread
+    struct PendingRecord {
+        uint64_t sequence = 0;
+        chat_app::EncodedMessage::Body payload;
+        AckCallback on_durable;
+    };
+
+    // A durable record waiting for the follower's acknowledgement
+    struct AwaitingReplica {
+        uint64_t sequence = 0;
+        AckCallback on_durable;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void writerLoop();
+
+    // Write, sync and publish one group commit; records receives the
+    // encoded records for replication
+    bool writeBatch(const std::vector<PendingRecord>& batch, std::vector<char>& records);
+
+    // Acknowledge a written batch, or hand it to the follower first
+    void completeBatch(std::vector<PendingRecord>& batch, const std::vector<char>& records, bool durable);
+
+    // capacity 0 maps an existing segment file
+    std::shared_ptr<Segment> openSegment(uint64_t base_sequence, std::size_t capacity);
+    bool recover();
+    std::shared_ptr<Segment> segmentFor(uint64_t sequence) const;
+    std::shared_ptr<Segment> segmentAfter(const Segment& segment) const;
+
+    bool replicating() const { return cluster_ && !options_.follower_node.empty(); }
+
+    // Follower side: apply a leader's records with their own sequences
+    void onReplicaAppend(const std::string& from_node, const std::vector<char>& body, uint16_t flags);
+
+    // Leader side
+    void onReplicaAck(const std::vector<char>& body);
+    void replicate(const std::vector<char>& records);
+    // Send the follower durable records from sequence on, one window at a
+    // time (replica_mutex_ held)
+    void resendLocked(uint64_t sequence);
+    // Resend when acks stalled and fail records past their deadline;
+    // runs on the writer thread
+    void checkReplica();
+
+    Options options_;
+    ClusterManager* cluster_ = nullptr;
+
+    // Queue between append() and the writer thread
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::vector<PendingRecord> queue_;
+    uint64_t next_sequence_ = 1;
+    bool running_ = false;
+    std::thread writer_;
+
+    // Segments, oldest first; the last one is written to
+    mutable std::shared_mutex segments_mutex_;
+    std::deque<std::shared_ptr<Segment>> segments_;
+
+    std::mutex replica_mutex_;
+    std::deque<AwaitingReplica> awaiting_replica_;
+    uint64_t replica_sequence_ = 0;     // Durable on the follower
+    uint64_t replica_sent_ = 0;         // Sent to the follower
+    uint64_t replica_resent_from_ = 0;  // Records in the last resend
+    uint64_t replica_resent_to_ = 0;
+    std::chrono::steady_clock::time_point replica_progress_{};  // Last ack progress or resend
+
+    std::atomic<uint64_t> durable_sequence_{0};
+    std::atomic<uint64_t> appended_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> replicated_{0};
+    std::atomic<uint64_t> unreplicated_{0};
+    std::atomic<uint64_t> resends_{0};
+    std::atomic<uint64_t> failed_{0};
+};
+
+} // namespace chat
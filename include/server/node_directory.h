@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace chat {
+
+/**
+ * Cluster-wide view of where users are connected and which nodes have
+ * members in each room. Every node keeps a full copy, fed by the
+ * directory updates peers broadcast. Lookups happen on every forwarded
+ * message, so reads share a lock and never block each other.
+ */
+class NodeDirectory {
+public:
+    explicit NodeDirectory(std::string local_node_id);
+
+    const std::string& localNodeId() const { return local_node_id_; }
+
+    // User location
+    void setUserNode(const std::string& user_id, const std::string& node_id);
+    // Remove only if the user is still mapped to node_id (a newer login
+    // on another node must not be undone by a stale logout)
+    void removeUser(const std::string& user_id, const std::string& node_id);
+    std::optional<std::string> nodeForUser(const std::string& user_id) const;
+
+    // Room interest: nodes with at least one member of the room
+    void addRoomNode(const std::string& room_id, const std::string& node_id);
+    void removeRoomNode(const std::string& room_id, const std::string& node_id);
+    std::vector<std::string> nodesForRoom(const std::string& room_id) const;
+
+    // Forget everything known about a node (it left or its link dropped)
+    void dropNode(const std::string& node_id);
+
+    std::size_t userCount() const;
+    std::size_t userCount(const std::string& node_id) const;
+
+private:
+    std::string local_node_id_;
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::string> user_nodes_;                       // User -> node
+    std::unordered_map<std::string, std::unordered_set<std::string>> room_nodes_;   // Room -> nodes
+};
+
+} // namespace chat
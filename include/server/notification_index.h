@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json_fwd.hpp>
+#include "common/chat_message.h"
+#include "common/config_loader.h"
+#include "server/incremental_autosave.h"
+
+namespace chat {
+
+/**
+ * Per-user unread counts and mentions, maintained as messages arrive.
+ *
+ * Each room keeps the positions (ChatMessage::sequence, the unit of
+ * READ_RECEIPT watermarks) of its last max_unread messages, and each
+ * member a read-up-to watermark; a user's unread count in a room is the
+ * number of positions after the watermark, one binary search, capped at
+ * max_unread ("999+"). Sequences are unique per room, so messages sent
+ * in the same millisecond or by senders with skewed clocks still count
+ * once each. Posting a message marks the room read for the
+ * sender. @mentions are parsed once when a message is recorded and kept
+ * in a bounded list per user until the user reads past them. A login
+ * summary is therefore one lookup per room the user is in, instead of a
+ * history scan.
+ *
+ * Watermarks and mentions are journaled to IncrementalAutosave and
+ * loaded back with restoreReadPosition()/restoreMention(); the room
+ * timelines are rebuilt from stored history with restoreMessage().
+ * Direct messages are not indexed.
+ */
+class NotificationIndex {
+public:
+    struct Options {
+        std::size_t max_unread = 999;   // UNREAD_COUNT_LIMIT: counts are capped here
+        std::size_t max_mentions = 100; // MENTION_LIMIT: unread mentions kept per user
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t messages = 0;        // Room messages recorded
+        uint64_t mentions = 0;        // Mentions indexed
+        uint64_t read_receipts = 0;   // Watermarks that advanced
+        uint64_t summaries = 0;
+    };
+
+    struct RoomSummary {
+        std::string room_id;
+        uint64_t unread = 0;    // At most max_unread
+        uint32_t mentions = 0;
+    };
+
+    struct Summary {
+        std::vector<RoomSummary> rooms;  // Rooms with unread messages or mentions
+        std::vector<Mention> mentions;   // Oldest first
+
+        // NOTIFICATION_SUMMARY body
+        nlohmann::json toJson() const;
+    };
+
+    // User id for a mentioned username, or nullopt if there is none
+    using UserResolver = std::function<std::optional<std::string>(std::string_view username)>;
+    // Whether the user is a member of the room
+    using MemberCheck = std::function<bool(const std::string& room_id, const std::string& user_id)>;
+
+    // autosave may be null (nothing is persisted); without a resolver
+    // usernames are taken as user ids
+    NotificationIndex(Options options, IncrementalAutosave* autosave,
+                      UserResolver resolver = nullptr, MemberCheck is_member = nullptr);
+
+    NotificationIndex(const NotificationIndex&) = delete;
+    NotificationIndex& operator=(const NotificationIndex&) = delete;
+
+    // Index a message posted to a room (not typing indicators or
+    // receipts) once ReliableDelivery has assigned its sequence; a
+    // message without one goes after the newest. Returns the users it
+    // mentions.
+    std::vector<std::string> record(const chat_app::ChatMessage& message);
+
+    // Move a user's watermark forward and drop the mentions it covers;
+    // fed READ_RECEIPT positions (PresenceAggregator::receiptPosition),
+    // where 0 means up to the newest message. Set it when a user joins a
+    // room, or the whole timeline is unread.
+    void markRead(const std::string& room_id, const std::string& user_id, uint64_t position);
+
+    uint64_t unread(const std::string& room_id, const std::string& user_id) const;
+    Summary summary(const std::string& user_id, const std::vector<std::string>& room_ids) const;
+
+    // Startup: rebuild state without journaling it again
+    void restoreMessage(const chat_app::ChatMessage& message);
+    void restoreReadPosition(const ReadPositionChange& change);
+    void restoreMention(const Mention& mention);
+
+    // Distinct @names in content, in order; an @ inside a word (an email
+    // address) does not count
+    static std::vector<std::string> parseMentions(std::string_view content);
+
+    Stats stats() const;
+
+private:
+    static constexpr std::size_t SHARD_COUNT = 16;
+
+    struct RoomState {
+        std::deque<uint64_t> timeline;                        // Message positions, ascending
+        std::unordered_map<std::string, uint64_t> watermarks;  // User -> read up to
+    };
+
+    struct RoomShard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, RoomState> rooms;
+    };
+
+    struct UserShard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::deque<Mention>> mentions;  // User -> unread, oldest first
+    };
+
+    RoomShard& roomShard(const std::string& room_id) const;
+    UserShard& userShard(const std::string& user_id) const;
+
+    // Add a message's position to the room timeline; returns it
+    uint64_t appendLocked(RoomState& room, uint64_t sequence);
+    // Advance a watermark; true if it moved
+    bool advanceLocked(RoomState& room, const std::string& user_id, uint64_t position);
+    void addMention(const Mention& mention);
+    void dropReadMentions(const std::string& room_id, const std::string& user_id, uint64_t position);
+
+    Options options_;
+    IncrementalAutosave* autosave_;
+    UserResolver resolver_;
+    MemberCheck is_member_;
+
+    mutable std::array<RoomShard, SHARD_COUNT> room_shards_;
+    mutable std::array<UserShard, SHARD_COUNT> user_shards_;
+
+    std::atomic<uint64_t> messages_{0};
+    std::atomic<uint64_t> mentions_{0};
+    std::atomic<uint64_t> read_receipts_{0};
+    mutable std::atomic<uint64_t> summaries_{0};
+};
+
+} // namespace chat
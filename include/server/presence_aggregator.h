@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <boost/asio.hpp>
+#include "common/chat_message.h"
+#include "common/config_loader.h"
+#include "common/encoded_message.h"
+
+namespace chat {
+
+/**
+ * Coalesces typing indicators and read receipts into one summary frame
+ * per room and flush interval.
+ *
+ * Typing state is debounced per (room, user): repeated "still typing"
+ * signals only refresh an expiry and produce no traffic, and a user who
+ * stops sending them drops out after the typing timeout. Read receipts
+ * are merged into a per-user "read up to" watermark that only moves
+ * forward. Every interval, each room that changed gets a single
+ * PRESENCE_SUMMARY message holding the current typists and the
+ * watermarks that advanced, instead of one frame per signal per member.
+ *
+ * Ingestion is safe from any thread; rooms are spread over lock shards.
+ */
+class PresenceAggregator {
+public:
+    struct Options {
+        std::chrono::milliseconds flush_interval{250};   // Summary period per room
+        std::chrono::milliseconds typing_timeout{5000};  // Typing expires without a refresh
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t typing_signals = 0;    // Typing indicators ingested
+        uint64_t read_receipts = 0;     // Read receipts ingested
+        uint64_t summaries = 0;         // Summary frames handed to the sink
+    };
+
+    // Receives each room summary; the body is encoded once for all members
+    using SummarySink = std::function<void(const std::string& room_id,
+                                           const chat_app::SharedEncodedMessage& summary)>;
+    using Clock = std::chrono::steady_clock;
+
+    PresenceAggregator(boost::asio::io_context& io_context, Options options, SummarySink sink);
+    ~PresenceAggregator();
+
+    PresenceAggregator(const PresenceAggregator&) = delete;
+    PresenceAggregator& operator=(const PresenceAggregator&) = delete;
+
+    // Start/stop the periodic flush timer
+    void start();
+    void stop();
+
+    // Consume a TYPING_INDICATOR or READ_RECEIPT room message.
+    // Returns false (and ignores it) for any other message, which the
+    // caller should route normally.
+    bool ingest(const chat_app::ChatMessage& message);
+
+    // Record that a user started or stopped typing in a room
+    void setTyping(const std::string& room_id, const std::string& user_id, bool typing,
+                   Clock::time_point now = Clock::now());
+
+    // Record that a user has read a room up to a position (the
+    // ChatMessage::sequence of the last message read); older positions
+    // are ignored
+    void markRead(const std::string& room_id, const std::string& user_id, uint64_t position);
+
+    // Read-up-to sequence of a READ_RECEIPT, 0 if the body has none
+    static uint64_t receiptPosition(const chat_app::ChatMessage& receipt);
+
+    // Forget a user's state in a room (left the room or disconnected)
+    void removeUser(const std::string& room_id, const std::string& user_id);
+
+    // Latest known watermark, 0 if none
+    uint64_t readPosition(const std::string& room_id, const std::string& user_id) const;
+
+    // Emit summaries for every changed room; called by the timer.
+    // Returns the number of summaries sent.
+    std::size_t flush(Clock::time_point now = Clock::now());
+
+    Stats stats() const;
+
+private:
+    static constexpr std::size_t SHARD_COUNT = 16;
+
+    struct RoomState {
+        std::unordered_map<std::string, Clock::time_point> typing;  // User -> typing expiry
+        std::unordered_map<std::string, uint64_t> watermarks;       // User -> read up to
+        std::unordered_set<std::string> advanced;                   // Watermarks moved since last flush
+        bool typing_changed = false;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, RoomState> rooms;
+        std::unordered_set<std::string> dirty;         // Rooms with something to report
+        std::unordered_set<std::string> typing_rooms;  // Rooms with someone typing
+    };
+
+    Shard& shardFor(const std::string& room_id);
+    const Shard& shardFor(const std::string& room_id) const;
+    void scheduleFlush();
+
+    // Build the summary for a dirty room (called with the shard locked)
+    static chat_app::ChatMessage buildSummary(const std::string& room_id, RoomState& room);
+
+    boost::asio::steady_timer timer_;
+    Options options_;
+    SummarySink sink_;
+    std::atomic<bool> running_{false};
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    std::atomic<uint64_t> typing_signals_{0};
+    std::atomic<uint64_t> read_receipts_{0};
+    std::atomic<uint64_t> summaries_{0};
+};
+
+} // namespace chat
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/config_loader.h"
+#include "common/tcp_connection.h"
+
+namespace chat {
+
+/**
+ * Token bucket kept in a single atomic word.
+ *
+ * Instead of a token count plus a refill timestamp, the bucket stores the
+ * time at which it would be full again (the GCRA form of a token bucket):
+ * taking a token advances that time by one emission interval, and a take
+ * is allowed while it stays within `burst` intervals of now. Refill is
+ * implicit, so a take is one load and one compare-exchange.
+ */
+class TokenBucket {
+public:
+    struct Limit {
+        double rate = 0;      // Tokens per second; 0 = unlimited
+        uint32_t burst = 1;   // Bucket size
+
+        bool enabled() const { return rate > 0; }
+        int64_t intervalNs() const { return static_cast<int64_t>(1e9 / rate); }
+    };
+
+    // Take a token if one is available and return 0, otherwise return the
+    // nanoseconds until one is. With reserve the token is taken anyway.
+    int64_t acquire(const Limit& limit, int64_t now_ns, bool reserve);
+
+    // Nanoseconds until a token is available, without taking it
+    int64_t peek(const Limit& limit, int64_t now_ns) const;
+
+    // Time the bucket is full again; at or before now it is as good as new
+    int64_t fullAt() const { return full_at_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> full_at_{0};
+};
+
+/**
+ * Ingress rate limiting by message type.
+ *
+ * Each frame type can have a token bucket limit. A frame is charged to
+ * the connection it arrived on, to the authenticated user (across all of
+ * their connections) and to the remote address (with a larger allowance,
+ * since several clients may share it). Limits are checked from the frame
+ * header before the body is read; an over-limit frame is either rejected
+ * with a rate-limited ERROR reply, or, in pause mode, the connection
+ * stops reading until the frame is within its limit so the sender is
+ * slowed down by TCP backpressure. Nobody is disconnected.
+ */
+class RateLimiter {
+public:
+    static constexpr std::size_t TYPE_COUNT = 32;  // Frame types with a limit slot
+
+    enum class Action {
+        REJECT,  // Drop the frame and reply with ERROR
+        PAUSE    // Stop reading the connection until the frame fits
+    };
+
+    struct Options {
+        std::array<TokenBucket::Limit, TYPE_COUNT> limits{};  // Indexed by MessageType
+        Action action = Action::REJECT;
+        double address_scale = 4.0;                           // Address limit = scale x type limit
+        std::chrono::milliseconds max_pause{2000};            // Longer waits are rejected instead
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t throttled = 0;   // Frames over a limit
+        uint64_t rejected = 0;    // ... dropped with an ERROR reply
+        uint64_t paused = 0;      // ... delivered after pausing reads
+        std::array<uint64_t, TYPE_COUNT> throttled_by_type{};
+    };
+
+    // Buckets for one connection, user or address
+    struct Buckets {
+        std::array<TokenBucket, TYPE_COUNT> buckets;
+    };
+
+    /**
+     * Limiter state of one connection. bindUser() is called once the
+     * connection authenticates, from the connection's message callback.
+     */
+    class ConnectionLimits {
+    public:
+        const std::string& address() const { return address_; }
+        const std::string& userId() const { return user_id_; }
+
+    private:
+        friend class RateLimiter;
+
+        std::string address_;
+        std::string user_id_;
+        Buckets connection_;
+        std::shared_ptr<Buckets> user_;
+        std::shared_ptr<Buckets> address_buckets_;
+        int64_t last_error_ns_ = 0;  // ERROR replies are sent at most once a second
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // The limiter must outlive the connections it is attached to
+    explicit RateLimiter(Options options);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // State for a new connection from an address
+    std::shared_ptr<ConnectionLimits> connect(const std::string& address);
+    void bindUser(ConnectionLimits& limits, const std::string& user_id);
+
+    // Charge a frame and decide what to do with it. Without can_pause
+    // (the connection cannot hold back reads) over-limit frames are
+    // rejected even in pause mode.
+    chat_app::FrameVerdict check(ConnectionLimits& limits, uint16_t type,
+                                 Clock::time_point now = Clock::now(), bool can_pause = true);
+
+    // Install check() as the connection's frame filter; rejected frames
+    // get an ERROR reply. Connections on io_uring are never paused.
+    void attach(chat_app::TcpConnection& connection, std::shared_ptr<ConnectionLimits> limits);
+
+    // Replace the limits (e.g. after a config reload)
+    void setOptions(const Options& options);
+
+    // Drop idle user/address buckets
+    void prune(Clock::time_point now = Clock::now());
+
+    Stats stats() const;
+
+private:
+    using BucketMap = std::unordered_map<std::string, std::shared_ptr<Buckets>>;
+
+    std::shared_ptr<Buckets> shared(BucketMap& map, const std::string& key);
+    void pruneLocked(int64_t now_ns);
+
+    // Body of the ERROR reply for a rejected frame
+    static chat_app::TcpConnection::SharedBody errorBody(uint16_t type, std::chrono::milliseconds retry_after);
+
+    // Published options; superseded ones are retained (reloads are rare)
+    // so check() reads them with one atomic load
+    std::atomic<const Options*> options_{nullptr};
+    std::vector<std::shared_ptr<const Options>> published_;
+    std::mutex options_mutex_;
+
+    std::mutex buckets_mutex_;
+    BucketMap users_;
+    BucketMap addresses_;
+    std::size_t inserts_since_prune_ = 0;
+
+    std::atomic<uint64_t> throttled_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> paused_{0};
+    std::array<std::atomic<uint64_t>, TYPE_COUNT> throttled_by_type_{};
+};
+
+} // namespace chat
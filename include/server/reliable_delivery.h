@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/config_loader.h"
+#include "common/encoded_message.h"
+
+namespace chat {
+
+/**
+ * Per-conversation sequence numbers, client acks and gap replay.
+ *
+ * Every room or direct message gets the next sequence of its
+ * conversation (ChatMessage::conversationId) before it is encoded, and
+ * is sent with MessageFlags::ACK_REQ. Clients acknowledge cumulatively
+ * with DELIVERY_ACK {"<conversation>": seq, ...}. After a reconnect a
+ * client sends RESUME with the last sequence it holds per conversation
+ * and gets only the messages after it: from the in-memory replay window
+ * of each conversation, or from storage through the history loader when
+ * the gap is older than the window. A conversation the client leaves out
+ * resumes from its last ack.
+ *
+ * Counters and windows are rebuilt at startup by passing the stored
+ * messages to restore() in order. Acks are kept in memory only; after a
+ * server restart the client's own RESUME cursors are what count.
+ */
+class ReliableDelivery {
+public:
+    struct Options {
+        std::size_t replay_window = 256;   // RESUME_WINDOW: recent messages kept per conversation
+        std::size_t max_replay = 2000;     // RESUME_MAX_REPLAY: messages replayed per RESUME
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t assigned = 0;              // Messages sequenced
+        uint64_t acks = 0;                  // Ack entries applied
+        uint64_t resumes = 0;
+        uint64_t replayed = 0;              // Messages sent back by resume()
+        uint64_t replayed_from_storage = 0; // Of those, loaded through the history loader
+        uint64_t truncated = 0;             // Conversations not fully replayed
+    };
+
+    // Messages of a conversation with sequence > after, oldest first, at
+    // most max; used when the gap starts before the replay window
+    using HistoryLoader = std::function<std::vector<chat_app::SharedEncodedMessage>(
+        const std::string& conversation, uint64_t after, std::size_t max)>;
+
+    // Whether user_id may read the conversation (room membership);
+    // direct conversations are checked against their key
+    using AccessCheck = std::function<bool(const std::string& user_id, const std::string& conversation)>;
+
+    // Conversation -> sequence, the body of DELIVERY_ACK and RESUME
+    using Cursors = std::unordered_map<std::string, uint64_t>;
+
+    struct Replay {
+        std::vector<chat_app::SharedEncodedMessage> messages;  // Per conversation, oldest first
+        std::vector<std::string> truncated;  // Still missing messages; the client refetches history
+    };
+
+    explicit ReliableDelivery(Options options, HistoryLoader loader = nullptr, AccessCheck access = nullptr);
+
+    ReliableDelivery(const ReliableDelivery&) = delete;
+    ReliableDelivery& operator=(const ReliableDelivery&) = delete;
+
+    // Give the message the next sequence of its conversation and keep it
+    // for replay; call before the message is encoded or sent
+    uint64_t assign(const chat_app::SharedEncodedMessage& message);
+
+    // Re-add a stored message at startup, keeping its sequence
+    void restore(const chat_app::SharedEncodedMessage& message);
+
+    // Cumulative ack; lower or unknown sequences are ignored
+    void acknowledge(const std::string& user_id, const Cursors& cursors);
+    uint64_t acknowledged(const std::string& user_id, const std::string& conversation) const;
+
+    // Messages the user missed after last_seen, for conversations it names
+    // or has acked before
+    Replay resume(const std::string& user_id, const Cursors& last_seen) const;
+
+    uint64_t lastSequence(const std::string& conversation) const;
+    Stats stats() const;
+
+    // DELIVERY_ACK / RESUME bodies
+    static std::optional<Cursors> parseCursors(const std::vector<char>& body);
+    static std::vector<char> encodeCursors(const Cursors& cursors);
+
+private:
+    struct Conversation {
+        uint64_t last_sequence = 0;
+        std::deque<chat_app::SharedEncodedMessage> window;  // Oldest first, consecutive sequences
+    };
+
+    bool mayRead(const std::string& user_id, const std::string& conversation) const;
+    void remember(Conversation& conversation, const chat_app::SharedEncodedMessage& message);
+
+    Options options_;
+    HistoryLoader loader_;
+    AccessCheck access_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Conversation> conversations_;
+    std::unordered_map<std::string, Cursors> acks_;  // user -> conversation -> acked sequence
+
+    std::atomic<uint64_t> assigned_{0};
+    std::atomic<uint64_t> acks_applied_{0};
+    mutable std::atomic<uint64_t> resumes_{0};
+    mutable std::atomic<uint64_t> replayed_{0};
+    mutable std::atomic<uint64_t> replayed_from_storage_{0};
+    mutable std::atomic<uint64_t> truncated_{0};
+};
+
+} // namespace chat
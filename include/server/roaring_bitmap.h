@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chat {
+
+/**
+ * Compressed set of 32-bit integers (roaring bitmap).
+ *
+ * Values are split by their high 16 bits into containers. A sparse
+ * container is a sorted array of the low 16 bits (at most 4096 of them);
+ * a denser one is a 65536-bit bitmap, so it never takes more than 8 KB.
+ * Membership is a binary search over the container keys followed by a
+ * bit test or a search of at most 4096 entries. Intersections and
+ * unions work container by container; bitmap containers are combined
+ * word-wise (SSE2/AVX2 where available), array containers by merging.
+ */
+class RoaringBitmap {
+public:
+    RoaringBitmap() = default;
+
+    // True if the set changed
+    bool add(uint32_t value);
+    bool remove(uint32_t value);
+    bool contains(uint32_t value) const;
+
+    std::size_t cardinality() const;
+    bool empty() const { return keys_.empty(); }
+    void clear();
+
+    // Set algebra
+    RoaringBitmap operator&(const RoaringBitmap& other) const;
+    RoaringBitmap operator|(const RoaringBitmap& other) const;
+    bool operator==(const RoaringBitmap& other) const;
+    bool operator!=(const RoaringBitmap& other) const { return !(*this == other); }
+
+    // |a & b| without building the intersection
+    static std::size_t intersectionCardinality(const RoaringBitmap& a, const RoaringBitmap& b);
+
+    // Visit values in ascending order
+    template <typename Visitor>
+    void forEach(Visitor&& visitor) const;
+
+    std::vector<uint32_t> toVector() const;
+
+    // Approximate heap footprint
+    std::size_t bytes() const;
+
+private:
+    static constexpr std::size_t ARRAY_LIMIT = 4096;   // Larger containers become bitmaps
+    static constexpr std::size_t BITMAP_WORDS = 1024;  // 65536 bits
+
+    struct Container {
+        std::vector<uint16_t> array;  // Sorted low bits, when not a bitmap
+        std::vector<uint64_t> bits;   // BITMAP_WORDS words, or empty
+        uint32_t cardinality = 0;
+
+        bool isBitmap() const { return !bits.empty(); }
+        bool add(uint16_t low);
+        bool remove(uint16_t low);
+        bool contains(uint16_t low) const;
+        void toBitmap();
+        void toArray();
+    };
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static std::size_t intersectCount(const Container& a, const Container& b);
+
+    // Index of the container for a key, or where it would be inserted
+    std::size_t lowerBound(uint16_t key) const;
+
+    std::vector<uint16_t> keys_;
+    std::vector<Container> containers_;
+};
+
+template <typename Visitor>
+void RoaringBitmap::forEach(Visitor&& visitor) const {
+    for (std::size_t i = 0; i < keys_.size(); ++i) {
+        uint32_t high = static_cast<uint32_t>(keys_[i]) << 16;
+        const Container& container = containers_[i];
+        if (container.isBitmap()) {
+            for (std::size_t word = 0; word < BITMAP_WORDS; ++word) {
+                uint64_t bits = container.bits[word];
+                while (bits != 0) {
+                    visitor(high | static_cast<uint32_t>(word * 64 + __builtin_ctzll(bits)));
+                    bits &= bits - 1;
+                }
+            }
+        } else {
+            for (uint16_t low : container.array) {
+                visitor(high | low);
+            }
+        }
+    }
+}
+
+} // namespace chat
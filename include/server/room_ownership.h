@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "common/config_loader.h"
+#include "common/encoded_message.h"
+#include "server/cluster_manager.h"
+#include "server/hash_ring.h"
+
+namespace chat {
+
+/**
+ * Assigns every room a single owner node with a consistent hash ring
+ * over the live cluster members, and keeps the in-memory state (member
+ * list and recent history) of the rooms this node owns.
+ *
+ * Room messages and membership changes are applied on the owner:
+ * calls made on another node are forwarded to it. When the ring
+ * changes, rooms whose owner moved are handed off as a ROOM_HANDOFF
+ * frame and kept until the new owner acknowledges them, so a target
+ * that disappears mid-transfer gets its rooms re-sent to the next
+ * owner. Anything that reaches the new owner before the handoff itself
+ * is merged with it (history by timestamp, members with removals
+ * replayed), so no message is dropped while rooms move. Only rooms
+ * first seen within the handoff grace period after a ring change wait
+ * for such a merge; others are final when created.
+ *
+ * Construct and start() before ClusterManager::start() so no membership
+ * change is missed.
+ */
+class RoomOwnership {
+public:
+    struct Options {
+        std::size_t virtual_nodes = 128;     // Ring points per node
+        std::size_t history_limit = 100;     // Recent messages kept per room
+        std::chrono::milliseconds handoff_grace{10000};  // A previous owner's handoff may still arrive
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t handoffs_sent = 0;      // Rooms sent to a new owner
+        uint64_t handoffs_received = 0;  // Rooms received from a previous owner
+        uint64_t forwarded = 0;          // Appends/membership changes sent to the owner
+    };
+
+    RoomOwnership(ClusterManager& cluster, Options options);
+
+    RoomOwnership(const RoomOwnership&) = delete;
+    RoomOwnership& operator=(const RoomOwnership&) = delete;
+
+    // Register frame handlers and follow cluster membership
+    void start();
+
+    // Hand every room to the remaining nodes (graceful shutdown);
+    // wait for pendingHandoffs() to reach zero before stopping the cluster
+    void leave();
+
+    // Ownership
+    std::string ownerOf(const std::string& room_id) const;
+    bool isLocalOwner(const std::string& room_id) const;
+    std::vector<std::string> ringNodes() const;
+
+    // Record a room message / membership change on the owner
+    void append(const chat_app::SharedEncodedMessage& message);
+    void addMember(const std::string& room_id, const std::string& user_id);
+    void removeMember(const std::string& room_id, const std::string& user_id);
+
+    // State of a locally owned room (empty if not owned here)
+    std::vector<std::string> members(const std::string& room_id) const;
+    std::vector<chat_app::SharedEncodedMessage> history(const std::string& room_id) const;
+
+    std::size_t roomCount() const;
+    std::size_t pendingHandoffs() const;
+    Stats stats() const;
+
+private:
+    struct RoomState {
+        std::unordered_set<std::string> members;
+        std::deque<chat_app::SharedEncodedMessage> history;  // Oldest first
+        // Created shortly after a ring change, before any handoff arrived;
+        // removals are remembered so a late handoff cannot resurrect
+        // those members
+        bool provisional = false;
+        std::unordered_set<std::string> early_removals;
+    };
+
+    // A room sent to new_owner, awaiting ROOM_HANDOFF_ACK
+    struct Migration {
+        std::string new_owner;
+        RoomState state;
+    };
+
+    void onMembership(const std::string& node_id, bool up);
+    void rebalanceLocked();
+    void sendHandoffLocked(const std::string& room_id, Migration& migration);
+
+    void onHandoff(const std::string& from_node, const std::vector<char>& body);
+    void onHandoffAck(const std::string& from_node, const std::vector<char>& body);
+    void onAppend(const std::string& from_node, const std::vector<char>& body, uint16_t flags);
+    void onMember(const std::string& from_node, const std::vector<char>& body);
+
+    // Apply locally or forward to the owner (called with mutex_ held)
+    void appendLocked(const chat_app::SharedEncodedMessage& message);
+    void memberLocked(const std::string& room_id, const std::string& user_id, bool joined);
+
+    // Room owned here, created on first use (called with mutex_ held)
+    RoomState& ownedRoomLocked(const std::string& room_id);
+    // Stop waiting for a handoff once the grace period is over
+    void settleLocked(RoomState& room) const;
+
+    void trimHistory(RoomState& room) const;
+    void mergeInto(RoomState& target, RoomState&& incoming) const;
+
+    ClusterManager& cluster_;
+    Options options_;
+    const std::string local_node_;
+
+    mutable std::mutex mutex_;
+    HashRing ring_;
+    bool leaving_ = false;
+    std::chrono::steady_clock::time_point handoffs_expected_until_{};
+    std::unordered_map<std::string, RoomState> rooms_;
+    std::unordered_map<std::string, Migration> migrations_;
+
+    std::atomic<uint64_t> handoffs_sent_{0};
+    std::atomic<uint64_t> handoffs_received_{0};
+    std::atomic<uint64_t> forwarded_{0};
+};
+
+} // namespace chat
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include "server/incremental_autosave.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace chat {
+
+/**
+ * User, room-membership and notification (read position and mention)
+ * tables in the SQLite database at DATABASE_PATH.
+ * apply() is the IncrementalAutosave persister: one IMMEDIATE transaction
+ * per batch with prepared statements, so a save touches only the rows in
+ * the batch and either lands completely or not at all.
+ */
+class SqliteStateStore {
+public:
+    SqliteStateStore() = default;
+    ~SqliteStateStore();
+
+    SqliteStateStore(const SqliteStateStore&) = delete;
+    SqliteStateStore& operator=(const SqliteStateStore&) = delete;
+
+    // Open (creating tables if needed); false on error
+    bool open(const std::string& path);
+    void close();
+
+    // Write a batch in one transaction; rolled back on any failure
+    bool apply(const ChangeBatch& batch);
+
+    std::optional<chat_app::User> loadUser(const std::string& user_id);
+    std::size_t userCount();
+
+    // Every stored read position and unread mention, for the notification
+    // index at startup
+    bool loadNotifications(const std::function<void(const ReadPositionChange&)>& on_read_position,
+                           const std::function<void(const Mention&)>& on_mention);
+
+private:
+    enum Statement {
+        BEGIN,
+        COMMIT,
+        ROLLBACK,
+        UPSERT_USER,
+        DELETE_USER,
+        DELETE_USER_ROOMS,
+        INSERT_MEMBER,
+        DELETE_MEMBER,
+        INSERT_MENTION,
+        UPSERT_READ_POSITION,
+        DELETE_READ_MENTIONS,
+        DELETE_USER_MENTIONS,
+        DELETE_USER_READ_POSITIONS,
+        SELECT_USER,
+        SELECT_USER_ROOMS,
+        COUNT_USERS,
+        SELECT_READ_POSITIONS,
+        SELECT_MENTIONS,
+        STATEMENT_COUNT
+    };
+
+    bool exec(const char* sql);
+    bool step(Statement statement);
+    bool writeUser(const UserChange& change);
+
+    sqlite3* db_ = nullptr;
+    sqlite3_stmt* statements_[STATEMENT_COUNT] = {};
+    std::mutex mutex_;
+};
+
+} // namespace chat
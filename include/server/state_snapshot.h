@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+#include "common/config_loader.h"
+#include "common/user.h"
+
+namespace chat {
+
+// Room table entry captured in a snapshot
+struct SnapshotRoom {
+    std::string room_id;
+    std::string name;
+    std::string creator_id;
+    std::vector<std::string> member_ids;
+};
+
+/**
+ * Builds a binary snapshot of the user, room and membership tables.
+ * Tables are sorted by id and memberships are stored as indices, so a
+ * mapped snapshot answers lookups without parsing anything. The file is
+ * written next to its final path and renamed, so a crash mid-write
+ * leaves the previous snapshot in place.
+ */
+class StateSnapshotWriter {
+public:
+    void addUser(const chat_app::User& user);
+    void addRoom(SnapshotRoom room);
+
+    // Write the snapshot; sequence is the last state change it includes
+    bool write(const std::string& path, uint64_t sequence);
+
+    std::size_t userCount() const { return users_.size(); }
+    std::size_t roomCount() const { return rooms_.size(); }
+
+private:
+    std::vector<chat_app::User> users_;
+    std::vector<SnapshotRoom> rooms_;
+};
+
+/**
+ * Read-only view of a snapshot file mapped into memory. Opening checks
+ * the header, section bounds and checksum; after that records are read
+ * in place, and only users actually requested are turned into
+ * chat_app::User objects. Startup maps the latest snapshot and replays
+ * the state changes after sequence() instead of rebuilding every table.
+ */
+class StateSnapshot {
+public:
+    // A user record read in place; views point into the mapping
+    struct UserView {
+        std::string_view user_id;
+        std::string_view username;
+        chat_app::UserStatus status = chat_app::UserStatus::OFFLINE;
+        std::optional<std::string_view> display_name;
+        std::optional<std::string_view> email;
+        std::optional<std::string_view> avatar_url;
+        std::optional<std::chrono::system_clock::time_point> last_seen;
+        const uint32_t* rooms = nullptr;  // Indices into the room table
+        std::size_t room_count = 0;
+    };
+
+    struct RoomView {
+        std::string_view room_id;
+        std::string_view name;
+        std::string_view creator_id;
+        const uint32_t* members = nullptr;  // Indices into the user table
+        std::size_t member_count = 0;
+    };
+
+    StateSnapshot() = default;
+    ~StateSnapshot();
+
+    StateSnapshot(const StateSnapshot&) = delete;
+    StateSnapshot& operator=(const StateSnapshot&) = delete;
+
+    // Map and validate a snapshot; false if missing or damaged
+    bool open(const std::string& path, bool verify_checksum = true);
+    void close();
+    bool isOpen() const { return data_ != nullptr; }
+
+    uint64_t sequence() const;
+    std::chrono::system_clock::time_point createdAt() const;
+
+    std::size_t userCount() const;
+    std::size_t roomCount() const;
+    UserView user(std::size_t index) const;
+    RoomView room(std::size_t index) const;
+
+    // Binary search over the sorted tables
+    std::optional<std::size_t> findUser(std::string_view user_id) const;
+    std::optional<std::size_t> findRoom(std::string_view room_id) const;
+
+    // Materialize a full User (room_ids resolved to ids)
+    chat_app::User loadUser(std::size_t index) const;
+
+private:
+    std::string_view string(const void* ref) const;
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+/**
+ * Writes a snapshot every AUTOSAVE_INTERVAL on a background thread.
+ * The collector fills a writer from the live tables (taking whatever
+ * locks they need) and returns the last state change sequence included;
+ * encoding and file I/O never run on the io_context threads.
+ */
+class SnapshotScheduler {
+public:
+    struct Options {
+        std::string path = "data/state.snap";
+        std::chrono::milliseconds interval{300 * 1000};
+
+        static Options fromConfig(const ConfigLoader& config);
+    };
+
+    struct Stats {
+        uint64_t snapshots = 0;     // Snapshots written
+        uint64_t failures = 0;      // Snapshots that could not be written
+        uint64_t last_users = 0;    // Users in the most recent snapshot
+        uint64_t last_duration_ms = 0;
+    };
+
+    using Collector = std::function<uint64_t(StateSnapshotWriter& writer)>;
+
+    SnapshotScheduler(boost::asio::io_context& io_context, Options options, Collector collector);
+    ~SnapshotScheduler();
+
+    SnapshotScheduler(const SnapshotScheduler&) = delete;
+    SnapshotScheduler& operator=(const SnapshotScheduler&) = delete;
+
+    void start();
+    void stop();
+
+    // Request a snapshot now (e.g. before stop()); requests made while
+    // one is being written are merged into a single follow-up snapshot
+    void requestSnapshot();
+
+    Stats stats() const;
+
+private:
+    void scheduleTimer();
+    void workerLoop();
+
+    // Only touched on its own strand
+    boost::asio::steady_timer timer_;
+    Options options_;
+    Collector collector_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool requested_ = false;
+    bool running_ = false;
+    std::thread worker_;
+
+    std::atomic<uint64_t> snapshots_{0};
+    std::atomic<uint64_t> failures_{0};
+    std::atomic<uint64_t> last_users_{0};
+    std::atomic<uint64_t> last_duration_ms_{0};
+};
+
+} // namespace chat
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "common/user.h"
+#include "server/roaring_bitmap.h"
+
+namespace chat {
+
+/**
+ * Append-only store for interned strings. Strings live in fixed-size
+ * blocks that never move, so a 32-bit offset (block << 16 | position)
+ * names a string and views stay valid for the arena's lifetime.
+ */
+class StringArena {
+public:
+    struct Ref {
+        uint32_t offset = 0;
+        uint16_t length = 0;
+    };
+
+    static constexpr std::size_t BLOCK_SIZE = 1 << 16;
+    static constexpr std::size_t MAX_LENGTH = 0xFFFF;
+
+    // Return the existing copy of a string or add it; nullopt if too long
+    std::optional<Ref> intern(std::string_view value);
+    std::string_view view(Ref ref) const {
+        return std::string_view(blocks_[ref.offset >> 16].get() + (ref.offset & 0xFFFF), ref.length);
+    }
+
+    std::size_t bytes() const { return blocks_.size() * BLOCK_SIZE; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::size_t used_ = BLOCK_SIZE;  // Bytes used in the last block
+    std::unordered_map<std::string_view, Ref> interned_;
+};
+
+/**
+ * Server-wide user directory stored as struct-of-arrays.
+ *
+ * Each user occupies a slot; per-slot data lives in parallel dense
+ * arrays (one status byte, a 32-bit last-seen time in seconds, and
+ * offsets of interned names in a string arena) instead of one heap-heavy
+ * chat_app::User per user. Presence counts and "/list"-style filters are
+ * linear scans of the status array, 16 or 32 slots per instruction with
+ * SSE2/AVX2, so they touch one byte per user. Room membership and the
+ * set of online users are roaring bitmaps over slots: membership tests
+ * are a bit probe, and fan-out targets ("members of the room that are
+ * online") or "users in both rooms" are bitmap intersections.
+ *
+ * Removed slots are tombstoned and reused. Reads take a shared lock.
+ */
+class UserDirectory {
+public:
+    using Slot = uint32_t;
+
+    // Status counts over all users
+    struct PresenceCounts {
+        std::size_t offline = 0;
+        std::size_t online = 0;
+        std::size_t away = 0;
+        std::size_t do_not_disturb = 0;
+
+        std::size_t total() const { return offline + online + away + do_not_disturb; }
+    };
+
+    // A user read in place; views point into the directory's arena
+    struct UserView {
+        Slot slot = 0;
+        std::string_view user_id;
+        std::string_view username;
+        std::optional<std::string_view> display_name;
+        chat_app::UserStatus status = chat_app::UserStatus::OFFLINE;
+        std::optional<std::chrono::system_clock::time_point> last_seen;  // Second resolution
+
+        std::string_view displayName() const { return display_name.value_or(username); }
+    };
+
+    UserDirectory() = default;
+
+    UserDirectory(const UserDirectory&) = delete;
+    UserDirectory& operator=(const UserDirectory&) = delete;
+
+    // Add or replace a user (including its rooms); nullopt if a name is too long
+    std::optional<Slot> upsert(const chat_app::User& user);
+    bool remove(std::string_view user_id);
+
+    bool setStatus(std::string_view user_id, chat_app::UserStatus status);
+    bool setLastSeen(std::string_view user_id, std::chrono::system_clock::time_point time);
+    bool joinRoom(std::string_view room_id, std::string_view user_id);
+    bool leaveRoom(std::string_view room_id, std::string_view user_id);
+
+    std::optional<Slot> find(std::string_view user_id) const;
+    std::optional<UserView> lookup(std::string_view user_id) const;
+
+    // Materialize a full User (e.g. for persistence or JSON)
+    std::optional<chat_app::User> toUser(std::string_view user_id) const;
+
+    std::size_t size() const;
+
+    // Presence scans
+    PresenceCounts countByStatus() const;
+    std::size_t countWithStatus(chat_app::UserStatus status) const;
+    std::size_t countSeenSince(std::chrono::system_clock::time_point since) const;
+
+    // Visit users with a status in slot order; return false from the
+    // visitor to stop early
+    void forEachWithStatus(chat_app::UserStatus status,
+                           const std::function<bool(const UserView&)>& visitor) const;
+
+    // Members of a room currently in a status
+    std::size_t countInRoom(std::string_view room_id, chat_app::UserStatus status) const;
+    std::vector<UserView> listInRoom(std::string_view room_id, chat_app::UserStatus status) const;
+
+    // Room membership as slot sets
+    bool isMember(std::string_view room_id, std::string_view user_id) const;
+    std::size_t memberCount(std::string_view room_id) const;
+    RoaringBitmap members(std::string_view room_id) const;
+    RoaringBitmap onlineMembers(std::string_view room_id) const;
+    RoaringBitmap commonMembers(std::string_view room_a, std::string_view room_b) const;
+
+    // Visit online members of a room (fan-out targets); return false to stop
+    void forEachOnlineMember(std::string_view room_id,
+                             const std::function<bool(const UserView&)>& visitor) const;
+    std::optional<UserView> view(Slot slot) const;
+
+private:
+    // Status byte of a free slot; never matches a real status
+    static constexpr uint8_t FREE_SLOT = 0xFF;
+    static constexpr uint32_t NO_NAME = 0xFFFFFFFF;
+
+    Slot allocateSlot();
+    void releaseSlot(Slot slot);
+    void removeFromRoomsLocked(Slot slot);
+    void setStatusLocked(Slot slot, uint8_t status);
+    std::optional<uint32_t> findRoomLocked(std::string_view room_id) const;
+    std::optional<uint32_t> internRoomLocked(std::string_view room_id);
+    bool joinLocked(uint32_t room, Slot slot);
+    std::size_t countWithStatusLocked(uint8_t status) const;
+    UserView viewLocked(Slot slot) const;
+
+    mutable std::shared_mutex mutex_;
+    StringArena arena_;
+
+    // Parallel per-slot arrays
+    std::vector<uint8_t> status_;
+    std::vector<uint32_t> last_seen_;  // Seconds since the epoch, 0 if never
+    std::vector<StringArena::Ref> user_id_;
+    std::vector<StringArena::Ref> username_;
+    std::vector<StringArena::Ref> display_name_;  // length 0 with offset NO_NAME if unset
+    std::vector<std::vector<uint32_t>> rooms_;   // Room indices per slot
+
+    std::unordered_map<std::string_view, Slot> slots_;     // user_id -> slot
+    std::unordered_map<std::string_view, uint32_t> room_index_;  // room_id -> room index
+    std::vector<StringArena::Ref> room_ids_;
+    std::vector<RoaringBitmap> room_members_;               // Slots per room
+    RoaringBitmap online_;                                  // Slots with status ONLINE
+    std::vector<Slot> free_slots_;
+};
+
+} // namespace chat
@@ -0,0 +1,318 @@
+#include "client/client_cache.h"
+#include "common/config_loader.h"
+#include "common/logger.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+namespace chat_app {
+
+namespace {
+
+const char* const SCHEMA =
+    "CREATE TABLE IF NOT EXISTS meta ("
+    "  key TEXT PRIMARY KEY,"
+    "  value TEXT NOT NULL"
+    ") WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS rooms ("
+    "  room_id TEXT PRIMARY KEY,"
+    "  name TEXT NOT NULL"
+    ") WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS room_members ("
+    "  room_id TEXT NOT NULL,"
+    "  user_id TEXT NOT NULL,"
+    "  PRIMARY KEY (room_id, user_id)"
+    ") WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS messages ("
+    "  conversation TEXT NOT NULL,"
+    "  sequence INTEGER NOT NULL,"
+    "  body BLOB NOT NULL,"
+    "  PRIMARY KEY (conversation, sequence)"
+    ") WITHOUT ROWID;";
+
+// Indexed by ClientCache::Statement
+const char* const STATEMENT_SQL[] = {
+    "BEGIN IMMEDIATE",
+    "COMMIT",
+    "ROLLBACK",
+    "SELECT value FROM meta WHERE key = 'owner'",
+    "INSERT INTO meta (key, value) VALUES ('owner', ?1) ON CONFLICT(key) DO UPDATE SET value = ?1",
+    "DELETE FROM rooms",
+    "DELETE FROM room_members",
+    "INSERT OR REPLACE INTO rooms (room_id, name) VALUES (?1, ?2)",
+    "INSERT OR IGNORE INTO room_members (room_id, user_id) VALUES (?1, ?2)",
+    "SELECT room_id, name FROM rooms ORDER BY room_id",
+    "SELECT room_id, user_id FROM room_members ORDER BY room_id, user_id",
+    "INSERT OR REPLACE INTO messages (conversation, sequence, body) VALUES (?1, ?2, ?3)",
+    "DELETE FROM messages WHERE conversation = ?1 AND "
+    "sequence <= (SELECT MAX(sequence) FROM messages WHERE conversation = ?1) - ?2",
+    "SELECT body FROM messages WHERE conversation = ?1 ORDER BY sequence DESC LIMIT ?2",
+    // End of the first unbroken run: the lowest sequence whose successor is missing
+    "SELECT conversation, MIN(sequence) FROM messages AS m WHERE NOT EXISTS ("
+    "SELECT 1 FROM messages WHERE conversation = m.conversation AND sequence = m.sequence + 1) "
+    "GROUP BY conversation",
+    "DELETE FROM messages WHERE conversation = ?1",
+};
+
+void bindText(sqlite3_stmt* statement, int index, const std::string& value) {
+    sqlite3_bind_text(statement, index, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+}
+
+std::string columnText(sqlite3_stmt* statement, int index) {
+    return std::string(reinterpret_cast<const char*>(sqlite3_column_text(statement, index)),
+                       static_cast<std::size_t>(sqlite3_column_bytes(statement, index)));
+}
+
+// Run a prepared query, calling on_row for each result row
+template <typename OnRow>
+void query(sqlite3_stmt* statement, OnRow&& on_row) {
+    while (sqlite3_step(statement) == SQLITE_ROW) {
+        on_row(statement);
+    }
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+}
+
+} // namespace
+
+ClientCache::Options ClientCache::Options::fromConfig(const chat::ConfigLoader& config) {
+    Options options;
+    options.path = config.getString("CLIENT_CACHE_PATH", options.path);
+    options.messages_per_conversation = static_cast<std::size_t>(std::max(1,
+        config.getInt("CLIENT_CACHE_MESSAGES", static_cast<int>(options.messages_per_conversation))));
+    return options;
+}
+
+ClientCache::ClientCache(Options options)
+    : options_(std::move(options)) {
+}
+
+ClientCache::~ClientCache() {
+    close();
+}
+
+bool ClientCache::open(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (db_) {
+        return ownCache(user_id);
+    }
+    if (sqlite3_open(options_.path.c_str(), &db_) != SQLITE_OK) {
+        CHAT_LOG_ERROR("Cannot open client cache {}: {}", options_.path, sqlite3_errmsg(db_));
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    // The cache can always be rebuilt from the server, so a lost tail
+    // after a crash is acceptable
+    if (!exec("PRAGMA journal_mode=WAL") || !exec("PRAGMA synchronous=OFF") || !exec(SCHEMA)) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    for (int i = 0; i < STATEMENT_COUNT; ++i) {
+        if (sqlite3_prepare_v2(db_, STATEMENT_SQL[i], -1, &statements_[i], nullptr) != SQLITE_OK) {
+            CHAT_LOG_ERROR("Cannot prepare client cache statement: {}", sqlite3_errmsg(db_));
+            for (auto*& statement : statements_) {
+                sqlite3_finalize(statement);
+                statement = nullptr;
+            }
+            sqlite3_close(db_);
+            db_ = nullptr;
+            return false;
+        }
+    }
+    return ownCache(user_id);
+}
+
+void ClientCache::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto*& statement : statements_) {
+        sqlite3_finalize(statement);
+        statement = nullptr;
+    }
+    if (db_) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+    }
+}
+
+bool ClientCache::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return db_ != nullptr;
+}
+
+Roster ClientCache::roster() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Roster roster;
+    if (!db_) {
+        return roster;
+    }
+    query(statements_[SELECT_ROOMS], [&roster](sqlite3_stmt* row) {
+        roster.push_back(RosterRoom{columnText(row, 0), columnText(row, 1), {}});
+    });
+    // Both queries are ordered by room_id, so members merge in one pass
+    auto room = roster.begin();
+    query(statements_[SELECT_MEMBERS], [&](sqlite3_stmt* row) {
+        std::string room_id = columnText(row, 0);
+        while (room != roster.end() && room->room_id < room_id) {
+            ++room;
+        }
+        if (room != roster.end() && room->room_id == room_id) {
+            room->members.push_back(columnText(row, 1));
+        }
+    });
+    return roster;
+}
+
+bool ClientCache::replaceRoster(const Roster& roster) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!db_ || !step(BEGIN)) {
+        return false;
+    }
+    bool ok = step(DELETE_ROOMS) && step(DELETE_MEMBERS);
+    for (auto room = roster.begin(); ok && room != roster.end(); ++room) {
+        bindText(statements_[INSERT_ROOM], 1, room->room_id);
+        bindText(statements_[INSERT_ROOM], 2, room->name);
+        ok = step(INSERT_ROOM);
+        for (auto member = room->members.begin(); ok && member != room->members.end(); ++member) {
+            bindText(statements_[INSERT_MEMBER], 1, room->room_id);
+            bindText(statements_[INSERT_MEMBER], 2, *member);
+            ok = step(INSERT_MEMBER);
+        }
+    }
+    if (!ok || !step(COMMIT)) {
+        step(ROLLBACK);
+        return false;
+    }
+    return true;
+}
+
+bool ClientCache::storeMessages(const std::vector<ChatMessage>& messages) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!db_ || !step(BEGIN)) {
+        return false;
+    }
+    bool ok = true;
+    std::set<std::string> touched;
+    for (auto message = messages.begin(); ok && message != messages.end(); ++message) {
+        if (message->sequence == 0) {
+            continue;
+        }
+        std::string conversation = message->conversationId();
+        std::vector<char> body = message->toBinary();
+        sqlite3_stmt* upsert = statements_[UPSERT_MESSAGE];
+        bindText(upsert, 1, conversation);
+        sqlite3_bind_int64(upsert, 2, static_cast<sqlite3_int64>(message->sequence));
+        sqlite3_bind_blob(upsert, 3, body.data(), static_cast<int>(body.size()), SQLITE_TRANSIENT);
+        ok = step(UPSERT_MESSAGE);
+        touched.insert(std::move(conversation));
+    }
+    for (auto conversation = touched.begin(); ok && conversation != touched.end(); ++conversation) {
+        bindText(statements_[PRUNE_MESSAGES], 1, *conversation);
+        sqlite3_bind_int64(statements_[PRUNE_MESSAGES], 2,
+                           static_cast<sqlite3_int64>(options_.messages_per_conversation));
+        ok = step(PRUNE_MESSAGES);
+    }
+    if (!ok || !step(COMMIT)) {
+        step(ROLLBACK);
+        return false;
+    }
+    return true;
+}
+
+std::vector<ChatMessage> ClientCache::recentMessages(const std::string& conversation, std::size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ChatMessage> messages;
+    if (!db_) {
+        return messages;
+    }
+    sqlite3_stmt* select = statements_[SELECT_RECENT];
+    bindText(select, 1, conversation);
+    sqlite3_bind_int64(select, 2, static_cast<sqlite3_int64>(limit));
+    query(select, [&messages](sqlite3_stmt* row) {
+        try {
+            messages.push_back(ChatMessage::fromBinary(static_cast<const char*>(sqlite3_column_blob(row, 0)),
+                                                       static_cast<std::size_t>(sqlite3_column_bytes(row, 0))));
+        } catch (const std::runtime_error& e) {
+            CHAT_LOG_WARN("Skipping unreadable cached message: {}", e.what());
+        }
+    });
+    std::reverse(messages.begin(), messages.end());
+    return messages;
+}
+
+SyncCursors ClientCache::cursors() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncCursors cursors;
+    if (!db_) {
+        return cursors;
+    }
+    query(statements_[SELECT_CURSORS], [&cursors](sqlite3_stmt* row) {
+        cursors[columnText(row, 0)] = static_cast<uint64_t>(sqlite3_column_int64(row, 1));
+    });
+    return cursors;
+}
+
+SyncRequest ClientCache::syncRequest() {
+    SyncRequest request;
+    request.roster_digest = rosterDigest(roster());
+    request.cursors = cursors();
+    return request;
+}
+
+bool ClientCache::forgetConversation(const std::string& conversation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!db_) {
+        return false;
+    }
+    bindText(statements_[DELETE_CONVERSATION], 1, conversation);
+    return step(DELETE_CONVERSATION);
+}
+
+bool ClientCache::exec(const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db_, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        CHAT_LOG_ERROR("Client cache error: {}", error ? error : "unknown");
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+bool ClientCache::step(Statement statement) {
+    sqlite3_stmt* prepared = statements_[statement];
+    int result = sqlite3_step(prepared);
+    sqlite3_reset(prepared);
+    sqlite3_clear_bindings(prepared);
+    if (result != SQLITE_DONE) {
+        CHAT_LOG_ERROR("Client cache error: {}", sqlite3_errmsg(db_));
+        return false;
+    }
+    return true;
+}
+
+bool ClientCache::ownCache(const std::string& user_id) {
+    std::string owner;
+    bool found = false;
+    query(statements_[SELECT_OWNER], [&](sqlite3_stmt* row) {
+        owner = columnText(row, 0);
+        found = true;
+    });
+    if (found && owner == user_id) {
+        return true;
+    }
+    // Another user's rooms and messages must not leak into this session
+    if (!exec("BEGIN IMMEDIATE; DELETE FROM rooms; DELETE FROM room_members; DELETE FROM messages;")) {
+        exec("ROLLBACK");
+        return false;
+    }
+    bindText(statements_[UPSERT_OWNER], 1, user_id);
+    if (!step(UPSERT_OWNER) || !exec("COMMIT")) {
+        exec("ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+} // namespace chat_app
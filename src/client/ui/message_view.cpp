@@ -0,0 +1,257 @@
+#include "client/ui/message_view.h"
+#include "common/config_loader.h"
+#include <curses.h>
+#include <algorithm>
+#include <ctime>
+
+namespace chat_app {
+
+namespace {
+
+// Marks a row whose contents are unknown; laid-out text never contains it
+const std::string UNKNOWN_ROW(1, '\0');
+
+std::size_t utf8Length(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if ((lead & 0xE0) == 0xC0) return 2;
+    if ((lead & 0xF0) == 0xE0) return 3;
+    if ((lead & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+} // namespace
+
+MessageView::Options MessageView::Options::fromConfig(const chat::ConfigLoader& config) {
+    Options options;
+    options.scrollback_lines = static_cast<std::size_t>(std::max(1,
+        config.getInt("CLIENT_SCROLLBACK_LINES", static_cast<int>(options.scrollback_lines))));
+    int rate = std::max(1, config.getInt("CLIENT_FRAME_RATE", 30));
+    options.frame_interval = std::chrono::milliseconds(1000 / rate);
+    return options;
+}
+
+MessageView::MessageView(Options options)
+    : options_(options) {
+}
+
+void MessageView::post(const ChatMessage& message) {
+    std::string text = format(message);
+    posted_.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    pending_.push_back(std::move(text));
+    // Every message takes at least one line, so older ones would be
+    // trimmed from the scrollback right after layout anyway
+    if (pending_.size() > options_.scrollback_lines) {
+        pending_.pop_front();
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MessageView::resize(int width, int height) {
+    if (width != width_) {
+        width_ = width;
+        lines_.clear();
+        for (auto& entry : entries_) {
+            appendLines(entry);
+        }
+        trim();
+    }
+    height_ = std::max(0, height);
+    screen_.assign(static_cast<std::size_t>(height_), UNKNOWN_ROW);
+    scrollBy(0);
+}
+
+void MessageView::scrollBy(int lines) {
+    if (lines < 0) {
+        offset_ += static_cast<std::size_t>(-lines);
+    } else {
+        offset_ -= std::min(offset_, static_cast<std::size_t>(lines));
+    }
+    std::size_t max_offset = lines_.size() > static_cast<std::size_t>(height_)
+                                 ? lines_.size() - static_cast<std::size_t>(height_) : 0;
+    offset_ = std::min(offset_, max_offset);
+    if (offset_ == 0) {
+        unseen_ = 0;
+    }
+}
+
+void MessageView::scrollToBottom() {
+    offset_ = 0;
+    unseen_ = 0;
+}
+
+MessageView::Frame MessageView::frame(Clock::time_point now) {
+    last_frame_ = now;
+    frames_.fetch_add(1, std::memory_order_relaxed);
+
+    std::deque<std::string> batch;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        batch.swap(pending_);
+    }
+
+    std::size_t before = lines_.size();
+    for (auto& text : batch) {
+        entries_.push_back(Entry{std::move(text), 0});
+        appendLines(entries_.back());
+    }
+    std::size_t appended = lines_.size() - before;
+    trim();
+
+    if (offset_ > 0) {
+        // Keep the lines being read in place
+        offset_ += appended;
+        unseen_ += appended;
+        scrollBy(0);
+    }
+
+    Frame frame;
+    std::size_t height = static_cast<std::size_t>(height_);
+    if (height == 0) {
+        return frame;
+    }
+
+    // New lines at the bottom: move what is on screen up instead of
+    // redrawing it, then only the new rows differ
+    if (offset_ == 0 && appended > 0 && appended < height) {
+        frame.scroll = static_cast<int>(appended);
+        screen_.erase(screen_.begin(), screen_.begin() + static_cast<std::ptrdiff_t>(appended));
+        screen_.resize(height, std::string());
+    }
+
+    // Bottom row shows the line offset_ above the newest; short
+    // histories leave blank rows at the top
+    std::size_t visible_end = lines_.size() - offset_;
+    static const std::string blank;
+    for (std::size_t row = 0; row < height; ++row) {
+        std::size_t from_bottom = height - row;
+        const std::string& line = from_bottom <= visible_end ? lines_[visible_end - from_bottom] : blank;
+        if (screen_[row] != line) {
+            screen_[row] = line;
+            frame.rows.push_back(Row{static_cast<int>(row), line});
+        }
+    }
+    rows_drawn_.fetch_add(frame.rows.size(), std::memory_order_relaxed);
+    return frame;
+}
+
+std::chrono::milliseconds MessageView::untilNextFrame(Clock::time_point now) const {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_frame_);
+    return elapsed >= options_.frame_interval ? std::chrono::milliseconds(0) : options_.frame_interval - elapsed;
+}
+
+MessageView::Stats MessageView::stats() const {
+    Stats stats;
+    stats.posted = posted_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.frames = frames_.load(std::memory_order_relaxed);
+    stats.rows_drawn = rows_drawn_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string MessageView::format(const ChatMessage& message) {
+    // localtime_r takes a lock and may stat the zone file; a busy room
+    // posts many messages per minute
+    thread_local std::time_t cached_minute = -1;
+    thread_local char stamp[16] = "";
+    std::time_t time = std::chrono::system_clock::to_time_t(message.timestamp);
+    if (time / 60 != cached_minute) {
+        cached_minute = time / 60;
+        std::tm local{};
+        localtime_r(&time, &local);
+        std::strftime(stamp, sizeof(stamp), "[%H:%M] ", &local);
+    }
+
+    std::string text = stamp + message.sender_id + ": " + message.content;
+    // Control characters would move the curses cursor
+    for (char& c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if ((byte < 0x20 && c != '\n') || byte == 0x7F) {
+            c = ' ';
+        }
+    }
+    return text;
+}
+
+std::vector<std::string> MessageView::wrap(const std::string& text, int width) {
+    std::vector<std::string> lines;
+    if (width <= 0) {
+        return lines;
+    }
+    const std::string indent = width > 4 ? "  " : "";
+
+    auto emit = [&](std::size_t from, std::size_t to) {
+        lines.push_back(lines.empty() ? text.substr(from, to - from) : indent + text.substr(from, to - from));
+    };
+
+    std::size_t paragraph = 0;
+    while (paragraph <= text.size()) {
+        std::size_t paragraph_end = std::min(text.find('\n', paragraph), text.size());
+        std::size_t pos = paragraph;
+        if (pos == paragraph_end) {
+            emit(pos, pos);
+        }
+        while (pos < paragraph_end) {
+            std::size_t available = static_cast<std::size_t>(width) - (lines.empty() ? 0 : indent.size());
+            std::size_t end = pos;
+            std::size_t columns = 0;
+            std::size_t last_space = std::string::npos;
+            while (end < paragraph_end && columns < available) {
+                if (text[end] == ' ') {
+                    last_space = end;
+                }
+                end = std::min(end + utf8Length(static_cast<unsigned char>(text[end])), paragraph_end);
+                ++columns;
+            }
+            if (end < paragraph_end && text[end] == ' ') {
+                emit(pos, end);
+                pos = end + 1;
+            } else if (end < paragraph_end && last_space != std::string::npos && last_space > pos) {
+                emit(pos, last_space);
+                pos = last_space + 1;
+            } else {
+                emit(pos, end);
+                pos = end;
+            }
+        }
+        paragraph = paragraph_end + 1;
+    }
+    return lines;
+}
+
+void MessageView::render(_win_st* window, const Frame& frame) {
+    if (frame.scroll > 0) {
+        scrollok(window, TRUE);
+        wscrl(window, frame.scroll);
+        scrollok(window, FALSE);
+    }
+    for (const auto& row : frame.rows) {
+        wmove(window, row.index, 0);
+        waddnstr(window, row.text.c_str(), static_cast<int>(row.text.size()));
+        // A full-width line leaves the cursor on the next row
+        if (getcury(window) == row.index) {
+            wclrtoeol(window);
+        }
+    }
+    wnoutrefresh(window);
+}
+
+void MessageView::appendLines(Entry& entry) {
+    std::vector<std::string> wrapped = wrap(entry.text, width_);
+    entry.line_count = wrapped.size();
+    for (auto& line : wrapped) {
+        lines_.push_back(std::move(line));
+    }
+}
+
+void MessageView::trim() {
+    while (entries_.size() > 1 &&
+           (lines_.size() > options_.scrollback_lines || entries_.size() > options_.scrollback_lines)) {
+        std::size_t count = std::min(entries_.front().line_count, lines_.size());
+        lines_.erase(lines_.begin(), lines_.begin() + static_cast<std::ptrdiff_t>(count));
+        entries_.pop_front();
+    }
+}
+
+} // namespace chat_app
@@ -1,9 +1,73 @@
 #include "common/chat_message.h"
 #include <ctime>
 #include <random>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>  // For network byte order conversions
 
 namespace chat_app {
 
+namespace {
+
+// Binary layout version, bumped whenever the field order changes
+constexpr uint8_t BINARY_FORMAT_VERSION = 1;
+
+// Presence bits for the optional fields
+constexpr uint8_t HAS_ROOM_ID      = 0x01;
+constexpr uint8_t HAS_RECIPIENT_ID = 0x02;
+constexpr uint8_t HAS_SEQUENCE     = 0x04;  // Appended last, so older readers ignore it
+
+void appendUint32(std::vector<char>& out, uint32_t value) {
+    uint32_t net_value = htonl(value);
+    const char* bytes = reinterpret_cast<const char*>(&net_value);
+    out.insert(out.end(), bytes, bytes + sizeof(net_value));
+}
+
+void appendString(std::vector<char>& out, const std::string& value) {
+    appendUint32(out, static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// Bounds-checked reader over an encoded buffer
+class BinaryReader {
+public:
+    BinaryReader(const char* data, std::size_t size) : data_(data), size_(size) {}
+    
+    uint8_t readUint8() {
+        require(1);
+        return static_cast<uint8_t>(data_[offset_++]);
+    }
+    
+    uint32_t readUint32() {
+        require(sizeof(uint32_t));
+        uint32_t net_value;
+        std::memcpy(&net_value, data_ + offset_, sizeof(net_value));
+        offset_ += sizeof(net_value);
+        return ntohl(net_value);
+    }
+    
+    std::string readString() {
+        uint32_t length = readUint32();
+        require(length);
+        std::string value(data_ + offset_, length);
+        offset_ += length;
+        return value;
+    }
+
+private:
+    void require(std::size_t count) const {
+        if (size_ - offset_ < count) {
+            throw std::runtime_error("Truncated binary chat message");
+        }
+    }
+    
+    const char* data_;
+    std::size_t size_;
+    std::size_t offset_ = 0;
+};
+
+} // namespace
+
 nlohmann::json ChatMessage::toJson() const {
     nlohmann::json json;
     json["id"] = message_id;
@@ -21,6 +85,10 @@ nlohmann::json ChatMessage::toJson() const {
         json["recipient"] = recipient_id.value();
     }
     
+    if (sequence != 0) {
+        json["seq"] = sequence;
+    }
+    
     return json;
 }
 
@@ -45,6 +113,72 @@ ChatMessage ChatMessage::fromJson(const nlohmann::json& json) {
         msg.recipient_id = json["recipient"].get<std::string>();
     }
     
+    if (json.contains("seq")) {
+        msg.sequence = json["seq"].get<uint64_t>();
+    }
+    
+    return msg;
+}
+
+std::vector<char> ChatMessage::toBinary() const {
+    std::vector<char> out;
+    out.reserve(3 + 8 + 4 * 5 + 8 + message_id.size() + sender_id.size() + content.size() +
+                room_id.value_or("").size() + recipient_id.value_or("").size());
+    
+    uint8_t presence = 0;
+    if (room_id.has_value()) presence |= HAS_ROOM_ID;
+    if (recipient_id.has_value()) presence |= HAS_RECIPIENT_ID;
+    if (sequence != 0) presence |= HAS_SEQUENCE;
+    
+    out.push_back(static_cast<char>(BINARY_FORMAT_VERSION));
+    out.push_back(static_cast<char>(message_type));
+    out.push_back(static_cast<char>(presence));
+    
+    // Timestamp as milliseconds since epoch, high word first
+    uint64_t ts = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        timestamp.time_since_epoch()).count());
+    appendUint32(out, static_cast<uint32_t>(ts >> 32));
+    appendUint32(out, static_cast<uint32_t>(ts & 0xFFFFFFFFu));
+    
+    appendString(out, message_id);
+    appendString(out, sender_id);
+    appendString(out, content);
+    if (room_id.has_value()) appendString(out, room_id.value());
+    if (recipient_id.has_value()) appendString(out, recipient_id.value());
+    if (sequence != 0) {
+        appendUint32(out, static_cast<uint32_t>(sequence >> 32));
+        appendUint32(out, static_cast<uint32_t>(sequence & 0xFFFFFFFFu));
+    }
+    
+    return out;
+}
+
+ChatMessage ChatMessage::fromBinary(const char* data, std::size_t size) {
+    BinaryReader reader(data, size);
+    
+    if (reader.readUint8() != BINARY_FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported binary chat message version");
+    }
+    
+    ChatMessage msg;
+    msg.message_type = reader.readUint8();
+    uint8_t presence = reader.readUint8();
+    
+    uint64_t ts = static_cast<uint64_t>(reader.readUint32()) << 32;
+    ts |= reader.readUint32();
+    msg.timestamp = std::chrono::system_clock::time_point(
+        std::chrono::milliseconds(static_cast<int64_t>(ts)));
+    
+    msg.message_id = reader.readString();
+    msg.sender_id = reader.readString();
+    msg.content = reader.readString();
+    if (presence & HAS_ROOM_ID) msg.room_id = reader.readString();
+    if (presence & HAS_RECIPIENT_ID) msg.recipient_id = reader.readString();
+    if (presence & HAS_SEQUENCE) {
+        msg.sequence = static_cast<uint64_t>(reader.readUint32()) << 32;
+        msg.sequence |= reader.readUint32();
+    }
+    
     return msg;
 }
 
@@ -4,13 +4,46 @@
 
 namespace chat {
 
+namespace {
+
+// Parse a boolean the way getBool() always has
+std::optional<bool> parseBool(const std::string& value) {
+    std::string value_lower = value;
+    std::transform(value_lower.begin(), value_lower.end(), value_lower.begin(), 
+                  [](unsigned char c) { return std::tolower(c); });
+                  
+    if (value_lower == "true" || value_lower == "yes" || value_lower == "1") {
+        return true;
+    } else if (value_lower == "false" || value_lower == "no" || value_lower == "0") {
+        return false;
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+bool ConfigSnapshot::differs(const ConfigSnapshot& other, const std::string& key) const {
+    auto mine = values.find(key);
+    auto theirs = other.values.find(key);
+    if (mine == values.end() || theirs == other.values.end()) {
+        return (mine == values.end()) != (theirs == other.values.end());
+    }
+    return mine->second != theirs->second;
+}
+
 ConfigLoader::ConfigLoader(const std::string& config_file_path)
     : config_file_path_(config_file_path) {
+    // Start from an empty snapshot so readers always have one
+    auto empty = std::make_shared<ConfigSnapshot>();
+    buildTypedValues(*empty);
+    published_.push_back(empty);
+    current_.store(empty.get(), std::memory_order_release);
+    
     reload();
 }
 
 bool ConfigLoader::reload() {
-    config_values_.clear();
+    std::unique_lock<std::mutex> lock(reload_mutex_);
     
     std::ifstream config_file(config_file_path_);
     if (!config_file.is_open()) {
@@ -18,15 +51,93 @@ bool ConfigLoader::reload() {
         return false;
     }
     
+    // Build the new snapshot off to the side
+    auto snapshot = std::make_shared<ConfigSnapshot>();
     std::string line;
     while (std::getline(config_file, line)) {
-        parseLine(line);
+        parseLine(line, snapshot->values);
+    }
+    buildTypedValues(*snapshot);
+    
+    // Publish it with a single pointer store
+    SnapshotPtr previous = published_.back();
+    snapshot->version = previous->version + 1;
+    published_.push_back(snapshot);
+    current_.store(snapshot.get(), std::memory_order_release);
+    lock.unlock();
+    
+    // Notify subscribers outside the reload lock
+    std::vector<std::shared_ptr<ChangeCallback>> callbacks;
+    {
+        std::lock_guard<std::mutex> subscriber_lock(subscriber_mutex_);
+        for (const auto& entry : subscribers_) {
+            callbacks.push_back(entry.second);
+        }
+    }
+    for (const auto& callback : callbacks) {
+        (*callback)(*previous, *snapshot);
     }
     
     return true;
 }
 
-void ConfigLoader::parseLine(const std::string& line) {
+ConfigLoader::SnapshotPtr ConfigLoader::snapshot() const {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    return published_.back();
+}
+
+ConfigLoader::SubscriptionId ConfigLoader::subscribe(ChangeCallback callback) {
+    std::lock_guard<std::mutex> lock(subscriber_mutex_);
+    SubscriptionId id = next_subscription_id_++;
+    subscribers_.emplace_back(id, std::make_shared<ChangeCallback>(std::move(callback)));
+    return id;
+}
+
+void ConfigLoader::unsubscribe(SubscriptionId id) {
+    std::lock_guard<std::mutex> lock(subscriber_mutex_);
+    subscribers_.erase(std::remove_if(subscribers_.begin(), subscribers_.end(),
+                                      [id](const auto& entry) { return entry.first == id; }),
+                       subscribers_.end());
+}
+
+void ConfigLoader::buildTypedValues(ConfigSnapshot& snapshot) const {
+    // Pre-parse every integer-looking value once
+    for (const auto& [key, value] : snapshot.values) {
+        try {
+            std::size_t consumed = 0;
+            long long parsed = std::stoll(value, &consumed);
+            if (consumed > 0) {
+                snapshot.int_values[key] = parsed;
+            }
+        } catch (const std::exception&) {
+            // Not an integer; getInt() reports it on use
+        }
+    }
+    
+    auto intOr = [&snapshot](const char* key, int default_value) {
+        auto it = snapshot.int_values.find(key);
+        return it != snapshot.int_values.end() ? static_cast<int>(it->second) : default_value;
+    };
+    auto boolOr = [&snapshot](const char* key, bool default_value) {
+        auto it = snapshot.values.find(key);
+        return it != snapshot.values.end() ? parseBool(it->second).value_or(default_value) : default_value;
+    };
+    
+    snapshot.server_port = intOr("SERVER_PORT", 8080);
+    snapshot.max_connections = intOr("MAX_CONNECTIONS", 100);
+    snapshot.connection_timeout = intOr("CONNECTION_TIMEOUT", 60);
+    snapshot.thread_pool_size = intOr("THREAD_POOL_SIZE", 0);
+    snapshot.autosave_interval = intOr("AUTOSAVE_INTERVAL", 300);
+    snapshot.message_queue_size = intOr("MESSAGE_QUEUE_SIZE", 1000);
+    snapshot.message_history_limit = intOr("MESSAGE_HISTORY_LIMIT", 100);
+    snapshot.enable_ssl = boolOr("ENABLE_SSL", false);
+    snapshot.enable_console_log = boolOr("ENABLE_CONSOLE_LOG", true);
+    
+    auto level = snapshot.values.find("LOG_LEVEL");
+    snapshot.log_level = level != snapshot.values.end() ? stringToLogLevel(level->second) : LogLevel::INFO;
+}
+
+void ConfigLoader::parseLine(const std::string& line, std::unordered_map<std::string, std::string>& values) const {
     // Skip empty lines and comments
     std::string trimmed_line = trim(line);
     if (trimmed_line.empty() || trimmed_line[0] == '#') {
@@ -54,41 +165,39 @@ void ConfigLoader::parseLine(const std::string& line) {
     
     // Store in the map if key is not empty
     if (!key.empty()) {
-        config_values_[key] = value;
+        values[key] = value;
     }
 }
 
 std::string ConfigLoader::getString(const std::string& key, const std::string& default_value) const {
-    auto it = config_values_.find(key);
-    if (it != config_values_.end()) {
+    const auto& values = current().values;
+    auto it = values.find(key);
+    if (it != values.end()) {
         return it->second;
     }
     return default_value;
 }
 
 int ConfigLoader::getInt(const std::string& key, int default_value) const {
-    auto it = config_values_.find(key);
-    if (it != config_values_.end()) {
-        try {
-            return std::stoi(it->second);
-        } catch (const std::exception& e) {
-            std::cerr << "Warning: Failed to convert '" << it->second << "' to int for key '" << key << "': " << e.what() << std::endl;
-        }
+    const ConfigSnapshot& snapshot = current();
+    auto parsed = snapshot.int_values.find(key);
+    if (parsed != snapshot.int_values.end()) {
+        return static_cast<int>(parsed->second);
+    }
+    
+    auto it = snapshot.values.find(key);
+    if (it != snapshot.values.end()) {
+        std::cerr << "Warning: Failed to convert '" << it->second << "' to int for key '" << key << "'" << std::endl;
     }
     return default_value;
 }
 
 bool ConfigLoader::getBool(const std::string& key, bool default_value) const {
-    auto it = config_values_.find(key);
-    if (it != config_values_.end()) {
-        std::string value_lower = it->second;
-        std::transform(value_lower.begin(), value_lower.end(), value_lower.begin(), 
-                      [](unsigned char c) { return std::tolower(c); });
-                      
-        if (value_lower == "true" || value_lower == "yes" || value_lower == "1") {
-            return true;
-        } else if (value_lower == "false" || value_lower == "no" || value_lower == "0") {
-            return false;
+    const auto& values = current().values;
+    auto it = values.find(key);
+    if (it != values.end()) {
+        if (auto parsed = parseBool(it->second)) {
+            return *parsed;
         }
         std::cerr << "Warning: Failed to convert '" << it->second << "' to bool for key '" << key << "'" << std::endl;
     }
@@ -96,8 +205,9 @@ bool ConfigLoader::getBool(const std::string& key, bool default_value) const {
 }
 
 double ConfigLoader::getFloat(const std::string& key, double default_value) const {
-    auto it = config_values_.find(key);
-    if (it != config_values_.end()) {
+    const auto& values = current().values;
+    auto it = values.find(key);
+    if (it != values.end()) {
         try {
             return std::stod(it->second);
         } catch (const std::exception& e) {
@@ -107,22 +217,19 @@ double ConfigLoader::getFloat(const std::string& key, double default_value) cons
     return default_value;
 }
 
-LogLevel ConfigLoader::getLogLevel() const {
-    return stringToLogLevel(getString("LOG_LEVEL", "INFO"));
-}
-
 bool ConfigLoader::hasKey(const std::string& key) const {
-    return config_values_.find(key) != config_values_.end();
+    const auto& values = current().values;
+    return values.find(key) != values.end();
 }
 
 void ConfigLoader::dumpConfig(std::ostream& out) const {
     out << "Configuration (" << config_file_path_ << "):\n";
-    for (const auto& [key, value] : config_values_) {
+    for (const auto& [key, value] : current().values) {
         out << "  " << key << " = " << value << "\n";
     }
 }
 
-LogLevel ConfigLoader::stringToLogLevel(const std::string& level_str) const {
+LogLevel ConfigLoader::stringToLogLevel(const std::string& level_str) {
     std::string upper_level = level_str;
     std::transform(upper_level.begin(), upper_level.end(), upper_level.begin(), 
                   [](unsigned char c) { return std::toupper(c); });
@@ -138,7 +245,7 @@ LogLevel ConfigLoader::stringToLogLevel(const std::string& level_str) const {
     return LogLevel::INFO;
 }
 
-std::string ConfigLoader::trim(const std::string& str) const {
+std::string ConfigLoader::trim(const std::string& str) {
     auto start = std::find_if_not(str.begin(), str.end(), [](unsigned char c) {
         return std::isspace(c);
     });
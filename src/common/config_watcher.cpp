@@ -0,0 +1,133 @@
+#include "common/config_watcher.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace chat {
+
+ConfigWatcher::ConfigWatcher(ConfigLoader& loader, std::chrono::milliseconds debounce)
+    : ConfigWatcher(loader.getConfigFilePath(), [&loader]() { return loader.reload(); }, debounce) {
+}
+
+ConfigWatcher::ConfigWatcher(std::string path, ReloadCallback reload, std::chrono::milliseconds debounce)
+    : path_(std::move(path)), reload_(std::move(reload)), debounce_(debounce) {
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+#ifdef __linux__
+
+bool ConfigWatcher::start() {
+    if (thread_.joinable()) {
+        return true;
+    }
+
+    std::filesystem::path config_path(path_);
+    std::filesystem::path directory = config_path.parent_path();
+    if (directory.empty()) {
+        directory = ".";
+    }
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        std::cerr << "Error: inotify_init1 failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    watch_fd_ = inotify_add_watch(inotify_fd_, directory.c_str(),
+                                  IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (watch_fd_ < 0 || stop_fd_ < 0) {
+        std::cerr << "Error: Failed to watch " << directory << ": " << std::strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+
+    thread_ = std::thread([this]() { run(); });
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(stop_fd_, &one, sizeof(one));
+        (void)ignored;
+        thread_.join();
+    }
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_);  // Also removes the watch
+        inotify_fd_ = -1;
+        watch_fd_ = -1;
+    }
+    if (stop_fd_ >= 0) {
+        ::close(stop_fd_);
+        stop_fd_ = -1;
+    }
+}
+
+void ConfigWatcher::run() {
+    const std::string file_name = std::filesystem::path(path_).filename().string();
+    alignas(inotify_event) char buffer[4096];
+    bool pending = false;
+
+    while (true) {
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        // While a change is pending, wait only for the debounce window
+        int timeout = pending ? static_cast<int>(debounce_.count()) : -1;
+        int ready = ::poll(fds, 2, timeout);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "Error: Config watcher poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+
+        if (ready == 0 && pending) {
+            // Quiet for a full debounce window: apply the change
+            pending = false;
+            if (reload_()) {
+                reload_count_.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t length;
+            while ((length = ::read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+                for (char* ptr = buffer; ptr < buffer + length;) {
+                    auto* event = reinterpret_cast<inotify_event*>(ptr);
+                    if (event->len > 0 && file_name == event->name) {
+                        pending = true;
+                    }
+                    ptr += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+    }
+}
+
+#else // !__linux__
+
+bool ConfigWatcher::start() {
+    std::cerr << "Warning: Config file watching is only supported on Linux; use SIGHUP to reload" << std::endl;
+    return false;
+}
+
+void ConfigWatcher::stop() {
+}
+
+void ConfigWatcher::run() {
+}
+
+#endif // __linux__
+
+} // namespace chat
@@ -0,0 +1,221 @@
+#include "common/coro_session.h"
+
+#ifdef WITH_COROUTINES
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+using boost::asio::use_awaitable;
+using boost::asio::redirect_error;
+
+namespace chat_app {
+
+std::shared_ptr<CoroSession> CoroSession::create(boost::asio::ip::tcp::socket socket) {
+    return create(std::move(socket), Options());
+}
+
+std::shared_ptr<CoroSession> CoroSession::create(boost::asio::ip::tcp::socket socket, Options options) {
+    return std::shared_ptr<CoroSession>(new CoroSession(std::move(socket), options));
+}
+
+CoroSession::CoroSession(boost::asio::ip::tcp::socket socket, Options options)
+    : socket_(std::move(socket)),
+      options_(options),
+      write_done_(socket_.get_executor()) {
+    if (options_.max_in_flight == 0) {
+        options_.max_in_flight = 1;
+    }
+    // Signals never expire; cancel() wakes every waiter and keeps the expiry
+    write_done_.expires_at(boost::asio::steady_timer::time_point::max());
+}
+
+void CoroSession::start(Handler handler, CloseCallback on_close) {
+    handler_ = std::move(handler);
+    on_close_ = std::move(on_close);
+
+    auto self = shared_from_this();
+    turn_queue_.assign(options_.max_in_flight, nullptr);
+    for (std::size_t i = 0; i < options_.max_in_flight; ++i) {
+        workers_.push_back(std::make_unique<Worker>(socket_.get_executor()));
+        workers_.back()->turn.expires_at(boost::asio::steady_timer::time_point::max());
+    }
+    running_workers_ = workers_.size();
+    for (auto& worker : workers_) {
+        boost::asio::co_spawn(socket_.get_executor(), work(self, *worker), boost::asio::detached);
+    }
+}
+
+CoroSession::Awaitable<boost::system::error_code> CoroSession::readFrame(Frame& frame) {
+    boost::system::error_code ec;
+    co_await boost::asio::async_read(socket_, boost::asio::buffer(read_header_), redirect_error(use_awaitable, ec));
+    if (ec) {
+        co_return ec;
+    }
+    if (!decodeHeader(frame)) {
+        co_return boost::asio::error::invalid_argument;
+    }
+    if (!frame.body.empty()) {
+        co_await boost::asio::async_read(socket_, boost::asio::buffer(frame.body), redirect_error(use_awaitable, ec));
+    }
+    if (!ec) {
+        frames_read_.fetch_add(1, std::memory_order_relaxed);
+    }
+    co_return ec;
+}
+
+CoroSession::Awaitable<boost::system::error_code> CoroSession::write(uint16_t type, uint16_t flags,
+                                                                     boost::asio::const_buffer body) {
+    // One write at a time, so frames of concurrent handlers never interleave
+    while (writing_) {
+        co_await wait(write_done_);
+    }
+    writing_ = true;
+
+    MessageHeader header;
+    header.setMessageType(type);
+    header.setFlags(flags);
+    header.setBodySize(static_cast<uint32_t>(body.size()));
+    header.encodeToBuffer(write_header_);
+
+    boost::system::error_code ec;
+    std::array<boost::asio::const_buffer, 2> buffers = {boost::asio::buffer(write_header_), body};
+    co_await boost::asio::async_write(socket_, buffers, redirect_error(use_awaitable, ec));
+    if (!ec) {
+        frames_written_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    writing_ = false;
+    signal(write_done_);
+    co_return ec;
+}
+
+void CoroSession::close() {
+    auto self = shared_from_this();
+    boost::asio::dispatch(socket_.get_executor(), [self]() {
+        boost::system::error_code ignored;
+        self->socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+        self->socket_.close(ignored);
+    });
+}
+
+CoroSession::Stats CoroSession::stats() const {
+    Stats stats;
+    stats.frames_read = frames_read_.load(std::memory_order_relaxed);
+    stats.frames_written = frames_written_.load(std::memory_order_relaxed);
+    stats.peak_in_flight = peak_in_flight_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+CoroSession::Awaitable<void> CoroSession::work([[maybe_unused]] std::shared_ptr<CoroSession> self, Worker& worker) {
+    Frame& frame = worker.frame;
+    for (;;) {
+        if (!tryAcquireReadTurn() && !co_await queueForReadTurn(worker)) {
+            break;
+        }
+        // Reads are awaited here rather than through readFrame(): Asio
+        // recycles only one coroutine frame per thread, so every extra
+        // level of nesting would allocate per frame
+        boost::system::error_code ec;
+        co_await boost::asio::async_read(socket_, boost::asio::buffer(read_header_), redirect_error(use_awaitable, ec));
+        if (!ec && !decodeHeader(frame)) {
+            ec = boost::asio::error::invalid_argument;
+        }
+        if (!ec && !frame.body.empty()) {
+            co_await boost::asio::async_read(socket_, boost::asio::buffer(frame.body), redirect_error(use_awaitable, ec));
+        }
+        if (ec) {
+            closed_ = true;
+            close_error_ = ec;
+            releaseReadTurn();
+            break;
+        }
+        frames_read_.fetch_add(1, std::memory_order_relaxed);
+        releaseReadTurn();
+
+        if (++in_flight_ > peak_in_flight_.load(std::memory_order_relaxed)) {
+            peak_in_flight_.store(in_flight_, std::memory_order_relaxed);
+        }
+        co_await handler_(*this, frame);
+        --in_flight_;
+    }
+
+    if (--running_workers_ == 0) {
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        if (on_close_) {
+            on_close_(close_error_);
+        }
+        // Handlers often capture the session; break the cycle
+        handler_ = nullptr;
+        on_close_ = nullptr;
+    }
+}
+
+bool CoroSession::tryAcquireReadTurn() {
+    if (closed_ || reading_) {
+        return false;
+    }
+    reading_ = true;
+    return true;
+}
+
+CoroSession::Awaitable<bool> CoroSession::queueForReadTurn(Worker& worker) {
+    if (closed_) {
+        co_return false;
+    }
+    // releaseReadTurn() hands the turn over by signalling this worker
+    turn_queue_[(turn_head_ + turn_waiting_) % turn_queue_.size()] = &worker;
+    ++turn_waiting_;
+    boost::system::error_code ignored;
+    co_await worker.turn.async_wait(redirect_error(use_awaitable, ignored));
+    co_return !closed_;
+}
+
+void CoroSession::releaseReadTurn() {
+    if (closed_) {
+        // Wake every queued worker so it can exit
+        while (turn_waiting_ > 0) {
+            signal(turn_queue_[turn_head_]->turn);
+            turn_head_ = (turn_head_ + 1) % turn_queue_.size();
+            --turn_waiting_;
+        }
+        reading_ = false;
+        return;
+    }
+    if (turn_waiting_ == 0) {
+        reading_ = false;
+        return;
+    }
+    // reading_ stays set: the turn passes straight to the next worker
+    Worker* next = turn_queue_[turn_head_];
+    turn_head_ = (turn_head_ + 1) % turn_queue_.size();
+    --turn_waiting_;
+    signal(next->turn);
+}
+
+bool CoroSession::decodeHeader(Frame& frame) {
+    MessageHeader header;
+    header.decodeFromBuffer(read_header_);
+    if (!header.isValid()) {
+        return false;
+    }
+    frame.type = header.getMessageType();
+    frame.flags = header.getFlags();
+    frame.body.resize(header.getBodySize());  // Keeps the capacity of earlier frames
+    return true;
+}
+
+CoroSession::Awaitable<void> CoroSession::wait(boost::asio::steady_timer& signal) {
+    boost::system::error_code ignored;
+    co_await signal.async_wait(redirect_error(use_awaitable, ignored));
+}
+
+void CoroSession::signal(boost::asio::steady_timer& signal) {
+    signal.cancel();
+}
+
+} // namespace chat_app
+
+#endif // WITH_COROUTINES
@@ -0,0 +1,54 @@
+#include "common/crc32c.h"
+#include <array>
+
+namespace chat_app {
+
+namespace {
+
+// Slicing-by-8 tables: eight bytes per step instead of one
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+const CrcTables& crcTables() {
+    static const CrcTables tables = []() {
+        CrcTables entries{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ 0x82F63B78u : value >> 1;
+            }
+            entries[0][i] = value;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (std::size_t slice = 1; slice < 8; ++slice) {
+                uint32_t previous = entries[slice - 1][i];
+                entries[slice][i] = (previous >> 8) ^ entries[0][previous & 0xFF];
+            }
+        }
+        return entries;
+    }();
+    return tables;
+}
+
+} // namespace
+
+uint32_t crc32c(uint32_t crc, const void* data, std::size_t size) {
+    const auto& tables = crcTables();
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+
+    while (size >= 8) {
+        uint32_t low = crc ^ (static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+                              static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24);
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^
+              tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24] ^
+              tables[3][bytes[4]] ^ tables[2][bytes[5]] ^ tables[1][bytes[6]] ^ tables[0][bytes[7]];
+        bytes += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = tables[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+} // namespace chat_app
@@ -0,0 +1,122 @@
+#include "common/delta_sync.h"
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+namespace chat_app {
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const std::string& text) {
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * FNV_PRIME;
+    }
+    // Field separator, so ("ab", "c") and ("a", "bc") differ
+    return (hash ^ 0xFF) * FNV_PRIME;
+}
+
+// splitmix64 finalizer; spreads each room hash before they are summed
+uint64_t mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+std::vector<char> toBody(const nlohmann::json& json) {
+    std::string text = json.dump();
+    return std::vector<char>(text.begin(), text.end());
+}
+
+} // namespace
+
+std::vector<char> SyncRequest::encode() const {
+    nlohmann::json json;
+    json["roster"] = roster_digest;
+    json["cursors"] = nlohmann::json::object();
+    for (const auto& [conversation, sequence] : cursors) {
+        json["cursors"][conversation] = sequence;
+    }
+    return toBody(json);
+}
+
+std::optional<SyncRequest> SyncRequest::decode(const std::vector<char>& body) {
+    auto json = nlohmann::json::parse(body.begin(), body.end(), nullptr, false);
+    if (json.is_discarded() || !json.is_object()) {
+        return std::nullopt;
+    }
+    SyncRequest request;
+    auto roster = json.find("roster");
+    if (roster != json.end()) {
+        if (!roster->is_number_unsigned()) {
+            return std::nullopt;
+        }
+        request.roster_digest = roster->get<uint64_t>();
+    }
+    auto cursors = json.find("cursors");
+    if (cursors != json.end()) {
+        if (!cursors->is_object()) {
+            return std::nullopt;
+        }
+        for (auto it = cursors->begin(); it != cursors->end(); ++it) {
+            if (!it.value().is_number_unsigned()) {
+                return std::nullopt;
+            }
+            request.cursors[it.key()] = it.value().get<uint64_t>();
+        }
+    }
+    return request;
+}
+
+uint64_t rosterDigest(const Roster& roster) {
+    uint64_t digest = 0;
+    std::vector<const std::string*> members;
+    for (const auto& room : roster) {
+        uint64_t hash = fnv1a(fnv1a(FNV_OFFSET, room.room_id), room.name);
+        members.clear();
+        for (const auto& member : room.members) {
+            members.push_back(&member);
+        }
+        std::sort(members.begin(), members.end(), [](const std::string* a, const std::string* b) {
+            return *a < *b;
+        });
+        for (const auto* member : members) {
+            hash = fnv1a(hash, *member);
+        }
+        // Summing makes the digest independent of room order
+        digest += mix(hash);
+    }
+    // 0 is reserved for "nothing cached"
+    return digest == 0 && !roster.empty() ? 1 : digest;
+}
+
+std::vector<char> encodeRoster(const Roster& roster) {
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& room : roster) {
+        json.push_back({{"room_id", room.room_id}, {"name", room.name}, {"members", room.members}});
+    }
+    return toBody(json);
+}
+
+std::optional<Roster> decodeRoster(const std::vector<char>& body) {
+    auto json = nlohmann::json::parse(body.begin(), body.end(), nullptr, false);
+    if (json.is_discarded() || !json.is_array()) {
+        return std::nullopt;
+    }
+    try {
+        Roster roster;
+        for (const auto& entry : json) {
+            RosterRoom room;
+            room.room_id = entry.at("room_id").get<std::string>();
+            room.name = entry.value("name", std::string());
+            room.members = entry.value("members", std::vector<std::string>());
+            roster.push_back(std::move(room));
+        }
+        return roster;
+    } catch (const nlohmann::json::exception&) {
+        return std::nullopt;
+    }
+}
+
+} // namespace chat_app
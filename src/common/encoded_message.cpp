@@ -0,0 +1,149 @@
+#include "common/encoded_message.h"
+#include "common/protocol.h"
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>  // For network byte order conversions
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace chat_app {
+
+namespace {
+
+#ifdef WITH_ZLIB
+// Compressed bodies are prefixed with the uncompressed size so the
+// receiver can allocate the output buffer in one go
+constexpr std::size_t SIZE_PREFIX = sizeof(uint32_t);
+
+std::vector<char> deflateBody(const std::vector<char>& plain) {
+    uLongf bound = compressBound(static_cast<uLong>(plain.size()));
+    std::vector<char> out(SIZE_PREFIX + bound);
+
+    uint32_t net_size = htonl(static_cast<uint32_t>(plain.size()));
+    std::memcpy(out.data(), &net_size, SIZE_PREFIX);
+
+    int result = compress2(reinterpret_cast<Bytef*>(out.data() + SIZE_PREFIX), &bound,
+                           reinterpret_cast<const Bytef*>(plain.data()),
+                           static_cast<uLong>(plain.size()), Z_BEST_SPEED);
+    if (result != Z_OK) {
+        throw std::runtime_error("Failed to compress message body");
+    }
+
+    out.resize(SIZE_PREFIX + bound);
+    return out;
+}
+
+std::vector<char> inflateBody(const std::vector<char>& body) {
+    if (body.size() < SIZE_PREFIX) {
+        throw std::runtime_error("Truncated compressed message body");
+    }
+
+    uint32_t net_size;
+    std::memcpy(&net_size, body.data(), SIZE_PREFIX);
+    uLongf plain_size = ntohl(net_size);
+    if (plain_size > MAX_BODY_SIZE) {
+        throw std::runtime_error("Compressed message body inflates beyond maximum size");
+    }
+
+    std::vector<char> out(plain_size);
+    int result = uncompress(reinterpret_cast<Bytef*>(out.data()), &plain_size,
+                            reinterpret_cast<const Bytef*>(body.data() + SIZE_PREFIX),
+                            static_cast<uLong>(body.size() - SIZE_PREFIX));
+    if (result != Z_OK) {
+        throw std::runtime_error("Failed to decompress message body");
+    }
+
+    out.resize(plain_size);
+    return out;
+}
+#endif
+
+} // namespace
+
+EncodedMessage::EncodedMessage(ChatMessage message)
+    : message_(std::move(message)) {
+}
+
+EncodedMessage::Body EncodedMessage::encoded(MessageEncoding encoding) const {
+    auto& slot = cache_[static_cast<std::size_t>(encoding)];
+
+    // Fast path: already encoded by an earlier consumer
+    Body body = std::atomic_load(&slot);
+    if (body) {
+        return body;
+    }
+
+    // Slow path: encode under the lock so concurrent first consumers
+    // don't all pay for the same work
+    std::lock_guard<std::mutex> lock(encode_mutex_);
+    body = std::atomic_load(&slot);
+    if (!body) {
+        body = encodeUncached(encoding);
+        std::atomic_store(&slot, body);
+    }
+    return body;
+}
+
+EncodedMessage::Body EncodedMessage::encodeUncached(MessageEncoding encoding) const {
+    encode_count_.fetch_add(1, std::memory_order_relaxed);
+
+    switch (encoding) {
+        case MessageEncoding::JSON: {
+            std::string dump = message_.toJson().dump();
+            return std::make_shared<const std::vector<char>>(dump.begin(), dump.end());
+        }
+        case MessageEncoding::COMPRESSED: {
+            // Reuse the cached binary form as the compression input
+            Body binary = std::atomic_load(&cache_[static_cast<std::size_t>(MessageEncoding::BINARY)]);
+            if (!binary) {
+                binary = std::make_shared<const std::vector<char>>(message_.toBinary());
+            }
+#ifdef WITH_ZLIB
+            return std::make_shared<const std::vector<char>>(deflateBody(*binary));
+#else
+            // Without zlib the compressed form is the binary form
+            return binary;
+#endif
+        }
+        case MessageEncoding::BINARY:
+        default:
+            return std::make_shared<const std::vector<char>>(message_.toBinary());
+    }
+}
+
+uint16_t EncodedMessage::flagsFor(MessageEncoding encoding) {
+    switch (encoding) {
+        case MessageEncoding::JSON:
+            return MessageFlags::JSON;
+        case MessageEncoding::COMPRESSED:
+#ifdef WITH_ZLIB
+            return MessageFlags::BINARY | MessageFlags::COMPRESSED;
+#else
+            return MessageFlags::BINARY;
+#endif
+        case MessageEncoding::BINARY:
+        default:
+            return MessageFlags::BINARY;
+    }
+}
+
+ChatMessage EncodedMessage::decode(const std::vector<char>& body, uint16_t flags) {
+    if (flags & MessageFlags::COMPRESSED) {
+#ifdef WITH_ZLIB
+        std::vector<char> plain = inflateBody(body);
+        return ChatMessage::fromBinary(plain.data(), plain.size());
+#else
+        throw std::runtime_error("Compressed message received but zlib support is disabled");
+#endif
+    }
+
+    if (flags & MessageFlags::BINARY) {
+        return ChatMessage::fromBinary(body.data(), body.size());
+    }
+
+    return ChatMessage::fromJson(nlohmann::json::parse(body.begin(), body.end()));
+}
+
+} // namespace chat_app
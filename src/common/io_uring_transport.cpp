@@ -0,0 +1,570 @@
+#include "common/io_uring_transport.h"
+#include "common/config_loader.h"
+#include <iostream>
+
+#ifdef WITH_LIBURING
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <boost/asio/error.hpp>
+#endif
+
+namespace chat_app {
+
+IoUringTransport::Options IoUringTransport::Options::fromConfig(const chat::ConfigLoader& config) {
+    Options options;
+    options.queue_depth = static_cast<unsigned>(config.getInt("IO_URING_QUEUE_DEPTH", options.queue_depth));
+    options.buffer_count = static_cast<unsigned>(config.getInt("IO_URING_BUFFER_COUNT", options.buffer_count));
+    options.buffer_size = static_cast<unsigned>(config.getInt("IO_URING_BUFFER_SIZE", options.buffer_size));
+    options.zero_copy_threshold = static_cast<std::size_t>(
+        config.getInt("IO_URING_ZEROCOPY_THRESHOLD", static_cast<int>(options.zero_copy_threshold)));
+    return options;
+}
+
+#ifdef WITH_LIBURING
+
+namespace {
+
+// Buffer group id of the provided receive buffer ring
+constexpr int RECV_BUFFER_GROUP = 0;
+
+// Upper bound on frames gathered into one sendmsg
+constexpr std::size_t MAX_FRAMES_PER_SEND = 64;
+
+bool isPowerOfTwo(unsigned value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+} // namespace
+
+struct IoUringTransport::Impl {
+    enum class OpType : uint8_t { RECV, SEND, WAKE };
+
+    struct Frame {
+        std::array<char, HEADER_SIZE> header;
+        SharedBody body;
+        std::size_t offset = 0;  // Bytes of header+body already sent
+    };
+
+    struct Connection {
+        int fd = -1;
+        DataHandler on_data;
+        CloseHandler on_close;
+        std::deque<Frame> queue;   // Frames waiting for the next send
+        bool send_active = false;  // A send op is in flight
+        bool closed = false;       // Detached, handlers must not run
+        bool reported = false;     // on_close already invoked
+    };
+
+    // Operation context passed through sqe user_data
+    struct Op {
+        OpType type;
+        std::shared_ptr<Connection> conn;
+
+        // Send state: frames, their iovecs and the msghdr must outlive the op
+        std::vector<Frame> frames;
+        std::vector<iovec> iov;
+        msghdr msg{};
+        bool zero_copy = false;
+    };
+
+    struct Command {
+        enum class Kind { ATTACH, SEND, DETACH } kind;
+        int handle;
+        std::shared_ptr<Connection> conn;  // ATTACH only
+        Frame frame;                       // SEND only
+    };
+
+    Options options;
+    io_uring ring{};
+    io_uring_buf_ring* buf_ring = nullptr;
+    std::vector<char> buffers;
+    int wake_fd = -1;
+    uint64_t wake_value = 0;
+    Op wake_op{OpType::WAKE, nullptr, {}, {}, {}, false};
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+
+    // Commands from other threads, drained by the completion thread
+    std::mutex command_mutex;
+    std::vector<Command> commands;
+
+    // Completion thread state
+    std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    std::unordered_set<Connection*> send_ready;
+
+    // Counters
+    std::atomic<uint64_t> submit_calls{0};
+    std::atomic<uint64_t> frames_sent{0};
+    std::atomic<uint64_t> zero_copy_sends{0};
+    std::atomic<uint64_t> recv_completions{0};
+
+    ~Impl() {
+        if (buf_ring) {
+            io_uring_free_buf_ring(&ring, buf_ring, options.buffer_count, RECV_BUFFER_GROUP);
+        }
+        if (ring.ring_fd > 0) {
+            io_uring_queue_exit(&ring);
+        }
+        if (wake_fd >= 0) {
+            ::close(wake_fd);
+        }
+    }
+
+    bool init() {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_COOP_TASKRUN;
+        int ret = io_uring_queue_init_params(options.queue_depth, &ring, &params);
+        if (ret == -EINVAL) {
+            // Older kernel without COOP_TASKRUN
+            params = io_uring_params{};
+            ret = io_uring_queue_init_params(options.queue_depth, &ring, &params);
+        }
+        if (ret < 0) {
+            std::cerr << "Error: io_uring setup failed: " << std::strerror(-ret) << std::endl;
+            ring.ring_fd = -1;
+            return false;
+        }
+
+        // Register the provided buffer ring used by multishot receive
+        buffers.resize(static_cast<std::size_t>(options.buffer_count) * options.buffer_size);
+        buf_ring = io_uring_setup_buf_ring(&ring, options.buffer_count, RECV_BUFFER_GROUP, 0, &ret);
+        if (!buf_ring) {
+            std::cerr << "Error: io_uring buffer ring setup failed: " << std::strerror(-ret) << std::endl;
+            return false;
+        }
+        int mask = io_uring_buf_ring_mask(options.buffer_count);
+        for (unsigned i = 0; i < options.buffer_count; ++i) {
+            io_uring_buf_ring_add(buf_ring, bufferAt(i), options.buffer_size,
+                                  static_cast<unsigned short>(i), mask, static_cast<int>(i));
+        }
+        io_uring_buf_ring_advance(buf_ring, static_cast<int>(options.buffer_count));
+
+        wake_fd = ::eventfd(0, EFD_CLOEXEC);
+        if (wake_fd < 0) {
+            std::cerr << "Error: eventfd failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        armWake();
+        return true;
+    }
+
+    char* bufferAt(unsigned id) {
+        return buffers.data() + static_cast<std::size_t>(id) * options.buffer_size;
+    }
+
+    void recycleBuffer(unsigned id) {
+        io_uring_buf_ring_add(buf_ring, bufferAt(id), options.buffer_size,
+                              static_cast<unsigned short>(id),
+                              io_uring_buf_ring_mask(options.buffer_count), 0);
+        io_uring_buf_ring_advance(buf_ring, 1);
+    }
+
+    io_uring_sqe* getSqe() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        while (!sqe) {
+            // Submission queue full: flush what we have and retry
+            io_uring_submit(&ring);
+            submit_calls.fetch_add(1, std::memory_order_relaxed);
+            sqe = io_uring_get_sqe(&ring);
+        }
+        return sqe;
+    }
+
+    void armWake() {
+        io_uring_sqe* sqe = getSqe();
+        io_uring_prep_read(sqe, wake_fd, &wake_value, sizeof(wake_value), 0);
+        io_uring_sqe_set_data(sqe, &wake_op);
+    }
+
+    void armRecv(Op* op) {
+        io_uring_sqe* sqe = getSqe();
+        io_uring_prep_recv_multishot(sqe, op->conn->fd, nullptr, 0, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RECV_BUFFER_GROUP;
+        io_uring_sqe_set_data(sqe, op);
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    void post(Command command) {
+        bool was_empty;
+        {
+            std::lock_guard<std::mutex> lock(command_mutex);
+            was_empty = commands.empty();
+            commands.push_back(std::move(command));
+        }
+        // Only the first command of a batch needs to wake the ring thread
+        if (was_empty) {
+            wake();
+        }
+    }
+
+    void drainCommands() {
+        std::vector<Command> pending;
+        {
+            std::lock_guard<std::mutex> lock(command_mutex);
+            pending.swap(commands);
+        }
+
+        for (auto& command : pending) {
+            switch (command.kind) {
+                case Command::Kind::ATTACH: {
+                    connections[command.handle] = command.conn;
+                    armRecv(new Op{OpType::RECV, command.conn, {}, {}, {}, false});
+                    break;
+                }
+                case Command::Kind::SEND: {
+                    auto it = connections.find(command.handle);
+                    if (it == connections.end() || it->second->closed) {
+                        break;
+                    }
+                    it->second->queue.push_back(std::move(command.frame));
+                    send_ready.insert(it->second.get());
+                    break;
+                }
+                case Command::Kind::DETACH: {
+                    auto it = connections.find(command.handle);
+                    if (it == connections.end()) {
+                        break;
+                    }
+                    closeConnection(it->second);
+                    connections.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+
+    void closeConnection(const std::shared_ptr<Connection>& conn) {
+        if (conn->closed) {
+            return;
+        }
+        conn->closed = true;
+        conn->queue.clear();
+        send_ready.erase(conn.get());
+
+        // Cancel the armed receive and any in-flight send. In-flight ops hold
+        // their own file reference, so the duplicate can be closed right away.
+        io_uring_sqe* sqe = getSqe();
+        io_uring_prep_cancel_fd(sqe, conn->fd, IORING_ASYNC_CANCEL_ALL);
+        io_uring_sqe_set_data(sqe, nullptr);
+        io_uring_submit(&ring);
+        submit_calls.fetch_add(1, std::memory_order_relaxed);
+        ::close(conn->fd);
+    }
+
+    void reportClose(Connection& conn, const boost::system::error_code& error) {
+        if (conn.closed || conn.reported) {
+            return;
+        }
+        conn.reported = true;
+        if (conn.on_close) {
+            conn.on_close(error);
+        }
+    }
+
+    void flushSends() {
+        for (Connection* raw : send_ready) {
+            auto it = connections.find(raw->fd);
+            if (it == connections.end() || raw->send_active || raw->queue.empty()) {
+                continue;
+            }
+            startSend(it->second);
+        }
+        send_ready.clear();
+    }
+
+    void startSend(const std::shared_ptr<Connection>& conn) {
+        auto* op = new Op{OpType::SEND, conn, {}, {}, {}, false};
+
+        // Gather queued frames into one scatter-gather send
+        std::size_t body_bytes = 0;
+        while (!conn->queue.empty() && op->frames.size() < MAX_FRAMES_PER_SEND) {
+            body_bytes += conn->queue.front().body ? conn->queue.front().body->size() : 0;
+            op->frames.push_back(std::move(conn->queue.front()));
+            conn->queue.pop_front();
+        }
+
+        for (auto& frame : op->frames) {
+            std::size_t skip = frame.offset;
+            if (skip < HEADER_SIZE) {
+                op->iov.push_back({frame.header.data() + skip, HEADER_SIZE - skip});
+                skip = 0;
+            } else {
+                skip -= HEADER_SIZE;
+            }
+            if (frame.body && frame.body->size() > skip) {
+                op->iov.push_back({const_cast<char*>(frame.body->data()) + skip, frame.body->size() - skip});
+            }
+        }
+
+        op->msg.msg_iov = op->iov.data();
+        op->msg.msg_iovlen = op->iov.size();
+        op->zero_copy = options.zero_copy_threshold > 0 && body_bytes >= options.zero_copy_threshold;
+
+        io_uring_sqe* sqe = getSqe();
+        if (op->zero_copy) {
+            io_uring_prep_sendmsg_zc(sqe, conn->fd, &op->msg, MSG_NOSIGNAL);
+            zero_copy_sends.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            io_uring_prep_sendmsg(sqe, conn->fd, &op->msg, MSG_NOSIGNAL);
+        }
+        io_uring_sqe_set_data(sqe, op);
+
+        conn->send_active = true;
+        frames_sent.fetch_add(op->frames.size(), std::memory_order_relaxed);
+    }
+
+    void handleRecv(Op* op, const io_uring_cqe* cqe) {
+        recv_completions.fetch_add(1, std::memory_order_relaxed);
+        auto& conn = op->conn;
+
+        if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+            unsigned id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            if (!conn->closed && conn->on_data) {
+                conn->on_data(bufferAt(id), static_cast<std::size_t>(cqe->res));
+            }
+            recycleBuffer(id);
+        }
+
+        if (cqe->flags & IORING_CQE_F_MORE) {
+            return;  // Multishot receive is still armed
+        }
+
+        // Receive terminated: re-arm on buffer exhaustion or a plain stop,
+        // report EOF/errors otherwise
+        if (!conn->closed && (cqe->res > 0 || cqe->res == -ENOBUFS)) {
+            armRecv(op);
+            return;
+        }
+
+        if (cqe->res != -ECANCELED) {
+            reportClose(*conn, cqe->res == 0
+                ? boost::system::error_code(boost::asio::error::eof)
+                : boost::system::error_code(-cqe->res, boost::system::system_category()));
+        }
+        delete op;
+    }
+
+    void handleSend(Op* op, const io_uring_cqe* cqe) {
+        if (cqe->flags & IORING_CQE_F_NOTIF) {
+            // Kernel released the zero-copy pages; buffers may now be freed
+            delete op;
+            return;
+        }
+
+        auto conn = op->conn;
+        conn->send_active = false;
+        bool keep_for_notification = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+        if (cqe->res < 0) {
+            if (cqe->res != -ECANCELED) {
+                reportClose(*conn, boost::system::error_code(-cqe->res, boost::system::system_category()));
+            }
+        } else if (!conn->closed) {
+            // Requeue whatever the kernel did not accept, in order
+            std::size_t sent = static_cast<std::size_t>(cqe->res);
+            std::vector<Frame> remaining;
+            for (auto& frame : op->frames) {
+                std::size_t frame_left = HEADER_SIZE + (frame.body ? frame.body->size() : 0) - frame.offset;
+                if (sent >= frame_left) {
+                    sent -= frame_left;
+                    continue;
+                }
+                Frame rest = frame;
+                rest.offset += sent;
+                sent = 0;
+                remaining.push_back(std::move(rest));
+            }
+            for (auto it = remaining.rbegin(); it != remaining.rend(); ++it) {
+                conn->queue.push_front(std::move(*it));
+            }
+            if (!conn->queue.empty()) {
+                send_ready.insert(conn.get());
+            }
+        }
+
+        if (!keep_for_notification) {
+            delete op;
+        }
+    }
+
+    void processCompletions() {
+        unsigned head;
+        unsigned count = 0;
+        io_uring_cqe* cqe;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            ++count;
+            auto* op = static_cast<Op*>(io_uring_cqe_get_data(cqe));
+            if (!op) {
+                continue;  // Cancel request completion
+            }
+            switch (op->type) {
+                case OpType::WAKE:
+                    armWake();
+                    break;
+                case OpType::RECV:
+                    handleRecv(op, cqe);
+                    break;
+                case OpType::SEND:
+                    handleSend(op, cqe);
+                    break;
+            }
+        }
+        io_uring_cq_advance(&ring, count);
+    }
+
+    void run() {
+        while (running.load(std::memory_order_acquire)) {
+            drainCommands();
+            flushSends();
+
+            // One submission covers every connection's pending sends
+            io_uring_submit_and_wait(&ring, 1);
+            submit_calls.fetch_add(1, std::memory_order_relaxed);
+
+            processCompletions();
+        }
+
+        for (auto& entry : connections) {
+            closeConnection(entry.second);
+        }
+        connections.clear();
+    }
+};
+
+IoUringTransport::IoUringTransport(std::unique_ptr<Impl> impl)
+    : impl_(std::move(impl)) {
+}
+
+IoUringTransport::~IoUringTransport() {
+    stop();
+}
+
+bool IoUringTransport::isCompiledIn() {
+    return true;
+}
+
+std::shared_ptr<IoUringTransport> IoUringTransport::create(const Options& options) {
+    if (!isPowerOfTwo(options.buffer_count) || options.buffer_count > 32768) {
+        std::cerr << "Error: IO_URING_BUFFER_COUNT must be a power of two no larger than 32768" << std::endl;
+        return nullptr;
+    }
+
+    auto impl = std::make_unique<Impl>();
+    impl->options = options;
+    if (!impl->init()) {
+        return nullptr;
+    }
+
+    std::shared_ptr<IoUringTransport> transport(new IoUringTransport(std::move(impl)));
+    Impl* raw = transport->impl_.get();
+    raw->running = true;
+    raw->thread = std::thread([raw]() { raw->run(); });
+    return transport;
+}
+
+int IoUringTransport::attach(int fd, DataHandler on_data, CloseHandler on_close) {
+    if (!impl_->running) {
+        return -1;
+    }
+
+    int handle = ::dup(fd);
+    if (handle < 0) {
+        std::cerr << "Error: Failed to duplicate socket for io_uring: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    auto conn = std::make_shared<Impl::Connection>();
+    conn->fd = handle;
+    conn->on_data = std::move(on_data);
+    conn->on_close = std::move(on_close);
+    impl_->post(Impl::Command{Impl::Command::Kind::ATTACH, handle, std::move(conn), {}});
+    return handle;
+}
+
+void IoUringTransport::detach(int handle) {
+    impl_->post(Impl::Command{Impl::Command::Kind::DETACH, handle, nullptr, {}});
+}
+
+void IoUringTransport::send(int handle, const std::array<char, HEADER_SIZE>& header, SharedBody body) {
+    Impl::Frame frame;
+    frame.header = header;
+    frame.body = std::move(body);
+    impl_->post(Impl::Command{Impl::Command::Kind::SEND, handle, nullptr, std::move(frame)});
+}
+
+void IoUringTransport::stop() {
+    if (!impl_ || !impl_->running.exchange(false)) {
+        return;
+    }
+    impl_->wake();
+    if (impl_->thread.joinable()) {
+        impl_->thread.join();
+    }
+}
+
+IoUringTransport::Stats IoUringTransport::stats() const {
+    Stats stats;
+    stats.submit_calls = impl_->submit_calls.load(std::memory_order_relaxed);
+    stats.frames_sent = impl_->frames_sent.load(std::memory_order_relaxed);
+    stats.zero_copy_sends = impl_->zero_copy_sends.load(std::memory_order_relaxed);
+    stats.recv_completions = impl_->recv_completions.load(std::memory_order_relaxed);
+    return stats;
+}
+
+#else // !WITH_LIBURING
+
+struct IoUringTransport::Impl {};
+
+IoUringTransport::IoUringTransport(std::unique_ptr<Impl> impl)
+    : impl_(std::move(impl)) {
+}
+
+IoUringTransport::~IoUringTransport() = default;
+
+bool IoUringTransport::isCompiledIn() {
+    return false;
+}
+
+std::shared_ptr<IoUringTransport> IoUringTransport::create(const Options& /*options*/) {
+    std::cerr << "Warning: io_uring transport requested but this build has no liburing support" << std::endl;
+    return nullptr;
+}
+
+int IoUringTransport::attach(int /*fd*/, DataHandler /*on_data*/, CloseHandler /*on_close*/) {
+    return -1;
+}
+
+void IoUringTransport::detach(int /*handle*/) {
+}
+
+void IoUringTransport::send(int /*handle*/, const std::array<char, HEADER_SIZE>& /*header*/, SharedBody /*body*/) {
+}
+
+void IoUringTransport::stop() {
+}
+
+IoUringTransport::Stats IoUringTransport::stats() const {
+    return Stats();
+}
+
+#endif // WITH_LIBURING
+
+} // namespace chat_app
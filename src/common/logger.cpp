@@ -0,0 +1,417 @@
+#include "common/logger.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <ctime>
+#include <iostream>
+
+namespace chat {
+
+std::atomic<int> Logger::level_{static_cast<int>(LogLevel::INFO)};
+
+/**
+ * Single-producer/single-consumer ring owned by one logging thread.
+ * The producer only advances head_, the flusher only advances tail_.
+ */
+struct Logger::ThreadBuffer {
+    ThreadBuffer(std::size_t slots, uint32_t id)
+        : records(slots), mask(slots - 1), thread_id(id) {
+    }
+
+    std::vector<Record> records;
+    const std::size_t mask;
+    const uint32_t thread_id;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    std::atomic<bool> retired{false};  // Owning thread has exited
+};
+
+namespace {
+
+const char* levelName(uint8_t level) {
+    switch (static_cast<LogLevel>(level)) {
+        case LogLevel::TRACE: return "TRACE";
+        case LogLevel::DEBUG: return "DEBUG";
+        case LogLevel::INFO:  return "INFO ";
+        case LogLevel::WARN:  return "WARN ";
+        case LogLevel::ERROR: return "ERROR";
+    }
+    return "?    ";
+}
+
+std::size_t roundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+Logger::Options Logger::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.file_path = config.getString("LOG_FILE", options.file_path);
+    options.console = config.getBool("ENABLE_CONSOLE_LOG", options.console);
+    options.level = config.getLogLevel();
+    options.ring_slots = static_cast<std::size_t>(
+        config.getInt("LOG_BUFFER_SLOTS", static_cast<int>(options.ring_slots)));
+    options.flush_interval = std::chrono::milliseconds(
+        config.getInt("LOG_FLUSH_INTERVAL_MS", static_cast<int>(options.flush_interval.count())));
+    return options;
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::~Logger() {
+    stop();
+}
+
+bool Logger::start(const Options& options) {
+    if (isRunning()) {
+        return true;
+    }
+
+    std::FILE* file = nullptr;
+    if (!options.file_path.empty()) {
+        file = std::fopen(options.file_path.c_str(), "a");
+        if (!file) {
+            std::cerr << "Error: Could not open log file: " << options.file_path << std::endl;
+            return false;
+        }
+    }
+
+    options_ = options;
+    options_.ring_slots = roundUpToPowerOfTwo(std::max<std::size_t>(options.ring_slots, 2));
+    if (options_.flush_interval.count() <= 0) {
+        options_.flush_interval = std::chrono::milliseconds(1);
+    }
+    file_ = file;
+    setLevel(options.level);
+
+    running_.store(true, std::memory_order_release);
+    flusher_ = std::thread([this]() { run(); });
+    return true;
+}
+
+void Logger::stop() {
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    wake_cv_.notify_one();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+
+    // Pick up anything a producer pushed while the flusher was exiting
+    std::string batch;
+    drain(batch);
+    write(batch);
+
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    flushed_cv_.notify_all();
+}
+
+void Logger::flush() {
+    if (!isRunning()) {
+        std::fflush(stderr);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    uint64_t target = ++flush_generation_;
+    wake_cv_.notify_one();
+    flushed_cv_.wait(lock, [&]() { return flushed_generation_ >= target || !isRunning(); });
+}
+
+Logger::Stats Logger::stats() const {
+    Stats stats;
+    stats.written = written_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void Logger::encodeString(Record& record, std::string_view value) {
+    constexpr std::size_t prefix = 1 + sizeof(uint16_t);
+    if (record.payload_size + prefix > PAYLOAD_SIZE) {
+        record.truncated = 1;
+        return;
+    }
+
+    std::size_t available = PAYLOAD_SIZE - record.payload_size - prefix;
+    uint16_t length = static_cast<uint16_t>(std::min(value.size(), available));
+    if (length < value.size()) {
+        record.truncated = 1;
+    }
+
+    char* out = record.payload + record.payload_size;
+    *out = static_cast<char>(ArgType::STRING);
+    std::memcpy(out + 1, &length, sizeof(length));
+    std::memcpy(out + prefix, value.data(), length);
+    record.payload_size = static_cast<uint16_t>(record.payload_size + prefix + length);
+}
+
+void Logger::formatRecord(const Record& record, uint32_t thread_id, std::string& out) {
+    // Timestamp, level, thread and source location
+    std::time_t seconds = static_cast<std::time_t>(record.timestamp_ns / 1000000000ULL);
+    unsigned micros = static_cast<unsigned>((record.timestamp_ns / 1000ULL) % 1000000ULL);
+    std::tm tm_utc{};
+    gmtime_r(&seconds, &tm_utc);
+
+    const char* file = record.file ? record.file : "";
+    if (const char* slash = std::strrchr(file, '/')) {
+        file = slash + 1;
+    }
+
+    char prefix[160];
+    int length = std::snprintf(prefix, sizeof(prefix),
+                               "%04d-%02d-%02d %02d:%02d:%02d.%06u %s [T%u] %s:%u ",
+                               tm_utc.tm_year + 1900, tm_utc.tm_mon + 1, tm_utc.tm_mday,
+                               tm_utc.tm_hour, tm_utc.tm_min, tm_utc.tm_sec, micros,
+                               levelName(record.level), thread_id, file, record.line);
+    out.append(prefix, static_cast<std::size_t>(std::clamp(length, 0, static_cast<int>(sizeof(prefix) - 1))));
+
+    // Expand "{}" placeholders from the binary payload
+    std::size_t position = 0;
+    auto append_next_arg = [&]() {
+        if (position >= record.payload_size) {
+            out += "{}";
+            return;
+        }
+
+        const char* in = record.payload + position;
+        auto type = static_cast<ArgType>(*in++);
+        char scratch[32];
+        switch (type) {
+            case ArgType::INT: {
+                int64_t value;
+                std::memcpy(&value, in, sizeof(value));
+                std::snprintf(scratch, sizeof(scratch), "%" PRId64, value);
+                out += scratch;
+                position += 1 + sizeof(value);
+                break;
+            }
+            case ArgType::UINT: {
+                uint64_t value;
+                std::memcpy(&value, in, sizeof(value));
+                std::snprintf(scratch, sizeof(scratch), "%" PRIu64, value);
+                out += scratch;
+                position += 1 + sizeof(value);
+                break;
+            }
+            case ArgType::DOUBLE: {
+                double value;
+                std::memcpy(&value, in, sizeof(value));
+                std::snprintf(scratch, sizeof(scratch), "%g", value);
+                out += scratch;
+                position += 1 + sizeof(value);
+                break;
+            }
+            case ArgType::BOOL:
+                out += *in ? "true" : "false";
+                position += 2;
+                break;
+            case ArgType::CHAR:
+                out += *in;
+                position += 2;
+                break;
+            case ArgType::STRING: {
+                uint16_t size;
+                std::memcpy(&size, in, sizeof(size));
+                out.append(in + sizeof(size), size);
+                position += 1 + sizeof(size) + size;
+                break;
+            }
+            case ArgType::POINTER: {
+                uintptr_t value;
+                std::memcpy(&value, in, sizeof(value));
+                std::snprintf(scratch, sizeof(scratch), "0x%" PRIxPTR, value);
+                out += scratch;
+                position += 1 + sizeof(value);
+                break;
+            }
+            default:
+                position = record.payload_size;
+                break;
+        }
+    };
+
+    for (const char* p = record.format; p && *p;) {
+        if (p[0] == '{' && p[1] == '}') {
+            append_next_arg();
+            p += 2;
+        } else if ((p[0] == '{' && p[1] == '{') || (p[0] == '}' && p[1] == '}')) {
+            out += p[0];
+            p += 2;
+        } else {
+            out += *p++;
+        }
+    }
+
+    if (record.truncated) {
+        out += " [truncated]";
+    }
+    out += '\n';
+}
+
+void Logger::submit(const Record& record) {
+    if (!isRunning()) {
+        // No flusher: format and write synchronously
+        std::string line;
+        formatRecord(record, 0, line);
+        std::lock_guard<std::mutex> lock(sync_mutex_);
+        std::fwrite(line.data(), 1, line.size(), stderr);
+        return;
+    }
+
+    ThreadBuffer& buffer = threadBuffer();
+    std::size_t head = buffer.head.load(std::memory_order_relaxed);
+    std::size_t used = head - buffer.tail.load(std::memory_order_acquire);
+    if (used >= buffer.records.size()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Copy only the header and the used part of the payload
+    static_assert(offsetof(Record, payload) == HEADER_BYTES, "Record header layout changed");
+    std::memcpy(static_cast<void*>(&buffer.records[head & buffer.mask]), &record,
+                HEADER_BYTES + record.payload_size);
+    buffer.head.store(head + 1, std::memory_order_release);
+
+    // Wake the flusher early for errors or a filling ring; otherwise it
+    // picks records up on its next interval
+    if (record.level >= static_cast<uint8_t>(LogLevel::WARN) || used + 1 == buffer.records.size() / 2) {
+        if (!wake_requested_.exchange(true, std::memory_order_acq_rel)) {
+            wake_cv_.notify_one();
+        }
+    }
+}
+
+Logger::ThreadBuffer& Logger::threadBuffer() {
+    // Marks the ring retired when its thread exits; the flusher frees it once drained
+    struct Handle {
+        std::shared_ptr<ThreadBuffer> buffer;
+        ~Handle() {
+            if (buffer) {
+                buffer->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Handle handle;
+
+    if (!handle.buffer) {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        handle.buffer = std::make_shared<ThreadBuffer>(options_.ring_slots, next_thread_id_++);
+        buffers_.push_back(handle.buffer);
+    }
+    return *handle.buffer;
+}
+
+void Logger::run() {
+    std::string batch;
+    while (true) {
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait_for(lock, options_.flush_interval, [&]() {
+                return wake_requested_.load(std::memory_order_acquire) || !isRunning() ||
+                       flush_generation_ != flushed_generation_;
+            });
+            wake_requested_.store(false, std::memory_order_release);
+            generation = flush_generation_;
+        }
+        bool stopping = !isRunning();
+
+        batch.clear();
+        if (drain(batch) > 0) {
+            write(batch);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            flushed_generation_ = generation;
+        }
+        flushed_cv_.notify_all();
+
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+std::size_t Logger::drain(std::string& batch) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers = buffers_;
+    }
+
+    // Merge all rings into timestamp order
+    struct Pending {
+        uint64_t timestamp_ns;
+        const Record* record;
+        uint32_t thread_id;
+    };
+    std::vector<Pending> pending;
+    std::vector<std::size_t> heads(buffers.size());
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        ThreadBuffer& buffer = *buffers[i];
+        std::size_t tail = buffer.tail.load(std::memory_order_relaxed);
+        heads[i] = buffer.head.load(std::memory_order_acquire);
+        for (; tail != heads[i]; ++tail) {
+            const Record& record = buffer.records[tail & buffer.mask];
+            pending.push_back({record.timestamp_ns, &record, buffer.thread_id});
+        }
+    }
+    std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+
+    for (const Pending& entry : pending) {
+        formatRecord(*entry.record, entry.thread_id, batch);
+    }
+
+    // Release the slots only after formatting
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        buffers[i]->tail.store(heads[i], std::memory_order_release);
+    }
+
+    // Forget rings of exited threads once they are empty
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                      [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                                          return buffer->retired.load(std::memory_order_acquire) &&
+                                                 buffer->head.load(std::memory_order_acquire) ==
+                                                     buffer->tail.load(std::memory_order_relaxed);
+                                      }),
+                       buffers_.end());
+    }
+
+    written_.fetch_add(pending.size(), std::memory_order_relaxed);
+    return pending.size();
+}
+
+void Logger::write(const std::string& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    if (file_) {
+        std::fwrite(batch.data(), 1, batch.size(), file_);
+        std::fflush(file_);
+    }
+    if (options_.console) {
+        std::lock_guard<std::mutex> lock(sync_mutex_);
+        std::fwrite(batch.data(), 1, batch.size(), stdout);
+        std::fflush(stdout);
+    }
+}
+
+} // namespace chat
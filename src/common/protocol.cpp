@@ -2,6 +2,7 @@
 #include <cstring>
 #include <arpa/inet.h>  // For network byte order conversions
 #include <stdexcept>
+#include <algorithm>
 
 namespace chat_app {
 
@@ -77,4 +78,99 @@ void MessageHeader::decodeFromBuffer(const std::array<char, HEADER_SIZE>& buffer
     body_size_ = ntohl(net_size);
 }
 
+bool FrameParser::consume(const char* data, std::size_t size, const FrameCallback& callback) {
+    while (size > 0) {
+        if (!have_header_) {
+            // Accumulate the fixed-size header
+            std::size_t needed = HEADER_SIZE - header_bytes_;
+            std::size_t count = std::min(needed, size);
+            std::memcpy(header_buffer_.data() + header_bytes_, data, count);
+            header_bytes_ += count;
+            data += count;
+            size -= count;
+            
+            if (header_bytes_ < HEADER_SIZE) {
+                return true;
+            }
+            
+            header_.decodeFromBuffer(header_buffer_);
+            if (!header_.isValid()) {
+                reset();
+                return false;
+            }
+            
+            have_header_ = true;
+            body_.resize(header_.getBodySize());
+            body_bytes_ = 0;
+        }
+        
+        // Accumulate the body
+        std::size_t count = std::min(body_.size() - body_bytes_, size);
+        if (count > 0) {
+            std::memcpy(body_.data() + body_bytes_, data, count);
+            body_bytes_ += count;
+            data += count;
+            size -= count;
+        }
+        
+        if (body_bytes_ == body_.size()) {
+            callback(body_, header_.getMessageType(), header_.getFlags());
+            have_header_ = false;
+            header_bytes_ = 0;
+        }
+    }
+    
+    return true;
+}
+
+std::size_t StreamExtension::capacity(std::size_t payload_size) {
+    if (payload_size + 2 >= MAX_BODY_SIZE) {
+        return 0;
+    }
+    return std::min<std::size_t>(UINT16_MAX, (MAX_BODY_SIZE - 2 - payload_size) / 4);
+}
+
+std::vector<char> StreamExtension::encode(const char* payload, std::size_t size) const {
+    std::vector<char> body(2 + 4 * streams.size() + size);
+    uint16_t count = htons(static_cast<uint16_t>(streams.size()));
+    std::memcpy(body.data(), &count, 2);
+    char* out = body.data() + 2;
+    for (uint32_t stream : streams) {
+        uint32_t id = htonl(stream);
+        std::memcpy(out, &id, 4);
+        out += 4;
+    }
+    if (size > 0) {
+        std::memcpy(out, payload, size);
+    }
+    return body;
+}
+
+std::optional<std::size_t> StreamExtension::decode(const std::vector<char>& body, StreamExtension& out) {
+    if (body.size() < 2) {
+        return std::nullopt;
+    }
+    uint16_t count;
+    std::memcpy(&count, body.data(), 2);
+    count = ntohs(count);
+    std::size_t offset = 2 + 4 * static_cast<std::size_t>(count);
+    if (count == 0 || body.size() < offset) {
+        return std::nullopt;
+    }
+    out.streams.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        uint32_t id;
+        std::memcpy(&id, body.data() + 2 + 4 * i, 4);
+        out.streams[i] = ntohl(id);
+    }
+    return offset;
+}
+
+void FrameParser::reset() {
+    header_bytes_ = 0;
+    have_header_ = false;
+    body_.clear();
+    body_bytes_ = 0;
+}
+
 } // namespace chat_app
\ No newline at end of file
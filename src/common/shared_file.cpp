@@ -0,0 +1,44 @@
+#include "common/shared_file.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace chat_app {
+
+std::shared_ptr<const SharedFile> SharedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return nullptr;
+    }
+    return std::shared_ptr<const SharedFile>(new SharedFile(fd, static_cast<uint64_t>(info.st_size)));
+}
+
+SharedFile::~SharedFile() {
+    ::close(fd_);
+}
+
+long SharedFile::read(uint64_t offset, char* data, std::size_t size) const {
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t count = ::pread(fd_, data + done, size - done, static_cast<off_t>(offset + done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            return -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        done += static_cast<std::size_t>(count);
+    }
+    return static_cast<long>(done);
+}
+
+} // namespace chat_app
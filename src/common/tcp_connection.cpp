@@ -1,11 +1,29 @@
 #include "common/tcp_connection.h"
+#include "common/logger.h"
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 namespace chat_app {
 
+namespace {
+
+// Upper bound on queued messages coalesced into one gather write
+constexpr std::size_t MAX_WRITE_BATCH = 64;
+
+// Copy size per write when a file is sent without sendfile
+constexpr std::size_t FILE_CHUNK_SIZE = 64 * 1024;
+
+} // namespace
+
 TcpConnection::TcpConnection(boost::asio::io_context& io_context)
     : io_context_(io_context),
       socket_(io_context),
+      read_pause_timer_(io_context),
       write_in_progress_(false),
       is_connected_(false) {
 }
@@ -18,14 +36,78 @@ boost::asio::ip::tcp::socket& TcpConnection::socket() {
     return socket_;
 }
 
+void TcpConnection::useIoUring(std::shared_ptr<IoUringTransport> transport) {
+    uring_transport_ = std::move(transport);
+}
+
+void TcpConnection::useTls(std::shared_ptr<TlsContext> context, const std::string& peer) {
+    tls_context_ = std::move(context);
+    tls_peer_ = peer;
+}
+
 void TcpConnection::start() {
     is_connected_ = true;
+    
+    if (tls_context_) {
+        if (uring_transport_) {
+            CHAT_LOG_WARN("TLS connections use the Asio transport");
+            uring_transport_.reset();
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(write_mutex_);
+            handshake_complete_ = false;
+        }
+        tls_stream_ = std::make_unique<TlsStream>(socket_, tls_context_, tls_peer_);
+        
+        auto self(shared_from_this());
+        tls_stream_->async_handshake([this, self](const boost::system::error_code& ec) {
+            handleHandshake(ec);
+        });
+        return;
+    }
+    
+    if (uring_transport_) {
+        std::weak_ptr<TcpConnection> weak_self = shared_from_this();
+        uring_handle_ = uring_transport_->attach(
+            socket_.native_handle(),
+            [weak_self](const char* data, std::size_t size) {
+                if (auto self = weak_self.lock()) {
+                    self->handleTransportData(data, size);
+                }
+            },
+            [weak_self](const boost::system::error_code& error) {
+                if (auto self = weak_self.lock()) {
+                    self->handleError(error);
+                }
+            });
+        
+        if (uring_handle_ >= 0) {
+            return;
+        }
+        
+        // Fall back to the reactor if the transport refused the socket
+        CHAT_LOG_WARN("io_uring attach failed, using Asio for {}", getRemoteAddress());
+        uring_transport_.reset();
+    }
+    
     asyncReadHeader();
 }
 
 void TcpConnection::stop() {
     boost::system::error_code ignored_error;
     
+    if (uring_transport_ && uring_handle_ >= 0) {
+        uring_transport_->detach(uring_handle_);
+        uring_handle_ = -1;
+    }
+    
+    if (tls_stream_ && is_connected_) {
+        tls_stream_->shutdown();
+    }
+    
+    read_pause_timer_.cancel();
+    
     if (socket_.is_open()) {
         socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_error);
         socket_.close(ignored_error);
@@ -35,23 +117,40 @@ void TcpConnection::stop() {
 }
 
 bool TcpConnection::send(const std::vector<char>& data, uint16_t type, uint16_t flags) {
+    return send(std::make_shared<const std::vector<char>>(data), type, flags);
+}
+
+bool TcpConnection::send(SharedBody body, uint16_t type, uint16_t flags) {
     if (!is_connected_) {
         return false;
     }
     
+    if (!body) {
+        body = std::make_shared<const std::vector<char>>();
+    }
+    
     // Create header and encode it
     MessageHeader header;
     header.setMessageType(type);
     header.setFlags(flags);
-    header.setBodySize(data.size());
+    header.setBodySize(body->size());
     
     // Prepare message for queuing
     OutgoingMessage message;
-    message.header_buffer.resize(HEADER_SIZE);
-    std::array<char, HEADER_SIZE> header_buffer;
-    header.encodeToBuffer(header_buffer);
-    std::copy(header_buffer.begin(), header_buffer.end(), message.header_buffer.begin());
-    message.body = data;
+    header.encodeToBuffer(message.header_buffer);
+    message.body = std::move(body);
+    
+    if (uint64_t trace_id = chat::Tracer::current()) {
+        uint64_t now = chat::Tracer::now();
+        chat::Tracer::instance().record(trace_id, chat::TraceStage::ENQUEUE, now, now);
+        message.trace_id = trace_id;
+        message.enqueued_ns = now;
+    }
+    
+    if (uring_transport_) {
+        uring_transport_->send(uring_handle_, message.header_buffer, std::move(message.body));
+        return true;
+    }
     
     // Queue the message
     {
@@ -59,7 +158,50 @@ bool TcpConnection::send(const std::vector<char>& data, uint16_t type, uint16_t
         bool write_in_progress = !write_queue_.empty();
         write_queue_.push_back(std::move(message));
         
-        if (!write_in_progress) {
+        if (!write_in_progress && handshake_complete_) {
+            asyncWrite();
+        }
+    }
+    
+    return true;
+}
+
+bool TcpConnection::sendFile(std::vector<char> prefix, std::shared_ptr<const SharedFile> file,
+                             uint64_t offset, uint32_t length, uint16_t type, uint16_t flags) {
+    if (!is_connected_ || !file || prefix.size() + length > MAX_BODY_SIZE ||
+        offset + length > file->size()) {
+        return false;
+    }
+    
+    if (uring_transport_) {
+        // The transport sends whole frames from memory; a frame is at
+        // most MAX_BODY_SIZE, so this never holds more than one chunk
+        std::size_t prefix_size = prefix.size();
+        prefix.resize(prefix_size + length);
+        if (file->read(offset, prefix.data() + prefix_size, length) != static_cast<long>(length)) {
+            return false;
+        }
+        return send(std::make_shared<const std::vector<char>>(std::move(prefix)), type, flags);
+    }
+    
+    MessageHeader header;
+    header.setMessageType(type);
+    header.setFlags(flags);
+    header.setBodySize(static_cast<uint32_t>(prefix.size() + length));
+    
+    OutgoingMessage message;
+    header.encodeToBuffer(message.header_buffer);
+    message.body = std::make_shared<const std::vector<char>>(std::move(prefix));
+    message.file.file = std::move(file);
+    message.file.offset = offset;
+    message.file.length = length;
+    
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        bool write_in_progress = !write_queue_.empty();
+        write_queue_.push_back(std::move(message));
+        
+        if (!write_in_progress && handshake_complete_) {
             asyncWrite();
         }
     }
@@ -75,6 +217,10 @@ void TcpConnection::setErrorCallback(ErrorCallback callback) {
     error_callback_ = callback;
 }
 
+void TcpConnection::setFrameFilter(FrameFilter filter) {
+    frame_filter_ = std::move(filter);
+}
+
 bool TcpConnection::isConnected() const {
     return is_connected_ && socket_.is_open();
 }
@@ -109,8 +255,7 @@ uint16_t TcpConnection::getRemotePort() const {
 
 void TcpConnection::asyncReadHeader() {
     auto self(shared_from_this());
-    boost::asio::async_read(
-        socket_,
+    asyncReadExactly(
         boost::asio::buffer(read_header_buffer_, HEADER_SIZE),
         [this, self](boost::system::error_code ec, std::size_t /*length*/) {
             handleReadHeader(ec);
@@ -122,8 +267,7 @@ void TcpConnection::asyncReadBody(uint32_t body_size) {
     read_body_buffer_.resize(body_size);
     
     auto self(shared_from_this());
-    boost::asio::async_read(
-        socket_,
+    asyncReadExactly(
         boost::asio::buffer(read_body_buffer_, body_size),
         [this, self](boost::system::error_code ec, std::size_t /*length*/) {
             handleReadBody(ec);
@@ -132,26 +276,112 @@ void TcpConnection::asyncReadBody(uint32_t body_size) {
 }
 
 void TcpConnection::asyncWrite() {
-    auto& message = write_queue_.front();
-    
-    // Prepare a vector of buffers for the gather write operation
+    // Coalesce everything queued so far into one gather write, so a burst
+    // of small messages costs one syscall instead of one per message
     std::vector<boost::asio::const_buffer> buffers;
-    buffers.push_back(boost::asio::buffer(message.header_buffer));
+    write_batch_size_ = std::min(write_queue_.size(), MAX_WRITE_BATCH);
+    buffers.reserve(write_batch_size_ * 2);
     
-    if (!message.body.empty()) {
-        buffers.push_back(boost::asio::buffer(message.body));
+    for (std::size_t i = 0; i < write_batch_size_; ++i) {
+        const auto& message = write_queue_[i];
+        buffers.push_back(boost::asio::buffer(message.header_buffer));
+        
+        if (!message.body->empty()) {
+            buffers.push_back(boost::asio::buffer(*message.body));
+        }
+        
+        // A file part is written on its own after the gather write, so
+        // the batch ends with its frame
+        if (message.file.file) {
+            write_batch_size_ = i + 1;
+            file_in_flight_ = message.file;
+            break;
+        }
     }
     
     auto self(shared_from_this());
-    boost::asio::async_write(
-        socket_,
+    asyncWriteAll(
         buffers,
         [this, self](boost::system::error_code ec, std::size_t /*bytes_transferred*/) {
+            if (!ec && file_in_flight_.file) {
+                writeFileRange();
+                return;
+            }
             handleWrite(ec);
         }
     );
 }
 
+void TcpConnection::writeFileRange() {
+    FileRange& range = file_in_flight_;
+    auto self(shared_from_this());
+    
+#ifdef __linux__
+    if (!tls_stream_ || tls_stream_->isKtlsSend()) {
+        // Zero-copy: the kernel moves page cache pages to the socket (and
+        // encrypts them under kTLS) without a trip through user space
+        boost::system::error_code ec;
+        socket_.native_non_blocking(true, ec);
+        while (!ec && range.length > 0) {
+            off_t offset = static_cast<off_t>(range.offset);
+            ssize_t sent = ::sendfile(socket_.native_handle(), range.file->fd(), &offset, range.length);
+            if (sent > 0) {
+                range.offset += static_cast<uint64_t>(sent);
+                range.length -= static_cast<uint32_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                socket_.async_wait(boost::asio::ip::tcp::socket::wait_write,
+                    [this, self](const boost::system::error_code& error) {
+                        if (error) {
+                            finishFileRange(error);
+                        } else {
+                            writeFileRange();
+                        }
+                    });
+                return;
+            }
+            // The file shrank after the header went out, or the socket failed
+            ec = sent == 0 ? boost::system::error_code(boost::asio::error::eof)
+                           : boost::system::error_code(errno, boost::system::system_category());
+        }
+        finishFileRange(ec);
+        return;
+    }
+#endif
+    
+    if (range.length == 0) {
+        finishFileRange(boost::system::error_code());
+        return;
+    }
+    std::size_t chunk = std::min<std::size_t>(range.length, FILE_CHUNK_SIZE);
+    file_chunk_.resize(chunk);
+    if (range.file->read(range.offset, file_chunk_.data(), chunk) != static_cast<long>(chunk)) {
+        finishFileRange(boost::asio::error::eof);
+        return;
+    }
+    range.offset += chunk;
+    range.length -= static_cast<uint32_t>(chunk);
+    asyncWriteAll(
+        boost::asio::buffer(file_chunk_),
+        [this, self](boost::system::error_code ec, std::size_t /*bytes_transferred*/) {
+            if (ec || file_in_flight_.length == 0) {
+                finishFileRange(ec);
+            } else {
+                writeFileRange();
+            }
+        }
+    );
+}
+
+void TcpConnection::finishFileRange(const boost::system::error_code& error) {
+    file_in_flight_ = FileRange();
+    handleWrite(error);
+}
+
 void TcpConnection::handleReadHeader(const boost::system::error_code& error) {
     if (error) {
         handleError(error);
@@ -168,17 +398,41 @@ void TcpConnection::handleReadHeader(const boost::system::error_code& error) {
         return;
     }
     
-    // Read the message body
+    // Sampling is decided here so the read span covers throttling delays
+    trace_id_ = chat::Tracer::active() ? chat::Tracer::instance().sample(current_header_.getFlags()) : 0;
+    if (trace_id_) {
+        read_started_ns_ = chat::Tracer::now();
+    }
+    
     uint32_t body_size = current_header_.getBodySize();
+    FrameVerdict verdict;
+    if (frame_filter_) {
+        verdict = frame_filter_(current_header_.getMessageType(), body_size);
+    }
+    discard_body_ = verdict.action == FrameVerdict::REJECT;
+    
+    if (verdict.action == FrameVerdict::DELAY && verdict.delay.count() > 0) {
+        // Leave the socket unread; the peer's sends back up behind it
+        auto self(shared_from_this());
+        read_pause_timer_.expires_after(verdict.delay);
+        read_pause_timer_.async_wait([this, self, body_size](const boost::system::error_code& ec) {
+            if (!ec && is_connected_) {
+                readFrameBody(body_size);
+            }
+        });
+        return;
+    }
+    
+    readFrameBody(body_size);
+}
+
+void TcpConnection::readFrameBody(uint32_t body_size) {
+    // Read the message body
     if (body_size > 0) {
         asyncReadBody(body_size);
     } else {
         // Empty message body, notify callback with an empty vector
-        if (message_callback_) {
-            message_callback_(std::vector<char>(), 
-                             current_header_.getMessageType(), 
-                             current_header_.getFlags());
-        }
+        deliverFrame(std::vector<char>());
         
         // Start reading the next message
         asyncReadHeader();
@@ -192,26 +446,46 @@ void TcpConnection::handleReadBody(const boost::system::error_code& error) {
     }
     
     // Notify the callback
-    if (message_callback_) {
-        message_callback_(read_body_buffer_, 
-                         current_header_.getMessageType(), 
-                         current_header_.getFlags());
-    }
+    deliverFrame(read_body_buffer_);
     
     // Start reading the next message
     asyncReadHeader();
 }
 
+void TcpConnection::deliverFrame(const std::vector<char>& body) {
+    if (!message_callback_ || discard_body_) {
+        return;
+    }
+    
+    if (!trace_id_) {
+        message_callback_(body, current_header_.getMessageType(), current_header_.getFlags());
+        return;
+    }
+    
+    // Sends made by the callback on this thread join the frame's trace
+    chat::Tracer& tracer = chat::Tracer::instance();
+    uint64_t dispatch_started = chat::Tracer::now();
+    tracer.record(trace_id_, chat::TraceStage::READ, read_started_ns_, dispatch_started);
+    {
+        chat::TraceContext context(trace_id_);
+        message_callback_(body, current_header_.getMessageType(), current_header_.getFlags());
+    }
+    tracer.record(trace_id_, chat::TraceStage::DISPATCH, dispatch_started, chat::Tracer::now());
+}
+
 void TcpConnection::handleWrite(const boost::system::error_code& error) {
     if (error) {
         handleError(error);
         return;
     }
     
-    // Remove the message from the queue
+    // Remove the written messages from the queue
     {
         std::lock_guard<std::mutex> lock(write_mutex_);
-        write_queue_.pop_front();
+        if (chat::Tracer::active()) {
+            traceWrites();
+        }
+        write_queue_.erase(write_queue_.begin(), write_queue_.begin() + write_batch_size_);
         
         if (!write_queue_.empty()) {
             // More messages in the queue, continue writing
@@ -223,6 +497,63 @@ void TcpConnection::handleWrite(const boost::system::error_code& error) {
     }
 }
 
+void TcpConnection::traceWrites() {
+    uint64_t now = chat::Tracer::now();
+    for (std::size_t i = 0; i < write_batch_size_; ++i) {
+        const auto& message = write_queue_[i];
+        if (message.trace_id) {
+            chat::Tracer::instance().record(message.trace_id, chat::TraceStage::WRITE, message.enqueued_ns, now);
+        }
+    }
+}
+
+void TcpConnection::handleHandshake(const boost::system::error_code& error) {
+    if (error) {
+        handleError(error);
+        return;
+    }
+    
+    // Flush anything queued while the handshake was running
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        handshake_complete_ = true;
+        if (!write_queue_.empty()) {
+            asyncWrite();
+        }
+    }
+    
+    asyncReadHeader();
+}
+
+void TcpConnection::handleTransportData(const char* data, std::size_t size) {
+    bool valid = uring_parser_.consume(data, size,
+        [this](const std::vector<char>& body, uint16_t type, uint16_t flags) {
+            // Reads cannot be held back here (canPauseReads()), so a
+            // DELAY verdict drops the frame like REJECT
+            if (frame_filter_ &&
+                frame_filter_(type, static_cast<uint32_t>(body.size())).action != FrameVerdict::ACCEPT) {
+                return;
+            }
+            if (!message_callback_) {
+                return;
+            }
+            uint64_t trace_id = chat::Tracer::active() ? chat::Tracer::instance().sample(flags) : 0;
+            if (!trace_id) {
+                message_callback_(body, type, flags);
+                return;
+            }
+            // Frames arrive whole here, so there is no read span
+            chat::TraceContext context(trace_id);
+            chat::TraceSpan span(chat::TraceStage::DISPATCH);
+            message_callback_(body, type, flags);
+        });
+    
+    if (!valid) {
+        // Invalid header, close connection
+        stop();
+    }
+}
+
 void TcpConnection::handleError(const boost::system::error_code& error) {
     if (error == boost::asio::error::eof ||
         error == boost::asio::error::connection_reset) {
@@ -0,0 +1,213 @@
+#include "common/tls_context.h"
+#include "common/tls_stream.h"
+#include "common/config_loader.h"
+#include <iostream>
+
+#ifdef WITH_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace chat_app {
+
+TlsContext::Options TlsContext::Options::fromConfig(const chat::ConfigLoader& config) {
+    Options options;
+    options.cert_file = config.getString("CERT_FILE", "certs/server.crt");
+    options.key_file = config.getString("KEY_FILE", "certs/server.key");
+    options.ca_file = config.getString("CA_FILE", "");
+    options.verify_peer = config.getBool("SSL_VERIFY_PEER", options.verify_peer);
+    options.enable_ktls = config.getBool("SSL_ENABLE_KTLS", options.enable_ktls);
+    options.enable_resumption = config.getBool("SSL_SESSION_RESUMPTION", options.enable_resumption);
+    options.session_cache_size = static_cast<std::size_t>(
+        config.getInt("SSL_SESSION_CACHE_SIZE", static_cast<int>(options.session_cache_size)));
+    options.session_timeout = config.getInt("SSL_SESSION_TIMEOUT", static_cast<int>(options.session_timeout));
+    options.num_tickets = config.getInt("SSL_NUM_TICKETS", options.num_tickets);
+    return options;
+}
+
+#ifdef WITH_OPENSSL
+
+namespace {
+
+void logOpenSslError(const std::string& what) {
+    unsigned long code = ERR_get_error();
+    char buffer[256] = {0};
+    if (code != 0) {
+        ERR_error_string_n(code, buffer, sizeof(buffer));
+    }
+    std::cerr << "Error: " << what << (code != 0 ? ": " : "") << buffer << std::endl;
+    ERR_clear_error();
+}
+
+// Client side: OpenSSL hands us every new session (TLS 1.3 tickets arrive
+// after the handshake); keep the latest one per peer for resumption
+int onNewClientSession(SSL* ssl, SSL_SESSION* session) {
+    auto* context = static_cast<TlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    auto* stream = static_cast<TlsStream*>(SSL_get_app_data(ssl));
+    if (!context || !stream || stream->peer().empty()) {
+        return 0;  // Not retained, OpenSSL frees it
+    }
+    context->storeSession(stream->peer(), session);
+    return 1;  // We own the reference now
+}
+
+} // namespace
+
+TlsContext::TlsContext(TlsRole role, const Options& options)
+    : role_(role), options_(options) {
+}
+
+TlsContext::~TlsContext() {
+    if (ctx_) {
+        SSL_CTX_free(ctx_);
+    }
+}
+
+std::shared_ptr<TlsContext> TlsContext::create(TlsRole role, const Options& options) {
+    std::shared_ptr<TlsContext> context(new TlsContext(role, options));
+
+    context->ctx_ = SSL_CTX_new(role == TlsRole::SERVER ? TLS_server_method() : TLS_client_method());
+    if (!context->ctx_) {
+        logOpenSslError("Failed to create TLS context");
+        return nullptr;
+    }
+    SSL_CTX* ctx = context->ctx_;
+    SSL_CTX_set_app_data(ctx, context.get());
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+
+    // Partial writes let TlsStream behave like a socket; the retry buffer
+    // may move because gathered writes are re-coalesced on every attempt
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                          SSL_MODE_RELEASE_BUFFERS);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+#ifdef SSL_OP_ENABLE_KTLS
+    if (options.enable_ktls) {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    }
+#else
+    if (options.enable_ktls) {
+        std::cerr << "Warning: OpenSSL built without kTLS support, using user-space TLS" << std::endl;
+    }
+#endif
+
+    if (role == TlsRole::SERVER) {
+        if (SSL_CTX_use_certificate_chain_file(ctx, options.cert_file.c_str()) != 1) {
+            logOpenSslError("Failed to load certificate " + options.cert_file);
+            return nullptr;
+        }
+        if (SSL_CTX_use_PrivateKey_file(ctx, options.key_file.c_str(), SSL_FILETYPE_PEM) != 1) {
+            logOpenSslError("Failed to load private key " + options.key_file);
+            return nullptr;
+        }
+        if (SSL_CTX_check_private_key(ctx) != 1) {
+            logOpenSslError("Private key does not match certificate");
+            return nullptr;
+        }
+
+        if (options.enable_resumption) {
+            // Stateful cache for TLS 1.2 session IDs plus stateless tickets
+            static const unsigned char session_id_context[] = "chat_app";
+            SSL_CTX_set_session_id_context(ctx, session_id_context, sizeof(session_id_context) - 1);
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(ctx, static_cast<long>(options.session_cache_size));
+            SSL_CTX_set_timeout(ctx, options.session_timeout);
+            SSL_CTX_set_num_tickets(ctx, static_cast<size_t>(options.num_tickets));
+        } else {
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            SSL_CTX_set_num_tickets(ctx, 0);
+        }
+    } else if (options.enable_resumption) {
+        // Sessions are stored per peer by onNewClientSession, not internally
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, onNewClientSession);
+    }
+
+    if (!options.ca_file.empty() && SSL_CTX_load_verify_locations(ctx, options.ca_file.c_str(), nullptr) != 1) {
+        logOpenSslError("Failed to load CA file " + options.ca_file);
+        return nullptr;
+    }
+    if (options.verify_peer) {
+        int mode = SSL_VERIFY_PEER;
+        if (role == TlsRole::SERVER) {
+            mode |= SSL_VERIFY_FAIL_IF_NO_PEER_CERT;
+        }
+        SSL_CTX_set_verify(ctx, mode, nullptr);
+    }
+
+    return context;
+}
+
+ssl_st* TlsContext::newSsl() const {
+    SSL* ssl = SSL_new(ctx_);
+    if (!ssl) {
+        logOpenSslError("Failed to create TLS session");
+    }
+    return ssl;
+}
+
+void TlsContext::storeSession(const std::string& peer, ssl_session_st* session) {
+    std::shared_ptr<SSL_SESSION> owned(session, SSL_SESSION_free);
+
+    std::lock_guard<std::mutex> lock(session_mutex_);
+    auto it = sessions_.find(peer);
+    if (it != sessions_.end()) {
+        session_order_.erase(it->second.second);
+        sessions_.erase(it);
+    }
+
+    session_order_.push_front(peer);
+    sessions_.emplace(peer, std::make_pair(std::move(owned), session_order_.begin()));
+
+    // Evict the least recently stored peers
+    while (sessions_.size() > options_.session_cache_size && !session_order_.empty()) {
+        sessions_.erase(session_order_.back());
+        session_order_.pop_back();
+    }
+}
+
+ssl_session_st* TlsContext::findSession(const std::string& peer) const {
+    std::lock_guard<std::mutex> lock(session_mutex_);
+    auto it = sessions_.find(peer);
+    if (it == sessions_.end()) {
+        return nullptr;
+    }
+
+    SSL_SESSION* session = it->second.first.get();
+    if (!SSL_SESSION_is_resumable(session)) {
+        return nullptr;
+    }
+    SSL_SESSION_up_ref(session);
+    return session;
+}
+
+#else // !WITH_OPENSSL
+
+TlsContext::TlsContext(TlsRole role, const Options& options)
+    : role_(role), options_(options) {
+}
+
+TlsContext::~TlsContext() = default;
+
+std::shared_ptr<TlsContext> TlsContext::create(TlsRole /*role*/, const Options& /*options*/) {
+    std::cerr << "Error: TLS requested but this build has no OpenSSL support" << std::endl;
+    return nullptr;
+}
+
+ssl_st* TlsContext::newSsl() const {
+    return nullptr;
+}
+
+void TlsContext::storeSession(const std::string& /*peer*/, ssl_session_st* /*session*/) {
+}
+
+ssl_session_st* TlsContext::findSession(const std::string& /*peer*/) const {
+    return nullptr;
+}
+
+#endif // WITH_OPENSSL
+
+} // namespace chat_app
@@ -0,0 +1,182 @@
+#include "common/tls_stream.h"
+#include "common/logger.h"
+
+#ifdef WITH_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace chat_app {
+
+#ifdef WITH_OPENSSL
+
+TlsStream::TlsStream(boost::asio::ip::tcp::socket& socket,
+                     std::shared_ptr<TlsContext> context,
+                     std::string peer)
+    : socket_(socket),
+      context_(std::move(context)),
+      peer_(std::move(peer)) {
+    ssl_ = context_->newSsl();
+    if (!ssl_) {
+        return;
+    }
+
+    boost::system::error_code ignored;
+    socket_.non_blocking(true, ignored);
+    SSL_set_fd(ssl_, static_cast<int>(socket_.native_handle()));
+    SSL_set_app_data(ssl_, this);
+
+    if (context_->role() == TlsRole::SERVER) {
+        SSL_set_accept_state(ssl_);
+    } else {
+        SSL_set_connect_state(ssl_);
+
+        // Offer the last session we got from this peer
+        if (SSL_SESSION* session = context_->findSession(peer_)) {
+            SSL_set_session(ssl_, session);
+            SSL_SESSION_free(session);
+        }
+    }
+}
+
+TlsStream::~TlsStream() {
+    if (ssl_) {
+        SSL_free(ssl_);
+    }
+}
+
+TlsStream::IoStatus TlsStream::translate(int result, boost::system::error_code& ec) {
+    int error = SSL_get_error(ssl_, result);
+    switch (error) {
+        case SSL_ERROR_NONE:
+            return IoStatus::DONE;
+        case SSL_ERROR_WANT_READ:
+            return IoStatus::WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            return IoStatus::WANT_WRITE;
+        case SSL_ERROR_ZERO_RETURN:
+            ec = boost::asio::error::eof;
+            return IoStatus::FAILED;
+        case SSL_ERROR_SYSCALL:
+            ec = errno != 0 ? boost::system::error_code(errno, boost::system::system_category())
+                            : boost::system::error_code(boost::asio::error::eof);
+            ERR_clear_error();
+            return IoStatus::FAILED;
+        default: {
+            unsigned long code = ERR_get_error();
+            char buffer[256] = {0};
+            ERR_error_string_n(code, buffer, sizeof(buffer));
+            CHAT_LOG_WARN("TLS error with {}: {}", peer_.empty() ? "peer" : peer_.c_str(), buffer);
+            ERR_clear_error();
+            ec = boost::asio::error::access_denied;
+            return IoStatus::FAILED;
+        }
+    }
+}
+
+TlsStream::IoStatus TlsStream::doHandshake(boost::system::error_code& ec) {
+    if (!ssl_) {
+        ec = boost::asio::error::no_protocol_option;
+        return IoStatus::FAILED;
+    }
+
+    std::lock_guard<std::mutex> lock(ssl_mutex_);
+    ERR_clear_error();
+    errno = 0;
+    int result = SSL_do_handshake(ssl_);
+    if (result != 1) {
+        return translate(result, ec);
+    }
+
+#ifdef SSL_OP_ENABLE_KTLS
+    // OpenSSL installs the kernel TLS keys during the handshake when the
+    // kernel and cipher allow it
+    ktls_send_ = BIO_get_ktls_send(SSL_get_wbio(ssl_)) != 0;
+    ktls_recv_ = BIO_get_ktls_recv(SSL_get_rbio(ssl_)) != 0;
+#endif
+    return IoStatus::DONE;
+}
+
+TlsStream::IoStatus TlsStream::doRead(void* data, std::size_t size, std::size_t& transferred,
+                                      boost::system::error_code& ec) {
+    std::lock_guard<std::mutex> lock(ssl_mutex_);
+    ERR_clear_error();
+    errno = 0;
+    int result = SSL_read_ex(ssl_, data, size, &transferred) == 1 ? 1 : 0;
+    if (result == 1) {
+        return IoStatus::DONE;
+    }
+    transferred = 0;
+    return translate(result, ec);
+}
+
+TlsStream::IoStatus TlsStream::doWrite(const void* data, std::size_t size, std::size_t& transferred,
+                                       boost::system::error_code& ec) {
+    std::lock_guard<std::mutex> lock(ssl_mutex_);
+    ERR_clear_error();
+    errno = 0;
+    int result = SSL_write_ex(ssl_, data, size, &transferred) == 1 ? 1 : 0;
+    if (result == 1) {
+        return IoStatus::DONE;
+    }
+    transferred = 0;
+    return translate(result, ec);
+}
+
+void TlsStream::shutdown() {
+    if (!ssl_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(ssl_mutex_);
+    ERR_clear_error();
+    SSL_shutdown(ssl_);
+    ERR_clear_error();
+}
+
+bool TlsStream::sessionReused() const {
+    return ssl_ && SSL_session_reused(ssl_) == 1;
+}
+
+#else // !WITH_OPENSSL
+
+TlsStream::TlsStream(boost::asio::ip::tcp::socket& socket,
+                     std::shared_ptr<TlsContext> context,
+                     std::string peer)
+    : socket_(socket),
+      context_(std::move(context)),
+      peer_(std::move(peer)) {
+}
+
+TlsStream::~TlsStream() = default;
+
+TlsStream::IoStatus TlsStream::translate(int /*result*/, boost::system::error_code& ec) {
+    ec = boost::asio::error::operation_not_supported;
+    return IoStatus::FAILED;
+}
+
+TlsStream::IoStatus TlsStream::doHandshake(boost::system::error_code& ec) {
+    return translate(0, ec);
+}
+
+TlsStream::IoStatus TlsStream::doRead(void* /*data*/, std::size_t /*size*/, std::size_t& transferred,
+                                      boost::system::error_code& ec) {
+    transferred = 0;
+    return translate(0, ec);
+}
+
+TlsStream::IoStatus TlsStream::doWrite(const void* /*data*/, std::size_t /*size*/, std::size_t& transferred,
+                                       boost::system::error_code& ec) {
+    transferred = 0;
+    return translate(0, ec);
+}
+
+void TlsStream::shutdown() {
+}
+
+bool TlsStream::sessionReused() const {
+    return false;
+}
+
+#endif // WITH_OPENSSL
+
+} // namespace chat_app
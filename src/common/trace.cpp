@@ -0,0 +1,233 @@
+#include "common/trace.h"
+#include "common/logger.h"
+#include "common/protocol.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace chat {
+
+std::atomic<bool> Tracer::active_{false};
+
+/**
+ * Fixed slots written round-robin. Each slot is a small seqlock: the
+ * writer clears sequence, stores the fields and publishes its claim
+ * index + 1, and readers keep only slots whose sequence was the same
+ * before and after copying. Fields are relaxed atomics so a torn read
+ * is discarded rather than undefined.
+ */
+struct Tracer::Ring {
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint64_t> trace_id{0};
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> end_ns{0};
+        std::atomic<uint64_t> stage_thread{0};  // Stage << 32 | thread id
+    };
+
+    explicit Ring(std::size_t size) : slots(size), mask(size - 1) {
+    }
+
+    std::vector<Slot> slots;
+    const std::size_t mask;
+    std::atomic<uint64_t> next{0};
+};
+
+namespace {
+
+std::size_t roundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Frames left before the next sample on this thread
+thread_local uint32_t sample_countdown = 0;
+
+std::atomic<uint32_t> sample_rate{0};
+std::atomic<uint32_t> next_thread_id{1};
+
+} // namespace
+
+const char* traceStageName(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::READ:     return "read";
+        case TraceStage::DISPATCH: return "dispatch";
+        case TraceStage::DECODE:   return "decode";
+        case TraceStage::ROUTE:    return "route";
+        case TraceStage::STORE:    return "store";
+        case TraceStage::ENQUEUE:  return "enqueue";
+        case TraceStage::WRITE:    return "write";
+    }
+    return "unknown";
+}
+
+Tracer::Options Tracer::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.sample_rate = static_cast<uint32_t>(std::max(0,
+        config.getInt("TRACE_SAMPLE_RATE", static_cast<int>(options.sample_rate))));
+    options.ring_slots = static_cast<std::size_t>(std::max(2,
+        config.getInt("TRACE_BUFFER_SLOTS", static_cast<int>(options.ring_slots))));
+    options.file_path = config.getString("TRACE_FILE", options.file_path);
+    return options;
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::~Tracer() = default;
+
+void Tracer::start(const Options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    options_.ring_slots = roundUpToPowerOfTwo(std::max<std::size_t>(options.ring_slots, 2));
+    // Spans still being recorded into the old ring finish there; it is
+    // kept until no record() call is running
+    auto ring = std::make_unique<Ring>(options_.ring_slots);
+    ring_.store(ring.get(), std::memory_order_seq_cst);
+    if (current_) {
+        retired_.push_back(std::move(current_));
+    }
+    current_ = std::move(ring);
+    reclaimLocked();
+    traces_.store(0, std::memory_order_relaxed);
+    sample_rate.store(options_.sample_rate, std::memory_order_relaxed);
+    active_.store(options_.sample_rate > 0, std::memory_order_release);
+}
+
+void Tracer::stop() {
+    active_.store(false, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(mutex_);
+    reclaimLocked();
+}
+
+void Tracer::reclaimLocked() {
+    // record() counts itself before loading ring_. Seeing no call in
+    // progress after ring_ was replaced means every later call loads the
+    // new ring, and every earlier one has finished with the old.
+    if (!retired_.empty() && recording_.load(std::memory_order_seq_cst) == 0) {
+        retired_.clear();
+    }
+}
+
+uint64_t Tracer::sample(uint16_t flags) {
+    if (!(flags & chat_app::MessageFlags::TRACED)) {
+        if (sample_countdown == 0) {
+            sample_countdown = std::max<uint32_t>(sample_rate.load(std::memory_order_relaxed), 1);
+        }
+        if (--sample_countdown > 0) {
+            return 0;
+        }
+    }
+    traces_.fetch_add(1, std::memory_order_relaxed);
+    return next_trace_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Tracer::record(uint64_t trace_id, TraceStage stage, uint64_t start_ns, uint64_t end_ns) {
+    recording_.fetch_add(1, std::memory_order_seq_cst);
+    Ring* ring = ring_.load(std::memory_order_seq_cst);
+    if (!ring) {
+        recording_.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    uint64_t index = ring->next.fetch_add(1, std::memory_order_relaxed);
+    Ring::Slot& slot = ring->slots[index & ring->mask];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.trace_id.store(trace_id, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.end_ns.store(end_ns, std::memory_order_relaxed);
+    slot.stage_thread.store(static_cast<uint64_t>(stage) << 32 | threadId(), std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+    recording_.fetch_sub(1, std::memory_order_release);
+}
+
+std::vector<Tracer::Span> Tracer::spans() const {
+    std::vector<Span> result;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Ring* ring = current_.get();
+    if (!ring) {
+        return result;
+    }
+
+    result.reserve(std::min<std::size_t>(ring->slots.size(), ring->next.load(std::memory_order_relaxed)));
+    for (const auto& slot : ring->slots) {
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            continue;
+        }
+        Span span;
+        span.trace_id = slot.trace_id.load(std::memory_order_relaxed);
+        span.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+        span.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+        uint64_t stage_thread = slot.stage_thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;  // Overwritten while copying
+        }
+        span.stage = static_cast<TraceStage>(stage_thread >> 32);
+        span.thread_id = static_cast<uint32_t>(stage_thread);
+        result.push_back(span);
+    }
+
+    std::sort(result.begin(), result.end(), [](const Span& a, const Span& b) {
+        return a.start_ns != b.start_ns ? a.start_ns < b.start_ns : a.end_ns < b.end_ns;
+    });
+    return result;
+}
+
+void Tracer::exportChromeTrace(std::ostream& out) const {
+    // Complete ("X") events; ts and dur are microseconds
+    auto micros = [](uint64_t ns) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%llu.%03llu",
+                      static_cast<unsigned long long>(ns / 1000), static_cast<unsigned long long>(ns % 1000));
+        return std::string(buffer);
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& span : spans()) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        uint64_t duration = span.end_ns > span.start_ns ? span.end_ns - span.start_ns : 0;
+        out << "{\"name\":\"" << traceStageName(span.stage) << "\",\"cat\":\"chat\",\"ph\":\"X\",\"pid\":1"
+            << ",\"tid\":" << span.thread_id << ",\"ts\":" << micros(span.start_ns)
+            << ",\"dur\":" << micros(duration) << ",\"args\":{\"trace\":" << span.trace_id << "}}";
+    }
+    out << "\n]}\n";
+}
+
+bool Tracer::writeChromeTrace() const {
+    std::ofstream file(options_.file_path, std::ios::trunc);
+    if (!file) {
+        CHAT_LOG_ERROR("Could not open trace file: {}", options_.file_path);
+        return false;
+    }
+    exportChromeTrace(file);
+    return static_cast<bool>(file);
+}
+
+Tracer::Stats Tracer::stats() const {
+    Stats stats;
+    stats.traces = traces_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Ring* ring = current_.get();
+    if (ring) {
+        stats.spans = ring->next.load(std::memory_order_relaxed);
+        stats.overwritten = stats.spans > ring->slots.size() ? stats.spans - ring->slots.size() : 0;
+    }
+    return stats;
+}
+
+uint32_t Tracer::threadId() {
+    thread_local uint32_t id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+} // namespace chat
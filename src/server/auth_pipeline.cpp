@@ -0,0 +1,360 @@
+#include "server/auth_pipeline.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+#ifdef WITH_OPENSSL
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#endif
+
+namespace chat {
+
+namespace {
+
+constexpr std::size_t SALT_SIZE = 16;
+constexpr std::size_t KEY_SIZE = 32;
+constexpr std::size_t TOKEN_SIZE = 32;
+// Stored hashes asking for more than this are treated as corrupt
+constexpr uint64_t MAX_SCRYPT_N = uint64_t(1) << 20;
+
+std::string toHex(const std::vector<unsigned char>& bytes) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(bytes.size() * 2);
+    for (unsigned char byte : bytes) {
+        hex.push_back(digits[byte >> 4]);
+        hex.push_back(digits[byte & 0x0F]);
+    }
+    return hex;
+}
+
+std::optional<std::vector<unsigned char>> fromHex(const std::string& hex) {
+    if (hex.size() % 2 != 0) {
+        return std::nullopt;
+    }
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    std::vector<unsigned char> bytes(hex.size() / 2);
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        int high = nibble(hex[2 * i]);
+        int low = nibble(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return std::nullopt;
+        }
+        bytes[i] = static_cast<unsigned char>((high << 4) | low);
+    }
+    return bytes;
+}
+
+std::vector<unsigned char> randomBytes(std::size_t count) {
+    std::vector<unsigned char> bytes(count);
+#ifdef WITH_OPENSSL
+    if (RAND_bytes(bytes.data(), static_cast<int>(count)) == 1) {
+        return bytes;
+    }
+#endif
+    std::random_device device;
+    for (auto& byte : bytes) {
+        byte = static_cast<unsigned char>(device());
+    }
+    return bytes;
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> fields;
+    std::stringstream stream(text);
+    std::string field;
+    while (std::getline(stream, field, separator)) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+#ifdef WITH_OPENSSL
+bool deriveKey(const std::string& password, const std::vector<unsigned char>& salt,
+               const PasswordHasher::Params& params, std::vector<unsigned char>& key) {
+    // OpenSSL refuses anything over maxmem; allow what the parameters need
+    uint64_t memory = 128 * static_cast<uint64_t>(params.r) * (params.n + params.p + 2);
+    return EVP_PBE_scrypt(password.data(), password.size(), salt.data(), salt.size(),
+                          params.n, params.r, params.p, memory + (1 << 20),
+                          key.data(), key.size()) == 1;
+}
+#endif
+
+} // namespace
+
+// PasswordHasher
+
+std::optional<std::string> PasswordHasher::hash(const std::string& password) {
+    return hash(password, Params());
+}
+
+std::optional<std::string> PasswordHasher::hash(const std::string& password, const Params& params) {
+#ifdef WITH_OPENSSL
+    auto salt = randomBytes(SALT_SIZE);
+    std::vector<unsigned char> key(KEY_SIZE);
+    if (!deriveKey(password, salt, params, key)) {
+        CHAT_LOG_ERROR("scrypt failed (N={} r={} p={})", params.n, params.r, params.p);
+        return std::nullopt;
+    }
+    return "scrypt$" + std::to_string(params.n) + "$" + std::to_string(params.r) + "$" +
+           std::to_string(params.p) + "$" + toHex(salt) + "$" + toHex(key);
+#else
+    (void)password;
+    (void)params;
+    CHAT_LOG_ERROR("Password hashing requires a build with OpenSSL support");
+    return std::nullopt;
+#endif
+}
+
+bool PasswordHasher::verify(const std::string& password, const std::string& encoded) {
+#ifdef WITH_OPENSSL
+    auto fields = split(encoded, '$');
+    if (fields.size() != 6 || fields[0] != "scrypt") {
+        return false;
+    }
+    Params params;
+    try {
+        params.n = std::stoull(fields[1]);
+        params.r = static_cast<uint32_t>(std::stoul(fields[2]));
+        params.p = static_cast<uint32_t>(std::stoul(fields[3]));
+    } catch (const std::exception&) {
+        return false;
+    }
+    auto salt = fromHex(fields[4]);
+    auto expected = fromHex(fields[5]);
+    if (!salt || !expected || expected->empty() || params.n > MAX_SCRYPT_N) {
+        return false;
+    }
+    std::vector<unsigned char> key(expected->size());
+    if (!deriveKey(password, *salt, params, key)) {
+        return false;
+    }
+    return CRYPTO_memcmp(key.data(), expected->data(), key.size()) == 0;
+#else
+    (void)password;
+    (void)encoded;
+    return false;
+#endif
+}
+
+// SessionTokenCache
+
+SessionTokenCache::SessionTokenCache(std::size_t capacity, std::chrono::seconds ttl)
+    : capacity_(std::max<std::size_t>(1, capacity)), ttl_(ttl) {
+}
+
+std::string SessionTokenCache::issue(const std::string& user_id) {
+    std::string token = toHex(randomBytes(TOKEN_SIZE));
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_front({token, user_id, std::chrono::steady_clock::now() + ttl_});
+    index_[token] = entries_.begin();
+    if (entries_.size() > capacity_) {
+        index_.erase(entries_.back().token);
+        entries_.pop_back();
+    }
+    return token;
+}
+
+std::optional<std::string> SessionTokenCache::lookup(const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(token);
+    if (it == index_.end()) {
+        return std::nullopt;
+    }
+    if (it->second->expires <= std::chrono::steady_clock::now()) {
+        entries_.erase(it->second);
+        index_.erase(it);
+        return std::nullopt;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->user_id;
+}
+
+void SessionTokenCache::revoke(const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(token);
+    if (it != index_.end()) {
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+}
+
+std::size_t SessionTokenCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+// AuthPipeline
+
+AuthPipeline::Options AuthPipeline::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.workers = static_cast<std::size_t>(std::max(0,
+        config.getInt("AUTH_WORKERS", static_cast<int>(options.workers))));
+    options.max_queued = static_cast<std::size_t>(std::max(1,
+        config.getInt("AUTH_QUEUE_SIZE", static_cast<int>(options.max_queued))));
+    options.token_cache_size = static_cast<std::size_t>(std::max(1,
+        config.getInt("AUTH_TOKEN_CACHE_SIZE", static_cast<int>(options.token_cache_size))));
+    options.token_ttl = std::chrono::seconds(
+        config.getInt("AUTH_TOKEN_TTL", static_cast<int>(options.token_ttl.count())));
+    return options;
+}
+
+AuthPipeline::AuthPipeline(Options options, CredentialLookup lookup)
+    : options_(options),
+      lookup_(std::move(lookup)),
+      tokens_(options.token_cache_size, options.token_ttl) {
+    if (options_.workers == 0) {
+        options_.workers = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+}
+
+AuthPipeline::~AuthPipeline() {
+    stop();
+}
+
+void AuthPipeline::start() {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    for (std::size_t i = 0; i < options_.workers; ++i) {
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+    CHAT_LOG_INFO("Auth pipeline started with {} workers", options_.workers);
+}
+
+void AuthPipeline::stop() {
+    std::deque<Job> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+        abandoned.swap(queue_);
+        queued_.store(0, std::memory_order_relaxed);
+    }
+    queue_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    for (auto& job : abandoned) {
+        Result result;
+        result.status = Status::BUSY;
+        complete(job, std::move(result));
+    }
+}
+
+void AuthPipeline::submit(const boost::asio::any_io_executor& executor, Request request, Completion completion) {
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    Job job{executor, std::move(request), std::move(completion)};
+
+    // A known token is a map lookup; it never waits for a worker
+    if (!job.request.token.empty()) {
+        if (auto user_id = tokens_.lookup(job.request.token)) {
+            cache_hits_.fetch_add(1, std::memory_order_relaxed);
+            succeeded_.fetch_add(1, std::memory_order_relaxed);
+            Result result;
+            result.status = Status::OK;
+            result.user_id = std::move(*user_id);
+            result.token = job.request.token;
+            result.from_cache = true;
+            complete(job, std::move(result));
+            return;
+        }
+        if (job.request.password.empty()) {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            complete(job, Result());
+            return;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (running_ && queue_.size() < options_.max_queued) {
+            queue_.push_back(std::move(job));
+            uint64_t queued = queue_.size();
+            queued_.store(queued, std::memory_order_relaxed);
+            if (queued > peak_queued_.load(std::memory_order_relaxed)) {
+                peak_queued_.store(queued, std::memory_order_relaxed);
+            }
+            queue_cv_.notify_one();
+            return;
+        }
+    }
+    rejected_busy_.fetch_add(1, std::memory_order_relaxed);
+    Result result;
+    result.status = Status::BUSY;
+    complete(job, std::move(result));
+}
+
+AuthPipeline::Stats AuthPipeline::stats() const {
+    Stats stats;
+    stats.submitted = submitted_.load(std::memory_order_relaxed);
+    stats.cache_hits = cache_hits_.load(std::memory_order_relaxed);
+    stats.verified = verified_.load(std::memory_order_relaxed);
+    stats.succeeded = succeeded_.load(std::memory_order_relaxed);
+    stats.failed = failed_.load(std::memory_order_relaxed);
+    stats.rejected_busy = rejected_busy_.load(std::memory_order_relaxed);
+    stats.queued = queued_.load(std::memory_order_relaxed);
+    stats.peak_queued = peak_queued_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AuthPipeline::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this]() { return !running_ || !queue_.empty(); });
+            if (!running_) {
+                return;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+            queued_.store(queue_.size(), std::memory_order_relaxed);
+        }
+        complete(job, verify(job.request));
+    }
+}
+
+AuthPipeline::Result AuthPipeline::verify(const Request& request) {
+    // Unknown users are checked against a throwaway hash so they take as
+    // long as a wrong password and cannot be told apart by timing
+    static const std::string unknown_user_hash = PasswordHasher::hash("").value_or("");
+
+    Result result;
+    auto credential = lookup_ ? lookup_(request.username) : std::nullopt;
+    verified_.fetch_add(1, std::memory_order_relaxed);
+    bool valid = PasswordHasher::verify(request.password,
+                                        credential ? credential->password_hash : unknown_user_hash);
+    if (!credential || !valid) {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+    succeeded_.fetch_add(1, std::memory_order_relaxed);
+    result.status = Status::OK;
+    result.user_id = credential->user_id;
+    result.token = tokens_.issue(credential->user_id);
+    return result;
+}
+
+void AuthPipeline::complete(Job& job, Result result) {
+    boost::asio::post(job.executor,
+        [completion = std::move(job.completion), result = std::move(result)]() {
+            if (completion) {
+                completion(result);
+            }
+        });
+}
+
+} // namespace chat
@@ -0,0 +1,703 @@
+#include "server/cluster_manager.h"
+#include "server/frame_helpers.h"
+#include "common/logger.h"
+#include "common/protocol.h"
+#include <sstream>
+
+namespace chat {
+
+using chat_app::TcpConnection;
+using boost::asio::ip::tcp;
+
+namespace {
+
+std::string trim(const std::string& text) {
+    std::size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    std::size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+bool NodeInfo::parse(const std::string& text, NodeInfo& out) {
+    std::size_t at = text.find('@');
+    std::size_t colon = text.rfind(':');
+    if (at == std::string::npos || colon == std::string::npos || colon < at || at == 0) {
+        return false;
+    }
+
+    NodeInfo info;
+    info.node_id = text.substr(0, at);
+    info.host = text.substr(at + 1, colon - at - 1);
+    try {
+        int port = std::stoi(text.substr(colon + 1));
+        if (port <= 0 || port > 65535 || info.host.empty()) {
+            return false;
+        }
+        info.port = static_cast<uint16_t>(port);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    out = std::move(info);
+    return true;
+}
+
+ClusterManager::Options ClusterManager::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.node_id = config.getString("NODE_ID", "");
+    options.listen_address = config.getString("CLUSTER_LISTEN_ADDRESS", options.listen_address);
+    options.listen_port = static_cast<uint16_t>(config.getInt("CLUSTER_PORT", options.listen_port));
+    options.reconnect_interval = std::chrono::milliseconds(
+        config.getInt("CLUSTER_RECONNECT_MS", static_cast<int>(options.reconnect_interval.count())));
+    options.max_pending_frames = static_cast<std::size_t>(
+        config.getInt("CLUSTER_MAX_PENDING", static_cast<int>(options.max_pending_frames)));
+
+    // CLUSTER_PEERS=node2@10.0.0.2:9100,node3@10.0.0.3:9100
+    std::stringstream peers(config.getString("CLUSTER_PEERS", ""));
+    std::string entry;
+    while (std::getline(peers, entry, ',')) {
+        entry = trim(entry);
+        if (entry.empty()) {
+            continue;
+        }
+        NodeInfo peer;
+        if (!NodeInfo::parse(entry, peer)) {
+            CHAT_LOG_WARN("Ignoring malformed cluster peer '{}'", entry);
+            continue;
+        }
+        if (peer.node_id != options.node_id) {
+            options.peers.push_back(std::move(peer));
+        }
+    }
+    return options;
+}
+
+ClusterManager::ClusterManager(boost::asio::io_context& io_context, Options options, DeliveryHandler delivery)
+    : io_context_(io_context),
+      options_(std::move(options)),
+      delivery_(std::move(delivery)),
+      directory_(options_.node_id),
+      acceptor_(io_context),
+      directory_timer_(io_context) {
+}
+
+ClusterManager::~ClusterManager() {
+    stop();
+}
+
+bool ClusterManager::start() {
+    if (!options_.enabled()) {
+        CHAT_LOG_ERROR("Cluster mode requires NODE_ID");
+        return false;
+    }
+    if (running_) {
+        return true;
+    }
+
+    boost::system::error_code ec;
+    auto address = boost::asio::ip::make_address(options_.listen_address, ec);
+    if (ec) {
+        CHAT_LOG_ERROR("Invalid CLUSTER_LISTEN_ADDRESS: {}", options_.listen_address);
+        return false;
+    }
+
+    tcp::endpoint endpoint(address, options_.listen_port);
+    acceptor_.open(endpoint.protocol(), ec);
+    if (!ec) acceptor_.set_option(tcp::acceptor::reuse_address(true), ec);
+    if (!ec) acceptor_.bind(endpoint, ec);
+    if (!ec) acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
+    if (ec) {
+        CHAT_LOG_ERROR("Cluster listener on port {} failed: {}", options_.listen_port, ec.message());
+        acceptor_.close(ec);
+        return false;
+    }
+    listen_port_ = acceptor_.local_endpoint().port();
+
+    running_ = true;
+    doAccept();
+    for (const NodeInfo& peer : options_.peers) {
+        addPeer(peer);
+    }
+
+    CHAT_LOG_INFO("Cluster node {} listening on port {} with {} peers",
+                  options_.node_id, listen_port_, options_.peers.size());
+    return true;
+}
+
+void ClusterManager::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    boost::system::error_code ignored;
+    acceptor_.close(ignored);
+    directory_timer_.cancel();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [node_id, link] : peers_) {
+        link->removed = true;
+        if (link->retry_timer) {
+            link->retry_timer->cancel();
+        }
+        if (link->connection) {
+            link->connection->setErrorCallback(nullptr);
+            link->connection->stop();
+        }
+    }
+    peers_.clear();
+
+    for (auto& [raw, link] : inbound_) {
+        link.connection->setMessageCallback(nullptr);
+        link.connection->setErrorCallback(nullptr);
+        link.connection->stop();
+    }
+    inbound_.clear();
+}
+
+void ClusterManager::addPeer(const NodeInfo& peer) {
+    if (peer.node_id == options_.node_id) {
+        return;
+    }
+
+    auto link = std::make_shared<PeerLink>();
+    link->peer = peer;
+    link->retry_timer = std::make_unique<boost::asio::steady_timer>(io_context_);
+    MembershipCallback membership;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = peers_.find(peer.node_id);
+        if (it == peers_.end() && hasInboundLocked(peer.node_id)) {
+            // It said hello before we knew its address; now it is reachable
+            membership = membership_callback_;
+        } else if (it != peers_.end()) {
+            // Keep frames queued for the old address
+            link->pending.swap(it->second->pending);
+            it->second->removed = true;
+            if (it->second->connection) {
+                it->second->connection->setErrorCallback(nullptr);
+                it->second->connection->stop();
+            }
+        }
+        peers_[peer.node_id] = link;
+    }
+
+    if (running_) {
+        connect(link);
+    }
+    if (membership) {
+        membership(peer.node_id, true);
+    }
+}
+
+void ClusterManager::removePeer(const std::string& node_id) {
+    std::shared_ptr<PeerLink> link;
+    MembershipCallback membership;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = peers_.find(node_id);
+        if (it == peers_.end()) {
+            return;
+        }
+        if (hasInboundLocked(node_id)) {
+            membership = membership_callback_;
+        }
+        link = it->second;
+        peers_.erase(it);
+        link->removed = true;
+        if (link->retry_timer) {
+            link->retry_timer->cancel();
+        }
+        if (link->connection) {
+            link->connection->setErrorCallback(nullptr);
+            link->connection->stop();
+        }
+    }
+    directory_.dropNode(node_id);
+    if (membership) {
+        membership(node_id, false);
+    }
+}
+
+void ClusterManager::setMembershipCallback(MembershipCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    membership_callback_ = std::move(callback);
+}
+
+void ClusterManager::setFrameHandler(uint16_t type, FrameHandler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame_handlers_[type] = std::move(handler);
+}
+
+bool ClusterManager::sendToNode(const std::string& node_id, TcpConnection::SharedBody body,
+                                uint16_t type, uint16_t flags) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sendLocked(node_id, std::move(body), type, flags);
+}
+
+void ClusterManager::connect(const std::shared_ptr<PeerLink>& link) {
+    auto connection = std::make_shared<TcpConnection>(io_context_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (link->removed) {
+            return;
+        }
+        link->connection = connection;
+        link->connected = false;
+    }
+
+    auto resolver = std::make_shared<tcp::resolver>(io_context_);
+    resolver->async_resolve(
+        link->peer.host, std::to_string(link->peer.port),
+        [this, link, connection, resolver](const boost::system::error_code& error,
+                                           const tcp::resolver::results_type& results) {
+            if (error == boost::asio::error::operation_aborted || !running_) {
+                return;
+            }
+            if (error) {
+                CHAT_LOG_WARN("Cannot resolve cluster peer {} ({}): {}",
+                              link->peer.node_id, link->peer.host, error.message());
+                scheduleReconnect(link);
+                return;
+            }
+
+            boost::asio::async_connect(
+                connection->socket(), results,
+                [this, link, connection](const boost::system::error_code& error, const tcp::endpoint&) {
+                    if (error == boost::asio::error::operation_aborted || !running_) {
+                        return;
+                    }
+                    if (error) {
+                        CHAT_LOG_DEBUG("Cluster peer {} unreachable: {}", link->peer.node_id, error.message());
+                        scheduleReconnect(link);
+                        return;
+                    }
+                    onLinkUp(link);
+                });
+        });
+}
+
+void ClusterManager::scheduleReconnect(const std::shared_ptr<PeerLink>& link) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || link->removed) {
+        return;
+    }
+    link->connection.reset();
+    link->connected = false;
+    link->retry_timer->expires_after(options_.reconnect_interval);
+    link->retry_timer->async_wait([this, link](const boost::system::error_code& error) {
+        if (error || !running_ || link->removed) {
+            return;
+        }
+        connect(link);
+    });
+}
+
+void ClusterManager::onLinkUp(const std::shared_ptr<PeerLink>& link) {
+    std::shared_ptr<TcpConnection> connection;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection = link->connection;
+    }
+    if (!connection) {
+        return;
+    }
+
+    boost::system::error_code ignored;
+    connection->socket().set_option(tcp::no_delay(true), ignored);
+
+    std::weak_ptr<TcpConnection> weak_connection = connection;
+    connection->setErrorCallback([this, link, weak_connection](const boost::system::error_code& error) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Both the read and the write side report a dead link; react once
+            if (link->connection != weak_connection.lock()) {
+                return;
+            }
+        }
+        CHAT_LOG_WARN("Cluster link to {} lost: {}", link->peer.node_id, error.message());
+        scheduleReconnect(link);
+    });
+    connection->start();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (link->removed || link->connection != connection) {
+        connection->stop();
+        return;
+    }
+
+    link->connected = true;
+    connection->send(jsonBody({{"node", options_.node_id}}), frameType(chat_app::MessageType::CLUSTER_HELLO));
+    connection->send(buildSnapshot(), frameType(chat_app::MessageType::CLUSTER_DIRECTORY), chat_app::MessageFlags::JSON);
+
+    // Everything queued while the link was down goes out in order
+    while (!link->pending.empty()) {
+        PendingFrame& frame = link->pending.front();
+        connection->send(std::move(frame.body), frame.type, frame.flags);
+        link->pending.pop_front();
+    }
+
+    CHAT_LOG_INFO("Cluster link to {} ({}:{}) established", link->peer.node_id, link->peer.host, link->peer.port);
+}
+
+void ClusterManager::doAccept() {
+    auto connection = std::make_shared<TcpConnection>(io_context_);
+    acceptor_.async_accept(connection->socket(), [this, connection](const boost::system::error_code& error) {
+        if (error == boost::asio::error::operation_aborted || !running_) {
+            return;
+        }
+
+        if (!error) {
+            boost::system::error_code ignored;
+            connection->socket().set_option(tcp::no_delay(true), ignored);
+
+            TcpConnection* raw = connection.get();
+            connection->setMessageCallback([this, raw](const std::vector<char>& body, uint16_t type, uint16_t flags) {
+                onInboundFrame(raw, body, type, flags);
+            });
+            connection->setErrorCallback([this, raw](const boost::system::error_code&) {
+                onInboundClosed(raw);
+            });
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                inbound_[raw] = InboundLink{connection, ""};
+            }
+            connection->start();
+        } else {
+            CHAT_LOG_WARN("Cluster accept failed: {}", error.message());
+        }
+
+        doAccept();
+    });
+}
+
+void ClusterManager::onInboundFrame(TcpConnection* connection, const std::vector<char>& body,
+                                    uint16_t type, uint16_t flags) {
+    std::string node_id;
+    MembershipCallback membership;
+    FrameHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = inbound_.find(connection);
+        if (it == inbound_.end()) {
+            return;
+        }
+
+        auto handler_it = frame_handlers_.find(type);
+        if (handler_it != frame_handlers_.end()) {
+            handler = handler_it->second;
+        }
+
+        if (type == frameType(chat_app::MessageType::CLUSTER_HELLO)) {
+            try {
+                it->second.node_id = nlohmann::json::parse(body.begin(), body.end()).at("node").get<std::string>();
+            } catch (const std::exception& e) {
+                CHAT_LOG_WARN("Malformed cluster hello from {}: {}", connection->getRemoteAddress(), e.what());
+                connection->stop();
+                return;
+            }
+            node_id = it->second.node_id;
+            // Only a peer we can send to counts as up; addPeer() reports
+            // the rest once their address is known
+            if (peers_.count(node_id) != 0) {
+                membership = membership_callback_;
+            }
+        } else {
+            node_id = it->second.node_id;
+        }
+    }
+
+    if (node_id.empty()) {
+        CHAT_LOG_WARN("Cluster frame before hello from {}", connection->getRemoteAddress());
+        return;
+    }
+
+    if (type == frameType(chat_app::MessageType::CLUSTER_HELLO)) {
+        CHAT_LOG_INFO("Cluster peer {} connected", node_id);
+        if (membership) {
+            membership(node_id, true);
+        }
+        return;
+    }
+
+    if (type == frameType(chat_app::MessageType::CLUSTER_DIRECTORY)) {
+        applyDirectoryUpdate(node_id, body);
+        return;
+    }
+
+    if (handler) {
+        handler(node_id, body, flags);
+        return;
+    }
+
+    if (flags & chat_app::MessageFlags::FORWARDED) {
+        try {
+            auto message = chat_app::makeEncodedMessage(chat_app::EncodedMessage::decode(body, flags));
+            received_.fetch_add(1, std::memory_order_relaxed);
+            if (delivery_) {
+                delivery_(message, node_id);
+            }
+        } catch (const std::exception& e) {
+            CHAT_LOG_WARN("Dropping malformed frame forwarded by {}: {}", node_id, e.what());
+        }
+    }
+}
+
+void ClusterManager::onInboundClosed(TcpConnection* connection) {
+    std::string node_id;
+    MembershipCallback membership;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = inbound_.find(connection);
+        if (it == inbound_.end()) {
+            return;
+        }
+        node_id = it->second.node_id;
+        inbound_.erase(it);
+
+        // A reconnected peer may already have a newer inbound link
+        if (hasInboundLocked(node_id)) {
+            return;
+        }
+        if (peers_.count(node_id) != 0) {
+            membership = membership_callback_;
+        }
+    }
+
+    if (node_id.empty()) {
+        return;
+    }
+
+    CHAT_LOG_WARN("Cluster peer {} disconnected", node_id);
+    directory_.dropNode(node_id);
+    if (membership) {
+        membership(node_id, false);
+    }
+}
+
+void ClusterManager::applyDirectoryUpdate(const std::string& node_id, const std::vector<char>& body) {
+    nlohmann::json update;
+    try {
+        update = nlohmann::json::parse(body.begin(), body.end());
+    } catch (const std::exception& e) {
+        CHAT_LOG_WARN("Malformed directory update from {}: {}", node_id, e.what());
+        return;
+    }
+
+    // A snapshot replaces everything previously known about the node
+    if (update.value("reset", false)) {
+        directory_.dropNode(node_id);
+    }
+
+    for (const auto& user : update.value("online", nlohmann::json::array())) {
+        directory_.setUserNode(user.get<std::string>(), node_id);
+    }
+    for (const auto& user : update.value("offline", nlohmann::json::array())) {
+        directory_.removeUser(user.get<std::string>(), node_id);
+    }
+    for (const auto& room : update.value("joined", nlohmann::json::array())) {
+        directory_.addRoomNode(room.get<std::string>(), node_id);
+    }
+    for (const auto& room : update.value("left", nlohmann::json::array())) {
+        directory_.removeRoomNode(room.get<std::string>(), node_id);
+    }
+}
+
+void ClusterManager::userOnline(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (++local_users_[user_id] == 1) {
+        directory_.setUserNode(user_id, options_.node_id);
+        pending_users_[user_id] = true;
+        scheduleDirectoryFlush();
+    }
+}
+
+void ClusterManager::userOffline(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = local_users_.find(user_id);
+    if (it == local_users_.end() || --it->second > 0) {
+        return;
+    }
+    local_users_.erase(it);
+    directory_.removeUser(user_id, options_.node_id);
+    pending_users_[user_id] = false;
+    scheduleDirectoryFlush();
+}
+
+void ClusterManager::roomMemberJoined(const std::string& room_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (++local_room_members_[room_id] == 1) {
+        directory_.addRoomNode(room_id, options_.node_id);
+        pending_rooms_[room_id] = true;
+        scheduleDirectoryFlush();
+    }
+}
+
+void ClusterManager::roomMemberLeft(const std::string& room_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = local_room_members_.find(room_id);
+    if (it == local_room_members_.end() || --it->second > 0) {
+        return;
+    }
+    local_room_members_.erase(it);
+    directory_.removeRoomNode(room_id, options_.node_id);
+    pending_rooms_[room_id] = false;
+    scheduleDirectoryFlush();
+}
+
+void ClusterManager::scheduleDirectoryFlush() {
+    // Called with mutex_ held; changes within one interval share a frame
+    if (directory_flush_scheduled_ || !running_) {
+        return;
+    }
+    directory_flush_scheduled_ = true;
+    directory_timer_.expires_after(options_.directory_flush_interval);
+    directory_timer_.async_wait([this](const boost::system::error_code& error) {
+        if (error) {
+            return;
+        }
+        flushDirectory();
+    });
+}
+
+void ClusterManager::flushDirectory() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_flush_scheduled_ = false;
+    if (pending_users_.empty() && pending_rooms_.empty()) {
+        return;
+    }
+
+    nlohmann::json update = {{"online", nlohmann::json::array()}, {"offline", nlohmann::json::array()},
+                             {"joined", nlohmann::json::array()}, {"left", nlohmann::json::array()}};
+    for (const auto& [user_id, online] : pending_users_) {
+        update[online ? "online" : "offline"].push_back(user_id);
+    }
+    for (const auto& [room_id, joined] : pending_rooms_) {
+        update[joined ? "joined" : "left"].push_back(room_id);
+    }
+    pending_users_.clear();
+    pending_rooms_.clear();
+
+    // Peers that are down get a full snapshot when they reconnect
+    auto body = jsonBody(update);
+    for (auto& [node_id, link] : peers_) {
+        if (link->connected && link->connection) {
+            link->connection->send(body, frameType(chat_app::MessageType::CLUSTER_DIRECTORY),
+                                   chat_app::MessageFlags::JSON);
+        }
+    }
+    directory_updates_.fetch_add(1, std::memory_order_relaxed);
+}
+
+TcpConnection::SharedBody ClusterManager::buildSnapshot() const {
+    nlohmann::json snapshot = {{"reset", true}, {"online", nlohmann::json::array()},
+                               {"joined", nlohmann::json::array()}};
+    for (const auto& entry : local_users_) {
+        snapshot["online"].push_back(entry.first);
+    }
+    for (const auto& entry : local_room_members_) {
+        snapshot["joined"].push_back(entry.first);
+    }
+    return jsonBody(snapshot);
+}
+
+bool ClusterManager::hasInboundLocked(const std::string& node_id) const {
+    for (const auto& entry : inbound_) {
+        if (entry.second.node_id == node_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ClusterManager::sendLocked(const std::string& node_id, TcpConnection::SharedBody body,
+                                uint16_t type, uint16_t flags) {
+    auto it = peers_.find(node_id);
+    if (it == peers_.end()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    PeerLink& link = *it->second;
+    if (link.connected && link.connection && link.connection->send(body, type, flags)) {
+        return true;
+    }
+
+    if (link.pending.size() >= options_.max_pending_frames) {
+        link.pending.pop_front();
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    link.pending.push_back(PendingFrame{std::move(body), type, flags});
+    return true;
+}
+
+bool ClusterManager::forwardDirect(const chat_app::SharedEncodedMessage& message) {
+    const chat_app::ChatMessage& chat_message = message->message();
+    if (!chat_message.recipient_id.has_value()) {
+        return false;
+    }
+
+    auto node_id = directory_.nodeForUser(*chat_message.recipient_id);
+    if (!node_id || *node_id == options_.node_id) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool sent = sendLocked(*node_id, message->binary(), chat_message.message_type,
+                           chat_app::MessageFlags::BINARY | chat_app::MessageFlags::FORWARDED);
+    if (sent) {
+        forwarded_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return sent;
+}
+
+std::size_t ClusterManager::forwardToRoom(const chat_app::SharedEncodedMessage& message) {
+    const chat_app::ChatMessage& chat_message = message->message();
+    if (!chat_message.room_id.has_value()) {
+        return 0;
+    }
+
+    std::vector<std::string> nodes = directory_.nodesForRoom(*chat_message.room_id);
+    if (nodes.empty()) {
+        return 0;
+    }
+
+    // One shared body for every node
+    auto body = message->binary();
+    std::size_t sent = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::string& node_id : nodes) {
+        if (node_id != options_.node_id &&
+            sendLocked(node_id, body, chat_message.message_type,
+                       chat_app::MessageFlags::BINARY | chat_app::MessageFlags::FORWARDED)) {
+            ++sent;
+        }
+    }
+    forwarded_.fetch_add(sent, std::memory_order_relaxed);
+    return sent;
+}
+
+std::vector<std::string> ClusterManager::connectedPeers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> connected;
+    for (const auto& [node_id, link] : peers_) {
+        if (link->connected) {
+            connected.push_back(node_id);
+        }
+    }
+    return connected;
+}
+
+ClusterManager::Stats ClusterManager::stats() const {
+    Stats stats;
+    stats.forwarded = forwarded_.load(std::memory_order_relaxed);
+    stats.received = received_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.directory_updates = directory_updates_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
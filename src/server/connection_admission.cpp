@@ -0,0 +1,380 @@
+#include "server/connection_admission.h"
+#include "common/logger.h"
+#include "common/message.h"
+#include "common/protocol.h"
+#include <algorithm>
+#include <array>
+#include <random>
+#include <nlohmann/json.hpp>
+
+using boost::asio::ip::tcp;
+
+namespace chat {
+
+namespace {
+
+// Refused sockets are kept this long at most while the client reads the reply
+constexpr auto REFUSAL_LINGER = std::chrono::seconds(2);
+// Pause before accepting again after an accept error (e.g. out of descriptors)
+constexpr auto ACCEPT_ERROR_BACKOFF = std::chrono::milliseconds(100);
+constexpr auto MAX_RETRY_HINT = std::chrono::milliseconds(60000);
+
+// A refused connection: the reply is written, our side shut down, and
+// the socket read until the client closes so the reply is not lost to a
+// reset caused by unread request bytes
+struct Refusal {
+    explicit Refusal(tcp::socket s)
+        : socket(std::move(s)), timer(socket.get_executor()) {}
+
+    tcp::socket socket;
+    boost::asio::steady_timer timer;
+    std::array<char, chat_app::HEADER_SIZE> header;
+    std::vector<char> body;
+    std::array<char, 512> scratch;
+};
+
+void drain(const std::shared_ptr<Refusal>& refusal) {
+    refusal->socket.async_read_some(boost::asio::buffer(refusal->scratch),
+        [refusal](const boost::system::error_code& error, std::size_t /*bytes*/) {
+            if (error) {
+                boost::system::error_code ignored;
+                refusal->timer.cancel();
+                refusal->socket.close(ignored);
+                return;
+            }
+            drain(refusal);
+        });
+}
+
+} // namespace
+
+struct ConnectionAdmission::Ticket::Counters {
+    std::atomic<uint64_t> active{0};
+    std::atomic<uint64_t> pending{0};
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> admitted{0};
+    std::atomic<uint64_t> rejected_full{0};
+    std::atomic<uint64_t> rejected_pending{0};
+    std::atomic<uint64_t> authenticated{0};
+    std::atomic<uint64_t> auth_timeouts{0};
+    std::atomic<uint64_t> accept_batches{0};
+    std::atomic<uint64_t> largest_batch{0};
+    std::atomic<int64_t> auth_latency_us{0};  // Admission to authentication (EWMA)
+};
+
+ConnectionAdmission::Options ConnectionAdmission::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.max_connections = static_cast<std::size_t>(std::max(1, config.current().max_connections));
+    options.max_pending_auth = static_cast<std::size_t>(std::max(1,
+        config.getInt("MAX_PENDING_AUTH", static_cast<int>(options.max_pending_auth))));
+    options.accept_batch = static_cast<std::size_t>(std::max(1,
+        config.getInt("ACCEPT_BATCH", static_cast<int>(options.accept_batch))));
+    options.auth_timeout = std::chrono::milliseconds(
+        config.getInt("AUTH_TIMEOUT_MS", static_cast<int>(options.auth_timeout.count())));
+    options.retry_after = std::chrono::milliseconds(
+        config.getInt("ADMISSION_RETRY_MS", static_cast<int>(options.retry_after.count())));
+    return options;
+}
+
+// Ticket
+
+ConnectionAdmission::Ticket::Ticket(std::shared_ptr<Counters> counters, boost::asio::io_context& io_context)
+    : counters_(std::move(counters)),
+      admitted_at_(std::chrono::steady_clock::now()),
+      timer_(io_context) {
+}
+
+ConnectionAdmission::Ticket::~Ticket() {
+    if (isAuthenticated()) {
+        counters_->active.fetch_sub(1, std::memory_order_relaxed);
+    } else {
+        counters_->pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void ConnectionAdmission::Ticket::authenticated() {
+    if (authenticated_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    // Count the new active connection before releasing the pending slot so
+    // admission never sees the connection in neither
+    counters_->active.fetch_add(1, std::memory_order_relaxed);
+    counters_->pending.fetch_sub(1, std::memory_order_relaxed);
+    counters_->authenticated.fetch_add(1, std::memory_order_relaxed);
+
+    // A lost update between racing authentications only skews the average
+    int64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - admitted_at_).count();
+    int64_t average = counters_->auth_latency_us.load(std::memory_order_relaxed);
+    counters_->auth_latency_us.store(average == 0 ? latency : average + (latency - average) / 8,
+                                     std::memory_order_relaxed);
+}
+
+void ConnectionAdmission::Ticket::onAuthTimeout(std::function<void()> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeout_handler_ = std::move(handler);
+}
+
+// ConnectionAdmission
+
+ConnectionAdmission::ConnectionAdmission(boost::asio::io_context& accept_context,
+                                         boost::asio::io_context& socket_context,
+                                         Options options, AdmitHandler handler)
+    : accept_context_(accept_context),
+      socket_context_(socket_context),
+      acceptor_(accept_context),
+      retry_timer_(accept_context),
+      options_(options),
+      handler_(std::move(handler)),
+      counters_(std::make_shared<Ticket::Counters>()) {
+}
+
+ConnectionAdmission::~ConnectionAdmission() {
+    stop();
+}
+
+bool ConnectionAdmission::start(const tcp::endpoint& endpoint) {
+    boost::system::error_code ec;
+    acceptor_.open(endpoint.protocol(), ec);
+    if (!ec) acceptor_.set_option(tcp::acceptor::reuse_address(true), ec);
+    if (!ec) acceptor_.bind(endpoint, ec);
+    if (!ec) acceptor_.listen(boost::asio::socket_base::max_listen_connections, ec);
+    if (!ec) acceptor_.non_blocking(true, ec);
+    if (ec) {
+        CHAT_LOG_ERROR("Listener on port {} failed: {}", endpoint.port(), ec.message());
+        acceptor_.close(ec);
+        return false;
+    }
+
+    running_ = true;
+    asyncAccept();
+    CHAT_LOG_INFO("Accepting clients on port {} (max {} connections, {} pending auth)",
+                  acceptor_.local_endpoint().port(), options_.max_connections, options_.max_pending_auth);
+    return true;
+}
+
+void ConnectionAdmission::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    // The acceptor and retry timer belong to the accept loop; closing them
+    // from another thread would race an accept in progress
+    boost::asio::post(accept_context_, [this]() {
+        boost::system::error_code ignored;
+        acceptor_.close(ignored);
+        retry_timer_.cancel();
+    });
+}
+
+tcp::endpoint ConnectionAdmission::localEndpoint() const {
+    boost::system::error_code ignored;
+    return acceptor_.local_endpoint(ignored);
+}
+
+void ConnectionAdmission::asyncAccept() {
+    // Sockets start on the acceptor's context so refusals never queue
+    // behind the server's work; admitted ones are moved over
+    acceptor_.async_accept(accept_context_, [this](const boost::system::error_code& error, tcp::socket socket) {
+        if (!running_) {
+            return;
+        }
+        if (error) {
+            if (error == boost::asio::error::operation_aborted) {
+                return;
+            }
+            CHAT_LOG_WARN("Accept failed: {}", error.message());
+            retry_timer_.expires_after(ACCEPT_ERROR_BACKOFF);
+            retry_timer_.async_wait([this](const boost::system::error_code& ec) {
+                if (!ec && running_) {
+                    asyncAccept();
+                }
+            });
+            return;
+        }
+
+        handleAccepted(std::move(socket));
+
+        // Drain connections already waiting in the backlog before going
+        // back to the event loop
+        uint64_t batch = 1;
+        while (batch < options_.accept_batch) {
+            boost::system::error_code ec;
+            tcp::socket next = acceptor_.accept(accept_context_, ec);
+            if (ec) {
+                break;  // would_block, or an error the next async accept reports
+            }
+            ++batch;
+            handleAccepted(std::move(next));
+        }
+
+        counters_->accept_batches.fetch_add(1, std::memory_order_relaxed);
+        if (batch > counters_->largest_batch.load(std::memory_order_relaxed)) {
+            counters_->largest_batch.store(batch, std::memory_order_relaxed);
+        }
+        asyncAccept();
+    });
+}
+
+void ConnectionAdmission::handleAccepted(tcp::socket socket) {
+    counters_->accepted.fetch_add(1, std::memory_order_relaxed);
+
+    // Only this thread adds to the counters, so the checks cannot be
+    // overtaken by another admission
+    uint64_t pending = counters_->pending.load(std::memory_order_relaxed);
+    uint64_t active = counters_->active.load(std::memory_order_relaxed);
+    if (active + pending >= options_.max_connections) {
+        counters_->rejected_full.fetch_add(1, std::memory_order_relaxed);
+        reject(socket, true);
+        return;
+    }
+    if (pending >= options_.max_pending_auth) {
+        counters_->rejected_pending.fetch_add(1, std::memory_order_relaxed);
+        reject(socket, false);
+        return;
+    }
+
+    boost::system::error_code ec;
+    tcp::socket admitted(socket_context_);
+    tcp protocol = socket.local_endpoint(ec).protocol();
+    tcp::socket::native_handle_type handle = ec ? -1 : socket.release(ec);
+    if (!ec) {
+        admitted.assign(protocol, handle, ec);
+    }
+    if (ec) {
+        CHAT_LOG_WARN("Dropping accepted connection: {}", ec.message());
+        return;
+    }
+
+    counters_->pending.fetch_add(1, std::memory_order_relaxed);
+    counters_->admitted.fetch_add(1, std::memory_order_relaxed);
+    TicketPtr ticket(new Ticket(counters_, socket_context_));
+
+    // Armed before the handoff: afterwards the ticket belongs to the
+    // session. The handler reads the timeout handler when it fires, so
+    // one installed later is still called.
+    if (options_.auth_timeout.count() > 0) {
+        std::weak_ptr<Ticket> weak_ticket = ticket;
+        auto counters = counters_;
+        ticket->timer_.expires_after(options_.auth_timeout);
+        ticket->timer_.async_wait([weak_ticket, counters](const boost::system::error_code& error) {
+            auto ticket = weak_ticket.lock();
+            if (error || !ticket || ticket->isAuthenticated()) {
+                return;
+            }
+            counters->auth_timeouts.fetch_add(1, std::memory_order_relaxed);
+            std::function<void()> handler;
+            {
+                std::lock_guard<std::mutex> lock(ticket->mutex_);
+                handler = ticket->timeout_handler_;
+            }
+            if (handler) {
+                handler();
+            }
+        });
+    }
+
+    handler_(std::move(admitted), std::move(ticket));
+}
+
+void ConnectionAdmission::reject(tcp::socket& socket, bool full) {
+    auto refusal = std::make_shared<Refusal>(std::move(socket));
+    refusal->body = busyResponse(retryHint(full));
+
+    chat_app::MessageHeader header;
+    header.setMessageType(static_cast<uint16_t>(chat_app::MessageType::AUTH_RESPONSE));
+    header.setFlags(chat_app::MessageFlags::JSON);
+    header.setBodySize(static_cast<uint32_t>(refusal->body.size()));
+    header.encodeToBuffer(refusal->header);
+
+    refusal->timer.expires_after(REFUSAL_LINGER);
+    refusal->timer.async_wait([refusal](const boost::system::error_code& error) {
+        if (!error) {
+            boost::system::error_code ignored;
+            refusal->socket.close(ignored);
+        }
+    });
+
+    std::array<boost::asio::const_buffer, 2> buffers = {
+        boost::asio::buffer(refusal->header),
+        boost::asio::buffer(refusal->body),
+    };
+    boost::asio::async_write(refusal->socket, buffers,
+        [refusal](const boost::system::error_code& error, std::size_t /*bytes*/) {
+            boost::system::error_code ignored;
+            if (error) {
+                refusal->timer.cancel();
+                refusal->socket.close(ignored);
+                return;
+            }
+            refusal->socket.shutdown(tcp::socket::shutdown_send, ignored);
+            drain(refusal);
+        });
+}
+
+std::chrono::milliseconds ConnectionAdmission::retryHint(bool full) {
+    using Millis = std::chrono::duration<double, std::milli>;
+    auto now = std::chrono::steady_clock::now();
+    Millis hint = options_.retry_after;
+    int64_t latency_us = counters_->auth_latency_us.load(std::memory_order_relaxed);
+
+    if (full) {
+        // Slots free up as sessions end, which auth latency says nothing about
+        hint *= 2;
+    } else {
+        // With the queue full, one authentication completes every
+        // latency / max_pending_auth (Little's law). Each refused client
+        // gets the next such slot after the current queue has drained.
+        // Until a latency is known, assume a full queue drains in retry_after.
+        Millis latency = latency_us > 0 ? Millis(static_cast<double>(latency_us) / 1000.0) : hint;
+        Millis per_auth = latency / static_cast<double>(options_.max_pending_auth);
+        auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(per_auth);
+        auto drained = now + step * static_cast<int64_t>(counters_->pending.load(std::memory_order_relaxed));
+        next_retry_slot_ = std::max(next_retry_slot_, drained) + step;
+        hint = std::max(hint, Millis(next_retry_slot_ - now));
+    }
+
+    // Jitter so clients handed nearby slots do not return as one wave
+    thread_local std::minstd_rand random{std::random_device{}()};
+    std::uniform_real_distribution<double> jitter(0.8, 1.2);
+    double hint_ms = std::min(hint.count() * jitter(random), static_cast<double>(MAX_RETRY_HINT.count()));
+    return std::chrono::milliseconds(static_cast<int64_t>(hint_ms));
+}
+
+std::vector<char> ConnectionAdmission::busyResponse(std::chrono::milliseconds retry_after) {
+    nlohmann::json json = {
+        {"success", false},
+        {"error", "server_busy"},
+        {"retry_after_ms", retry_after.count()},
+    };
+    std::string text = json.dump();
+    return std::vector<char>(text.begin(), text.end());
+}
+
+std::optional<std::chrono::milliseconds> ConnectionAdmission::retryAfter(const std::vector<char>& body) {
+    auto json = nlohmann::json::parse(body.begin(), body.end(), nullptr, false);
+    if (json.is_discarded() || !json.is_object()) {
+        return std::nullopt;
+    }
+    auto it = json.find("retry_after_ms");
+    if (it == json.end() || !it->is_number_integer()) {
+        return std::nullopt;
+    }
+    return std::chrono::milliseconds(it->get<int64_t>());
+}
+
+ConnectionAdmission::Stats ConnectionAdmission::stats() const {
+    Stats stats;
+    stats.accepted = counters_->accepted.load(std::memory_order_relaxed);
+    stats.admitted = counters_->admitted.load(std::memory_order_relaxed);
+    stats.rejected_full = counters_->rejected_full.load(std::memory_order_relaxed);
+    stats.rejected_pending = counters_->rejected_pending.load(std::memory_order_relaxed);
+    stats.authenticated = counters_->authenticated.load(std::memory_order_relaxed);
+    stats.auth_timeouts = counters_->auth_timeouts.load(std::memory_order_relaxed);
+    stats.accept_batches = counters_->accept_batches.load(std::memory_order_relaxed);
+    stats.largest_batch = counters_->largest_batch.load(std::memory_order_relaxed);
+    stats.active = counters_->active.load(std::memory_order_relaxed);
+    stats.pending = counters_->pending.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
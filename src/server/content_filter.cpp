@@ -0,0 +1,237 @@
+#include "server/content_filter.h"
+#include "common/logger.h"
+#include <chrono>
+#include <fstream>
+#include <unordered_set>
+#include <utility>
+
+namespace chat {
+
+namespace {
+
+std::string foldCase(const std::string& term) {
+    std::string folded = term;
+    for (char& c : folded) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return folded;
+}
+
+} // namespace
+
+std::shared_ptr<const PatternMatcher> PatternMatcher::compile(const std::vector<std::string>& terms,
+                                                              bool whole_words) {
+    auto matcher = std::make_shared<PatternMatcher>();
+    matcher->whole_words_ = whole_words;
+
+    std::vector<std::string> folded_terms;
+    std::unordered_set<std::string> seen;
+    for (const auto& term : terms) {
+        std::string folded = foldCase(term);
+        if (!folded.empty() && seen.insert(folded).second) {
+            matcher->terms_.push_back(term);
+            folded_terms.push_back(std::move(folded));
+        }
+    }
+
+    // One class per distinct (folded) byte in the terms; class 0 is every
+    // other byte, which can only lead back towards the root
+    uint32_t classes = 1;
+    for (const auto& term : folded_terms) {
+        for (unsigned char byte : term) {
+            if (matcher->byte_class_[byte] == 0) {
+                matcher->byte_class_[byte] = static_cast<uint8_t>(classes++);
+            }
+        }
+    }
+    for (int upper = 'A'; upper <= 'Z'; ++upper) {
+        matcher->byte_class_[upper] = matcher->byte_class_[upper - 'A' + 'a'];
+    }
+    matcher->class_count_ = classes;
+
+    // Trie; 0 is the root and doubles as "no edge" while building
+    std::vector<uint32_t>& next = matcher->next_;
+    std::vector<uint32_t>& output = matcher->output_;
+    next.assign(classes, 0);
+    output.assign(1, NO_OUTPUT);
+    for (uint32_t t = 0; t < folded_terms.size(); ++t) {
+        uint32_t state = 0;
+        for (unsigned char byte : folded_terms[t]) {
+            std::size_t edge = state * classes + matcher->byte_class_[byte];
+            if (next[edge] == 0) {
+                next[edge] = static_cast<uint32_t>(output.size());
+                output.push_back(NO_OUTPUT);
+                next.resize(next.size() + classes, 0);
+            }
+            state = next[edge];
+        }
+        output[state] = t;
+    }
+
+    // Breadth first: failure links, output links, and the missing edges
+    // filled in from the failure state so the table is a complete DFA
+    std::vector<uint32_t> failure(output.size(), 0);
+    std::vector<uint32_t>& suffix = matcher->suffix_;
+    suffix.assign(output.size(), 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(output.size());
+    for (uint32_t c = 0; c < classes; ++c) {
+        if (next[c] != 0) {
+            queue.push_back(next[c]);
+        }
+    }
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        uint32_t state = queue[head];
+        for (uint32_t c = 0; c < classes; ++c) {
+            uint32_t& edge = next[state * classes + c];
+            uint32_t fallback = next[failure[state] * classes + c];
+            if (edge == 0) {
+                edge = fallback;
+                continue;
+            }
+            failure[edge] = fallback;
+            suffix[edge] = output[fallback] != NO_OUTPUT ? fallback : suffix[fallback];
+            queue.push_back(edge);
+        }
+    }
+
+    matcher->accepts_.resize(output.size());
+    for (std::size_t s = 0; s < output.size(); ++s) {
+        matcher->accepts_[s] = output[s] != NO_OUTPUT || suffix[s] != 0;
+    }
+    return matcher;
+}
+
+bool PatternMatcher::atBoundary(std::string_view text, std::size_t offset, std::size_t length) const {
+    auto byte = [&text](std::size_t i) { return static_cast<unsigned char>(text[i]); };
+    std::size_t end = offset + length;
+    if (offset > 0 && isWordByte(byte(offset)) && isWordByte(byte(offset - 1))) {
+        return false;
+    }
+    return !(end < text.size() && isWordByte(byte(end - 1)) && isWordByte(byte(end)));
+}
+
+ContentFilter::Options ContentFilter::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.blocklist_path = config.getString("CONTENT_FILTER_FILE", options.blocklist_path);
+    options.whole_words = config.getBool("CONTENT_FILTER_WHOLE_WORDS", options.whole_words);
+    std::string action = config.getString("CONTENT_FILTER_ACTION", "reject");
+    if (action == "mask") {
+        options.action = Action::MASK;
+    } else if (action != "reject") {
+        CHAT_LOG_WARN("Unknown CONTENT_FILTER_ACTION '{}', using reject", action);
+    }
+    return options;
+}
+
+ContentFilter::ContentFilter(Options options) : options_(std::move(options)) {
+}
+
+ContentFilter::~ContentFilter() {
+    stop();
+}
+
+std::vector<std::string> ContentFilter::readBlocklist(std::istream& in) {
+    std::vector<std::string> terms;
+    std::string line;
+    while (std::getline(in, line)) {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        auto last = line.find_last_not_of(" \t\r");
+        terms.push_back(line.substr(first, last - first + 1));
+    }
+    return terms;
+}
+
+bool ContentFilter::load() {
+    if (options_.blocklist_path.empty()) {
+        return true;
+    }
+    std::ifstream in(options_.blocklist_path);
+    if (!in) {
+        reload_failures_.fetch_add(1, std::memory_order_relaxed);
+        CHAT_LOG_WARN("Cannot read blocklist {}, keeping the current one", options_.blocklist_path);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto matcher = PatternMatcher::compile(readBlocklist(in), options_.whole_words);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::atomic_store(&matcher_, matcher);
+    reloads_.fetch_add(1, std::memory_order_relaxed);
+    CHAT_LOG_INFO("Loaded blocklist {}: {} terms, {} states in {} ms", options_.blocklist_path,
+                  matcher->terms().size(), matcher->stateCount(), elapsed.count());
+    return true;
+}
+
+bool ContentFilter::watch() {
+    if (options_.blocklist_path.empty() || watcher_) {
+        return static_cast<bool>(watcher_);
+    }
+    watcher_ = std::make_unique<ConfigWatcher>(options_.blocklist_path, [this]() { return load(); });
+    if (!watcher_->start()) {
+        watcher_.reset();
+        return false;
+    }
+    return true;
+}
+
+void ContentFilter::stop() {
+    if (watcher_) {
+        watcher_->stop();
+        watcher_.reset();
+    }
+}
+
+ContentFilter::Verdict ContentFilter::filter(chat_app::ChatMessage& message) const {
+    checked_.fetch_add(1, std::memory_order_relaxed);
+    auto matcher = std::atomic_load(&matcher_);
+    if (!matcher) {
+        return Verdict::PASS;
+    }
+
+    if (options_.action == Action::REJECT) {
+        if (!matcher->contains(message.content)) {
+            return Verdict::PASS;
+        }
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return Verdict::REJECTED;
+    }
+
+    // Collect first: masking during the scan would change the word
+    // boundaries seen by later matches
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    matcher->scan(message.content, [&ranges](const PatternMatcher::Match& match) {
+        ranges.emplace_back(match.offset, match.length);
+        return true;
+    });
+    if (ranges.empty()) {
+        return Verdict::PASS;
+    }
+    for (const auto& [offset, length] : ranges) {
+        message.content.replace(offset, length, length, '*');
+    }
+    masked_.fetch_add(1, std::memory_order_relaxed);
+    return Verdict::MASKED;
+}
+
+std::size_t ContentFilter::termCount() const {
+    auto matcher = std::atomic_load(&matcher_);
+    return matcher ? matcher->terms().size() : 0;
+}
+
+ContentFilter::Stats ContentFilter::stats() const {
+    Stats stats;
+    stats.checked = checked_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.masked = masked_.load(std::memory_order_relaxed);
+    stats.reloads = reloads_.load(std::memory_order_relaxed);
+    stats.reload_failures = reload_failures_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
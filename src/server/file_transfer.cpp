@@ -0,0 +1,448 @@
+#include "server/file_transfer.h"
+#include "common/logger.h"
+#include "common/message.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+#ifdef WITH_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace chat {
+
+namespace {
+
+constexpr uint16_t FILE_TRANSFER = static_cast<uint16_t>(chat_app::MessageType::FILE_TRANSFER);
+constexpr std::size_t UPLOAD_ID_SIZE = 16;
+constexpr std::size_t FILE_ID_LENGTH = 64;
+// Read size when re-hashing the part file of a resumed upload
+constexpr std::size_t REHASH_CHUNK = 64 * 1024;
+
+std::string toHex(const unsigned char* data, std::size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(size * 2);
+    for (std::size_t i = 0; i < size; ++i) {
+        hex.push_back(digits[data[i] >> 4]);
+        hex.push_back(digits[data[i] & 0x0F]);
+    }
+    return hex;
+}
+
+// Ids become file names; anything but lowercase hex of the right length is refused
+bool isHexId(const std::string& id, std::size_t length) {
+    return id.size() == length &&
+           std::all_of(id.begin(), id.end(), [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+}
+
+std::string newUploadId() {
+    std::random_device device;
+    std::array<unsigned char, UPLOAD_ID_SIZE> bytes;
+    for (auto& byte : bytes) {
+        byte = static_cast<unsigned char>(device());
+    }
+    return toHex(bytes.data(), bytes.size());
+}
+
+bool writeAll(int fd, uint64_t offset, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t count = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        offset += static_cast<uint64_t>(count);
+        size -= static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+void reply(chat_app::TcpConnection& connection, const nlohmann::json& message) {
+    std::string text = message.dump();
+    connection.send(std::vector<char>(text.begin(), text.end()), FILE_TRANSFER, chat_app::MessageFlags::JSON);
+}
+
+void replyError(chat_app::TcpConnection& connection, const std::string& error) {
+    reply(connection, {{"op", "error"}, {"error", error}});
+}
+
+} // namespace
+
+// Incremental SHA-256 of the bytes received so far
+struct FileStore::Upload::Hash {
+#ifdef WITH_OPENSSL
+    Hash() : context(EVP_MD_CTX_new()) {
+        EVP_DigestInit_ex(context, EVP_sha256(), nullptr);
+    }
+    ~Hash() { EVP_MD_CTX_free(context); }
+
+    void update(const char* data, std::size_t size) { EVP_DigestUpdate(context, data, size); }
+
+    std::string finish() {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(context, digest, &length);
+        return toHex(digest, length);
+    }
+
+    EVP_MD_CTX* context;
+#else
+    void update(const char* /*data*/, std::size_t /*size*/) {}
+    std::string finish() { return std::string(); }
+#endif
+};
+
+// Upload
+
+FileStore::Upload::Upload(FileStore& store, std::string id, uint64_t size, int fd)
+    : store_(store), id_(std::move(id)), size_(size), fd_(fd), hash_(std::make_unique<Hash>()) {
+}
+
+FileStore::Upload::~Upload() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    store_.release(id_);
+}
+
+// FileStore
+
+FileStore::Options FileStore::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.directory = config.getString("FILE_STORE_DIR", options.directory);
+    options.max_file_size = static_cast<uint64_t>(std::max(1,
+        config.getInt("FILE_MAX_SIZE_MB", static_cast<int>(options.max_file_size >> 20)))) << 20;
+    return options;
+}
+
+FileStore::FileStore(Options options) : options_(std::move(options)) {
+}
+
+FileStore::~FileStore() = default;
+
+bool FileStore::open() {
+    std::error_code error;
+    fs::create_directories(fs::path(options_.directory) / "objects", error);
+    if (!error) {
+        fs::create_directories(fs::path(options_.directory) / "uploads", error);
+    }
+    if (error) {
+        CHAT_LOG_ERROR("Cannot create file store {}: {}", options_.directory, error.message());
+        return false;
+    }
+#ifndef WITH_OPENSSL
+    CHAT_LOG_WARN("File store needs OpenSSL for SHA-256; uploads will fail");
+#endif
+    return true;
+}
+
+std::shared_ptr<FileStore::Upload> FileStore::beginUpload(uint64_t size) {
+    if (size == 0 || size > options_.max_file_size) {
+        return nullptr;
+    }
+    std::string id = newUploadId();
+    int fd = ::open(partPath(id).c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        CHAT_LOG_ERROR("Cannot create upload {}: {}", partPath(id), std::strerror(errno));
+        return nullptr;
+    }
+    std::shared_ptr<Upload> upload(new Upload(*this, id, size, fd));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_[id] = upload.get();
+    }
+    uploads_started_.fetch_add(1, std::memory_order_relaxed);
+    return upload;
+}
+
+std::shared_ptr<FileStore::Upload> FileStore::resumeUpload(const std::string& upload_id, uint64_t size) {
+    if (!isHexId(upload_id, UPLOAD_ID_SIZE * 2) || size == 0 || size > options_.max_file_size) {
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (active_.count(upload_id)) {
+            return nullptr;
+        }
+        // Claimed before the part file is read so a second resume fails
+        active_[upload_id] = nullptr;
+    }
+    int fd = ::open(partPath(upload_id).c_str(), O_RDWR | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) > size) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        release(upload_id);
+        return nullptr;
+    }
+    std::shared_ptr<Upload> upload(new Upload(*this, upload_id, size, fd));
+
+    // The hash state is not persisted; rebuild it from what is on disk
+    std::vector<char> buffer(REHASH_CHUNK);
+    uint64_t received = static_cast<uint64_t>(info.st_size);
+    while (upload->offset_ < received) {
+        std::size_t count = static_cast<std::size_t>(std::min<uint64_t>(buffer.size(), received - upload->offset_));
+        ssize_t read = ::pread(fd, buffer.data(), count, static_cast<off_t>(upload->offset_));
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return nullptr;
+        }
+        upload->hash_->update(buffer.data(), static_cast<std::size_t>(read));
+        upload->offset_ += static_cast<uint64_t>(read);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_[upload_id] = upload.get();
+    }
+    uploads_resumed_.fetch_add(1, std::memory_order_relaxed);
+    return upload;
+}
+
+bool FileStore::write(Upload& upload, uint64_t offset, const char* data, std::size_t size) {
+    if (upload.fd_ < 0 || offset != upload.offset_ || size > upload.size_ - upload.offset_) {
+        return false;
+    }
+    if (!writeAll(upload.fd_, offset, data, size)) {
+        CHAT_LOG_ERROR("Write to upload {} failed: {}", upload.id_, std::strerror(errno));
+        return false;
+    }
+    upload.hash_->update(data, size);
+    upload.offset_ += size;
+    bytes_received_.fetch_add(size, std::memory_order_relaxed);
+    return true;
+}
+
+std::optional<FileStore::FileInfo> FileStore::finishUpload(Upload& upload) {
+    if (upload.fd_ < 0 || !upload.isComplete()) {
+        return std::nullopt;
+    }
+    FileInfo info;
+    info.file_id = upload.hash_->finish();
+    info.size = upload.size_;
+    bool synced = ::fdatasync(upload.fd_) == 0;
+    ::close(upload.fd_);
+    upload.fd_ = -1;
+    if (!isHexId(info.file_id, FILE_ID_LENGTH) || !synced) {
+        CHAT_LOG_ERROR("Cannot finish upload {}", upload.id_);
+        return std::nullopt;
+    }
+
+    std::error_code error;
+    std::string part = partPath(upload.id_);
+    std::string object = objectPath(info.file_id);
+    if (fs::exists(object, error)) {
+        fs::remove(part, error);
+        info.deduplicated = true;
+        deduplicated_.fetch_add(1, std::memory_order_relaxed);
+        bytes_deduplicated_.fetch_add(info.size, std::memory_order_relaxed);
+    } else {
+        fs::rename(part, object, error);
+        if (error) {
+            CHAT_LOG_ERROR("Cannot store upload {} as {}: {}", upload.id_, object, error.message());
+            return std::nullopt;
+        }
+    }
+    uploads_completed_.fetch_add(1, std::memory_order_relaxed);
+    return info;
+}
+
+std::optional<FileStore::FileInfo> FileStore::find(const std::string& file_id) const {
+    if (!isHexId(file_id, FILE_ID_LENGTH)) {
+        return std::nullopt;
+    }
+    std::error_code error;
+    auto size = fs::file_size(objectPath(file_id), error);
+    if (error) {
+        return std::nullopt;
+    }
+    return FileInfo{file_id, static_cast<uint64_t>(size)};
+}
+
+std::shared_ptr<const chat_app::SharedFile> FileStore::openFile(const std::string& file_id) const {
+    if (!isHexId(file_id, FILE_ID_LENGTH)) {
+        return nullptr;
+    }
+    return chat_app::SharedFile::open(objectPath(file_id));
+}
+
+FileStore::Stats FileStore::stats() const {
+    Stats stats;
+    stats.uploads_started = uploads_started_.load(std::memory_order_relaxed);
+    stats.uploads_resumed = uploads_resumed_.load(std::memory_order_relaxed);
+    stats.uploads_completed = uploads_completed_.load(std::memory_order_relaxed);
+    stats.deduplicated = deduplicated_.load(std::memory_order_relaxed);
+    stats.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+    stats.bytes_deduplicated = bytes_deduplicated_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string FileStore::objectPath(const std::string& file_id) const {
+    return (fs::path(options_.directory) / "objects" / file_id).string();
+}
+
+std::string FileStore::partPath(const std::string& upload_id) const {
+    return (fs::path(options_.directory) / "uploads" / (upload_id + ".part")).string();
+}
+
+void FileStore::release(const std::string& upload_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_.erase(upload_id);
+}
+
+// FileTransferService
+
+FileTransferService::FileTransferService(FileStore& store, uint32_t chunk_size)
+    : store_(store),
+      chunk_size_(std::clamp<uint32_t>(chunk_size, 1, chat_app::MAX_BODY_SIZE - DATA_PREFIX_SIZE)) {
+}
+
+void FileTransferService::handleFrame(chat_app::TcpConnection& connection, Transfer& transfer,
+                                      const std::vector<char>& body, uint16_t flags) {
+    if (!(flags & chat_app::MessageFlags::JSON)) {
+        handleData(connection, transfer, body);
+        return;
+    }
+    auto request = nlohmann::json::parse(body.begin(), body.end(), nullptr, false);
+    if (!request.is_object() || !request.contains("op") || !request["op"].is_string()) {
+        replyError(connection, "invalid request");
+        return;
+    }
+    try {
+        std::string op = request["op"];
+        if (op == "upload") {
+            handleUpload(connection, transfer, request);
+        } else if (op == "download") {
+            handleDownload(connection, request);
+        } else {
+            replyError(connection, "unknown op " + op);
+        }
+    } catch (const nlohmann::json::exception&) {
+        replyError(connection, "invalid request");
+    }
+}
+
+std::vector<char> FileTransferService::encodeDataPrefix(uint64_t offset) {
+    std::vector<char> prefix(DATA_PREFIX_SIZE);
+    for (std::size_t i = 0; i < DATA_PREFIX_SIZE; ++i) {
+        prefix[i] = static_cast<char>(offset >> (8 * (DATA_PREFIX_SIZE - 1 - i)));
+    }
+    return prefix;
+}
+
+std::optional<uint64_t> FileTransferService::decodeDataPrefix(const std::vector<char>& body) {
+    if (body.size() < DATA_PREFIX_SIZE) {
+        return std::nullopt;
+    }
+    uint64_t offset = 0;
+    for (std::size_t i = 0; i < DATA_PREFIX_SIZE; ++i) {
+        offset = (offset << 8) | static_cast<unsigned char>(body[i]);
+    }
+    return offset;
+}
+
+void FileTransferService::handleUpload(chat_app::TcpConnection& connection, Transfer& transfer,
+                                       const nlohmann::json& request) {
+    uint64_t size = request.at("size").get<uint64_t>();
+
+    // The hash is the download id, so a client that knows it gains nothing
+    // by skipping the upload
+    if (request.contains("sha256")) {
+        auto existing = store_.find(request["sha256"].get<std::string>());
+        if (existing && existing->size == size) {
+            transfer.upload.reset();
+            reply(connection, {{"op", "upload_complete"}, {"file_id", existing->file_id},
+                               {"size", existing->size}, {"deduplicated", true}});
+            return;
+        }
+    }
+
+    transfer.upload.reset();
+    transfer.upload = request.contains("upload_id")
+        ? store_.resumeUpload(request["upload_id"].get<std::string>(), size)
+        : store_.beginUpload(size);
+    if (!transfer.upload) {
+        replyError(connection, "upload refused");
+        return;
+    }
+    reply(connection, {{"op", "upload_ready"}, {"upload_id", transfer.upload->id()},
+                       {"offset", transfer.upload->offset()}});
+    if (transfer.upload->isComplete()) {
+        // Every byte arrived before the connection dropped
+        handleData(connection, transfer, encodeDataPrefix(transfer.upload->offset()));
+    }
+}
+
+void FileTransferService::handleDownload(chat_app::TcpConnection& connection, const nlohmann::json& request) {
+    std::string file_id = request.at("file_id").get<std::string>();
+    auto file = store_.openFile(file_id);
+    if (!file) {
+        replyError(connection, "unknown file");
+        return;
+    }
+    uint64_t offset = request.value("offset", uint64_t(0));
+    if (offset > file->size()) {
+        replyError(connection, "offset past end of file");
+        return;
+    }
+    uint64_t length = std::min(request.value("length", file->size() - offset), file->size() - offset);
+    reply(connection, {{"op", "download_ready"}, {"file_id", file_id}, {"size", file->size()},
+                       {"offset", offset}, {"length", length}});
+
+    uint64_t end = offset + length;
+    while (offset < end) {
+        uint32_t chunk = static_cast<uint32_t>(std::min<uint64_t>(chunk_size_, end - offset));
+        uint16_t flags = chat_app::MessageFlags::BINARY | chat_app::MessageFlags::FRAGMENT;
+        if (offset + chunk == end) {
+            flags |= chat_app::MessageFlags::LAST_FRAG;
+        }
+        if (!connection.sendFile(encodeDataPrefix(offset), file, offset, chunk, FILE_TRANSFER, flags)) {
+            return;
+        }
+        offset += chunk;
+    }
+}
+
+void FileTransferService::handleData(chat_app::TcpConnection& connection, Transfer& transfer,
+                                     const std::vector<char>& body) {
+    auto offset = decodeDataPrefix(body);
+    if (!transfer.upload || !offset) {
+        replyError(connection, "no upload in progress");
+        return;
+    }
+    FileStore::Upload& upload = *transfer.upload;
+    if (!store_.write(upload, *offset, body.data() + DATA_PREFIX_SIZE, body.size() - DATA_PREFIX_SIZE)) {
+        // The client resumes from the offset in the next upload_ready
+        replyError(connection, "expected offset " + std::to_string(upload.offset()));
+        transfer.upload.reset();
+        return;
+    }
+    if (!upload.isComplete()) {
+        return;
+    }
+    auto info = store_.finishUpload(upload);
+    transfer.upload.reset();
+    if (!info) {
+        replyError(connection, "upload failed");
+        return;
+    }
+    reply(connection, {{"op", "upload_complete"}, {"file_id", info->file_id}, {"size", info->size},
+                       {"deduplicated", info->deduplicated}});
+}
+
+} // namespace chat
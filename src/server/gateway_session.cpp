@@ -0,0 +1,356 @@
+#include "server/gateway_session.h"
+#include "common/logger.h"
+#include "common/message.h"
+#include "server/frame_helpers.h"
+#include <algorithm>
+#include <limits>
+#include <nlohmann/json.hpp>
+
+namespace chat {
+
+namespace {
+
+// Stream id of a control body, 0 if missing or out of range
+uint32_t streamOf(const nlohmann::json& json) {
+    auto stream = json.find("stream");
+    if (stream == json.end() || !stream->is_number_unsigned() ||
+        stream->get<uint64_t>() > std::numeric_limits<uint32_t>::max()) {
+        return 0;
+    }
+    return static_cast<uint32_t>(stream->get<uint64_t>());
+}
+
+nlohmann::json parseObject(const std::vector<char>& body) {
+    auto json = nlohmann::json::parse(body.begin(), body.end(), nullptr, false);
+    return json.is_object() ? json : nlohmann::json();
+}
+
+} // namespace
+
+GatewaySession::Options GatewaySession::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.max_streams = static_cast<std::size_t>(std::max(1,
+        config.getInt("GATEWAY_MAX_STREAMS", static_cast<int>(options.max_streams))));
+    options.initial_credit = static_cast<uint32_t>(std::max(1,
+        config.getInt("GATEWAY_STREAM_CREDIT", static_cast<int>(options.initial_credit))));
+    options.max_queued = static_cast<std::size_t>(std::max(0,
+        config.getInt("GATEWAY_STREAM_QUEUE", static_cast<int>(options.max_queued))));
+    return options;
+}
+
+GatewaySession::GatewaySession(std::string gateway_id, Options options, FrameSink sink, FrameHandler handler,
+                               StreamAuthorizer authorize, StreamCallback on_stream)
+    : gateway_id_(std::move(gateway_id)),
+      options_(options),
+      sink_(std::move(sink)),
+      handler_(std::move(handler)),
+      authorize_(std::move(authorize)),
+      on_stream_(std::move(on_stream)) {
+}
+
+void GatewaySession::handleFrame(const std::vector<char>& body, uint16_t type, uint16_t flags) {
+    if (!(flags & chat_app::MessageFlags::MULTIPLEXED)) {
+        switch (type) {
+            case frameType(chat_app::MessageType::STREAM_OPEN):
+                openStream(body);
+                return;
+            case frameType(chat_app::MessageType::STREAM_CLOSE):
+                closeStream(body);
+                return;
+            case frameType(chat_app::MessageType::STREAM_CREDIT):
+                addCredit(body);
+                return;
+            default:
+                // A gateway only speaks for its streams
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                return;
+        }
+    }
+
+    chat_app::StreamExtension extension;
+    auto offset = chat_app::StreamExtension::decode(body, extension);
+    std::string user_id;
+    if (offset && extension.streams.size() == 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto stream = streams_.find(extension.streams[0]);
+        if (stream != streams_.end()) {
+            user_id = stream->second.user_id;
+        }
+    }
+    if (user_id.empty()) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        CHAT_LOG_DEBUG("Gateway {} sent a frame for no open stream", gateway_id_);
+        return;
+    }
+
+    frames_in_.fetch_add(1, std::memory_order_relaxed);
+    if (handler_) {
+        std::vector<char> payload(body.begin() + static_cast<std::ptrdiff_t>(*offset), body.end());
+        handler_(user_id, payload, type, static_cast<uint16_t>(flags & ~chat_app::MessageFlags::MULTIPLEXED));
+    }
+}
+
+std::size_t GatewaySession::deliver(const std::vector<std::string>& user_ids,
+                                    chat_app::TcpConnection::SharedBody body, uint16_t type, uint16_t flags,
+                                    std::vector<std::string>* missing) {
+    Pending frame{std::move(body), type, flags};
+    std::vector<uint32_t> ready;
+    std::size_t matched = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& user_id : user_ids) {
+        auto id = stream_of_user_.find(user_id);
+        if (id == stream_of_user_.end()) {
+            if (missing) {
+                missing->push_back(user_id);
+            }
+            continue;
+        }
+        ++matched;
+        Stream& stream = streams_[id->second];
+        // Queued frames go first, so a stream never sees them reordered
+        if (stream.queue.empty() && stream.credit > 0) {
+            --stream.credit;
+            ready.push_back(id->second);
+            continue;
+        }
+        queued_.fetch_add(1, std::memory_order_relaxed);
+        stream.queue.push_back(frame);
+        if (stream.queue.size() > options_.max_queued) {
+            stream.queue.pop_front();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!ready.empty()) {
+        sendLocked(ready, frame);
+    }
+    return matched;
+}
+
+void GatewaySession::close() {
+    std::vector<std::string> users;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [user_id, stream] : stream_of_user_) {
+            users.push_back(user_id);
+        }
+        streams_.clear();
+        stream_of_user_.clear();
+    }
+    if (on_stream_) {
+        for (const auto& user_id : users) {
+            on_stream_(user_id, false);
+        }
+    }
+}
+
+bool GatewaySession::hasUser(const std::string& user_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stream_of_user_.count(user_id) > 0;
+}
+
+std::vector<std::string> GatewaySession::users() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> users;
+    users.reserve(stream_of_user_.size());
+    for (const auto& [user_id, stream] : stream_of_user_) {
+        users.push_back(user_id);
+    }
+    return users;
+}
+
+GatewaySession::Stats GatewaySession::stats() const {
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.streams = streams_.size();
+    }
+    stats.frames_in = frames_in_.load(std::memory_order_relaxed);
+    stats.frames_out = frames_out_.load(std::memory_order_relaxed);
+    stats.deliveries = deliveries_.load(std::memory_order_relaxed);
+    stats.queued = queued_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void GatewaySession::openStream(const std::vector<char>& body) {
+    nlohmann::json request = parseObject(body);
+    uint32_t stream_id = request.is_object() ? streamOf(request) : 0;
+    std::string user_id = request.is_object() ? request.value("user_id", std::string()) : std::string();
+
+    std::string error;
+    if (stream_id == 0 || user_id.empty()) {
+        error = "malformed";
+    } else if (authorize_ && !authorize_(user_id)) {
+        error = "not allowed";
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (streams_.count(stream_id) > 0 || stream_of_user_.count(user_id) > 0) {
+            error = "already open";
+        } else if (streams_.size() >= options_.max_streams) {
+            error = "too many streams";
+        } else {
+            Stream& stream = streams_[stream_id];
+            stream.user_id = user_id;
+            stream.credit = options_.initial_credit;
+            stream_of_user_[user_id] = stream_id;
+        }
+    }
+
+    nlohmann::json response = {{"stream", stream_id}, {"user_id", user_id}, {"ok", error.empty()}};
+    if (error.empty()) {
+        response["credit"] = options_.initial_credit;
+    } else {
+        response["error"] = error;
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        CHAT_LOG_WARN("Gateway {} stream for '{}' refused: {}", gateway_id_, user_id, error);
+    }
+    reply(frameType(chat_app::MessageType::STREAM_OPEN), response.dump());
+
+    if (error.empty() && on_stream_) {
+        on_stream_(user_id, true);
+    }
+}
+
+void GatewaySession::closeStream(const std::vector<char>& body) {
+    nlohmann::json request = parseObject(body);
+    uint32_t stream_id = request.is_object() ? streamOf(request) : 0;
+
+    std::string user_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto stream = streams_.find(stream_id);
+        if (stream == streams_.end()) {
+            return;
+        }
+        user_id = std::move(stream->second.user_id);
+        stream_of_user_.erase(user_id);
+        streams_.erase(stream);
+    }
+    if (on_stream_) {
+        on_stream_(user_id, false);
+    }
+}
+
+void GatewaySession::addCredit(const std::vector<char>& body) {
+    nlohmann::json request = parseObject(body);
+    uint32_t stream_id = request.is_object() ? streamOf(request) : 0;
+    auto credit = request.is_object() ? request.find("credit") : request.end();
+    if (stream_id == 0 || credit == request.end() || !credit->is_number_unsigned()) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        return;
+    }
+    Stream& stream = it->second;
+    stream.credit = static_cast<uint32_t>(std::min<uint64_t>(
+        uint64_t(stream.credit) + credit->get<uint64_t>(), std::numeric_limits<uint32_t>::max()));
+
+    // Send what waited for credit, in order
+    std::vector<uint32_t> single{stream_id};
+    while (stream.credit > 0 && !stream.queue.empty()) {
+        --stream.credit;
+        sendLocked(single, stream.queue.front());
+        stream.queue.pop_front();
+    }
+}
+
+void GatewaySession::sendLocked(const std::vector<uint32_t>& streams, const Pending& frame) {
+    static const std::vector<char> empty;
+    const std::vector<char>& payload = frame.body ? *frame.body : empty;
+    std::size_t capacity = chat_app::StreamExtension::capacity(payload.size());
+    if (capacity == 0) {
+        dropped_.fetch_add(streams.size(), std::memory_order_relaxed);
+        return;
+    }
+
+    uint16_t flags = static_cast<uint16_t>(frame.flags | chat_app::MessageFlags::MULTIPLEXED);
+    for (std::size_t begin = 0; begin < streams.size(); begin += capacity) {
+        std::size_t end = std::min(streams.size(), begin + capacity);
+        chat_app::StreamExtension extension;
+        extension.streams.assign(streams.begin() + static_cast<std::ptrdiff_t>(begin),
+                                 streams.begin() + static_cast<std::ptrdiff_t>(end));
+        auto body = std::make_shared<const std::vector<char>>(extension.encode(payload.data(), payload.size()));
+        if (sink_(std::move(body), frame.type, flags)) {
+            frames_out_.fetch_add(1, std::memory_order_relaxed);
+            deliveries_.fetch_add(end - begin, std::memory_order_relaxed);
+        } else {
+            dropped_.fetch_add(end - begin, std::memory_order_relaxed);
+        }
+    }
+}
+
+void GatewaySession::reply(uint16_t type, const std::string& json) {
+    sink_(std::make_shared<const std::vector<char>>(json.begin(), json.end()), type,
+          chat_app::MessageFlags::JSON);
+}
+
+void GatewayRegistry::streamChanged(const std::shared_ptr<GatewaySession>& session,
+                                    const std::string& user_id, bool open) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open) {
+        users_[user_id] = session;
+        return;
+    }
+    auto it = users_.find(user_id);
+    if (it != users_.end() && it->second.lock() == session) {
+        users_.erase(it);
+    }
+}
+
+void GatewayRegistry::remove(const std::shared_ptr<GatewaySession>& session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = users_.begin(); it != users_.end();) {
+        auto owner = it->second.lock();
+        if (!owner || owner == session) {
+            it = users_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<GatewaySession> GatewayRegistry::find(const std::string& user_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = users_.find(user_id);
+    return it == users_.end() ? nullptr : it->second.lock();
+}
+
+std::vector<std::string> GatewayRegistry::fanOut(const std::vector<std::string>& recipients,
+                                                 chat_app::TcpConnection::SharedBody body,
+                                                 uint16_t type, uint16_t flags) const {
+    std::vector<std::string> direct;
+    std::vector<std::pair<std::shared_ptr<GatewaySession>, std::vector<std::string>>> batches;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& user_id : recipients) {
+            auto it = users_.find(user_id);
+            auto session = it == users_.end() ? nullptr : it->second.lock();
+            if (!session) {
+                direct.push_back(user_id);
+                continue;
+            }
+            // A handful of gateways at most; a linear search beats hashing
+            auto batch = std::find_if(batches.begin(), batches.end(),
+                                      [&session](const auto& entry) { return entry.first == session; });
+            if (batch == batches.end()) {
+                batches.emplace_back(session, std::vector<std::string>());
+                batch = batches.end() - 1;
+            }
+            batch->second.push_back(user_id);
+        }
+    }
+    // A stream can close between the lookup and the batch; those users
+    // fall back to normal delivery too
+    for (const auto& [session, users] : batches) {
+        session->deliver(users, body, type, flags, &direct);
+    }
+    return direct;
+}
+
+} // namespace chat
@@ -0,0 +1,82 @@
+#include "server/hash_ring.h"
+#include <algorithm>
+
+namespace chat {
+
+namespace {
+
+const std::string EMPTY_NODE;
+
+} // namespace
+
+HashRing::HashRing(std::size_t virtual_nodes)
+    : virtual_nodes_(std::max<std::size_t>(virtual_nodes, 1)) {
+}
+
+bool HashRing::addNode(const std::string& node_id) {
+    auto it = std::lower_bound(nodes_.begin(), nodes_.end(), node_id);
+    if (it != nodes_.end() && *it == node_id) {
+        return false;
+    }
+    nodes_.insert(it, node_id);
+    rebuild();
+    return true;
+}
+
+bool HashRing::removeNode(const std::string& node_id) {
+    auto it = std::lower_bound(nodes_.begin(), nodes_.end(), node_id);
+    if (it == nodes_.end() || *it != node_id) {
+        return false;
+    }
+    nodes_.erase(it);
+    rebuild();
+    return true;
+}
+
+bool HashRing::hasNode(const std::string& node_id) const {
+    return std::binary_search(nodes_.begin(), nodes_.end(), node_id);
+}
+
+const std::string& HashRing::ownerOf(std::string_view key) const {
+    if (points_.empty()) {
+        return EMPTY_NODE;
+    }
+
+    // First point clockwise from the key's hash, wrapping around
+    uint64_t point = hash(key);
+    auto it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(point, uint32_t{0}));
+    if (it == points_.end()) {
+        it = points_.begin();
+    }
+    return nodes_[it->second];
+}
+
+uint64_t HashRing::hash(std::string_view key) {
+    uint64_t value = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key) {
+        value ^= c;
+        value *= 0x100000001b3ULL;
+    }
+
+    // FNV alone clusters similar keys ("room-1", "room-2"); mix the bits
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+void HashRing::rebuild() {
+    // Points depend only on node ids, so every node computes the same ring
+    points_.clear();
+    points_.reserve(nodes_.size() * virtual_nodes_);
+    for (uint32_t index = 0; index < nodes_.size(); ++index) {
+        for (std::size_t replica = 0; replica < virtual_nodes_; ++replica) {
+            points_.emplace_back(hash(nodes_[index] + "#" + std::to_string(replica)), index);
+        }
+    }
+    std::sort(points_.begin(), points_.end());
+}
+
+} // namespace chat
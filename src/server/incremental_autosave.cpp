@@ -0,0 +1,220 @@
+#include "server/incremental_autosave.h"
+#include "common/logger.h"
+#include <algorithm>
+
+namespace chat {
+
+IncrementalAutosave::Options IncrementalAutosave::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.interval = std::chrono::seconds(config.getAutosaveInterval());
+    return options;
+}
+
+IncrementalAutosave::IncrementalAutosave(boost::asio::io_context& io_context, Options options,
+                                         UserResolver resolver, Persister persister)
+    : timer_(boost::asio::make_strand(io_context)),
+      options_(options),
+      resolver_(std::move(resolver)),
+      persister_(std::move(persister)) {
+}
+
+IncrementalAutosave::~IncrementalAutosave() {
+    stop();
+}
+
+void IncrementalAutosave::start() {
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        if (running_) {
+            return;
+        }
+        running_ = true;
+    }
+    worker_ = std::thread([this]() { workerLoop(); });
+    if (options_.interval.count() > 0) {
+        boost::asio::post(timer_.get_executor(), [this]() { scheduleTimer(); });
+    }
+}
+
+void IncrementalAutosave::stop() {
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    // Cancel on the timer's strand, after any handler already running;
+    // that handler sees running_ cleared and does not re-arm
+    boost::asio::post(timer_.get_executor(), [this]() { timer_.cancel(); });
+    worker_cv_.notify_all();
+    worker_.join();
+    saveNow();
+}
+
+void IncrementalAutosave::userChanged(chat_app::User& user) {
+    if (user.dirty_fields != 0) {
+        userChanged(user.user_id, user.dirty_fields);
+        user.dirty_fields = 0;
+    }
+}
+
+void IncrementalAutosave::userChanged(const std::string& user_id, uint8_t fields) {
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    journal_.removed_users.erase(user_id);
+    journal_.users[user_id] |= fields;
+}
+
+void IncrementalAutosave::userRemoved(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    journal_.users.erase(user_id);
+    journal_.removed_users.insert(user_id);
+}
+
+void IncrementalAutosave::membershipChanged(const std::string& room_id, const std::string& user_id, bool joined) {
+    // Only the latest state of a pair matters; join+leave collapses
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    journal_.memberships[{room_id, user_id}] = joined;
+}
+
+void IncrementalAutosave::mentionAdded(const Mention& mention) {
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    journal_.mentions.push_back(mention);
+}
+
+void IncrementalAutosave::readPositionChanged(const std::string& room_id, const std::string& user_id,
+                                              uint64_t position) {
+    // Watermarks only move forward; keep the furthest
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    uint64_t& journaled = journal_.read_positions[{room_id, user_id}];
+    journaled = std::max(journaled, position);
+}
+
+void IncrementalAutosave::scheduleTimer() {
+    timer_.expires_after(options_.interval);
+    timer_.async_wait([this](const boost::system::error_code& error) {
+        if (error) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(worker_mutex_);
+            if (!running_) {
+                return;
+            }
+            requested_ = true;
+        }
+        worker_cv_.notify_all();
+        scheduleTimer();
+    });
+}
+
+void IncrementalAutosave::workerLoop() {
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    while (true) {
+        worker_cv_.wait(lock, [this]() { return requested_ || !running_; });
+        if (!running_) {
+            return;
+        }
+        requested_ = false;
+        lock.unlock();
+        saveNow();
+        lock.lock();
+    }
+}
+
+bool IncrementalAutosave::saveNow() {
+    std::lock_guard<std::mutex> save_lock(save_mutex_);
+
+    Journal taken;
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex_);
+        std::swap(taken, journal_);
+    }
+    if (taken.empty()) {
+        return true;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    // Read the current state of just the changed users
+    ChangeBatch batch;
+    batch.users.reserve(taken.users.size());
+    for (const auto& [user_id, fields] : taken.users) {
+        if (auto user = resolver_(user_id)) {
+            batch.users.push_back(UserChange{std::move(*user), fields});
+        } else {
+            batch.removed_users.push_back(user_id);
+        }
+    }
+    batch.removed_users.insert(batch.removed_users.end(), taken.removed_users.begin(), taken.removed_users.end());
+    batch.memberships.reserve(taken.memberships.size());
+    for (const auto& [key, joined] : taken.memberships) {
+        batch.memberships.push_back(MembershipChange{key.first, key.second, joined});
+    }
+    batch.mentions = taken.mentions;
+    batch.read_positions.reserve(taken.read_positions.size());
+    for (const auto& [key, position] : taken.read_positions) {
+        batch.read_positions.push_back(ReadPositionChange{key.first, key.second, position});
+    }
+
+    if (!persister_(batch)) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        CHAT_LOG_WARN("Autosave of {} changes failed; retrying with the next save", batch.size());
+        requeue(std::move(taken));
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    saves_.fetch_add(1, std::memory_order_relaxed);
+    users_written_.fetch_add(batch.users.size(), std::memory_order_relaxed);
+    memberships_written_.fetch_add(batch.memberships.size(), std::memory_order_relaxed);
+    last_batch_.store(batch.size(), std::memory_order_relaxed);
+    last_duration_ms_.store(static_cast<uint64_t>(elapsed), std::memory_order_relaxed);
+    CHAT_LOG_DEBUG("Autosaved {} users, {} removals, {} memberships, {} mentions, {} read positions in {} ms",
+                   batch.users.size(), batch.removed_users.size(), batch.memberships.size(),
+                   batch.mentions.size(), batch.read_positions.size(), elapsed);
+    return true;
+}
+
+void IncrementalAutosave::requeue(Journal&& journal) {
+    // Changes journaled since the failed save are newer and win
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    for (const auto& [user_id, fields] : journal.users) {
+        if (journal_.removed_users.count(user_id) == 0) {
+            journal_.users[user_id] |= fields;
+        }
+    }
+    for (const auto& user_id : journal.removed_users) {
+        if (journal_.users.count(user_id) == 0) {
+            journal_.removed_users.insert(user_id);
+        }
+    }
+    for (const auto& entry : journal.memberships) {
+        journal_.memberships.insert(entry);
+    }
+    journal_.mentions.insert(journal_.mentions.begin(), journal.mentions.begin(), journal.mentions.end());
+    for (const auto& [key, position] : journal.read_positions) {
+        uint64_t& journaled = journal_.read_positions[key];
+        journaled = std::max(journaled, position);
+    }
+}
+
+std::size_t IncrementalAutosave::pendingChanges() const {
+    std::lock_guard<std::mutex> lock(journal_mutex_);
+    return journal_.users.size() + journal_.removed_users.size() + journal_.memberships.size() +
+           journal_.mentions.size() + journal_.read_positions.size();
+}
+
+IncrementalAutosave::Stats IncrementalAutosave::stats() const {
+    Stats stats;
+    stats.saves = saves_.load(std::memory_order_relaxed);
+    stats.users_written = users_written_.load(std::memory_order_relaxed);
+    stats.memberships_written = memberships_written_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    stats.last_batch = last_batch_.load(std::memory_order_relaxed);
+    stats.last_duration_ms = last_duration_ms_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
@@ -4,9 +4,13 @@
 #include <vector>
 #include <boost/asio.hpp>
 #include <filesystem>
+#include <functional>
+#include <csignal>
 
 #include "server/chat_server.h"
 #include "common/config_loader.h"
+#include "common/config_watcher.h"
+#include "common/logger.h"
 
 namespace fs = std::filesystem;
 
@@ -54,14 +58,45 @@ int main(int argc, char* argv[]) {
            std::cout << "Creating log directory: " << log_dir << std::endl;
            fs::create_directories(log_dir);
        }
+       
+       // Start the asynchronous logger; LOG_LEVEL changes apply on reload
+       if (!chat::Logger::instance().start(chat::Logger::Options::fromConfig(config))) {
+           return 1;
+       }
+       config.subscribe([](const chat::ConfigSnapshot& previous, const chat::ConfigSnapshot& current) {
+           if (current.log_level != previous.log_level) {
+               chat::Logger::setLevel(current.log_level);
+           }
+       });
         
         // Create io_context
         boost::asio::io_context io_context;
         
+       // Reload configuration on SIGHUP; subsystems pick up new limits
+       // through ConfigLoader::subscribe()
+       boost::asio::signal_set reload_signals(io_context, SIGHUP);
+       std::function<void()> wait_for_reload = [&]() {
+           reload_signals.async_wait([&](const boost::system::error_code& error, int /*signal*/) {
+               if (error) {
+                   return;
+               }
+               CHAT_LOG_INFO("SIGHUP received, reloading {}", config_path);
+               config.reload();
+               wait_for_reload();
+           });
+       };
+       wait_for_reload();
+       
+       // Optionally reload whenever the file changes on disk
+       chat::ConfigWatcher config_watcher(config);
+       if (config.getBool("CONFIG_WATCH", false)) {
+           config_watcher.start();
+       }
+        
         // Create and start the server
         chat::ChatServer server(io_context, port);
  
-       std::cout << "Starting server on port " << port << std::endl;
+       CHAT_LOG_INFO("Starting server on port {}", port);
         server.start();
 
          
@@ -72,7 +107,7 @@ int main(int argc, char* argv[]) {
                thread_pool_size = 4; // Default if hardware_concurrency returns 0
            }
        }
-       std::cout << "Using thread pool size: " << thread_pool_size << std::endl;
+       CHAT_LOG_INFO("Using thread pool size: {}", thread_pool_size);
        
        threads.reserve(thread_pool_size);
 
@@ -82,14 +117,15 @@ int main(int argc, char* argv[]) {
             });
         }
 
-        std::cout << "Server is running. Press Ctrl+C to stop." << std::endl;
+        CHAT_LOG_INFO("Server is running. Press Ctrl+C to stop.");
        
         // Wait for all threads to complete
         for (auto& thread : threads) {
             thread.join();
         }
        
-       std::cout << "Server stopped." << std::endl;
+       CHAT_LOG_INFO("Server stopped.");
+       chat::Logger::instance().stop();
     }
     catch (const std::exception& e) {
         std::cerr << "Exception: " << e.what() << std::endl;
@@ -0,0 +1,834 @@
+#include "server/message_log.h"
+#include "server/cluster_manager.h"
+#include "server/frame_helpers.h"
+#include "common/crc32c.h"
+#include "common/logger.h"
+#include "common/protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace chat {
+
+namespace {
+
+// On-disk record header, host byte order (logs are not moved between
+// architectures). The CRC covers the sequence and the payload.
+struct RecordHeader {
+    uint32_t size;
+    uint32_t crc;
+    uint64_t sequence;
+};
+
+constexpr std::size_t RECORD_HEADER_SIZE = sizeof(RecordHeader);
+static_assert(RECORD_HEADER_SIZE == 16, "record header must stay 16 bytes");
+
+// A sparse index entry is kept every INDEX_INTERVAL records per segment
+constexpr std::size_t INDEX_INTERVAL = 64;
+
+// Replication frames stay well under the protocol's body limit
+constexpr std::size_t MAX_REPLICA_FRAME = chat_app::MAX_BODY_SIZE / 2;
+
+constexpr const char* SEGMENT_SUFFIX = ".log";
+
+uint32_t recordCrc(uint64_t sequence, const char* payload, std::size_t size) {
+    return chat_app::crc32c(chat_app::crc32c(0, &sequence, sizeof(sequence)), payload, size);
+}
+
+void appendRecord(std::vector<char>& out, uint64_t sequence, const char* payload, std::size_t size) {
+    RecordHeader header{static_cast<uint32_t>(size), recordCrc(sequence, payload, size), sequence};
+    const char* raw = reinterpret_cast<const char*>(&header);
+    out.insert(out.end(), raw, raw + RECORD_HEADER_SIZE);
+    out.insert(out.end(), payload, payload + size);
+}
+
+// Validates the record at offset; returns its header or false at the end
+// of valid data
+bool parseRecord(const char* data, std::size_t end, std::size_t offset, RecordHeader& header) {
+    if (end - offset < RECORD_HEADER_SIZE) {
+        return false;
+    }
+    std::memcpy(&header, data + offset, RECORD_HEADER_SIZE);
+    if (header.size == 0 || header.size > end - offset - RECORD_HEADER_SIZE) {
+        return false;
+    }
+    return header.crc == recordCrc(header.sequence, data + offset + RECORD_HEADER_SIZE, header.size);
+}
+
+bool writeAll(int fd, const char* data, std::size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, data, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+        offset += written;
+    }
+    return true;
+}
+
+// Zero a segment from offset to its end and make that durable. The range
+// stays allocated where the filesystem can zero in place.
+bool zeroFrom(int fd, std::size_t offset, std::size_t capacity) {
+    if (offset >= capacity) {
+        return true;
+    }
+    if (::fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+                    static_cast<off_t>(capacity - offset)) != 0) {
+        static const std::vector<char> zeros(64 * 1024);
+        while (offset < capacity) {
+            std::size_t size = std::min(zeros.size(), capacity - offset);
+            if (!writeAll(fd, zeros.data(), size, static_cast<off_t>(offset))) {
+                return false;
+            }
+            offset += size;
+        }
+    }
+    return ::fdatasync(fd) == 0;
+}
+
+std::string segmentName(uint64_t base_sequence) {
+    std::string digits = std::to_string(base_sequence);
+    return std::string(20 - std::min<std::size_t>(digits.size(), 20), '0') + digits + SEGMENT_SUFFIX;
+}
+
+} // namespace
+
+// One segment file, mapped read-only for its whole preallocated size.
+// end is the durable length: readers never look past it.
+struct MessageLog::Segment {
+    uint64_t base_sequence = 0;
+    std::string path;
+    int fd = -1;
+    char* map = nullptr;
+    std::size_t capacity = 0;
+    std::atomic<std::size_t> end{0};
+    bool released = false;
+
+    // (sequence, offset) of every INDEX_INTERVAL-th record
+    mutable std::mutex index_mutex;
+    std::vector<std::pair<uint64_t, std::size_t>> index;
+    std::size_t record_count = 0;
+
+    ~Segment() {
+        if (map) {
+            ::munmap(map, capacity);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (released) {
+            ::unlink(path.c_str());
+        }
+    }
+
+    void addToIndex(uint64_t sequence, std::size_t offset) {
+        if (record_count++ % INDEX_INTERVAL == 0) {
+            std::lock_guard<std::mutex> lock(index_mutex);
+            index.emplace_back(sequence, offset);
+        }
+    }
+
+    // Offset of the last indexed record at or before sequence
+    std::size_t seek(uint64_t sequence) const {
+        std::lock_guard<std::mutex> lock(index_mutex);
+        auto it = std::upper_bound(index.begin(), index.end(), std::make_pair(sequence, SIZE_MAX));
+        return it == index.begin() ? 0 : std::prev(it)->second;
+    }
+};
+
+MessageLog::Options MessageLog::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.directory = config.getString("MESSAGE_LOG_DIR", options.directory);
+    options.segment_bytes = static_cast<std::size_t>(
+        config.getInt("MESSAGE_LOG_SEGMENT_MB", static_cast<int>(options.segment_bytes >> 20))) << 20;
+    options.max_batch_bytes = static_cast<std::size_t>(
+        config.getInt("MESSAGE_LOG_BATCH_KB", static_cast<int>(options.max_batch_bytes >> 10))) << 10;
+    options.sync = config.getBool("MESSAGE_LOG_SYNC", options.sync);
+    options.follower_node = config.getString("MESSAGE_LOG_FOLLOWER", options.follower_node);
+    options.replica_retry = std::chrono::milliseconds(std::max(
+        10, config.getInt("MESSAGE_LOG_RESEND_MS", static_cast<int>(options.replica_retry.count()))));
+    options.replica_timeout = std::chrono::milliseconds(std::max(
+        0, config.getInt("MESSAGE_LOG_CONFIRM_MS", static_cast<int>(options.replica_timeout.count()))));
+    return options;
+}
+
+MessageLog::MessageLog(Options options)
+    : options_(std::move(options)) {
+    options_.segment_bytes = std::max<std::size_t>(options_.segment_bytes, 4096);
+    options_.max_batch_bytes = std::max<std::size_t>(options_.max_batch_bytes, 4096);
+}
+
+MessageLog::~MessageLog() {
+    close();
+}
+
+bool MessageLog::open() {
+    std::error_code error;
+    fs::create_directories(options_.directory, error);
+    if (error) {
+        CHAT_LOG_ERROR("Could not create message log directory {}: {}", options_.directory, error.message());
+        return false;
+    }
+
+    if (!recover()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    running_ = true;
+    writer_ = std::thread([this]() { writerLoop(); });
+    return true;
+}
+
+void MessageLog::close() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    queue_cv_.notify_all();
+    writer_.join();
+
+    // Locally durable, but the follower never confirmed them
+    std::deque<AwaitingReplica> unconfirmed;
+    {
+        std::lock_guard<std::mutex> lock(replica_mutex_);
+        unconfirmed.swap(awaiting_replica_);
+    }
+    for (auto& record : unconfirmed) {
+        if (record.on_durable) {
+            record.on_durable(record.sequence, false);
+        }
+    }
+}
+
+void MessageLog::attachCluster(ClusterManager& cluster) {
+    cluster_ = &cluster;
+    cluster.setFrameHandler(frameType(chat_app::MessageType::LOG_APPEND),
+                            [this](const std::string& from, const std::vector<char>& body, uint16_t flags) {
+                                onReplicaAppend(from, body, flags);
+                            });
+    cluster.setFrameHandler(frameType(chat_app::MessageType::LOG_ACK),
+                            [this](const std::string&, const std::vector<char>& body, uint16_t) {
+                                onReplicaAck(body);
+                            });
+}
+
+uint64_t MessageLog::append(const chat_app::SharedEncodedMessage& message, AckCallback on_durable) {
+    // The binary body is shared with connections that already sent it
+    return append(message->binary(), std::move(on_durable));
+}
+
+uint64_t MessageLog::append(chat_app::EncodedMessage::Body payload, AckCallback on_durable) {
+    if (!payload || payload->empty()) {
+        return 0;
+    }
+
+    uint64_t sequence = 0;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!running_) {
+            return 0;
+        }
+        sequence = next_sequence_++;
+        queue_.push_back(PendingRecord{sequence, std::move(payload), std::move(on_durable)});
+    }
+    queue_cv_.notify_one();
+    return sequence;
+}
+
+void MessageLog::writerLoop() {
+    std::vector<PendingRecord> batch;
+    std::vector<char> records;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            auto ready = [this]() { return !queue_.empty() || !running_; };
+            if (replicating()) {
+                // Wake up while idle too, to retry a follower that went quiet
+                queue_cv_.wait_for(lock, options_.replica_retry, ready);
+            } else {
+                queue_cv_.wait(lock, ready);
+            }
+            if (queue_.empty() && !running_) {
+                return;
+            }
+
+            // Everything queued while the last batch was syncing, up to
+            // max_batch_bytes
+            std::size_t bytes = 0;
+            std::size_t count = 0;
+            while (count < queue_.size() && (count == 0 || bytes < options_.max_batch_bytes)) {
+                bytes += queue_[count].payload->size() + RECORD_HEADER_SIZE;
+                ++count;
+            }
+            batch.assign(std::make_move_iterator(queue_.begin()),
+                         std::make_move_iterator(queue_.begin() + static_cast<std::ptrdiff_t>(count)));
+            queue_.erase(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(count));
+        }
+
+        if (!batch.empty()) {
+            records.clear();
+            bool durable = writeBatch(batch, records);
+            completeBatch(batch, records, durable);
+            batch.clear();
+        }
+        if (replicating()) {
+            checkReplica();
+        }
+    }
+}
+
+bool MessageLog::writeBatch(const std::vector<PendingRecord>& batch, std::vector<char>& records) {
+    std::shared_ptr<Segment> tail;
+    {
+        std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+        tail = segments_.back();
+    }
+
+    // Records are written per segment run; a run ends when the tail fills up
+    std::size_t run_start = 0;
+    std::size_t offset = tail->end.load(std::memory_order_relaxed);
+    std::vector<std::pair<uint64_t, std::size_t>> run_index;
+
+    auto flushRun = [&]() -> bool {
+        std::size_t size = records.size() - run_start;
+        if (size == 0) {
+            return true;
+        }
+        std::size_t start = tail->end.load(std::memory_order_relaxed);
+        if (!writeAll(tail->fd, records.data() + run_start, size, static_cast<off_t>(start)) ||
+            (options_.sync && ::fdatasync(tail->fd) != 0)) {
+            CHAT_LOG_ERROR("Message log write to {} failed: {}", tail->path, std::strerror(errno));
+            return false;
+        }
+        for (const auto& entry : run_index) {
+            tail->addToIndex(entry.first, entry.second);
+        }
+        tail->end.store(start + size, std::memory_order_release);
+        run_index.clear();
+        run_start = records.size();
+        return true;
+    };
+
+    for (const auto& record : batch) {
+        std::size_t record_size = RECORD_HEADER_SIZE + record.payload->size();
+        if (offset + record_size > tail->capacity) {
+            if (!flushRun()) {
+                return false;
+            }
+            auto segment = openSegment(record.sequence, std::max(options_.segment_bytes, record_size));
+            if (!segment) {
+                return false;
+            }
+            {
+                std::unique_lock<std::shared_mutex> lock(segments_mutex_);
+                segments_.push_back(segment);
+            }
+            tail = segment;
+            offset = 0;
+        }
+
+        run_index.emplace_back(record.sequence, offset);
+        appendRecord(records, record.sequence, record.payload->data(), record.payload->size());
+        offset += record_size;
+    }
+
+    if (!flushRun()) {
+        return false;
+    }
+
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    appended_.fetch_add(batch.size(), std::memory_order_relaxed);
+    durable_sequence_.store(batch.back().sequence, std::memory_order_release);
+    return true;
+}
+
+void MessageLog::completeBatch(std::vector<PendingRecord>& batch, const std::vector<char>& records, bool durable) {
+    if (durable && replicating()) {
+        // Park the callbacks before sending, the ack may come back first
+        std::vector<PendingRecord> confirmed;
+        {
+            std::lock_guard<std::mutex> lock(replica_mutex_);
+            auto now = std::chrono::steady_clock::now();
+            if (replica_sent_ <= replica_sequence_) {
+                // The follower was idle and up to date: start the retry clock
+                replica_progress_ = now;
+            }
+            for (auto& record : batch) {
+                if (record.sequence <= replica_sequence_) {
+                    confirmed.push_back(std::move(record));
+                } else {
+                    awaiting_replica_.push_back(AwaitingReplica{record.sequence, std::move(record.on_durable),
+                                                                now + options_.replica_timeout});
+                }
+            }
+            // Sent in sequence order only; while the follower is catching up
+            // (or a resend already covered this batch) acks pull the rest
+            // from the log instead
+            if (replica_sent_ + 1 == batch.front().sequence) {
+                replicate(records);
+                replica_sent_ = batch.back().sequence;
+            }
+        }
+        for (auto& record : confirmed) {
+            if (record.on_durable) {
+                record.on_durable(record.sequence, true);
+            }
+        }
+        return;
+    }
+
+    if (!durable) {
+        failed_.fetch_add(batch.size(), std::memory_order_relaxed);
+    }
+    for (auto& record : batch) {
+        if (record.on_durable) {
+            record.on_durable(record.sequence, durable);
+        }
+    }
+}
+
+void MessageLog::replicate(const std::vector<char>& records) {
+    // Split on record boundaries so each frame fits the protocol limit
+    std::size_t start = 0;
+    std::size_t offset = 0;
+    while (offset < records.size()) {
+        RecordHeader header;
+        std::memcpy(&header, records.data() + offset, RECORD_HEADER_SIZE);
+        std::size_t next = offset + RECORD_HEADER_SIZE + header.size;
+        if (next - start > MAX_REPLICA_FRAME && offset > start) {
+            cluster_->sendToNode(options_.follower_node,
+                                 std::make_shared<const std::vector<char>>(records.begin() + start, records.begin() + offset),
+                                 frameType(chat_app::MessageType::LOG_APPEND), chat_app::MessageFlags::BINARY);
+            start = offset;
+        }
+        offset = next;
+    }
+    if (offset > start) {
+        cluster_->sendToNode(options_.follower_node,
+                             std::make_shared<const std::vector<char>>(records.begin() + start, records.end()),
+                             frameType(chat_app::MessageType::LOG_APPEND), chat_app::MessageFlags::BINARY);
+    }
+}
+
+void MessageLog::resendLocked(uint64_t sequence) {
+    // Records released here cannot be sent: the follower continues from
+    // the first one still held
+    uint64_t first = firstSequence();
+    if (sequence < first) {
+        cluster_->sendToNode(options_.follower_node, jsonBody({{"base", first}}),
+                             frameType(chat_app::MessageType::LOG_APPEND), chat_app::MessageFlags::JSON);
+        sequence = first;
+    }
+
+    std::vector<char> records;
+    uint64_t last = 0;
+    read(sequence, SIZE_MAX, [&](uint64_t record_sequence, const char* data, std::size_t size) {
+        if (!records.empty() && records.size() + RECORD_HEADER_SIZE + size > options_.max_batch_bytes) {
+            return false;
+        }
+        appendRecord(records, record_sequence, data, size);
+        last = record_sequence;
+        return true;
+    });
+    if (last != 0) {
+        replicate(records);
+        replica_sent_ = last;
+    }
+    replica_resent_from_ = sequence;
+    replica_resent_to_ = last;
+    replica_progress_ = std::chrono::steady_clock::now();
+    resends_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MessageLog::checkReplica() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<AwaitingReplica> expired;
+    {
+        std::lock_guard<std::mutex> lock(replica_mutex_);
+        // Acks stopped: frames were lost with a dropped link or the
+        // follower restarted. Only resend over a live link, frames for a
+        // down peer just pile up in its queue.
+        if (replica_sequence_ < durableSequence() && now - replica_progress_ >= options_.replica_retry) {
+            auto peers = cluster_->connectedPeers();
+            if (std::find(peers.begin(), peers.end(), options_.follower_node) != peers.end()) {
+                resendLocked(replica_sequence_ + 1);
+            }
+        }
+        while (!awaiting_replica_.empty() && awaiting_replica_.front().deadline <= now) {
+            expired.push_back(std::move(awaiting_replica_.front()));
+            awaiting_replica_.pop_front();
+        }
+    }
+
+    if (!expired.empty()) {
+        CHAT_LOG_WARN("Follower {} did not confirm {} log records in time", options_.follower_node, expired.size());
+    }
+    unreplicated_.fetch_add(expired.size(), std::memory_order_relaxed);
+    for (auto& record : expired) {
+        if (record.on_durable) {
+            record.on_durable(record.sequence, false);
+        }
+    }
+}
+
+void MessageLog::onReplicaAppend(const std::string& from_node, const std::vector<char>& body, uint16_t flags) {
+    if (flags & chat_app::MessageFlags::JSON) {
+        // The leader no longer holds the records we need next
+        uint64_t base = 0;
+        try {
+            base = nlohmann::json::parse(body.begin(), body.end()).at("base").get<uint64_t>();
+        } catch (const std::exception& e) {
+            CHAT_LOG_WARN("Malformed log frame from {}: {}", from_node, e.what());
+            return;
+        }
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (base > next_sequence_) {
+            CHAT_LOG_WARN("Message log skipping to sequence {}; {} released the records before it", base, from_node);
+            next_sequence_ = base;
+        }
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, chat_app::EncodedMessage::Body>> records;
+    std::size_t offset = 0;
+    RecordHeader header;
+    while (offset < body.size()) {
+        if (!parseRecord(body.data(), body.size(), offset, header)) {
+            CHAT_LOG_WARN("Dropping corrupt log frame from {} at offset {}", from_node, offset);
+            return;
+        }
+        const char* payload = body.data() + offset + RECORD_HEADER_SIZE;
+        records.emplace_back(header.sequence, std::make_shared<const std::vector<char>>(payload, payload + header.size));
+        offset += RECORD_HEADER_SIZE + header.size;
+    }
+    if (records.empty()) {
+        return;
+    }
+
+    // next asks the leader to resend from that sequence
+    auto sendAck = [this, from_node](uint64_t sequence, uint64_t next) {
+        nlohmann::json ack{{"sequence", sequence}};
+        if (next != 0) {
+            ack["next"] = next;
+        }
+        cluster_->sendToNode(from_node, jsonBody(ack),
+                             frameType(chat_app::MessageType::LOG_ACK), chat_app::MessageFlags::JSON);
+    };
+
+    // Records are applied strictly in sequence: duplicates (a resend
+    // overlapping what arrived) are skipped, and a gap stops the frame
+    uint64_t last_queued = 0;
+    uint64_t expected = 0;
+    bool gap = false;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!running_) {
+            return;
+        }
+        for (auto& record : records) {
+            if (record.first < next_sequence_) {
+                continue;
+            }
+            if (record.first > next_sequence_) {
+                gap = true;
+                break;
+            }
+            queue_.push_back(PendingRecord{record.first, std::move(record.second), nullptr});
+            last_queued = next_sequence_++;
+        }
+        // Acknowledge the frame once its last new record is durable here
+        if (last_queued != 0) {
+            queue_.back().on_durable = [sendAck](uint64_t sequence, bool durable) {
+                if (durable) {
+                    sendAck(sequence, 0);
+                }
+            };
+        }
+        expected = next_sequence_;
+    }
+    if (last_queued != 0) {
+        queue_cv_.notify_one();
+    }
+
+    if (gap) {
+        sendAck(durableSequence(), expected);
+    } else if (last_queued == 0) {
+        // Every record was a duplicate: confirm what is already durable
+        uint64_t durable = std::min(durableSequence(), records.back().first);
+        if (durable != 0) {
+            sendAck(durable, 0);
+        }
+    }
+}
+
+void MessageLog::onReplicaAck(const std::vector<char>& body) {
+    uint64_t sequence = 0;
+    uint64_t next = 0;
+    try {
+        auto ack = nlohmann::json::parse(body.begin(), body.end());
+        sequence = ack.at("sequence").get<uint64_t>();
+        next = ack.value("next", uint64_t{0});
+    } catch (const std::exception& e) {
+        CHAT_LOG_WARN("Malformed log ack: {}", e.what());
+        return;
+    }
+
+    // Acks are cumulative
+    std::vector<AwaitingReplica> confirmed;
+    {
+        std::lock_guard<std::mutex> lock(replica_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        if (sequence > replica_sequence_) {
+            replica_sequence_ = sequence;
+            replica_progress_ = now;
+        }
+        while (!awaiting_replica_.empty() && awaiting_replica_.front().sequence <= replica_sequence_) {
+            confirmed.push_back(std::move(awaiting_replica_.front()));
+            awaiting_replica_.pop_front();
+        }
+
+        if (next != 0) {
+            // The follower missed records. Every frame after the gap asks
+            // again; skip requests a recent resend already covers.
+            bool in_flight = next >= replica_resent_from_ && next <= replica_resent_to_ &&
+                             now - replica_progress_ < options_.replica_retry;
+            if (!in_flight) {
+                resendLocked(next);
+            }
+        } else if (replica_sequence_ >= replica_sent_ && replica_sent_ < durableSequence()) {
+            // Catching up: the last window is in, send the next one
+            resendLocked(replica_sent_ + 1);
+        }
+    }
+
+    replicated_.fetch_add(confirmed.size(), std::memory_order_relaxed);
+    for (auto& record : confirmed) {
+        if (record.on_durable) {
+            record.on_durable(record.sequence, true);
+        }
+    }
+}
+
+std::shared_ptr<MessageLog::Segment> MessageLog::openSegment(uint64_t base_sequence, std::size_t capacity) {
+    auto segment = std::make_shared<Segment>();
+    segment->base_sequence = base_sequence;
+    segment->path = (fs::path(options_.directory) / segmentName(base_sequence)).string();
+
+    bool create = capacity != 0;
+    segment->fd = ::open(segment->path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC : O_RDWR | O_CLOEXEC, 0644);
+    if (segment->fd < 0) {
+        CHAT_LOG_ERROR("Could not open message log segment {}: {}", segment->path, std::strerror(errno));
+        return nullptr;
+    }
+
+    if (create) {
+        // Preallocate so appends never extend the file (no metadata sync)
+        // and the whole segment can be mapped up front
+        if (::posix_fallocate(segment->fd, 0, static_cast<off_t>(capacity)) != 0 &&
+            ::ftruncate(segment->fd, static_cast<off_t>(capacity)) != 0) {
+            CHAT_LOG_ERROR("Could not allocate message log segment {}", segment->path);
+            return nullptr;
+        }
+        // Make the new file itself durable
+        if (options_.sync) {
+            ::fsync(segment->fd);
+            int dir = ::open(options_.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir >= 0) {
+                ::fsync(dir);
+                ::close(dir);
+            }
+        }
+    } else {
+        struct stat info;
+        if (::fstat(segment->fd, &info) != 0 || info.st_size <= 0) {
+            return nullptr;
+        }
+        capacity = static_cast<std::size_t>(info.st_size);
+    }
+
+    void* map = ::mmap(nullptr, capacity, PROT_READ, MAP_SHARED, segment->fd, 0);
+    if (map == MAP_FAILED) {
+        CHAT_LOG_ERROR("Could not map message log segment {}: {}", segment->path, std::strerror(errno));
+        return nullptr;
+    }
+    segment->map = static_cast<char*>(map);
+    segment->capacity = capacity;
+    return segment;
+}
+
+bool MessageLog::recover() {
+    std::vector<uint64_t> bases;
+    for (const auto& entry : fs::directory_iterator(options_.directory)) {
+        const std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && name.size() == 20 + std::strlen(SEGMENT_SUFFIX) &&
+            entry.path().extension() == SEGMENT_SUFFIX) {
+            try {
+                bases.push_back(std::stoull(name.substr(0, 20)));
+            } catch (const std::exception&) {
+            }
+        }
+    }
+    std::sort(bases.begin(), bases.end());
+
+    std::deque<std::shared_ptr<Segment>> segments;
+    uint64_t last_sequence = 0;
+    bool truncated = false;
+    for (uint64_t base : bases) {
+        auto segment = openSegment(base, 0);
+        if (!segment) {
+            return false;
+        }
+        if (truncated) {
+            // Records after a corrupt one cannot be trusted to be complete
+            CHAT_LOG_WARN("Discarding message log segment {} after a corrupt record", segment->path);
+            segment->released = true;
+            continue;
+        }
+
+        // Replay to the last record with a valid CRC and increasing sequence
+        std::size_t offset = 0;
+        RecordHeader header;
+        while (parseRecord(segment->map, segment->capacity, offset, header) &&
+               header.sequence > last_sequence && header.sequence >= base) {
+            segment->addToIndex(header.sequence, offset);
+            last_sequence = header.sequence;
+            offset += RECORD_HEADER_SIZE + header.size;
+        }
+        segment->end.store(offset, std::memory_order_relaxed);
+
+        // Anything left that is not zero fill is a torn or corrupt write.
+        // This segment becomes the tail; clear the rest so new records are
+        // never followed by stale bytes a later recovery would trip over.
+        if (offset + RECORD_HEADER_SIZE <= segment->capacity) {
+            std::memcpy(&header, segment->map + offset, RECORD_HEADER_SIZE);
+            truncated = header.size != 0;
+        }
+        if (truncated && !zeroFrom(segment->fd, offset, segment->capacity)) {
+            CHAT_LOG_ERROR("Could not clear the torn tail of {}: {}", segment->path, std::strerror(errno));
+            return false;
+        }
+        segments.push_back(std::move(segment));
+    }
+
+    if (truncated) {
+        CHAT_LOG_WARN("Message log recovered to sequence {}; discarded a torn tail", last_sequence);
+    }
+
+    if (segments.empty()) {
+        auto segment = openSegment(1, options_.segment_bytes);
+        if (!segment) {
+            return false;
+        }
+        segments.push_back(std::move(segment));
+    }
+
+    CHAT_LOG_INFO("Message log {} open at sequence {} ({} segments)",
+                  options_.directory, last_sequence, segments.size());
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        next_sequence_ = std::max(last_sequence + 1, segments.back()->base_sequence);
+    }
+    durable_sequence_.store(last_sequence, std::memory_order_release);
+    {
+        // Assume the follower has what we recovered; if not, its first
+        // ack names the sequence it needs
+        std::lock_guard<std::mutex> lock(replica_mutex_);
+        replica_sequence_ = last_sequence;
+        replica_sent_ = last_sequence;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(segments_mutex_);
+    segments_ = std::move(segments);
+    return true;
+}
+
+std::shared_ptr<MessageLog::Segment> MessageLog::segmentFor(uint64_t sequence) const {
+    std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), sequence,
+                               [](uint64_t value, const std::shared_ptr<Segment>& segment) {
+                                   return value < segment->base_sequence;
+                               });
+    return it == segments_.begin() ? segments_.front() : *std::prev(it);
+}
+
+std::shared_ptr<MessageLog::Segment> MessageLog::segmentAfter(const Segment& segment) const {
+    std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+    for (const auto& candidate : segments_) {
+        if (candidate->base_sequence > segment.base_sequence) {
+            return candidate;
+        }
+    }
+    return nullptr;
+}
+
+std::size_t MessageLog::read(uint64_t from_sequence, std::size_t max_records, const RecordVisitor& visitor) const {
+    std::size_t visited = 0;
+    for (auto segment = segmentFor(from_sequence); segment && visited < max_records; segment = segmentAfter(*segment)) {
+        std::size_t end = segment->end.load(std::memory_order_acquire);
+        std::size_t offset = segment->seek(from_sequence);
+        while (offset + RECORD_HEADER_SIZE <= end && visited < max_records) {
+            // Durable records were validated when written or recovered
+            RecordHeader header;
+            std::memcpy(&header, segment->map + offset, RECORD_HEADER_SIZE);
+            const char* payload = segment->map + offset + RECORD_HEADER_SIZE;
+            offset += RECORD_HEADER_SIZE + header.size;
+            if (header.sequence < from_sequence) {
+                continue;
+            }
+            ++visited;
+            if (!visitor(header.sequence, payload, header.size)) {
+                return visited;
+            }
+        }
+    }
+    return visited;
+}
+
+void MessageLog::releaseBefore(uint64_t sequence) {
+    std::unique_lock<std::shared_mutex> lock(segments_mutex_);
+    // Never the tail; a segment goes once the next one starts at or below
+    // sequence. Files are unlinked when the last reader lets go.
+    while (segments_.size() > 1 && segments_[1]->base_sequence <= sequence) {
+        segments_.front()->released = true;
+        segments_.pop_front();
+    }
+}
+
+uint64_t MessageLog::lastSequence() const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return next_sequence_ - 1;
+}
+
+uint64_t MessageLog::firstSequence() const {
+    std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+    return segments_.empty() ? 0 : segments_.front()->base_sequence;
+}
+
+MessageLog::Stats MessageLog::stats() const {
+    Stats stats;
+    stats.appended = appended_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.replicated = replicated_.load(std::memory_order_relaxed);
+    stats.unreplicated = unreplicated_.load(std::memory_order_relaxed);
+    stats.resends = resends_.load(std::memory_order_relaxed);
+    stats.failed = failed_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
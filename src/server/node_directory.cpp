@@ -0,0 +1,81 @@
+#include "server/node_directory.h"
+#include <algorithm>
+#include <mutex>
+
+namespace chat {
+
+NodeDirectory::NodeDirectory(std::string local_node_id)
+    : local_node_id_(std::move(local_node_id)) {
+}
+
+void NodeDirectory::setUserNode(const std::string& user_id, const std::string& node_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    user_nodes_[user_id] = node_id;
+}
+
+void NodeDirectory::removeUser(const std::string& user_id, const std::string& node_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = user_nodes_.find(user_id);
+    if (it != user_nodes_.end() && it->second == node_id) {
+        user_nodes_.erase(it);
+    }
+}
+
+std::optional<std::string> NodeDirectory::nodeForUser(const std::string& user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = user_nodes_.find(user_id);
+    if (it == user_nodes_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void NodeDirectory::addRoomNode(const std::string& room_id, const std::string& node_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    room_nodes_[room_id].insert(node_id);
+}
+
+void NodeDirectory::removeRoomNode(const std::string& room_id, const std::string& node_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = room_nodes_.find(room_id);
+    if (it == room_nodes_.end()) {
+        return;
+    }
+    it->second.erase(node_id);
+    if (it->second.empty()) {
+        room_nodes_.erase(it);
+    }
+}
+
+std::vector<std::string> NodeDirectory::nodesForRoom(const std::string& room_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = room_nodes_.find(room_id);
+    if (it == room_nodes_.end()) {
+        return {};
+    }
+    return std::vector<std::string>(it->second.begin(), it->second.end());
+}
+
+void NodeDirectory::dropNode(const std::string& node_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (auto it = user_nodes_.begin(); it != user_nodes_.end();) {
+        it = it->second == node_id ? user_nodes_.erase(it) : std::next(it);
+    }
+    for (auto it = room_nodes_.begin(); it != room_nodes_.end();) {
+        it->second.erase(node_id);
+        it = it->second.empty() ? room_nodes_.erase(it) : std::next(it);
+    }
+}
+
+std::size_t NodeDirectory::userCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return user_nodes_.size();
+}
+
+std::size_t NodeDirectory::userCount(const std::string& node_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return static_cast<std::size_t>(std::count_if(user_nodes_.begin(), user_nodes_.end(),
+                                                  [&](const auto& entry) { return entry.second == node_id; }));
+}
+
+} // namespace chat
@@ -0,0 +1,269 @@
+#include "server/notification_index.h"
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+namespace chat {
+
+namespace {
+
+bool isWordChar(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isNameChar(char c) {
+    return isWordChar(c) || c == '.' || c == '-';
+}
+
+} // namespace
+
+NotificationIndex::Options NotificationIndex::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.max_unread = static_cast<std::size_t>(std::max(1,
+        config.getInt("UNREAD_COUNT_LIMIT", static_cast<int>(options.max_unread))));
+    options.max_mentions = static_cast<std::size_t>(std::max(0,
+        config.getInt("MENTION_LIMIT", static_cast<int>(options.max_mentions))));
+    return options;
+}
+
+nlohmann::json NotificationIndex::Summary::toJson() const {
+    nlohmann::json json;
+    json["rooms"] = nlohmann::json::array();
+    for (const auto& room : rooms) {
+        json["rooms"].push_back({{"room_id", room.room_id}, {"unread", room.unread}, {"mentions", room.mentions}});
+    }
+    json["mentions"] = nlohmann::json::array();
+    for (const auto& mention : mentions) {
+        json["mentions"].push_back({{"room_id", mention.room_id}, {"id", mention.message_id},
+                                    {"sender", mention.sender_id}, {"sequence", mention.position}});
+    }
+    return json;
+}
+
+NotificationIndex::NotificationIndex(Options options, IncrementalAutosave* autosave,
+                                     UserResolver resolver, MemberCheck is_member)
+    : options_(options),
+      autosave_(autosave),
+      resolver_(std::move(resolver)),
+      is_member_(std::move(is_member)) {
+}
+
+std::vector<std::string> NotificationIndex::record(const chat_app::ChatMessage& message) {
+    if (!message.room_id.has_value()) {
+        return {};
+    }
+    const std::string& room_id = *message.room_id;
+    messages_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t position;
+    {
+        RoomShard& shard = roomShard(room_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        RoomState& room = shard.rooms[room_id];
+        position = appendLocked(room, message.sequence);
+        // The sender has read everything up to their own message
+        if (advanceLocked(room, message.sender_id, position) && autosave_) {
+            autosave_->readPositionChanged(room_id, message.sender_id, position);
+        }
+    }
+
+    std::vector<std::string> mentioned;
+    for (const auto& name : parseMentions(message.content)) {
+        std::optional<std::string> user_id = resolver_ ? resolver_(name) : std::optional<std::string>(name);
+        if (!user_id || *user_id == message.sender_id ||
+            std::find(mentioned.begin(), mentioned.end(), *user_id) != mentioned.end() ||
+            (is_member_ && !is_member_(room_id, *user_id))) {
+            continue;
+        }
+        Mention mention{room_id, *user_id, message.message_id, message.sender_id, position};
+        addMention(mention);
+        if (autosave_) {
+            autosave_->mentionAdded(mention);
+        }
+        mentioned.push_back(std::move(*user_id));
+    }
+    mentions_.fetch_add(mentioned.size(), std::memory_order_relaxed);
+    return mentioned;
+}
+
+void NotificationIndex::markRead(const std::string& room_id, const std::string& user_id, uint64_t position) {
+    {
+        RoomShard& shard = roomShard(room_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        RoomState& room = shard.rooms[room_id];
+        if (position == 0) {
+            if (room.timeline.empty()) {
+                return;
+            }
+            position = room.timeline.back();
+        }
+        if (!advanceLocked(room, user_id, position)) {
+            return;
+        }
+    }
+    read_receipts_.fetch_add(1, std::memory_order_relaxed);
+    if (autosave_) {
+        autosave_->readPositionChanged(room_id, user_id, position);
+    }
+    dropReadMentions(room_id, user_id, position);
+}
+
+uint64_t NotificationIndex::unread(const std::string& room_id, const std::string& user_id) const {
+    const RoomShard& shard = roomShard(room_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto room = shard.rooms.find(room_id);
+    if (room == shard.rooms.end()) {
+        return 0;
+    }
+    auto watermark = room->second.watermarks.find(user_id);
+    uint64_t read = watermark == room->second.watermarks.end() ? 0 : watermark->second;
+    const auto& timeline = room->second.timeline;
+    return static_cast<uint64_t>(timeline.end() - std::upper_bound(timeline.begin(), timeline.end(), read));
+}
+
+NotificationIndex::Summary NotificationIndex::summary(const std::string& user_id,
+                                                      const std::vector<std::string>& room_ids) const {
+    summaries_.fetch_add(1, std::memory_order_relaxed);
+
+    std::unordered_set<std::string> rooms(room_ids.begin(), room_ids.end());
+    std::unordered_map<std::string, uint32_t> mention_counts;
+    Summary summary;
+    {
+        const UserShard& shard = userShard(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto mentions = shard.mentions.find(user_id);
+        if (mentions != shard.mentions.end()) {
+            for (const auto& mention : mentions->second) {
+                if (rooms.count(mention.room_id) != 0) {
+                    ++mention_counts[mention.room_id];
+                    summary.mentions.push_back(mention);
+                }
+            }
+        }
+    }
+
+    for (const auto& room_id : room_ids) {
+        uint64_t count = unread(room_id, user_id);
+        auto mentions = mention_counts.find(room_id);
+        uint32_t mentioned = mentions == mention_counts.end() ? 0 : mentions->second;
+        if (count > 0 || mentioned > 0) {
+            summary.rooms.push_back(RoomSummary{room_id, count, mentioned});
+        }
+    }
+    return summary;
+}
+
+void NotificationIndex::restoreMessage(const chat_app::ChatMessage& message) {
+    if (!message.room_id.has_value()) {
+        return;
+    }
+    RoomShard& shard = roomShard(*message.room_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    appendLocked(shard.rooms[*message.room_id], message.sequence);
+}
+
+void NotificationIndex::restoreReadPosition(const ReadPositionChange& change) {
+    RoomShard& shard = roomShard(change.room_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    advanceLocked(shard.rooms[change.room_id], change.user_id, change.position);
+}
+
+void NotificationIndex::restoreMention(const Mention& mention) {
+    addMention(mention);
+}
+
+std::vector<std::string> NotificationIndex::parseMentions(std::string_view content) {
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < content.size(); ++i) {
+        if (content[i] != '@' || (i > 0 && isWordChar(content[i - 1]))) {
+            continue;
+        }
+        std::size_t end = i + 1;
+        while (end < content.size() && isNameChar(content[end])) {
+            ++end;
+        }
+        // Trailing punctuation ends the sentence, not the name
+        while (end > i + 1 && (content[end - 1] == '.' || content[end - 1] == '-')) {
+            --end;
+        }
+        std::string name(content.substr(i + 1, end - i - 1));
+        if (!name.empty() && std::find(names.begin(), names.end(), name) == names.end()) {
+            names.push_back(std::move(name));
+        }
+        i = end - 1;
+    }
+    return names;
+}
+
+uint64_t NotificationIndex::appendLocked(RoomState& room, uint64_t sequence) {
+    if (sequence == 0) {
+        sequence = room.timeline.empty() ? 1 : room.timeline.back() + 1;
+    }
+    // A repeat (e.g. restored and then recorded) counts once; one that
+    // arrives late goes into place
+    auto it = std::lower_bound(room.timeline.begin(), room.timeline.end(), sequence);
+    if (it != room.timeline.end() && *it == sequence) {
+        return sequence;
+    }
+    room.timeline.insert(it, sequence);
+    if (room.timeline.size() > options_.max_unread) {
+        room.timeline.pop_front();
+    }
+    return sequence;
+}
+
+bool NotificationIndex::advanceLocked(RoomState& room, const std::string& user_id, uint64_t position) {
+    uint64_t& watermark = room.watermarks[user_id];
+    if (position <= watermark) {
+        return false;
+    }
+    watermark = position;
+    return true;
+}
+
+void NotificationIndex::addMention(const Mention& mention) {
+    if (options_.max_mentions == 0) {
+        return;
+    }
+    UserShard& shard = userShard(mention.user_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto& mentions = shard.mentions[mention.user_id];
+    mentions.push_back(mention);
+    if (mentions.size() > options_.max_mentions) {
+        mentions.pop_front();
+    }
+}
+
+void NotificationIndex::dropReadMentions(const std::string& room_id, const std::string& user_id, uint64_t position) {
+    UserShard& shard = userShard(user_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.mentions.find(user_id);
+    if (it == shard.mentions.end()) {
+        return;
+    }
+    auto& mentions = it->second;
+    mentions.erase(std::remove_if(mentions.begin(), mentions.end(), [&](const Mention& mention) {
+        return mention.room_id == room_id && mention.position <= position;
+    }), mentions.end());
+    if (mentions.empty()) {
+        shard.mentions.erase(it);
+    }
+}
+
+NotificationIndex::RoomShard& NotificationIndex::roomShard(const std::string& room_id) const {
+    return room_shards_[std::hash<std::string>{}(room_id) % SHARD_COUNT];
+}
+
+NotificationIndex::UserShard& NotificationIndex::userShard(const std::string& user_id) const {
+    return user_shards_[std::hash<std::string>{}(user_id) % SHARD_COUNT];
+}
+
+NotificationIndex::Stats NotificationIndex::stats() const {
+    Stats stats;
+    stats.messages = messages_.load(std::memory_order_relaxed);
+    stats.mentions = mentions_.load(std::memory_order_relaxed);
+    stats.read_receipts = read_receipts_.load(std::memory_order_relaxed);
+    stats.summaries = summaries_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
@@ -0,0 +1,268 @@
+#include "server/presence_aggregator.h"
+#include "common/message.h"
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+namespace chat {
+
+namespace {
+
+constexpr const char* SERVER_SENDER_ID = "server";
+
+// Typing indicators carry "0"/"false"/"stop" to clear; anything else
+// (including an empty body) means the user is typing
+bool parseTypingState(const std::string& content) {
+    return !(content == "0" || content == "false" || content == "stop");
+}
+
+} // namespace
+
+PresenceAggregator::Options PresenceAggregator::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.flush_interval = std::chrono::milliseconds(
+        config.getInt("PRESENCE_FLUSH_INTERVAL_MS", static_cast<int>(options.flush_interval.count())));
+    options.typing_timeout = std::chrono::milliseconds(
+        config.getInt("TYPING_TIMEOUT_MS", static_cast<int>(options.typing_timeout.count())));
+    return options;
+}
+
+PresenceAggregator::PresenceAggregator(boost::asio::io_context& io_context, Options options, SummarySink sink)
+    : timer_(io_context),
+      options_(options),
+      sink_(std::move(sink)) {
+    if (options_.flush_interval.count() <= 0) {
+        options_.flush_interval = std::chrono::milliseconds(1);
+    }
+}
+
+PresenceAggregator::~PresenceAggregator() {
+    stop();
+}
+
+void PresenceAggregator::start() {
+    if (!running_.exchange(true)) {
+        scheduleFlush();
+    }
+}
+
+void PresenceAggregator::stop() {
+    if (running_.exchange(false)) {
+        timer_.cancel();
+    }
+}
+
+void PresenceAggregator::scheduleFlush() {
+    timer_.expires_after(options_.flush_interval);
+    timer_.async_wait([this](const boost::system::error_code& error) {
+        if (error || !running_) {
+            return;
+        }
+        flush();
+        scheduleFlush();
+    });
+}
+
+bool PresenceAggregator::ingest(const chat_app::ChatMessage& message) {
+    if (!message.room_id.has_value()) {
+        return false;
+    }
+
+    const auto type = static_cast<chat_app::MessageType>(message.message_type);
+    if (type == chat_app::MessageType::TYPING_INDICATOR) {
+        setTyping(*message.room_id, message.sender_id, parseTypingState(message.content));
+        return true;
+    }
+
+    if (type == chat_app::MessageType::READ_RECEIPT) {
+        markRead(*message.room_id, message.sender_id, receiptPosition(message));
+        return true;
+    }
+
+    return false;
+}
+
+uint64_t PresenceAggregator::receiptPosition(const chat_app::ChatMessage& receipt) {
+    // The body is the sequence of the last message read. Receipts without
+    // one carry no position: the presence watermark stays put and the
+    // notification index reads them as "everything so far".
+    try {
+        return std::stoull(receipt.content);
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+void PresenceAggregator::setTyping(const std::string& room_id, const std::string& user_id, bool typing,
+                                   Clock::time_point now) {
+    typing_signals_.fetch_add(1, std::memory_order_relaxed);
+
+    Shard& shard = shardFor(room_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (typing) {
+        RoomState& room = shard.rooms[room_id];
+        auto [it, inserted] = room.typing.try_emplace(user_id, now + options_.typing_timeout);
+        if (!inserted) {
+            // Still typing: just push the expiry out, nothing to report
+            it->second = now + options_.typing_timeout;
+            return;
+        }
+        room.typing_changed = true;
+        shard.dirty.insert(room_id);
+        shard.typing_rooms.insert(room_id);
+        return;
+    }
+
+    auto room_it = shard.rooms.find(room_id);
+    if (room_it != shard.rooms.end() && room_it->second.typing.erase(user_id) > 0) {
+        room_it->second.typing_changed = true;
+        shard.dirty.insert(room_id);
+    }
+}
+
+void PresenceAggregator::markRead(const std::string& room_id, const std::string& user_id, uint64_t position) {
+    read_receipts_.fetch_add(1, std::memory_order_relaxed);
+
+    Shard& shard = shardFor(room_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    RoomState& room = shard.rooms[room_id];
+    uint64_t& watermark = room.watermarks[user_id];
+    if (position <= watermark) {
+        return;
+    }
+    watermark = position;
+    room.advanced.insert(user_id);
+    shard.dirty.insert(room_id);
+}
+
+void PresenceAggregator::removeUser(const std::string& room_id, const std::string& user_id) {
+    Shard& shard = shardFor(room_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto room_it = shard.rooms.find(room_id);
+    if (room_it == shard.rooms.end()) {
+        return;
+    }
+
+    RoomState& room = room_it->second;
+    if (room.typing.erase(user_id) > 0) {
+        room.typing_changed = true;
+        shard.dirty.insert(room_id);
+    }
+    room.watermarks.erase(user_id);
+    room.advanced.erase(user_id);
+}
+
+uint64_t PresenceAggregator::readPosition(const std::string& room_id, const std::string& user_id) const {
+    const Shard& shard = shardFor(room_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto room_it = shard.rooms.find(room_id);
+    if (room_it == shard.rooms.end()) {
+        return 0;
+    }
+    auto it = room_it->second.watermarks.find(user_id);
+    return it != room_it->second.watermarks.end() ? it->second : 0;
+}
+
+std::size_t PresenceAggregator::flush(Clock::time_point now) {
+    std::vector<std::pair<std::string, chat_app::ChatMessage>> summaries;
+
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        // Expire typists that stopped refreshing
+        for (auto it = shard.typing_rooms.begin(); it != shard.typing_rooms.end();) {
+            auto room_it = shard.rooms.find(*it);
+            if (room_it == shard.rooms.end()) {
+                it = shard.typing_rooms.erase(it);
+                continue;
+            }
+
+            RoomState& room = room_it->second;
+            for (auto user_it = room.typing.begin(); user_it != room.typing.end();) {
+                if (user_it->second <= now) {
+                    user_it = room.typing.erase(user_it);
+                    room.typing_changed = true;
+                    shard.dirty.insert(*it);
+                } else {
+                    ++user_it;
+                }
+            }
+            it = room.typing.empty() ? shard.typing_rooms.erase(it) : std::next(it);
+        }
+
+        for (const std::string& room_id : shard.dirty) {
+            auto room_it = shard.rooms.find(room_id);
+            if (room_it == shard.rooms.end()) {
+                continue;
+            }
+
+            RoomState& room = room_it->second;
+            if (room.typing_changed || !room.advanced.empty()) {
+                summaries.emplace_back(room_id, buildSummary(room_id, room));
+            }
+            if (room.typing.empty() && room.watermarks.empty()) {
+                shard.rooms.erase(room_it);
+            }
+        }
+        shard.dirty.clear();
+    }
+
+    // Hand summaries to the sink without holding any shard lock
+    for (auto& [room_id, message] : summaries) {
+        if (sink_) {
+            sink_(room_id, chat_app::makeEncodedMessage(std::move(message)));
+        }
+    }
+    summaries_.fetch_add(summaries.size(), std::memory_order_relaxed);
+    return summaries.size();
+}
+
+chat_app::ChatMessage PresenceAggregator::buildSummary(const std::string& room_id, RoomState& room) {
+    nlohmann::json content = nlohmann::json::object();
+
+    // The typing list is sent whole (it is small); watermarks as a delta
+    if (room.typing_changed) {
+        std::vector<std::string> typists;
+        typists.reserve(room.typing.size());
+        for (const auto& entry : room.typing) {
+            typists.push_back(entry.first);
+        }
+        std::sort(typists.begin(), typists.end());
+        content["typing"] = std::move(typists);
+        room.typing_changed = false;
+    }
+
+    if (!room.advanced.empty()) {
+        nlohmann::json read = nlohmann::json::object();
+        for (const std::string& user_id : room.advanced) {
+            read[user_id] = room.watermarks[user_id];
+        }
+        content["read"] = std::move(read);
+        room.advanced.clear();
+    }
+
+    return chat_app::ChatMessage::forRoom(
+        SERVER_SENDER_ID, room_id, content.dump(),
+        static_cast<uint8_t>(chat_app::MessageType::PRESENCE_SUMMARY));
+}
+
+PresenceAggregator::Stats PresenceAggregator::stats() const {
+    Stats stats;
+    stats.typing_signals = typing_signals_.load(std::memory_order_relaxed);
+    stats.read_receipts = read_receipts_.load(std::memory_order_relaxed);
+    stats.summaries = summaries_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+PresenceAggregator::Shard& PresenceAggregator::shardFor(const std::string& room_id) {
+    return shards_[std::hash<std::string>{}(room_id) % SHARD_COUNT];
+}
+
+const PresenceAggregator::Shard& PresenceAggregator::shardFor(const std::string& room_id) const {
+    return shards_[std::hash<std::string>{}(room_id) % SHARD_COUNT];
+}
+
+} // namespace chat
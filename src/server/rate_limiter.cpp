@@ -0,0 +1,285 @@
+#include "server/rate_limiter.h"
+#include "common/logger.h"
+#include "common/message.h"
+#include "common/protocol.h"
+#include <algorithm>
+#include <cmath>
+#include <nlohmann/json.hpp>
+
+namespace chat {
+
+namespace {
+
+struct DefaultLimit {
+    const char* name;
+    chat_app::MessageType type;
+    double rate;
+    uint32_t burst;
+};
+
+// Client frame types with a limit, and their defaults (rate per second / burst)
+const DefaultLimit DEFAULT_LIMITS[] = {
+    {"AUTH_REQUEST", chat_app::MessageType::AUTH_REQUEST, 1, 5},
+    {"USER_STATUS", chat_app::MessageType::USER_STATUS, 2, 10},
+    {"TEXT_MESSAGE", chat_app::MessageType::TEXT_MESSAGE, 10, 20},
+    {"GROUP_MESSAGE", chat_app::MessageType::GROUP_MESSAGE, 10, 20},
+    {"FILE_TRANSFER", chat_app::MessageType::FILE_TRANSFER, 200, 400},
+    {"TYPING_INDICATOR", chat_app::MessageType::TYPING_INDICATOR, 5, 10},
+    {"READ_RECEIPT", chat_app::MessageType::READ_RECEIPT, 10, 20},
+    {"JOIN_ROOM", chat_app::MessageType::JOIN_ROOM, 2, 10},
+    {"LEAVE_ROOM", chat_app::MessageType::LEAVE_ROOM, 2, 10},
+    {"CREATE_ROOM", chat_app::MessageType::CREATE_ROOM, 1, 5},
+};
+
+constexpr int64_t ERROR_REPLY_INTERVAL_NS = 1000000000;
+
+int64_t toNs(RateLimiter::Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// "rate/burst" or "rate" (burst = rate); "0" disables the limit
+bool parseLimit(const std::string& text, TokenBucket::Limit& limit) {
+    try {
+        std::size_t used = 0;
+        double rate = std::stod(text, &used);
+        double burst = rate;
+        if (used < text.size()) {
+            if (text[used] != '/') {
+                return false;
+            }
+            burst = std::stod(text.substr(used + 1));
+        }
+        if (rate < 0 || burst < 0) {
+            return false;
+        }
+        limit.rate = rate;
+        limit.burst = static_cast<uint32_t>(std::max(1.0, std::ceil(burst)));
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+} // namespace
+
+int64_t TokenBucket::acquire(const Limit& limit, int64_t now_ns, bool reserve) {
+    const int64_t interval = limit.intervalNs();
+    const int64_t window = interval * static_cast<int64_t>(limit.burst);
+    int64_t full_at = full_at_.load(std::memory_order_relaxed);
+    while (true) {
+        int64_t next = std::max(full_at, now_ns) + interval;
+        int64_t wait = next - window - now_ns;
+        if (wait > 0 && !reserve) {
+            return wait;
+        }
+        if (full_at_.compare_exchange_weak(full_at, next, std::memory_order_relaxed)) {
+            return std::max<int64_t>(wait, 0);
+        }
+    }
+}
+
+int64_t TokenBucket::peek(const Limit& limit, int64_t now_ns) const {
+    const int64_t interval = limit.intervalNs();
+    int64_t next = std::max(full_at_.load(std::memory_order_relaxed), now_ns) + interval;
+    return std::max<int64_t>(next - interval * static_cast<int64_t>(limit.burst) - now_ns, 0);
+}
+
+RateLimiter::Options RateLimiter::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    for (const auto& entry : DEFAULT_LIMITS) {
+        auto& limit = options.limits[static_cast<std::size_t>(entry.type)];
+        limit.rate = entry.rate;
+        limit.burst = entry.burst;
+
+        std::string key = std::string("RATE_LIMIT_") + entry.name;
+        if (config.hasKey(key) && !parseLimit(config.getString(key), limit)) {
+            CHAT_LOG_ERROR("Invalid {} (expected rate/burst), using {}/{}", key, entry.rate, entry.burst);
+        }
+    }
+
+    std::string action = config.getString("RATE_LIMIT_ACTION", "reject");
+    if (action == "pause") {
+        options.action = Action::PAUSE;
+    } else if (action != "reject") {
+        CHAT_LOG_ERROR("Unknown RATE_LIMIT_ACTION '{}', using reject", action);
+    }
+    options.address_scale = std::max(1.0, config.getFloat("RATE_LIMIT_ADDRESS_SCALE", options.address_scale));
+    options.max_pause = std::chrono::milliseconds(
+        config.getInt("RATE_LIMIT_MAX_PAUSE_MS", static_cast<int>(options.max_pause.count())));
+    return options;
+}
+
+RateLimiter::RateLimiter(Options options) {
+    setOptions(options);
+}
+
+void RateLimiter::setOptions(const Options& options) {
+    auto published = std::make_shared<const Options>(options);
+    std::lock_guard<std::mutex> lock(options_mutex_);
+    published_.push_back(published);
+    options_.store(published.get(), std::memory_order_release);
+}
+
+std::shared_ptr<RateLimiter::Buckets> RateLimiter::shared(BucketMap& map, const std::string& key) {
+    std::lock_guard<std::mutex> lock(buckets_mutex_);
+    auto& buckets = map[key];
+    if (!buckets) {
+        buckets = std::make_shared<Buckets>();
+        if (++inserts_since_prune_ >= 1024) {
+            pruneLocked(toNs(Clock::now()));
+        }
+    }
+    return buckets;
+}
+
+std::shared_ptr<RateLimiter::ConnectionLimits> RateLimiter::connect(const std::string& address) {
+    auto limits = std::make_shared<ConnectionLimits>();
+    limits->address_ = address;
+    if (!address.empty()) {
+        limits->address_buckets_ = shared(addresses_, address);
+    }
+    return limits;
+}
+
+void RateLimiter::bindUser(ConnectionLimits& limits, const std::string& user_id) {
+    limits.user_id_ = user_id;
+    limits.user_ = user_id.empty() ? nullptr : shared(users_, user_id);
+}
+
+chat_app::FrameVerdict RateLimiter::check(ConnectionLimits& limits, uint16_t type, Clock::time_point now,
+                                          bool can_pause) {
+    chat_app::FrameVerdict verdict;
+    if (type >= TYPE_COUNT) {
+        return verdict;
+    }
+    const Options& options = *options_.load(std::memory_order_acquire);
+    const TokenBucket::Limit& limit = options.limits[type];
+    if (!limit.enabled()) {
+        return verdict;
+    }
+
+    TokenBucket::Limit address_limit;
+    address_limit.rate = limit.rate * options.address_scale;
+    address_limit.burst = static_cast<uint32_t>(std::ceil(limit.burst * options.address_scale));
+
+    struct Charge {
+        TokenBucket* bucket;
+        const TokenBucket::Limit* limit;
+    };
+    Charge charges[3];
+    std::size_t count = 0;
+    charges[count++] = {&limits.connection_.buckets[type], &limit};
+    if (limits.user_) {
+        charges[count++] = {&limits.user_->buckets[type], &limit};
+    }
+    if (limits.address_buckets_) {
+        charges[count++] = {&limits.address_buckets_->buckets[type], &address_limit};
+    }
+
+    // Probe every scope first so a frame rejected by one is not charged to the others
+    const int64_t now_ns = toNs(now);
+    int64_t wait = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        wait = std::max(wait, charges[i].bucket->peek(*charges[i].limit, now_ns));
+    }
+    auto charge = [&]() {
+        int64_t reserved = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            reserved = std::max(reserved, charges[i].bucket->acquire(*charges[i].limit, now_ns, true));
+        }
+        return reserved;
+    };
+    if (wait == 0) {
+        charge();
+        return verdict;
+    }
+
+    throttled_.fetch_add(1, std::memory_order_relaxed);
+    throttled_by_type_[type].fetch_add(1, std::memory_order_relaxed);
+
+    const int64_t max_pause_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(options.max_pause).count();
+    if (options.action == Action::PAUSE && can_pause && wait <= max_pause_ns) {
+        wait = charge();
+        paused_.fetch_add(1, std::memory_order_relaxed);
+        verdict.action = chat_app::FrameVerdict::DELAY;
+    } else {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        verdict.action = chat_app::FrameVerdict::REJECT;
+    }
+    verdict.delay = std::chrono::milliseconds((wait + 999999) / 1000000);
+    return verdict;
+}
+
+void RateLimiter::attach(chat_app::TcpConnection& connection, std::shared_ptr<ConnectionLimits> limits) {
+    std::weak_ptr<chat_app::TcpConnection> weak_connection = connection.shared_from_this();
+    // The filter is owned by the connection, so the raw pointer is valid
+    // whenever it runs
+    chat_app::TcpConnection* raw_connection = &connection;
+    connection.setFrameFilter([this, limits, weak_connection, raw_connection](uint16_t type, uint32_t /*body_size*/) {
+        auto now = Clock::now();
+        chat_app::FrameVerdict verdict = check(*limits, type, now, raw_connection->canPauseReads());
+        if (verdict.action != chat_app::FrameVerdict::REJECT) {
+            return verdict;
+        }
+
+        // One reply per second is enough to tell the client; a flood of
+        // rejected frames must not turn into a flood of replies
+        int64_t now_ns = toNs(now);
+        if (now_ns - limits->last_error_ns_ >= ERROR_REPLY_INTERVAL_NS) {
+            limits->last_error_ns_ = now_ns;
+            if (auto connection = weak_connection.lock()) {
+                connection->send(errorBody(type, verdict.delay),
+                                 static_cast<uint16_t>(chat_app::MessageType::ERROR),
+                                 chat_app::MessageFlags::JSON);
+            }
+            CHAT_LOG_DEBUG("Rate limited frame type {} from {} (user '{}')",
+                           type, limits->address(), limits->userId());
+        }
+        return verdict;
+    });
+}
+
+chat_app::TcpConnection::SharedBody RateLimiter::errorBody(uint16_t type, std::chrono::milliseconds retry_after) {
+    nlohmann::json json = {
+        {"error", "rate_limited"},
+        {"message_type", type},
+        {"retry_after_ms", retry_after.count()},
+    };
+    std::string text = json.dump();
+    return std::make_shared<const std::vector<char>>(text.begin(), text.end());
+}
+
+void RateLimiter::pruneLocked(int64_t now_ns) {
+    // A bucket that is full again behaves exactly like a new one
+    auto idle = [now_ns](const std::shared_ptr<Buckets>& buckets) {
+        if (buckets.use_count() > 1) {
+            return false;
+        }
+        return std::all_of(buckets->buckets.begin(), buckets->buckets.end(),
+                           [now_ns](const TokenBucket& bucket) { return bucket.fullAt() <= now_ns; });
+    };
+    for (BucketMap* map : {&users_, &addresses_}) {
+        for (auto it = map->begin(); it != map->end();) {
+            it = idle(it->second) ? map->erase(it) : std::next(it);
+        }
+    }
+    inserts_since_prune_ = 0;
+}
+
+void RateLimiter::prune(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(buckets_mutex_);
+    pruneLocked(toNs(now));
+}
+
+RateLimiter::Stats RateLimiter::stats() const {
+    Stats stats;
+    stats.throttled = throttled_.load(std::memory_order_relaxed);
+    stats.rejected = rejected_.load(std::memory_order_relaxed);
+    stats.paused = paused_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < TYPE_COUNT; ++i) {
+        stats.throttled_by_type[i] = throttled_by_type_[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+} // namespace chat
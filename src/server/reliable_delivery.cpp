@@ -0,0 +1,265 @@
+#include "server/reliable_delivery.h"
+#include "common/logger.h"
+#include "common/message.h"
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+namespace chat {
+
+namespace {
+
+constexpr const char* DIRECT_PREFIX = "dm:";
+
+bool isDirect(const std::string& conversation) {
+    return conversation.compare(0, 3, DIRECT_PREFIX) == 0;
+}
+
+// Whether user_id is one side of a "dm:<length of a>:<a>:<b>" key
+bool isParticipant(const std::string& conversation, const std::string& user_id) {
+    std::size_t colon = conversation.find(':', 3);
+    if (colon == std::string::npos || colon == 3) {
+        return false;
+    }
+    std::size_t length = 0;
+    for (std::size_t i = 3; i < colon; ++i) {
+        if (conversation[i] < '0' || conversation[i] > '9' || length > conversation.size()) {
+            return false;
+        }
+        length = length * 10 + static_cast<std::size_t>(conversation[i] - '0');
+    }
+    std::size_t first = colon + 1;
+    if (length >= conversation.size() - first || conversation[first + length] != ':') {
+        return false;
+    }
+    return conversation.compare(first, length, user_id) == 0 ||
+           conversation.compare(first + length + 1, std::string::npos, user_id) == 0;
+}
+
+} // namespace
+
+ReliableDelivery::Options ReliableDelivery::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.replay_window = static_cast<std::size_t>(std::max(0,
+        config.getInt("RESUME_WINDOW", static_cast<int>(options.replay_window))));
+    options.max_replay = static_cast<std::size_t>(std::max(1,
+        config.getInt("RESUME_MAX_REPLAY", static_cast<int>(options.max_replay))));
+    return options;
+}
+
+ReliableDelivery::ReliableDelivery(Options options, HistoryLoader loader, AccessCheck access)
+    : options_(options), loader_(std::move(loader)), access_(std::move(access)) {
+}
+
+uint64_t ReliableDelivery::assign(const chat_app::SharedEncodedMessage& message) {
+    std::string key = message->message().conversationId();
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Conversation& conversation = conversations_[key];
+        sequence = ++conversation.last_sequence;
+        message->modify([sequence](chat_app::ChatMessage& m) { m.sequence = sequence; });
+        remember(conversation, message);
+    }
+    assigned_.fetch_add(1, std::memory_order_relaxed);
+    return sequence;
+}
+
+void ReliableDelivery::restore(const chat_app::SharedEncodedMessage& message) {
+    uint64_t sequence = message->message().sequence;
+    if (sequence == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Conversation& conversation = conversations_[message->message().conversationId()];
+    if (sequence <= conversation.last_sequence) {
+        return;
+    }
+    // A hole in storage restarts the window so it stays consecutive
+    if (sequence != conversation.last_sequence + 1) {
+        conversation.window.clear();
+    }
+    conversation.last_sequence = sequence;
+    remember(conversation, message);
+}
+
+void ReliableDelivery::remember(Conversation& conversation, const chat_app::SharedEncodedMessage& message) {
+    if (options_.replay_window == 0) {
+        return;
+    }
+    conversation.window.push_back(message);
+    while (conversation.window.size() > options_.replay_window) {
+        conversation.window.pop_front();
+    }
+}
+
+void ReliableDelivery::acknowledge(const std::string& user_id, const Cursors& cursors) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [key, sequence] : cursors) {
+        auto conversation = conversations_.find(key);
+        if (conversation == conversations_.end() || sequence > conversation->second.last_sequence) {
+            continue;
+        }
+        uint64_t& acked = acks_[user_id][key];
+        if (sequence > acked) {
+            acked = sequence;
+            acks_applied_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t ReliableDelivery::acknowledged(const std::string& user_id, const std::string& conversation) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto user = acks_.find(user_id);
+    if (user == acks_.end()) {
+        return 0;
+    }
+    auto acked = user->second.find(conversation);
+    return acked == user->second.end() ? 0 : acked->second;
+}
+
+bool ReliableDelivery::mayRead(const std::string& user_id, const std::string& conversation) const {
+    if (isDirect(conversation)) {
+        return isParticipant(conversation, user_id);
+    }
+    return !access_ || access_(user_id, conversation);
+}
+
+ReliableDelivery::Replay ReliableDelivery::resume(const std::string& user_id, const Cursors& last_seen) const {
+    resumes_.fetch_add(1, std::memory_order_relaxed);
+
+    // Named conversations start from the client's cursor, the rest from
+    // the last ack
+    Cursors cursors = last_seen;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto acked = acks_.find(user_id);
+        if (acked != acks_.end()) {
+            for (const auto& [key, sequence] : acked->second) {
+                cursors.emplace(key, sequence);
+            }
+        }
+    }
+
+    // Stable order, so which conversations a truncated replay covers
+    // does not change between attempts
+    std::vector<std::pair<std::string, uint64_t>> ordered(cursors.begin(), cursors.end());
+    std::sort(ordered.begin(), ordered.end());
+
+    Replay replay;
+    std::size_t budget = options_.max_replay;
+    uint64_t from_storage = 0;
+    for (const auto& [key, cursor] : ordered) {
+        if (!mayRead(user_id, key)) {
+            continue;
+        }
+
+        uint64_t last = 0;
+        std::vector<chat_app::SharedEncodedMessage> recent;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto conversation = conversations_.find(key);
+            if (conversation == conversations_.end()) {
+                continue;
+            }
+            last = conversation->second.last_sequence;
+            for (const auto& message : conversation->second.window) {
+                if (message->message().sequence > cursor) {
+                    recent.push_back(message);
+                }
+            }
+        }
+        if (cursor >= last) {
+            continue;
+        }
+        if (budget == 0) {
+            replay.truncated.push_back(key);
+            continue;
+        }
+
+        // Messages between the cursor and the window come from storage
+        uint64_t next = cursor + 1;
+        uint64_t window_start = recent.empty() ? last + 1 : recent.front()->message().sequence;
+        if (next < window_start && loader_) {
+            std::size_t wanted = static_cast<std::size_t>(std::min<uint64_t>(window_start - next, budget));
+            for (auto& message : loader_(key, cursor, wanted)) {
+                uint64_t sequence = message->message().sequence;
+                if (sequence != next || sequence >= window_start) {
+                    break;
+                }
+                replay.messages.push_back(std::move(message));
+                ++next;
+                --budget;
+                ++from_storage;
+            }
+        }
+
+        if (next < window_start) {
+            // Storage could not bridge the gap; the newer messages would
+            // leave a hole, so stop here and let the client refetch
+            replay.truncated.push_back(key);
+            continue;
+        }
+        for (auto& message : recent) {
+            if (budget == 0) {
+                break;
+            }
+            replay.messages.push_back(std::move(message));
+            ++next;
+            --budget;
+        }
+        if (next <= last) {
+            replay.truncated.push_back(key);
+        }
+    }
+
+    replayed_.fetch_add(replay.messages.size(), std::memory_order_relaxed);
+    replayed_from_storage_.fetch_add(from_storage, std::memory_order_relaxed);
+    truncated_.fetch_add(replay.truncated.size(), std::memory_order_relaxed);
+    if (!replay.truncated.empty()) {
+        CHAT_LOG_DEBUG("Resume for {} left {} conversation(s) incomplete", user_id, replay.truncated.size());
+    }
+    return replay;
+}
+
+uint64_t ReliableDelivery::lastSequence(const std::string& conversation) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = conversations_.find(conversation);
+    return it == conversations_.end() ? 0 : it->second.last_sequence;
+}
+
+ReliableDelivery::Stats ReliableDelivery::stats() const {
+    Stats stats;
+    stats.assigned = assigned_.load(std::memory_order_relaxed);
+    stats.acks = acks_applied_.load(std::memory_order_relaxed);
+    stats.resumes = resumes_.load(std::memory_order_relaxed);
+    stats.replayed = replayed_.load(std::memory_order_relaxed);
+    stats.replayed_from_storage = replayed_from_storage_.load(std::memory_order_relaxed);
+    stats.truncated = truncated_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::optional<ReliableDelivery::Cursors> ReliableDelivery::parseCursors(const std::vector<char>& body) {
+    auto json = nlohmann::json::parse(body.begin(), body.end(), nullptr, false);
+    if (json.is_discarded() || !json.is_object()) {
+        return std::nullopt;
+    }
+    Cursors cursors;
+    for (auto it = json.begin(); it != json.end(); ++it) {
+        if (!it.value().is_number_unsigned()) {
+            return std::nullopt;
+        }
+        cursors[it.key()] = it.value().get<uint64_t>();
+    }
+    return cursors;
+}
+
+std::vector<char> ReliableDelivery::encodeCursors(const Cursors& cursors) {
+    nlohmann::json json = nlohmann::json::object();
+    for (const auto& [key, sequence] : cursors) {
+        json[key] = sequence;
+    }
+    std::string text = json.dump();
+    return std::vector<char>(text.begin(), text.end());
+}
+
+} // namespace chat
@@ -0,0 +1,353 @@
+#include "server/roaring_bitmap.h"
+#include <algorithm>
+#include <iterator>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace chat {
+
+namespace {
+
+// out = a & b (or a | b) over a full bitmap container; returns the popcount.
+// words is a multiple of 4.
+template <bool Union>
+std::size_t combineWords(const uint64_t* a, const uint64_t* b, uint64_t* out, std::size_t words) {
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= words; i += 4) {
+        __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i result = Union ? _mm256_or_si256(left, right) : _mm256_and_si256(left, right);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= words; i += 2) {
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i result = Union ? _mm_or_si128(left, right) : _mm_and_si128(left, right);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+    }
+#else
+    for (; i < words; ++i) {
+        out[i] = Union ? (a[i] | b[i]) : (a[i] & b[i]);
+    }
+#endif
+    std::size_t count = 0;
+    for (i = 0; i < words; ++i) {
+        count += static_cast<std::size_t>(__builtin_popcountll(out[i]));
+    }
+    return count;
+}
+
+inline bool testBit(const std::vector<uint64_t>& bits, uint16_t low) {
+    return (bits[low >> 6] >> (low & 63)) & 1;
+}
+
+} // namespace
+
+// Container
+
+bool RoaringBitmap::Container::add(uint16_t low) {
+    if (isBitmap()) {
+        uint64_t mask = uint64_t(1) << (low & 63);
+        uint64_t& word = bits[low >> 6];
+        if (word & mask) {
+            return false;
+        }
+        word |= mask;
+        ++cardinality;
+        return true;
+    }
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) {
+        return false;
+    }
+    array.insert(it, low);
+    ++cardinality;
+    if (cardinality > ARRAY_LIMIT) {
+        toBitmap();
+    }
+    return true;
+}
+
+bool RoaringBitmap::Container::remove(uint16_t low) {
+    if (isBitmap()) {
+        uint64_t mask = uint64_t(1) << (low & 63);
+        uint64_t& word = bits[low >> 6];
+        if (!(word & mask)) {
+            return false;
+        }
+        word &= ~mask;
+        --cardinality;
+        if (cardinality <= ARRAY_LIMIT / 2) {
+            // Hysteresis keeps a container near the limit from flipping
+            toArray();
+        }
+        return true;
+    }
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it == array.end() || *it != low) {
+        return false;
+    }
+    array.erase(it);
+    --cardinality;
+    return true;
+}
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (isBitmap()) {
+        return testBit(bits, low);
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::toBitmap() {
+    bits.assign(BITMAP_WORDS, 0);
+    for (uint16_t low : array) {
+        bits[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    std::vector<uint16_t>().swap(array);
+}
+
+void RoaringBitmap::Container::toArray() {
+    array.clear();
+    array.reserve(cardinality);
+    for (std::size_t word = 0; word < BITMAP_WORDS; ++word) {
+        uint64_t value = bits[word];
+        while (value != 0) {
+            array.push_back(static_cast<uint16_t>(word * 64 + __builtin_ctzll(value)));
+            value &= value - 1;
+        }
+    }
+    std::vector<uint64_t>().swap(bits);
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container& a, const Container& b) {
+    Container result;
+    if (a.isBitmap() && b.isBitmap()) {
+        result.bits.resize(BITMAP_WORDS);
+        result.cardinality = static_cast<uint32_t>(
+            combineWords<false>(a.bits.data(), b.bits.data(), result.bits.data(), BITMAP_WORDS));
+        if (result.cardinality <= ARRAY_LIMIT) {
+            result.toArray();
+        }
+        return result;
+    }
+    if (a.isBitmap() || b.isBitmap()) {
+        const Container& array = a.isBitmap() ? b : a;
+        const Container& bitmap = a.isBitmap() ? a : b;
+        for (uint16_t low : array.array) {
+            if (testBit(bitmap.bits, low)) {
+                result.array.push_back(low);
+            }
+        }
+    } else {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                              std::back_inserter(result.array));
+    }
+    result.cardinality = static_cast<uint32_t>(result.array.size());
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container& a, const Container& b) {
+    Container result;
+    if (a.isBitmap() && b.isBitmap()) {
+        result.bits.resize(BITMAP_WORDS);
+        result.cardinality = static_cast<uint32_t>(
+            combineWords<true>(a.bits.data(), b.bits.data(), result.bits.data(), BITMAP_WORDS));
+        return result;
+    }
+    if (a.isBitmap() || b.isBitmap()) {
+        const Container& array = a.isBitmap() ? b : a;
+        result = a.isBitmap() ? a : b;
+        for (uint16_t low : array.array) {
+            uint64_t mask = uint64_t(1) << (low & 63);
+            uint64_t& word = result.bits[low >> 6];
+            result.cardinality += (word & mask) == 0;
+            word |= mask;
+        }
+        return result;
+    }
+    std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                   std::back_inserter(result.array));
+    result.cardinality = static_cast<uint32_t>(result.array.size());
+    if (result.cardinality > ARRAY_LIMIT) {
+        result.toBitmap();
+    }
+    return result;
+}
+
+std::size_t RoaringBitmap::intersectCount(const Container& a, const Container& b) {
+    if (a.isBitmap() && b.isBitmap()) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < BITMAP_WORDS; ++i) {
+            count += static_cast<std::size_t>(__builtin_popcountll(a.bits[i] & b.bits[i]));
+        }
+        return count;
+    }
+    if (a.isBitmap() || b.isBitmap()) {
+        const Container& array = a.isBitmap() ? b : a;
+        const Container& bitmap = a.isBitmap() ? a : b;
+        std::size_t count = 0;
+        for (uint16_t low : array.array) {
+            count += testBit(bitmap.bits, low);
+        }
+        return count;
+    }
+    std::size_t count = 0;
+    auto left = a.array.begin();
+    auto right = b.array.begin();
+    while (left != a.array.end() && right != b.array.end()) {
+        if (*left < *right) {
+            ++left;
+        } else if (*right < *left) {
+            ++right;
+        } else {
+            ++count;
+            ++left;
+            ++right;
+        }
+    }
+    return count;
+}
+
+// RoaringBitmap
+
+std::size_t RoaringBitmap::lowerBound(uint16_t key) const {
+    return static_cast<std::size_t>(std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin());
+}
+
+bool RoaringBitmap::add(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    std::size_t index = lowerBound(key);
+    if (index == keys_.size() || keys_[index] != key) {
+        keys_.insert(keys_.begin() + index, key);
+        containers_.insert(containers_.begin() + index, Container{});
+    }
+    return containers_[index].add(static_cast<uint16_t>(value));
+}
+
+bool RoaringBitmap::remove(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    std::size_t index = lowerBound(key);
+    if (index == keys_.size() || keys_[index] != key) {
+        return false;
+    }
+    if (!containers_[index].remove(static_cast<uint16_t>(value))) {
+        return false;
+    }
+    if (containers_[index].cardinality == 0) {
+        keys_.erase(keys_.begin() + index);
+        containers_.erase(containers_.begin() + index);
+    }
+    return true;
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    std::size_t index = lowerBound(key);
+    return index < keys_.size() && keys_[index] == key && containers_[index].contains(static_cast<uint16_t>(value));
+}
+
+std::size_t RoaringBitmap::cardinality() const {
+    std::size_t count = 0;
+    for (const auto& container : containers_) {
+        count += container.cardinality;
+    }
+    return count;
+}
+
+void RoaringBitmap::clear() {
+    keys_.clear();
+    containers_.clear();
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < keys_.size() && j < other.keys_.size()) {
+        if (keys_[i] < other.keys_[j]) {
+            ++i;
+        } else if (other.keys_[j] < keys_[i]) {
+            ++j;
+        } else {
+            Container container = intersect(containers_[i], other.containers_[j]);
+            if (container.cardinality != 0) {
+                result.keys_.push_back(keys_[i]);
+                result.containers_.push_back(std::move(container));
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < keys_.size() || j < other.keys_.size()) {
+        if (j == other.keys_.size() || (i < keys_.size() && keys_[i] < other.keys_[j])) {
+            result.keys_.push_back(keys_[i]);
+            result.containers_.push_back(containers_[i++]);
+        } else if (i == keys_.size() || other.keys_[j] < keys_[i]) {
+            result.keys_.push_back(other.keys_[j]);
+            result.containers_.push_back(other.containers_[j++]);
+        } else {
+            result.keys_.push_back(keys_[i]);
+            result.containers_.push_back(unite(containers_[i++], other.containers_[j++]));
+        }
+    }
+    return result;
+}
+
+bool RoaringBitmap::operator==(const RoaringBitmap& other) const {
+    if (keys_ != other.keys_) {
+        return false;
+    }
+    for (std::size_t i = 0; i < containers_.size(); ++i) {
+        const Container& a = containers_[i];
+        const Container& b = other.containers_[i];
+        if (a.cardinality != b.cardinality || intersectCount(a, b) != a.cardinality) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t RoaringBitmap::intersectionCardinality(const RoaringBitmap& a, const RoaringBitmap& b) {
+    std::size_t count = 0;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while (i < a.keys_.size() && j < b.keys_.size()) {
+        if (a.keys_[i] < b.keys_[j]) {
+            ++i;
+        } else if (b.keys_[j] < a.keys_[i]) {
+            ++j;
+        } else {
+            count += intersectCount(a.containers_[i++], b.containers_[j++]);
+        }
+    }
+    return count;
+}
+
+std::vector<uint32_t> RoaringBitmap::toVector() const {
+    std::vector<uint32_t> values;
+    values.reserve(cardinality());
+    forEach([&](uint32_t value) { values.push_back(value); });
+    return values;
+}
+
+std::size_t RoaringBitmap::bytes() const {
+    std::size_t total = keys_.capacity() * sizeof(uint16_t) + containers_.capacity() * sizeof(Container);
+    for (const auto& container : containers_) {
+        total += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return total;
+}
+
+} // namespace chat
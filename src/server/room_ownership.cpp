@@ -0,0 +1,399 @@
+#include "server/room_ownership.h"
+#include "server/frame_helpers.h"
+#include "common/logger.h"
+#include "common/protocol.h"
+#include <algorithm>
+
+namespace chat {
+
+RoomOwnership::Options RoomOwnership::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.virtual_nodes = static_cast<std::size_t>(
+        config.getInt("CLUSTER_VIRTUAL_NODES", static_cast<int>(options.virtual_nodes)));
+    options.history_limit = static_cast<std::size_t>(config.current().message_history_limit);
+    options.handoff_grace = std::chrono::milliseconds(std::max(0,
+        config.getInt("CLUSTER_HANDOFF_GRACE_MS", static_cast<int>(options.handoff_grace.count()))));
+    return options;
+}
+
+RoomOwnership::RoomOwnership(ClusterManager& cluster, Options options)
+    : cluster_(cluster),
+      options_(options),
+      local_node_(cluster.nodeId()),
+      ring_(options.virtual_nodes) {
+}
+
+void RoomOwnership::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring_.addNode(local_node_);
+    }
+
+    cluster_.setMembershipCallback([this](const std::string& node_id, bool up) {
+        onMembership(node_id, up);
+    });
+    cluster_.setFrameHandler(frameType(chat_app::MessageType::ROOM_HANDOFF),
+                             [this](const std::string& from, const std::vector<char>& body, uint16_t) {
+                                 onHandoff(from, body);
+                             });
+    cluster_.setFrameHandler(frameType(chat_app::MessageType::ROOM_HANDOFF_ACK),
+                             [this](const std::string& from, const std::vector<char>& body, uint16_t) {
+                                 onHandoffAck(from, body);
+                             });
+    cluster_.setFrameHandler(frameType(chat_app::MessageType::ROOM_APPEND),
+                             [this](const std::string& from, const std::vector<char>& body, uint16_t flags) {
+                                 onAppend(from, body, flags);
+                             });
+    cluster_.setFrameHandler(frameType(chat_app::MessageType::ROOM_MEMBER),
+                             [this](const std::string& from, const std::vector<char>& body, uint16_t) {
+                                 onMember(from, body);
+                             });
+}
+
+void RoomOwnership::leave() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    leaving_ = true;
+    ring_.removeNode(local_node_);
+    CHAT_LOG_INFO("Leaving ring, handing off {} rooms", rooms_.size());
+    rebalanceLocked();
+}
+
+std::string RoomOwnership::ownerOf(const std::string& room_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ring_.ownerOf(room_id);
+}
+
+bool RoomOwnership::isLocalOwner(const std::string& room_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ring_.ownerOf(room_id) == local_node_;
+}
+
+std::vector<std::string> RoomOwnership::ringNodes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ring_.nodes();
+}
+
+void RoomOwnership::onMembership(const std::string& node_id, bool up) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool changed = up ? ring_.addNode(node_id) : ring_.removeNode(node_id);
+    if (changed) {
+        CHAT_LOG_INFO("Node {} {} the ring ({} nodes)", node_id, up ? "joined" : "left", ring_.size());
+        handoffs_expected_until_ = std::chrono::steady_clock::now() + options_.handoff_grace;
+        rebalanceLocked();
+    }
+}
+
+void RoomOwnership::rebalanceLocked() {
+    // Rooms owned here whose owner moved
+    for (auto it = rooms_.begin(); it != rooms_.end();) {
+        const std::string& owner = ring_.ownerOf(it->first);
+        if (owner.empty() || owner == local_node_) {
+            ++it;
+            continue;
+        }
+
+        settleLocked(it->second);
+        auto [migration_it, inserted] = migrations_.try_emplace(it->first);
+        Migration& migration = migration_it->second;
+        if (inserted) {
+            migration.state = std::move(it->second);
+        } else {
+            mergeInto(migration.state, std::move(it->second));
+        }
+        migration.new_owner = owner;
+        sendHandoffLocked(it->first, migration);
+        it = rooms_.erase(it);
+    }
+
+    // Transfers whose target is no longer the owner (it left mid-handoff)
+    for (auto it = migrations_.begin(); it != migrations_.end();) {
+        const std::string& owner = ring_.ownerOf(it->first);
+        if (owner == it->second.new_owner) {
+            ++it;
+            continue;
+        }
+
+        if (owner.empty() || owner == local_node_) {
+            RoomState& room = rooms_[it->first];
+            mergeInto(room, std::move(it->second.state));
+            room.provisional = false;
+            it = migrations_.erase(it);
+            continue;
+        }
+
+        it->second.new_owner = owner;
+        sendHandoffLocked(it->first, it->second);
+        ++it;
+    }
+}
+
+void RoomOwnership::sendHandoffLocked(const std::string& room_id, Migration& migration) {
+    const RoomState& state = migration.state;
+    nlohmann::json handoff = {
+        {"room", room_id},
+        {"members", std::vector<std::string>(state.members.begin(), state.members.end())},
+        {"removals", std::vector<std::string>(state.early_removals.begin(), state.early_removals.end())},
+        {"history", nlohmann::json::array()}
+    };
+    for (const auto& message : state.history) {
+        handoff["history"].push_back(message->message().toJson());
+    }
+
+    cluster_.sendToNode(migration.new_owner, jsonBody(handoff),
+                        frameType(chat_app::MessageType::ROOM_HANDOFF), chat_app::MessageFlags::JSON);
+    handoffs_sent_.fetch_add(1, std::memory_order_relaxed);
+    CHAT_LOG_DEBUG("Handing room {} to {} ({} members, {} messages)",
+                   room_id, migration.new_owner, state.members.size(), state.history.size());
+}
+
+void RoomOwnership::onHandoff(const std::string& from_node, const std::vector<char>& body) {
+    std::string room_id;
+    RoomState incoming;
+    try {
+        auto handoff = nlohmann::json::parse(body.begin(), body.end());
+        room_id = handoff.at("room").get<std::string>();
+        for (const auto& member : handoff.at("members")) {
+            incoming.members.insert(member.get<std::string>());
+        }
+        for (const auto& member : handoff.value("removals", nlohmann::json::array())) {
+            incoming.early_removals.insert(member.get<std::string>());
+        }
+        for (const auto& message : handoff.at("history")) {
+            incoming.history.push_back(chat_app::makeEncodedMessage(chat_app::ChatMessage::fromJson(message)));
+        }
+    } catch (const std::exception& e) {
+        CHAT_LOG_WARN("Malformed room handoff from {}: {}", from_node, e.what());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    RoomState& room = rooms_[room_id];
+    mergeInto(room, std::move(incoming));
+    room.provisional = false;
+    room.early_removals.clear();
+    handoffs_received_.fetch_add(1, std::memory_order_relaxed);
+
+    // The sender can forget the room now; if the ring moved again in the
+    // meantime, rebalancing passes it on
+    cluster_.sendToNode(from_node, jsonBody({{"room", room_id}}),
+                        frameType(chat_app::MessageType::ROOM_HANDOFF_ACK), chat_app::MessageFlags::JSON);
+    if (ring_.ownerOf(room_id) != local_node_) {
+        rebalanceLocked();
+    }
+}
+
+void RoomOwnership::onHandoffAck(const std::string& from_node, const std::vector<char>& body) {
+    std::string room_id;
+    try {
+        room_id = nlohmann::json::parse(body.begin(), body.end()).at("room").get<std::string>();
+    } catch (const std::exception& e) {
+        CHAT_LOG_WARN("Malformed handoff ack from {}: {}", from_node, e.what());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = migrations_.find(room_id);
+    if (it != migrations_.end() && it->second.new_owner == from_node) {
+        migrations_.erase(it);
+    }
+}
+
+void RoomOwnership::onAppend(const std::string& from_node, const std::vector<char>& body, uint16_t flags) {
+    chat_app::SharedEncodedMessage message;
+    try {
+        message = chat_app::makeEncodedMessage(chat_app::EncodedMessage::decode(body, flags));
+    } catch (const std::exception& e) {
+        CHAT_LOG_WARN("Malformed room append from {}: {}", from_node, e.what());
+        return;
+    }
+    if (!message->message().room_id.has_value()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // If the rings disagree, keep it here rather than bouncing it back;
+    // the next rebalance moves it to the agreed owner
+    if (ring_.ownerOf(*message->message().room_id) == from_node) {
+        RoomState& room = ownedRoomLocked(*message->message().room_id);
+        room.history.push_back(message);
+        trimHistory(room);
+        return;
+    }
+    appendLocked(message);
+}
+
+void RoomOwnership::onMember(const std::string& from_node, const std::vector<char>& body) {
+    std::string room_id;
+    std::string user_id;
+    bool joined = false;
+    try {
+        auto change = nlohmann::json::parse(body.begin(), body.end());
+        room_id = change.at("room").get<std::string>();
+        user_id = change.at("user").get<std::string>();
+        joined = change.at("joined").get<bool>();
+    } catch (const std::exception& e) {
+        CHAT_LOG_WARN("Malformed room membership change from {}: {}", from_node, e.what());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ring_.ownerOf(room_id) == from_node) {
+        RoomState& room = ownedRoomLocked(room_id);
+        if (joined) {
+            room.members.insert(user_id);
+        } else {
+            room.members.erase(user_id);
+        }
+        return;
+    }
+    memberLocked(room_id, user_id, joined);
+}
+
+void RoomOwnership::append(const chat_app::SharedEncodedMessage& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    appendLocked(message);
+}
+
+void RoomOwnership::addMember(const std::string& room_id, const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memberLocked(room_id, user_id, true);
+}
+
+void RoomOwnership::removeMember(const std::string& room_id, const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memberLocked(room_id, user_id, false);
+}
+
+void RoomOwnership::appendLocked(const chat_app::SharedEncodedMessage& message) {
+    const auto& room_id = message->message().room_id;
+    if (!room_id.has_value()) {
+        return;
+    }
+
+    const std::string& owner = ring_.ownerOf(*room_id);
+    if (owner.empty() || owner == local_node_) {
+        RoomState& room = ownedRoomLocked(*room_id);
+        room.history.push_back(message);
+        trimHistory(room);
+        return;
+    }
+
+    cluster_.sendToNode(owner, message->binary(), frameType(chat_app::MessageType::ROOM_APPEND),
+                        chat_app::MessageFlags::BINARY);
+    forwarded_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RoomOwnership::memberLocked(const std::string& room_id, const std::string& user_id, bool joined) {
+    const std::string& owner = ring_.ownerOf(room_id);
+    if (owner.empty() || owner == local_node_) {
+        RoomState& room = ownedRoomLocked(room_id);
+        settleLocked(room);
+        if (joined) {
+            room.members.insert(user_id);
+            room.early_removals.erase(user_id);
+        } else {
+            room.members.erase(user_id);
+            if (room.provisional) {
+                room.early_removals.insert(user_id);
+            }
+        }
+        return;
+    }
+
+    cluster_.sendToNode(owner, jsonBody({{"room", room_id}, {"user", user_id}, {"joined", joined}}),
+                        frameType(chat_app::MessageType::ROOM_MEMBER), chat_app::MessageFlags::JSON);
+    forwarded_.fetch_add(1, std::memory_order_relaxed);
+}
+
+RoomOwnership::RoomState& RoomOwnership::ownedRoomLocked(const std::string& room_id) {
+    auto [it, inserted] = rooms_.try_emplace(room_id);
+    // Outside the grace period no other node is still handing this room
+    // over, so it starts final
+    if (inserted && std::chrono::steady_clock::now() < handoffs_expected_until_) {
+        it->second.provisional = true;
+    }
+    return it->second;
+}
+
+void RoomOwnership::settleLocked(RoomState& room) const {
+    if (room.provisional && std::chrono::steady_clock::now() >= handoffs_expected_until_) {
+        room.provisional = false;
+        room.early_removals.clear();
+    }
+}
+
+void RoomOwnership::trimHistory(RoomState& room) const {
+    while (room.history.size() > options_.history_limit) {
+        room.history.pop_front();
+    }
+}
+
+void RoomOwnership::mergeInto(RoomState& target, RoomState&& incoming) const {
+    // Members: union, except those removed here before the state arrived
+    for (const std::string& member : incoming.members) {
+        if (target.early_removals.count(member) == 0) {
+            target.members.insert(member);
+        }
+    }
+    for (const std::string& member : incoming.early_removals) {
+        if (target.members.count(member) == 0) {
+            target.early_removals.insert(member);
+        }
+    }
+
+    // History: interleave by timestamp, dropping duplicates
+    std::vector<chat_app::SharedEncodedMessage> merged(incoming.history.begin(), incoming.history.end());
+    merged.insert(merged.end(), target.history.begin(), target.history.end());
+    std::stable_sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) {
+        return a->message().timestamp < b->message().timestamp;
+    });
+
+    std::unordered_set<std::string> seen;
+    target.history.clear();
+    for (auto& message : merged) {
+        if (seen.insert(message->message().message_id).second) {
+            target.history.push_back(std::move(message));
+        }
+    }
+    trimHistory(target);
+}
+
+std::vector<std::string> RoomOwnership::members(const std::string& room_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end()) {
+        return {};
+    }
+    std::vector<std::string> result(it->second.members.begin(), it->second.members.end());
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<chat_app::SharedEncodedMessage> RoomOwnership::history(const std::string& room_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end()) {
+        return {};
+    }
+    return std::vector<chat_app::SharedEncodedMessage>(it->second.history.begin(), it->second.history.end());
+}
+
+std::size_t RoomOwnership::roomCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rooms_.size();
+}
+
+std::size_t RoomOwnership::pendingHandoffs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return migrations_.size();
+}
+
+RoomOwnership::Stats RoomOwnership::stats() const {
+    Stats stats;
+    stats.handoffs_sent = handoffs_sent_.load(std::memory_order_relaxed);
+    stats.handoffs_received = handoffs_received_.load(std::memory_order_relaxed);
+    stats.forwarded = forwarded_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
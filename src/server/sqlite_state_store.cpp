@@ -0,0 +1,343 @@
+#include "server/sqlite_state_store.h"
+#include "common/logger.h"
+#include <sqlite3.h>
+
+namespace chat {
+
+namespace {
+
+const char* const SCHEMA =
+    "CREATE TABLE IF NOT EXISTS users ("
+    "  user_id TEXT PRIMARY KEY,"
+    "  username TEXT NOT NULL,"
+    "  status INTEGER NOT NULL,"
+    "  display_name TEXT,"
+    "  email TEXT,"
+    "  avatar_url TEXT,"
+    "  last_seen INTEGER"
+    ") WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS room_members ("
+    "  room_id TEXT NOT NULL,"
+    "  user_id TEXT NOT NULL,"
+    "  PRIMARY KEY (room_id, user_id)"
+    ") WITHOUT ROWID;"
+    "CREATE INDEX IF NOT EXISTS room_members_user ON room_members(user_id);"
+    "CREATE TABLE IF NOT EXISTS read_positions ("
+    "  user_id TEXT NOT NULL,"
+    "  room_id TEXT NOT NULL,"
+    "  position INTEGER NOT NULL,"
+    "  PRIMARY KEY (user_id, room_id)"
+    ") WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS mentions ("
+    "  user_id TEXT NOT NULL,"
+    "  room_id TEXT NOT NULL,"
+    "  position INTEGER NOT NULL,"
+    "  message_id TEXT NOT NULL,"
+    "  sender_id TEXT NOT NULL,"
+    "  PRIMARY KEY (user_id, room_id, position, message_id)"
+    ") WITHOUT ROWID;";
+
+// Indexed by SqliteStateStore::Statement
+const char* const STATEMENT_SQL[] = {
+    "BEGIN IMMEDIATE",
+    "COMMIT",
+    "ROLLBACK",
+    "INSERT INTO users (user_id, username, status, display_name, email, avatar_url, last_seen) "
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7) "
+    "ON CONFLICT(user_id) DO UPDATE SET username = ?2, status = ?3, display_name = ?4, "
+    "email = ?5, avatar_url = ?6, last_seen = ?7",
+    "DELETE FROM users WHERE user_id = ?1",
+    "DELETE FROM room_members WHERE user_id = ?1",
+    "INSERT OR IGNORE INTO room_members (room_id, user_id) VALUES (?1, ?2)",
+    "DELETE FROM room_members WHERE room_id = ?1 AND user_id = ?2",
+    "INSERT OR IGNORE INTO mentions (user_id, room_id, position, message_id, sender_id) "
+    "VALUES (?1, ?2, ?3, ?4, ?5)",
+    "INSERT INTO read_positions (user_id, room_id, position) VALUES (?1, ?2, ?3) "
+    "ON CONFLICT(user_id, room_id) DO UPDATE SET position = max(position, ?3)",
+    "DELETE FROM mentions WHERE user_id = ?1 AND room_id = ?2 AND position <= ?3",
+    "DELETE FROM mentions WHERE user_id = ?1",
+    "DELETE FROM read_positions WHERE user_id = ?1",
+    "SELECT username, status, display_name, email, avatar_url, last_seen FROM users WHERE user_id = ?1",
+    "SELECT room_id FROM room_members WHERE user_id = ?1 ORDER BY room_id",
+    "SELECT COUNT(*) FROM users",
+    "SELECT user_id, room_id, position FROM read_positions",
+    "SELECT user_id, room_id, position, message_id, sender_id FROM mentions ORDER BY user_id, position",
+};
+
+void bindText(sqlite3_stmt* statement, int index, const std::string& value) {
+    sqlite3_bind_text(statement, index, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+}
+
+void bindOptional(sqlite3_stmt* statement, int index, const std::optional<std::string>& value) {
+    if (value) {
+        bindText(statement, index, *value);
+    } else {
+        sqlite3_bind_null(statement, index);
+    }
+}
+
+std::string columnText(sqlite3_stmt* statement, int index) {
+    return std::string(reinterpret_cast<const char*>(sqlite3_column_text(statement, index)),
+                       static_cast<std::size_t>(sqlite3_column_bytes(statement, index)));
+}
+
+std::optional<std::string> columnOptional(sqlite3_stmt* statement, int index) {
+    if (sqlite3_column_type(statement, index) == SQLITE_NULL) {
+        return std::nullopt;
+    }
+    return columnText(statement, index);
+}
+
+} // namespace
+
+SqliteStateStore::~SqliteStateStore() {
+    close();
+}
+
+bool SqliteStateStore::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sqlite3_open(path.c_str(), &db_) != SQLITE_OK) {
+        CHAT_LOG_ERROR("Cannot open state database {}: {}", path, sqlite3_errmsg(db_));
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    // WAL keeps readers unblocked while an autosave commits
+    if (!exec("PRAGMA journal_mode=WAL") || !exec("PRAGMA synchronous=NORMAL") || !exec(SCHEMA)) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return false;
+    }
+    for (int i = 0; i < STATEMENT_COUNT; ++i) {
+        if (sqlite3_prepare_v2(db_, STATEMENT_SQL[i], -1, &statements_[i], nullptr) != SQLITE_OK) {
+            CHAT_LOG_ERROR("Cannot prepare state statement: {}", sqlite3_errmsg(db_));
+            for (auto*& statement : statements_) {
+                sqlite3_finalize(statement);
+                statement = nullptr;
+            }
+            sqlite3_close(db_);
+            db_ = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+void SqliteStateStore::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto*& statement : statements_) {
+        sqlite3_finalize(statement);
+        statement = nullptr;
+    }
+    if (db_) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+    }
+}
+
+bool SqliteStateStore::exec(const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db_, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        CHAT_LOG_ERROR("State database error: {}", error ? error : "unknown");
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+bool SqliteStateStore::step(Statement statement) {
+    sqlite3_stmt* prepared = statements_[statement];
+    int result = sqlite3_step(prepared);
+    sqlite3_reset(prepared);
+    sqlite3_clear_bindings(prepared);
+    if (result != SQLITE_DONE) {
+        CHAT_LOG_ERROR("State database error: {}", sqlite3_errmsg(db_));
+        return false;
+    }
+    return true;
+}
+
+bool SqliteStateStore::writeUser(const UserChange& change) {
+    const chat_app::User& user = change.user;
+
+    if (change.fields & ~chat_app::UserFields::ROOMS) {
+        sqlite3_stmt* upsert = statements_[UPSERT_USER];
+        bindText(upsert, 1, user.user_id);
+        bindText(upsert, 2, user.username);
+        sqlite3_bind_int(upsert, 3, static_cast<int>(user.status));
+        bindOptional(upsert, 4, user.display_name);
+        bindOptional(upsert, 5, user.email);
+        bindOptional(upsert, 6, user.avatar_url);
+        if (user.last_seen) {
+            sqlite3_bind_int64(upsert, 7, std::chrono::duration_cast<std::chrono::milliseconds>(
+                user.last_seen->time_since_epoch()).count());
+        } else {
+            sqlite3_bind_null(upsert, 7);
+        }
+        if (!step(UPSERT_USER)) {
+            return false;
+        }
+    }
+
+    if (change.fields & chat_app::UserFields::ROOMS) {
+        // room_ids is small; replacing the user's rows beats diffing them
+        bindText(statements_[DELETE_USER_ROOMS], 1, user.user_id);
+        if (!step(DELETE_USER_ROOMS)) {
+            return false;
+        }
+        for (const auto& room_id : user.room_ids) {
+            bindText(statements_[INSERT_MEMBER], 1, room_id);
+            bindText(statements_[INSERT_MEMBER], 2, user.user_id);
+            if (!step(INSERT_MEMBER)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool SqliteStateStore::apply(const ChangeBatch& batch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!db_) {
+        return false;
+    }
+    if (!step(BEGIN)) {
+        return false;
+    }
+
+    bool ok = true;
+    for (const auto& change : batch.users) {
+        if (!(ok = writeUser(change))) {
+            break;
+        }
+    }
+    for (std::size_t i = 0; ok && i < batch.memberships.size(); ++i) {
+        const auto& change = batch.memberships[i];
+        Statement statement = change.joined ? INSERT_MEMBER : DELETE_MEMBER;
+        bindText(statements_[statement], 1, change.room_id);
+        bindText(statements_[statement], 2, change.user_id);
+        ok = step(statement);
+    }
+    for (std::size_t i = 0; ok && i < batch.mentions.size(); ++i) {
+        const auto& mention = batch.mentions[i];
+        sqlite3_stmt* insert = statements_[INSERT_MENTION];
+        bindText(insert, 1, mention.user_id);
+        bindText(insert, 2, mention.room_id);
+        sqlite3_bind_int64(insert, 3, static_cast<sqlite3_int64>(mention.position));
+        bindText(insert, 4, mention.message_id);
+        bindText(insert, 5, mention.sender_id);
+        ok = step(INSERT_MENTION);
+    }
+    // After the mentions, so ones read within the same batch are dropped
+    for (std::size_t i = 0; ok && i < batch.read_positions.size(); ++i) {
+        const auto& change = batch.read_positions[i];
+        for (Statement statement : {UPSERT_READ_POSITION, DELETE_READ_MENTIONS}) {
+            bindText(statements_[statement], 1, change.user_id);
+            bindText(statements_[statement], 2, change.room_id);
+            sqlite3_bind_int64(statements_[statement], 3, static_cast<sqlite3_int64>(change.position));
+            if (!(ok = step(statement))) {
+                break;
+            }
+        }
+    }
+
+    // Last, so nothing above recreates rows of a removed user
+    for (std::size_t i = 0; ok && i < batch.removed_users.size(); ++i) {
+        for (Statement statement : {DELETE_USER, DELETE_USER_ROOMS, DELETE_USER_MENTIONS, DELETE_USER_READ_POSITIONS}) {
+            bindText(statements_[statement], 1, batch.removed_users[i]);
+            if (!(ok = step(statement))) {
+                break;
+            }
+        }
+    }
+
+    if (ok && step(COMMIT)) {
+        return true;
+    }
+    step(ROLLBACK);
+    return false;
+}
+
+std::optional<chat_app::User> SqliteStateStore::loadUser(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!db_) {
+        return std::nullopt;
+    }
+
+    sqlite3_stmt* select = statements_[SELECT_USER];
+    bindText(select, 1, user_id);
+    std::optional<chat_app::User> user;
+    if (sqlite3_step(select) == SQLITE_ROW) {
+        user.emplace(user_id, reinterpret_cast<const char*>(sqlite3_column_text(select, 0)),
+                     static_cast<chat_app::UserStatus>(sqlite3_column_int(select, 1)));
+        user->display_name = columnOptional(select, 2);
+        user->email = columnOptional(select, 3);
+        user->avatar_url = columnOptional(select, 4);
+        if (sqlite3_column_type(select, 5) != SQLITE_NULL) {
+            user->last_seen = std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(sqlite3_column_int64(select, 5)));
+        }
+    }
+    sqlite3_reset(select);
+    sqlite3_clear_bindings(select);
+    if (!user) {
+        return std::nullopt;
+    }
+
+    sqlite3_stmt* rooms = statements_[SELECT_USER_ROOMS];
+    bindText(rooms, 1, user_id);
+    while (sqlite3_step(rooms) == SQLITE_ROW) {
+        user->room_ids.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(rooms, 0)));
+    }
+    sqlite3_reset(rooms);
+    sqlite3_clear_bindings(rooms);
+    return user;
+}
+
+std::size_t SqliteStateStore::userCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!db_) {
+        return 0;
+    }
+    sqlite3_stmt* count = statements_[COUNT_USERS];
+    std::size_t users = 0;
+    if (sqlite3_step(count) == SQLITE_ROW) {
+        users = static_cast<std::size_t>(sqlite3_column_int64(count, 0));
+    }
+    sqlite3_reset(count);
+    return users;
+}
+
+bool SqliteStateStore::loadNotifications(const std::function<void(const ReadPositionChange&)>& on_read_position,
+                                         const std::function<void(const Mention&)>& on_mention) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!db_) {
+        return false;
+    }
+
+    sqlite3_stmt* positions = statements_[SELECT_READ_POSITIONS];
+    int result;
+    while ((result = sqlite3_step(positions)) == SQLITE_ROW) {
+        on_read_position(ReadPositionChange{columnText(positions, 1), columnText(positions, 0),
+                                            static_cast<uint64_t>(sqlite3_column_int64(positions, 2))});
+    }
+    sqlite3_reset(positions);
+    if (result != SQLITE_DONE) {
+        CHAT_LOG_ERROR("State database error: {}", sqlite3_errmsg(db_));
+        return false;
+    }
+
+    sqlite3_stmt* mentions = statements_[SELECT_MENTIONS];
+    while ((result = sqlite3_step(mentions)) == SQLITE_ROW) {
+        on_mention(Mention{columnText(mentions, 1), columnText(mentions, 0), columnText(mentions, 3),
+                           columnText(mentions, 4), static_cast<uint64_t>(sqlite3_column_int64(mentions, 2))});
+    }
+    sqlite3_reset(mentions);
+    if (result != SQLITE_DONE) {
+        CHAT_LOG_ERROR("State database error: {}", sqlite3_errmsg(db_));
+        return false;
+    }
+    return true;
+}
+
+} // namespace chat
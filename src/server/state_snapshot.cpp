@@ -0,0 +1,545 @@
+#include "server/state_snapshot.h"
+#include "common/crc32c.h"
+#include "common/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace chat {
+
+namespace {
+
+// File layout (host byte order, 8-byte aligned sections):
+//   FileHeader | UserRecord[user_count] | RoomRecord[room_count]
+//   | uint32_t links[link_count] (padded to 8) | string pool
+constexpr char SNAPSHOT_MAGIC[8] = {'C', 'H', 'A', 'T', 'S', 'N', 'A', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t crc;           // CRC-32C of everything after the header
+    uint64_t sequence;      // Last state change included
+    int64_t created_ms;
+    uint64_t user_count;
+    uint64_t room_count;
+    uint64_t link_count;
+    uint64_t strings_size;
+};
+
+struct StringRef {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t present;       // 0 for an absent optional field
+};
+
+struct UserRecord {
+    StringRef user_id;
+    StringRef username;
+    StringRef display_name;
+    StringRef email;
+    StringRef avatar_url;
+    int64_t last_seen_ms;
+    uint64_t rooms_begin;   // Into links
+    uint32_t room_count;
+    uint8_t status;
+    uint8_t has_last_seen;
+    uint8_t reserved[2];
+};
+
+struct RoomRecord {
+    StringRef room_id;
+    StringRef name;
+    StringRef creator_id;
+    uint64_t members_begin; // Into links
+    uint32_t member_count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FileHeader) == 64, "snapshot header layout changed");
+static_assert(sizeof(UserRecord) == 104, "snapshot user layout changed");
+static_assert(sizeof(RoomRecord) == 64, "snapshot room layout changed");
+static_assert(std::is_trivially_copyable_v<UserRecord> && std::is_trivially_copyable_v<RoomRecord>,
+              "snapshot records are written as raw bytes");
+
+std::size_t alignedLinks(uint64_t link_count) {
+    return static_cast<std::size_t>((link_count * sizeof(uint32_t) + 7) & ~uint64_t{7});
+}
+
+int64_t toMillis(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point fromMillis(int64_t millis) {
+    return std::chrono::system_clock::time_point(std::chrono::milliseconds(millis));
+}
+
+// Appends strings to the pool
+class StringPool {
+public:
+    StringRef add(std::string_view value) {
+        StringRef ref{pool_.size(), static_cast<uint32_t>(value.size()), 1};
+        pool_.append(value);
+        return ref;
+    }
+
+    StringRef addOptional(const std::optional<std::string>& value) {
+        return value ? add(*value) : StringRef{0, 0, 0};
+    }
+
+    const std::string& data() const { return pool_; }
+
+private:
+    std::string pool_;
+};
+
+bool writeFile(FILE* file, const void* data, std::size_t size, uint32_t& crc) {
+    crc = chat_app::crc32c(crc, data, size);
+    return size == 0 || std::fwrite(data, 1, size, file) == size;
+}
+
+} // namespace
+
+// StateSnapshotWriter
+
+void StateSnapshotWriter::addUser(const chat_app::User& user) {
+    users_.push_back(user);
+}
+
+void StateSnapshotWriter::addRoom(SnapshotRoom room) {
+    rooms_.push_back(std::move(room));
+}
+
+bool StateSnapshotWriter::write(const std::string& path, uint64_t sequence) {
+    std::sort(users_.begin(), users_.end(),
+              [](const chat_app::User& a, const chat_app::User& b) { return a.user_id < b.user_id; });
+    std::sort(rooms_.begin(), rooms_.end(),
+              [](const SnapshotRoom& a, const SnapshotRoom& b) { return a.room_id < b.room_id; });
+
+    std::unordered_map<std::string_view, uint32_t> user_index;
+    std::unordered_map<std::string_view, uint32_t> room_index;
+    user_index.reserve(users_.size());
+    room_index.reserve(rooms_.size());
+    for (uint32_t i = 0; i < users_.size(); ++i) {
+        user_index.emplace(users_[i].user_id, i);
+    }
+    for (uint32_t i = 0; i < rooms_.size(); ++i) {
+        room_index.emplace(rooms_[i].room_id, i);
+    }
+
+    StringPool strings;
+    std::vector<uint32_t> links;
+    std::vector<UserRecord> user_records(users_.size());
+    std::vector<RoomRecord> room_records(rooms_.size());
+
+    for (std::size_t i = 0; i < users_.size(); ++i) {
+        const chat_app::User& user = users_[i];
+        UserRecord& record = user_records[i];
+        record.user_id = strings.add(user.user_id);
+        record.username = strings.add(user.username);
+        record.display_name = strings.addOptional(user.display_name);
+        record.email = strings.addOptional(user.email);
+        record.avatar_url = strings.addOptional(user.avatar_url);
+        record.has_last_seen = user.last_seen.has_value() ? 1 : 0;
+        record.last_seen_ms = user.last_seen ? toMillis(*user.last_seen) : 0;
+        record.status = static_cast<uint8_t>(user.status);
+        record.rooms_begin = links.size();
+        for (const auto& room_id : user.room_ids) {
+            auto it = room_index.find(room_id);
+            if (it != room_index.end()) {
+                links.push_back(it->second);
+            }
+        }
+        record.room_count = static_cast<uint32_t>(links.size() - record.rooms_begin);
+    }
+
+    for (std::size_t i = 0; i < rooms_.size(); ++i) {
+        const SnapshotRoom& room = rooms_[i];
+        RoomRecord& record = room_records[i];
+        record.room_id = strings.add(room.room_id);
+        record.name = strings.add(room.name);
+        record.creator_id = strings.add(room.creator_id);
+        record.members_begin = links.size();
+        for (const auto& member_id : room.member_ids) {
+            auto it = user_index.find(member_id);
+            if (it != user_index.end()) {
+                links.push_back(it->second);
+            }
+        }
+        record.member_count = static_cast<uint32_t>(links.size() - record.members_begin);
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.sequence = sequence;
+    header.created_ms = toMillis(std::chrono::system_clock::now());
+    header.user_count = user_records.size();
+    header.room_count = room_records.size();
+    header.link_count = links.size();
+    header.strings_size = strings.data().size();
+    links.resize(alignedLinks(links.size()) / sizeof(uint32_t), 0);
+
+    // Write beside the target and rename over it once synced
+    const std::string temp_path = path + ".tmp";
+    fs::path directory = fs::path(path).parent_path();
+    if (!directory.empty()) {
+        std::error_code error;
+        fs::create_directories(directory, error);
+    }
+
+    FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        CHAT_LOG_ERROR("Cannot create snapshot {}: {}", temp_path, std::strerror(errno));
+        return false;
+    }
+
+    uint32_t crc = 0;
+    uint32_t header_crc = 0;
+    bool ok = writeFile(file, &header, sizeof(header), header_crc) &&
+              writeFile(file, user_records.data(), user_records.size() * sizeof(UserRecord), crc) &&
+              writeFile(file, room_records.data(), room_records.size() * sizeof(RoomRecord), crc) &&
+              writeFile(file, links.data(), links.size() * sizeof(uint32_t), crc) &&
+              writeFile(file, strings.data().data(), strings.data().size(), crc);
+
+    // The checksum goes into the header last
+    header.crc = crc;
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && writeFile(file, &header, sizeof(header), header_crc) &&
+         std::fflush(file) == 0 && ::fsync(::fileno(file)) == 0;
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        CHAT_LOG_ERROR("Cannot write snapshot {}: {}", path, std::strerror(errno));
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    int dir = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+    return true;
+}
+
+// StateSnapshot
+
+StateSnapshot::~StateSnapshot() {
+    close();
+}
+
+bool StateSnapshot::open(const std::string& path, bool verify_checksum) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        CHAT_LOG_WARN("Ignoring truncated snapshot {}", path);
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(info.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        CHAT_LOG_WARN("Cannot map snapshot {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    data_ = static_cast<const char*>(map);
+    size_ = size;
+
+    // Sections must add up to exactly the file size
+    const auto* header = reinterpret_cast<const FileHeader*>(data_);
+    bool valid = std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == SNAPSHOT_VERSION &&
+                 header->user_count <= size / sizeof(UserRecord) &&
+                 header->room_count <= size / sizeof(RoomRecord) &&
+                 header->link_count <= size / sizeof(uint32_t) &&
+                 header->strings_size <= size &&
+                 sizeof(FileHeader) + header->user_count * sizeof(UserRecord) +
+                         header->room_count * sizeof(RoomRecord) + alignedLinks(header->link_count) +
+                         header->strings_size == size;
+    if (valid && verify_checksum) {
+        valid = chat_app::crc32c(0, data_ + sizeof(FileHeader), size_ - sizeof(FileHeader)) == header->crc;
+    }
+    if (!valid) {
+        CHAT_LOG_WARN("Ignoring damaged snapshot {}", path);
+        close();
+        return false;
+    }
+
+    // Lookups binary search the tables; let the kernel read ahead
+    ::madvise(const_cast<char*>(data_), size_, MADV_WILLNEED);
+    return true;
+}
+
+void StateSnapshot::close() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+uint64_t StateSnapshot::sequence() const {
+    return data_ ? reinterpret_cast<const FileHeader*>(data_)->sequence : 0;
+}
+
+std::chrono::system_clock::time_point StateSnapshot::createdAt() const {
+    return data_ ? fromMillis(reinterpret_cast<const FileHeader*>(data_)->created_ms)
+                 : std::chrono::system_clock::time_point();
+}
+
+std::size_t StateSnapshot::userCount() const {
+    return data_ ? reinterpret_cast<const FileHeader*>(data_)->user_count : 0;
+}
+
+std::size_t StateSnapshot::roomCount() const {
+    return data_ ? reinterpret_cast<const FileHeader*>(data_)->room_count : 0;
+}
+
+std::string_view StateSnapshot::string(const void* ref) const {
+    const auto* value = static_cast<const StringRef*>(ref);
+    const auto* header = reinterpret_cast<const FileHeader*>(data_);
+    if (value->offset + value->length > header->strings_size) {
+        return {};
+    }
+    const char* strings = data_ + size_ - header->strings_size;
+    return std::string_view(strings + value->offset, value->length);
+}
+
+StateSnapshot::UserView StateSnapshot::user(std::size_t index) const {
+    const auto* records = reinterpret_cast<const UserRecord*>(data_ + sizeof(FileHeader));
+    const UserRecord& record = records[index];
+    const auto* header = reinterpret_cast<const FileHeader*>(data_);
+    const auto* links = reinterpret_cast<const uint32_t*>(
+        data_ + sizeof(FileHeader) + header->user_count * sizeof(UserRecord) + header->room_count * sizeof(RoomRecord));
+
+    UserView view;
+    view.user_id = string(&record.user_id);
+    view.username = string(&record.username);
+    view.status = static_cast<chat_app::UserStatus>(record.status);
+    if (record.display_name.present) {
+        view.display_name = string(&record.display_name);
+    }
+    if (record.email.present) {
+        view.email = string(&record.email);
+    }
+    if (record.avatar_url.present) {
+        view.avatar_url = string(&record.avatar_url);
+    }
+    if (record.has_last_seen) {
+        view.last_seen = fromMillis(record.last_seen_ms);
+    }
+    if (record.rooms_begin + record.room_count <= header->link_count) {
+        view.rooms = links + record.rooms_begin;
+        view.room_count = record.room_count;
+    }
+    return view;
+}
+
+StateSnapshot::RoomView StateSnapshot::room(std::size_t index) const {
+    const auto* header = reinterpret_cast<const FileHeader*>(data_);
+    const auto* records = reinterpret_cast<const RoomRecord*>(
+        data_ + sizeof(FileHeader) + header->user_count * sizeof(UserRecord));
+    const RoomRecord& record = records[index];
+    const auto* links = reinterpret_cast<const uint32_t*>(
+        data_ + sizeof(FileHeader) + header->user_count * sizeof(UserRecord) + header->room_count * sizeof(RoomRecord));
+
+    RoomView view;
+    view.room_id = string(&record.room_id);
+    view.name = string(&record.name);
+    view.creator_id = string(&record.creator_id);
+    if (record.members_begin + record.member_count <= header->link_count) {
+        view.members = links + record.members_begin;
+        view.member_count = record.member_count;
+    }
+    return view;
+}
+
+std::optional<std::size_t> StateSnapshot::findUser(std::string_view user_id) const {
+    std::size_t low = 0;
+    std::size_t high = userCount();
+    while (low < high) {
+        std::size_t middle = low + (high - low) / 2;
+        const auto* record = reinterpret_cast<const UserRecord*>(data_ + sizeof(FileHeader)) + middle;
+        int order = string(&record->user_id).compare(user_id);
+        if (order == 0) {
+            return middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::size_t> StateSnapshot::findRoom(std::string_view room_id) const {
+    std::size_t low = 0;
+    std::size_t high = roomCount();
+    while (low < high) {
+        std::size_t middle = low + (high - low) / 2;
+        int order = room(middle).room_id.compare(room_id);
+        if (order == 0) {
+            return middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return std::nullopt;
+}
+
+chat_app::User StateSnapshot::loadUser(std::size_t index) const {
+    UserView view = user(index);
+    chat_app::User user(std::string(view.user_id), std::string(view.username), view.status);
+    if (view.display_name) {
+        user.display_name = std::string(*view.display_name);
+    }
+    if (view.email) {
+        user.email = std::string(*view.email);
+    }
+    if (view.avatar_url) {
+        user.avatar_url = std::string(*view.avatar_url);
+    }
+    user.last_seen = view.last_seen;
+    user.room_ids.reserve(view.room_count);
+    for (std::size_t i = 0; i < view.room_count; ++i) {
+        if (view.rooms[i] < roomCount()) {
+            user.room_ids.emplace_back(room(view.rooms[i]).room_id);
+        }
+    }
+    return user;
+}
+
+// SnapshotScheduler
+
+SnapshotScheduler::Options SnapshotScheduler::Options::fromConfig(const ConfigLoader& config) {
+    Options options;
+    options.path = config.getString("SNAPSHOT_PATH", options.path);
+    options.interval = std::chrono::seconds(config.getAutosaveInterval());
+    return options;
+}
+
+SnapshotScheduler::SnapshotScheduler(boost::asio::io_context& io_context, Options options, Collector collector)
+    : timer_(boost::asio::make_strand(io_context)),
+      options_(std::move(options)),
+      collector_(std::move(collector)) {
+}
+
+SnapshotScheduler::~SnapshotScheduler() {
+    stop();
+}
+
+void SnapshotScheduler::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            return;
+        }
+        running_ = true;
+    }
+    worker_ = std::thread([this]() { workerLoop(); });
+    if (options_.interval.count() > 0) {
+        boost::asio::post(timer_.get_executor(), [this]() { scheduleTimer(); });
+    }
+}
+
+void SnapshotScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    // The timer belongs to its strand: a handler running right now sees
+    // running_ cleared and stops re-arming, and the cancel runs after it
+    boost::asio::post(timer_.get_executor(), [this]() { timer_.cancel(); });
+    cv_.notify_all();
+    worker_.join();
+}
+
+void SnapshotScheduler::requestSnapshot() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requested_ = true;
+    }
+    cv_.notify_all();
+}
+
+void SnapshotScheduler::scheduleTimer() {
+    timer_.expires_after(options_.interval);
+    timer_.async_wait([this](const boost::system::error_code& error) {
+        if (error) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            requested_ = true;
+        }
+        cv_.notify_all();
+        scheduleTimer();
+    });
+}
+
+void SnapshotScheduler::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        // A snapshot requested before stop() is still written
+        cv_.wait(lock, [this]() { return requested_ || !running_; });
+        if (!requested_) {
+            return;
+        }
+        requested_ = false;
+        lock.unlock();
+
+        auto started = std::chrono::steady_clock::now();
+        StateSnapshotWriter writer;
+        uint64_t sequence = collector_(writer);
+        if (writer.write(options_.path, sequence)) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - started).count();
+            snapshots_.fetch_add(1, std::memory_order_relaxed);
+            last_users_.store(writer.userCount(), std::memory_order_relaxed);
+            last_duration_ms_.store(static_cast<uint64_t>(elapsed), std::memory_order_relaxed);
+            CHAT_LOG_INFO("Snapshot {} written: {} users, {} rooms at sequence {} in {} ms",
+                          options_.path, writer.userCount(), writer.roomCount(), sequence, elapsed);
+        } else {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        lock.lock();
+    }
+}
+
+SnapshotScheduler::Stats SnapshotScheduler::stats() const {
+    Stats stats;
+    stats.snapshots = snapshots_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    stats.last_users = last_users_.load(std::memory_order_relaxed);
+    stats.last_duration_ms = last_duration_ms_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace chat
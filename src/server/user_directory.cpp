@@ -0,0 +1,479 @@
+#include "server/user_directory.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace chat {
+
+namespace {
+
+// Bit b set if data[b] == value, for 32 consecutive bytes
+inline uint32_t matchMask32(const uint8_t* data, uint8_t value) {
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8(static_cast<char>(value));
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(value));
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+    uint32_t low_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle)));
+    uint32_t high_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle)));
+    return low_mask | (high_mask << 16);
+#else
+    uint32_t mask = 0;
+    for (int b = 0; b < 32; ++b) {
+        mask |= static_cast<uint32_t>(data[b] == value) << b;
+    }
+    return mask;
+#endif
+}
+
+// Same for the bytes of a final partial block
+inline uint32_t matchMaskTail(const uint8_t* data, std::size_t size, uint8_t value) {
+    uint32_t mask = 0;
+    for (std::size_t b = 0; b < size; ++b) {
+        mask |= static_cast<uint32_t>(data[b] == value) << b;
+    }
+    return mask;
+}
+
+inline std::size_t popcount(uint32_t mask) {
+    return static_cast<std::size_t>(__builtin_popcount(mask));
+}
+
+// Number of values >= threshold (threshold > 0)
+std::size_t countAtLeast(const uint32_t* data, std::size_t size, uint32_t threshold) {
+    std::size_t count = 0;
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    // Flip the sign bit so the signed compare orders unsigned values
+    const __m256i bias = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+    const __m256i floor = _mm256_set1_epi32(static_cast<int>((threshold - 1) ^ 0x80000000u));
+    for (; i + 8 <= size; i += 8) {
+        __m256i chunk = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), bias);
+        count += popcount(static_cast<uint32_t>(
+            _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(chunk, floor)))));
+    }
+#elif defined(__SSE2__)
+    const __m128i bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i floor = _mm_set1_epi32(static_cast<int>((threshold - 1) ^ 0x80000000u));
+    for (; i + 4 <= size; i += 4) {
+        __m128i chunk = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), bias);
+        count += popcount(static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(chunk, floor)))));
+    }
+#endif
+    for (; i < size; ++i) {
+        count += data[i] >= threshold;
+    }
+    return count;
+}
+
+uint32_t toSeconds(std::chrono::system_clock::time_point time) {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+    return static_cast<uint32_t>(std::clamp<int64_t>(seconds, 1, UINT32_MAX));
+}
+
+} // namespace
+
+std::optional<StringArena::Ref> StringArena::intern(std::string_view value) {
+    if (value.size() > MAX_LENGTH) {
+        return std::nullopt;
+    }
+    auto it = interned_.find(value);
+    if (it != interned_.end()) {
+        return it->second;
+    }
+    if (used_ + value.size() > BLOCK_SIZE) {
+        blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+        used_ = 0;
+    }
+    Ref ref;
+    ref.offset = static_cast<uint32_t>(((blocks_.size() - 1) << 16) | used_);
+    ref.length = static_cast<uint16_t>(value.size());
+    if (!value.empty()) {
+        std::memcpy(blocks_.back().get() + used_, value.data(), value.size());
+    }
+    used_ += value.size();
+    interned_.emplace(this->view(ref), ref);
+    return ref;
+}
+
+UserDirectory::Slot UserDirectory::allocateSlot() {
+    if (!free_slots_.empty()) {
+        Slot slot = free_slots_.back();
+        free_slots_.pop_back();
+        return slot;
+    }
+    Slot slot = static_cast<Slot>(status_.size());
+    status_.push_back(FREE_SLOT);
+    last_seen_.push_back(0);
+    user_id_.emplace_back();
+    username_.emplace_back();
+    display_name_.emplace_back();
+    rooms_.emplace_back();
+    return slot;
+}
+
+void UserDirectory::releaseSlot(Slot slot) {
+    setStatusLocked(slot, FREE_SLOT);
+    last_seen_[slot] = 0;
+    free_slots_.push_back(slot);
+}
+
+std::optional<uint32_t> UserDirectory::findRoomLocked(std::string_view room_id) const {
+    auto it = room_index_.find(room_id);
+    if (it == room_index_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<uint32_t> UserDirectory::internRoomLocked(std::string_view room_id) {
+    if (auto room = findRoomLocked(room_id)) {
+        return room;
+    }
+    auto ref = arena_.intern(room_id);
+    if (!ref) {
+        return std::nullopt;
+    }
+    uint32_t room = static_cast<uint32_t>(room_ids_.size());
+    room_ids_.push_back(*ref);
+    room_members_.emplace_back();
+    room_index_.emplace(arena_.view(*ref), room);
+    return room;
+}
+
+bool UserDirectory::joinLocked(uint32_t room, Slot slot) {
+    if (!room_members_[room].add(slot)) {
+        return false;
+    }
+    rooms_[slot].push_back(room);
+    return true;
+}
+
+void UserDirectory::removeFromRoomsLocked(Slot slot) {
+    for (uint32_t room : rooms_[slot]) {
+        room_members_[room].remove(slot);
+    }
+    rooms_[slot].clear();
+}
+
+void UserDirectory::setStatusLocked(Slot slot, uint8_t status) {
+    status_[slot] = status;
+    if (status == static_cast<uint8_t>(chat_app::UserStatus::ONLINE)) {
+        online_.add(slot);
+    } else {
+        online_.remove(slot);
+    }
+}
+
+std::optional<UserDirectory::Slot> UserDirectory::upsert(const chat_app::User& user) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    auto user_id = arena_.intern(user.user_id);
+    auto username = arena_.intern(user.username);
+    std::optional<StringArena::Ref> display_name = StringArena::Ref{NO_NAME, 0};
+    if (user.display_name) {
+        display_name = arena_.intern(*user.display_name);
+    }
+    if (!user_id || !username || !display_name) {
+        return std::nullopt;
+    }
+
+    Slot slot;
+    auto it = slots_.find(user.user_id);
+    if (it != slots_.end()) {
+        slot = it->second;
+        removeFromRoomsLocked(slot);
+    } else {
+        slot = allocateSlot();
+        slots_.emplace(arena_.view(*user_id), slot);
+    }
+
+    setStatusLocked(slot, static_cast<uint8_t>(user.status));
+    last_seen_[slot] = user.last_seen ? toSeconds(*user.last_seen) : 0;
+    user_id_[slot] = *user_id;
+    username_[slot] = *username;
+    display_name_[slot] = *display_name;
+    for (const auto& room_id : user.room_ids) {
+        if (auto room = internRoomLocked(room_id)) {
+            joinLocked(*room, slot);
+        }
+    }
+    return slot;
+}
+
+bool UserDirectory::remove(std::string_view user_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    if (it == slots_.end()) {
+        return false;
+    }
+    Slot slot = it->second;
+    slots_.erase(it);
+    removeFromRoomsLocked(slot);
+    releaseSlot(slot);
+    return true;
+}
+
+bool UserDirectory::setStatus(std::string_view user_id, chat_app::UserStatus status) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    if (it == slots_.end()) {
+        return false;
+    }
+    setStatusLocked(it->second, static_cast<uint8_t>(status));
+    return true;
+}
+
+bool UserDirectory::setLastSeen(std::string_view user_id, std::chrono::system_clock::time_point time) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    if (it == slots_.end()) {
+        return false;
+    }
+    last_seen_[it->second] = toSeconds(time);
+    return true;
+}
+
+bool UserDirectory::joinRoom(std::string_view room_id, std::string_view user_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    if (it == slots_.end()) {
+        return false;
+    }
+    auto room = internRoomLocked(room_id);
+    return room && joinLocked(*room, it->second);
+}
+
+bool UserDirectory::leaveRoom(std::string_view room_id, std::string_view user_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    auto room = findRoomLocked(room_id);
+    if (it == slots_.end() || !room) {
+        return false;
+    }
+    Slot slot = it->second;
+    if (!room_members_[*room].remove(slot)) {
+        return false;
+    }
+    auto& rooms = rooms_[slot];
+    rooms.erase(std::find(rooms.begin(), rooms.end(), *room));
+    return true;
+}
+
+UserDirectory::UserView UserDirectory::viewLocked(Slot slot) const {
+    UserView view;
+    view.slot = slot;
+    view.user_id = arena_.view(user_id_[slot]);
+    view.username = arena_.view(username_[slot]);
+    if (display_name_[slot].offset != NO_NAME) {
+        view.display_name = arena_.view(display_name_[slot]);
+    }
+    view.status = static_cast<chat_app::UserStatus>(status_[slot]);
+    if (last_seen_[slot] != 0) {
+        view.last_seen = std::chrono::system_clock::time_point(std::chrono::seconds(last_seen_[slot]));
+    }
+    return view;
+}
+
+std::optional<UserDirectory::Slot> UserDirectory::find(std::string_view user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    if (it == slots_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<UserDirectory::UserView> UserDirectory::lookup(std::string_view user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    if (it == slots_.end()) {
+        return std::nullopt;
+    }
+    return viewLocked(it->second);
+}
+
+std::optional<chat_app::User> UserDirectory::toUser(std::string_view user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    if (it == slots_.end()) {
+        return std::nullopt;
+    }
+    UserView view = viewLocked(it->second);
+    chat_app::User user(std::string(view.user_id), std::string(view.username), view.status);
+    if (view.display_name) {
+        user.display_name = std::string(*view.display_name);
+    }
+    user.last_seen = view.last_seen;
+    for (uint32_t room : rooms_[it->second]) {
+        user.room_ids.emplace_back(arena_.view(room_ids_[room]));
+    }
+    return user;
+}
+
+std::size_t UserDirectory::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return slots_.size();
+}
+
+std::size_t UserDirectory::countWithStatusLocked(uint8_t status) const {
+    const uint8_t* data = status_.data();
+    std::size_t size = status_.size();
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        count += popcount(matchMask32(data + i, status));
+    }
+    return count + popcount(matchMaskTail(data + i, size - i, status));
+}
+
+UserDirectory::PresenceCounts UserDirectory::countByStatus() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const uint8_t* data = status_.data();
+    std::size_t size = status_.size();
+    std::size_t counts[4] = {};
+
+    // One pass over the array; four compares per block stay in registers
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (uint8_t status = 0; status < 4; ++status) {
+            counts[status] += popcount(matchMask32(data + i, status));
+        }
+    }
+    for (uint8_t status = 0; status < 4; ++status) {
+        counts[status] += popcount(matchMaskTail(data + i, size - i, status));
+    }
+
+    PresenceCounts result;
+    result.offline = counts[static_cast<int>(chat_app::UserStatus::OFFLINE)];
+    result.online = counts[static_cast<int>(chat_app::UserStatus::ONLINE)];
+    result.away = counts[static_cast<int>(chat_app::UserStatus::AWAY)];
+    result.do_not_disturb = counts[static_cast<int>(chat_app::UserStatus::DO_NOT_DISTURB)];
+    return result;
+}
+
+std::size_t UserDirectory::countWithStatus(chat_app::UserStatus status) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return countWithStatusLocked(static_cast<uint8_t>(status));
+}
+
+std::size_t UserDirectory::countSeenSince(std::chrono::system_clock::time_point since) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    // Free slots and never-seen users hold 0, below any threshold
+    return countAtLeast(last_seen_.data(), last_seen_.size(), toSeconds(since));
+}
+
+void UserDirectory::forEachWithStatus(chat_app::UserStatus status,
+                                      const std::function<bool(const UserView&)>& visitor) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const uint8_t* data = status_.data();
+    std::size_t size = status_.size();
+    uint8_t value = static_cast<uint8_t>(status);
+
+    for (std::size_t base = 0; base < size; base += 32) {
+        uint32_t mask = base + 32 <= size ? matchMask32(data + base, value)
+                                          : matchMaskTail(data + base, size - base, value);
+        while (mask != 0) {
+            Slot slot = static_cast<Slot>(base + __builtin_ctz(mask));
+            mask &= mask - 1;
+            if (!visitor(viewLocked(slot))) {
+                return;
+            }
+        }
+    }
+}
+
+std::size_t UserDirectory::countInRoom(std::string_view room_id, chat_app::UserStatus status) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto room = findRoomLocked(room_id);
+    if (!room) {
+        return 0;
+    }
+    if (status == chat_app::UserStatus::ONLINE) {
+        return RoaringBitmap::intersectionCardinality(room_members_[*room], online_);
+    }
+    uint8_t value = static_cast<uint8_t>(status);
+    std::size_t count = 0;
+    room_members_[*room].forEach([&](Slot slot) { count += status_[slot] == value; });
+    return count;
+}
+
+std::vector<UserDirectory::UserView> UserDirectory::listInRoom(std::string_view room_id,
+                                                               chat_app::UserStatus status) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<UserView> users;
+    auto room = findRoomLocked(room_id);
+    if (!room) {
+        return users;
+    }
+    uint8_t value = static_cast<uint8_t>(status);
+    room_members_[*room].forEach([&](Slot slot) {
+        if (status_[slot] == value) {
+            users.push_back(viewLocked(slot));
+        }
+    });
+    return users;
+}
+
+bool UserDirectory::isMember(std::string_view room_id, std::string_view user_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(user_id);
+    auto room = findRoomLocked(room_id);
+    return it != slots_.end() && room && room_members_[*room].contains(it->second);
+}
+
+std::size_t UserDirectory::memberCount(std::string_view room_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto room = findRoomLocked(room_id);
+    return room ? room_members_[*room].cardinality() : 0;
+}
+
+RoaringBitmap UserDirectory::members(std::string_view room_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto room = findRoomLocked(room_id);
+    return room ? room_members_[*room] : RoaringBitmap();
+}
+
+RoaringBitmap UserDirectory::onlineMembers(std::string_view room_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto room = findRoomLocked(room_id);
+    return room ? room_members_[*room] & online_ : RoaringBitmap();
+}
+
+RoaringBitmap UserDirectory::commonMembers(std::string_view room_a, std::string_view room_b) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto a = findRoomLocked(room_a);
+    auto b = findRoomLocked(room_b);
+    return a && b ? room_members_[*a] & room_members_[*b] : RoaringBitmap();
+}
+
+void UserDirectory::forEachOnlineMember(std::string_view room_id,
+                                        const std::function<bool(const UserView&)>& visitor) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto room = findRoomLocked(room_id);
+    if (!room) {
+        return;
+    }
+    for (Slot slot : (room_members_[*room] & online_).toVector()) {
+        if (!visitor(viewLocked(slot))) {
+            return;
+        }
+    }
+}
+
+std::optional<UserDirectory::UserView> UserDirectory::view(Slot slot) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (slot >= status_.size() || status_[slot] == FREE_SLOT) {
+        return std::nullopt;
+    }
+    return viewLocked(slot);
+}
+
+} // namespace chat
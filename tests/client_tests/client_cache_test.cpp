@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "client/client_cache.h"
+#include <cstdio>
+#include <unistd.h>
+
+using namespace chat_app;
+
+namespace {
+
+ChatMessage roomMessage(const std::string& room, uint64_t sequence) {
+    ChatMessage message = ChatMessage::forRoom("alice", room, "message " + std::to_string(sequence));
+    message.sequence = sequence;
+    return message;
+}
+
+} // namespace
+
+class ClientCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        options_.path = "client_cache_test_" + std::to_string(::getpid()) + ".db";
+        options_.messages_per_conversation = 5;
+    }
+
+    void TearDown() override {
+        for (const char* suffix : {"", "-wal", "-shm"}) {
+            std::remove((options_.path + suffix).c_str());
+        }
+    }
+
+    ClientCache::Options options_;
+};
+
+// The digest ignores room and member order but sees every change
+TEST_F(ClientCacheTest, RosterDigest) {
+    Roster roster = {{"general", "General", {"u1", "u2"}}, {"random", "Random", {"u3"}}};
+    Roster reordered = {{"random", "Random", {"u3"}}, {"general", "General", {"u2", "u1"}}};
+    EXPECT_EQ(rosterDigest(roster), rosterDigest(reordered));
+    EXPECT_EQ(rosterDigest({}), 0u);
+
+    Roster joined = roster;
+    joined[1].members.push_back("u4");
+    EXPECT_NE(rosterDigest(roster), rosterDigest(joined));
+    Roster renamed = roster;
+    renamed[0].name = "Lobby";
+    EXPECT_NE(rosterDigest(roster), rosterDigest(renamed));
+
+    auto decoded = decodeRoster(encodeRoster(roster));
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(rosterDigest(*decoded), rosterDigest(roster));
+    EXPECT_FALSE(decodeRoster(std::vector<char>{'{', '}'}).has_value());
+}
+
+// What was cached survives a restart, and the SYNC request carries the
+// high-water marks and roster digest of the cache
+TEST_F(ClientCacheTest, PersistsAcrossRestarts) {
+    Roster roster = {{"general", "General", {"alice", "bob"}}};
+    {
+        ClientCache cache(options_);
+        ASSERT_TRUE(cache.open("bob"));
+        ASSERT_TRUE(cache.replaceRoster(roster));
+        std::vector<ChatMessage> messages;
+        for (uint64_t sequence = 1; sequence <= 8; ++sequence) {
+            messages.push_back(roomMessage("general", sequence));
+        }
+        ChatMessage direct("alice", "bob", "hi");
+        direct.sequence = 3;
+        messages.push_back(direct);
+        messages.push_back(ChatMessage::forRoom("alice", "general", "not sequenced"));
+        ASSERT_TRUE(cache.storeMessages(messages));
+    }
+
+    ClientCache cache(options_);
+    ASSERT_TRUE(cache.open("bob"));
+    EXPECT_EQ(cache.roster().size(), 1u);
+    EXPECT_EQ(cache.roster()[0].members, (std::vector<std::string>{"alice", "bob"}));
+
+    auto recent = cache.recentMessages("general", 100);
+    ASSERT_EQ(recent.size(), 5u);  // Window of 5
+    EXPECT_EQ(recent.front().sequence, 4u);
+    EXPECT_EQ(recent.back().content, "message 8");
+    EXPECT_EQ(cache.recentMessages("general", 2).front().sequence, 7u);
+
+    SyncRequest request = cache.syncRequest();
+    EXPECT_EQ(request.roster_digest, rosterDigest(roster));
+    EXPECT_EQ(request.cursors, (SyncCursors{{"general", 8}, {"dm:5:alice:bob", 3}}));
+
+    auto decoded = SyncRequest::decode(request.encode());
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->roster_digest, request.roster_digest);
+    EXPECT_EQ(decoded->cursors, request.cursors);
+}
+
+// Replayed deltas extend the cache; a truncated conversation is dropped
+TEST_F(ClientCacheTest, AppliesDeltas) {
+    ClientCache cache(options_);
+    ASSERT_TRUE(cache.open("bob"));
+    ASSERT_TRUE(cache.storeMessages({roomMessage("general", 1), roomMessage("general", 2),
+                                     roomMessage("random", 10)}));
+    ASSERT_TRUE(cache.storeMessages({roomMessage("general", 2), roomMessage("general", 3)}));
+    EXPECT_EQ(cache.recentMessages("general", 10).size(), 3u);
+    EXPECT_EQ(cache.cursors()["general"], 3u);
+
+    ASSERT_TRUE(cache.forgetConversation("random"));
+    EXPECT_EQ(cache.cursors().count("random"), 0u);
+
+    ASSERT_TRUE(cache.replaceRoster({{"general", "General", {"bob"}}}));
+    ASSERT_TRUE(cache.replaceRoster({{"lobby", "Lobby", {"bob", "carol"}}}));
+    ASSERT_EQ(cache.roster().size(), 1u);
+    EXPECT_EQ(cache.roster()[0].room_id, "lobby");
+}
+
+// Cursors stop below a gap, so a SYNC asks for the missing messages
+TEST_F(ClientCacheTest, CursorsStopAtGaps) {
+    ClientCache cache(options_);
+    ASSERT_TRUE(cache.open("bob"));
+    ASSERT_TRUE(cache.storeMessages({roomMessage("general", 1), roomMessage("general", 2),
+                                     roomMessage("general", 5), roomMessage("general", 6)}));
+    EXPECT_EQ(cache.cursors()["general"], 2u);
+
+    ASSERT_TRUE(cache.storeMessages({roomMessage("general", 3), roomMessage("general", 4)}));
+    EXPECT_EQ(cache.cursors()["general"], 6u);
+}
+
+// Opening the cache for another user starts empty
+TEST_F(ClientCacheTest, BelongsToOneUser) {
+    {
+        ClientCache cache(options_);
+        ASSERT_TRUE(cache.open("bob"));
+        ASSERT_TRUE(cache.replaceRoster({{"general", "General", {"bob"}}}));
+        ASSERT_TRUE(cache.storeMessages({roomMessage("general", 1)}));
+    }
+    ClientCache cache(options_);
+    ASSERT_TRUE(cache.open("carol"));
+    EXPECT_TRUE(cache.roster().empty());
+    EXPECT_TRUE(cache.cursors().empty());
+    EXPECT_EQ(cache.syncRequest().roster_digest, 0u);
+}
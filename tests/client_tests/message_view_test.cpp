@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "client/ui/message_view.h"
+
+using namespace chat_app;
+
+namespace {
+
+ChatMessage say(const std::string& content) {
+    return ChatMessage::forRoom("bob", "general", content);
+}
+
+MessageView::Options scrollback(std::size_t lines) {
+    MessageView::Options options;
+    options.scrollback_lines = lines;
+    return options;
+}
+
+} // namespace
+
+TEST(MessageViewTest, WrapsAtWordsAndCodePoints) {
+    EXPECT_EQ(MessageView::wrap("hello brave new world", 11),
+              (std::vector<std::string>{"hello brave", "  new world"}));
+    EXPECT_EQ(MessageView::wrap("abcdefghij", 4), (std::vector<std::string>{"abcd", "efgh", "ij"}));
+    EXPECT_EQ(MessageView::wrap("one\ntwo", 20), (std::vector<std::string>{"one", "  two"}));
+    // Five two-byte characters fit in five columns
+    EXPECT_EQ(MessageView::wrap("\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9", 5).size(), 1u);
+    EXPECT_EQ(MessageView::format(say("a\tb\x1b[2J")).substr(8), "bob: a b [2J");
+}
+
+// Messages posted between ticks are drawn together, and new lines at the
+// bottom scroll the window so only they are redrawn
+TEST(MessageViewTest, DrawsOnlyNewRows) {
+    MessageView view(scrollback(100));
+    view.resize(40, 5);
+    auto first = view.frame();
+    EXPECT_EQ(first.rows.size(), 5u);  // Initial clear
+
+    view.post(say("one"));
+    view.post(say("two"));
+    auto frame = view.frame();
+    EXPECT_EQ(frame.scroll, 2);
+    ASSERT_EQ(frame.rows.size(), 2u);
+    EXPECT_EQ(frame.rows[0].index, 3);
+    EXPECT_NE(frame.rows[1].text.find("two"), std::string::npos);
+
+    EXPECT_TRUE(view.frame().empty());  // Nothing new
+
+    view.post(say("three"));
+    frame = view.frame();
+    EXPECT_EQ(frame.scroll, 1);
+    ASSERT_EQ(frame.rows.size(), 1u);
+    EXPECT_EQ(frame.rows[0].index, 4);
+}
+
+// A firehose costs at most one screen per frame and the queue stays
+// bounded by the scrollback
+TEST(MessageViewTest, FirehoseIsBoundedPerFrame) {
+    MessageView view(scrollback(1000));
+    view.resize(80, 24);
+    view.frame();
+    for (int i = 0; i < 100000; ++i) {
+        view.post(say("message " + std::to_string(i)));
+    }
+    auto frame = view.frame();
+    EXPECT_EQ(frame.scroll, 0);
+    EXPECT_EQ(frame.rows.size(), 24u);
+    EXPECT_NE(frame.rows.back().text.find("message 99999"), std::string::npos);
+    EXPECT_EQ(view.lineCount(), 1000u);
+    EXPECT_EQ(view.stats().dropped, 99000u);
+}
+
+// Scrolled back, the rows being read stay put while new lines arrive
+TEST(MessageViewTest, ScrollbackStaysAnchored) {
+    MessageView view(scrollback(100));
+    view.resize(40, 3);
+    for (int i = 0; i < 10; ++i) {
+        view.post(say("m" + std::to_string(i)));
+    }
+    view.frame();
+
+    view.scrollBy(-4);
+    auto frame = view.frame();
+    ASSERT_EQ(frame.rows.size(), 3u);
+    EXPECT_NE(frame.rows[2].text.find("m5"), std::string::npos);
+
+    view.post(say("m10"));
+    view.post(say("m11"));
+    EXPECT_TRUE(view.frame().empty());
+    EXPECT_EQ(view.unseen(), 2u);
+    EXPECT_FALSE(view.following());
+
+    view.scrollToBottom();
+    frame = view.frame();
+    EXPECT_EQ(frame.rows.size(), 3u);
+    EXPECT_NE(frame.rows[2].text.find("m11"), std::string::npos);
+    EXPECT_EQ(view.unseen(), 0u);
+}
+
+TEST(MessageViewTest, RelaysOutOnResize) {
+    MessageView view(scrollback(100));
+    view.resize(80, 10);
+    view.post(say(std::string(60, 'x')));
+    view.frame();
+    EXPECT_EQ(view.lineCount(), 1u);
+
+    view.resize(30, 10);
+    EXPECT_EQ(view.lineCount(), 4u);  // Header, then 28 + 28 + 4 indented
+    EXPECT_EQ(view.frame().rows.size(), 10u);  // Every row after a resize
+
+    auto now = MessageView::Clock::now();
+    view.frame(now);
+    EXPECT_EQ(view.untilNextFrame(now), std::chrono::milliseconds(33));
+    EXPECT_EQ(view.untilNextFrame(now + std::chrono::milliseconds(50)), std::chrono::milliseconds(0));
+}
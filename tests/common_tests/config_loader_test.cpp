@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
 #include "common/config_loader.h"
+#include "common/config_watcher.h"
 #include <sstream>
 #include <fstream>
+#include <thread>
 
 using namespace chat;
 
@@ -70,4 +72,78 @@ TEST_F(ConfigLoaderTest, DumpConfig) {
     EXPECT_TRUE(dump.find("SERVER_PORT = 9000") != std::string::npos);
     EXPECT_TRUE(dump.find("MAX_CONNECTIONS = 50") != std::string::npos);
     EXPECT_TRUE(dump.find("LOG_LEVEL = DEBUG") != std::string::npos);
-}
\ No newline at end of file
+}
+
+// Test that reload publishes a new snapshot without invalidating the old one
+TEST_F(ConfigLoaderTest, ReloadPublishesSnapshot) {
+    ConfigLoader config("test_config.env");
+    auto before = config.snapshot();
+    EXPECT_EQ(before->max_connections, 50);
+    EXPECT_EQ(before->log_level, LogLevel::DEBUG);
+    
+    std::ofstream config_file("test_config.env");
+    config_file << "MAX_CONNECTIONS=75\n";
+    config_file << "LOG_LEVEL=WARN\n";
+    config_file.close();
+    
+    ASSERT_TRUE(config.reload());
+    EXPECT_EQ(config.current().max_connections, 75);
+    EXPECT_EQ(config.getLogLevel(), LogLevel::WARN);
+    EXPECT_GT(config.current().version, before->version);
+    
+    // Previously obtained snapshot is unchanged
+    EXPECT_EQ(before->max_connections, 50);
+    EXPECT_EQ(before->values.at("SERVER_PORT"), "9000");
+}
+
+// Test that a failed reload keeps the current configuration
+TEST_F(ConfigLoaderTest, FailedReloadKeepsSnapshot) {
+    ConfigLoader config("test_config.env");
+    std::remove("test_config.env");
+    
+    EXPECT_FALSE(config.reload());
+    EXPECT_EQ(config.getServerPort(), 9000);
+}
+
+// Test change subscriptions
+TEST_F(ConfigLoaderTest, SubscribersNotified) {
+    ConfigLoader config("test_config.env");
+    int calls = 0;
+    bool queue_size_changed = false;
+    auto id = config.subscribe([&](const ConfigSnapshot& previous, const ConfigSnapshot& current) {
+        ++calls;
+        queue_size_changed = current.differs(previous, "MESSAGE_QUEUE_SIZE");
+    });
+    
+    std::ofstream config_file("test_config.env", std::ios::app);
+    config_file << "MESSAGE_QUEUE_SIZE=42\n";
+    config_file.close();
+    
+    ASSERT_TRUE(config.reload());
+    EXPECT_EQ(calls, 1);
+    EXPECT_TRUE(queue_size_changed);
+    EXPECT_EQ(config.current().message_queue_size, 42);
+    
+    config.unsubscribe(id);
+    config.reload();
+    EXPECT_EQ(calls, 1);
+}
+
+// Test that the watcher reloads after the file is rewritten
+TEST_F(ConfigLoaderTest, WatcherReloadsOnChange) {
+    ConfigLoader config("test_config.env");
+    ConfigWatcher watcher(config, std::chrono::milliseconds(20));
+    if (!watcher.start()) {
+        GTEST_SKIP() << "inotify not available";
+    }
+    
+    std::ofstream config_file("test_config.env");
+    config_file << "SERVER_PORT=9100\n";
+    config_file.close();
+    
+    for (int i = 0; i < 200 && config.getServerPort() != 9100; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(config.getServerPort(), 9100);
+    EXPECT_GE(watcher.reloadCount(), 1u);
+}
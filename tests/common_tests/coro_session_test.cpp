@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include "common/coro_session.h"
+
+#ifdef WITH_COROUTINES
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace chat_app;
+using boost::asio::ip::tcp;
+
+namespace {
+
+// Server side sessions on a background io_context, blocking client sockets
+class SessionFixture {
+public:
+    SessionFixture()
+        : guard_(boost::asio::make_work_guard(io_context_)),
+          acceptor_(io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+        thread_ = std::thread([this] { io_context_.run(); });
+    }
+
+    ~SessionFixture() {
+        guard_.reset();
+        io_context_.stop();
+        thread_.join();
+    }
+
+    // Connect a client and hand the accepted socket to a new session
+    std::pair<tcp::socket, std::shared_ptr<CoroSession>> connect(CoroSession::Options options = CoroSession::Options()) {
+        tcp::socket client(client_context_);
+        client.connect(acceptor_.local_endpoint());
+        client.set_option(tcp::no_delay(true));
+        tcp::socket server(io_context_);
+        acceptor_.accept(server);
+        return {std::move(client), CoroSession::create(std::move(server), options)};
+    }
+
+    boost::asio::io_context& context() { return io_context_; }
+
+private:
+    boost::asio::io_context io_context_;
+    boost::asio::io_context client_context_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> guard_;
+    tcp::acceptor acceptor_;
+    std::thread thread_;
+};
+
+void sendFrame(tcp::socket& socket, uint16_t type, const std::string& body) {
+    MessageHeader header;
+    header.setMessageType(type);
+    header.setBodySize(static_cast<uint32_t>(body.size()));
+    std::array<char, HEADER_SIZE> buffer;
+    header.encodeToBuffer(buffer);
+    std::array<boost::asio::const_buffer, 2> buffers = {boost::asio::buffer(buffer), boost::asio::buffer(body)};
+    boost::asio::write(socket, buffers);
+}
+
+std::pair<uint16_t, std::string> readFrame(tcp::socket& socket) {
+    std::array<char, HEADER_SIZE> buffer;
+    boost::asio::read(socket, boost::asio::buffer(buffer));
+    MessageHeader header;
+    header.decodeFromBuffer(buffer);
+    std::string body(header.getBodySize(), '\0');
+    boost::asio::read(socket, boost::asio::buffer(body));
+    return {header.getMessageType(), body};
+}
+
+// Replies with the request body after sleeping for as many milliseconds as it names
+CoroSession::Handler delayedEcho() {
+    return [](CoroSession& session, CoroSession::Frame& frame) -> CoroSession::Awaitable<void> {
+        boost::asio::steady_timer timer(session.executor());
+        timer.expires_after(std::chrono::milliseconds(std::stoi(std::string(frame.body.begin(), frame.body.end()))));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        co_await session.write(frame.type, 0, boost::asio::buffer(frame.body));
+    };
+}
+
+} // namespace
+
+// Frames are read in a loop and answered by the handler
+TEST(CoroSessionTest, EchoesFrames) {
+    SessionFixture fixture;
+    auto [client, session] = fixture.connect();
+    std::promise<boost::system::error_code> closed;
+    session->start(
+        [](CoroSession& session, CoroSession::Frame& frame) -> CoroSession::Awaitable<void> {
+            co_await session.write(frame.type, frame.flags, boost::asio::buffer(frame.body));
+        },
+        [&closed](const boost::system::error_code& ec) { closed.set_value(ec); });
+
+    for (int i = 0; i < 100; ++i) {
+        std::string body(static_cast<std::size_t>(i * 37), 'x');
+        sendFrame(client, static_cast<uint16_t>(i), body);
+        auto reply = readFrame(client);
+        EXPECT_EQ(reply.first, i);
+        EXPECT_EQ(reply.second, body);
+    }
+
+    client.close();
+    EXPECT_EQ(closed.get_future().get(), boost::asio::error::eof);
+    EXPECT_EQ(session->stats().frames_read, 100u);
+    EXPECT_EQ(session->stats().frames_written, 100u);
+}
+
+// With one request in flight replies keep request order
+TEST(CoroSessionTest, SerializesRequestsByDefault) {
+    SessionFixture fixture;
+    auto [client, session] = fixture.connect();
+    session->start(delayedEcho());
+
+    sendFrame(client, 1, "80");
+    sendFrame(client, 2, "10");
+    sendFrame(client, 3, "40");
+    EXPECT_EQ(readFrame(client).first, 1);
+    EXPECT_EQ(readFrame(client).first, 2);
+    EXPECT_EQ(readFrame(client).first, 3);
+    EXPECT_EQ(session->stats().peak_in_flight, 1u);
+    session->close();
+}
+
+// Pipelined requests run concurrently and are answered as they complete
+TEST(CoroSessionTest, PipelinesRequests) {
+    SessionFixture fixture;
+    auto [client, session] = fixture.connect(CoroSession::Options{3});
+    session->start(delayedEcho());
+
+    auto start = std::chrono::steady_clock::now();
+    sendFrame(client, 1, "150");
+    sendFrame(client, 2, "10");
+    sendFrame(client, 3, "80");
+    sendFrame(client, 4, "0");  // Waits for a free slot
+    EXPECT_EQ(readFrame(client).first, 2);
+    EXPECT_EQ(readFrame(client).first, 4);
+    EXPECT_EQ(readFrame(client).first, 3);
+    EXPECT_EQ(readFrame(client).first, 1);
+    // Overlapped, not 240 ms back to back
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(230));
+    EXPECT_EQ(session->stats().peak_in_flight, 3u);
+    session->close();
+}
+
+// A handshake read before start() runs as straight-line code
+TEST(CoroSessionTest, ReadsHandshakeBeforeLoop) {
+    SessionFixture fixture;
+    auto [client, session] = fixture.connect();
+    std::promise<std::string> user;
+    boost::asio::co_spawn(session->executor(),
+        [session = session, &user]() -> CoroSession::Awaitable<void> {
+            CoroSession::Frame frame;
+            if (co_await session->readFrame(frame)) {
+                co_return;
+            }
+            std::string name(frame.body.begin(), frame.body.end());
+            co_await session->write(frame.type, 0, boost::asio::buffer(std::string_view("ok")));
+            user.set_value(name);
+            session->start(delayedEcho());
+        },
+        boost::asio::detached);
+
+    sendFrame(client, 1, "alice");
+    EXPECT_EQ(readFrame(client).second, "ok");
+    EXPECT_EQ(user.get_future().get(), "alice");
+    sendFrame(client, 2, "0");
+    EXPECT_EQ(readFrame(client).first, 2);
+    session->close();
+}
+
+#endif // WITH_COROUTINES
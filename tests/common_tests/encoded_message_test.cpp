@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "common/encoded_message.h"
+#include "common/protocol.h"
+#include <thread>
+#include <vector>
+
+using namespace chat_app;
+
+// Test fixture
+class EncodedMessageTest : public ::testing::Test {
+protected:
+    ChatMessage makeRoomMessage() {
+        return ChatMessage::forRoom("alice", "lobby", "hello everyone", 4);
+    }
+};
+
+// Test binary round trip of every field
+TEST_F(EncodedMessageTest, BinaryRoundTrip) {
+    ChatMessage original("alice", "bob", "hi bob", 3);
+    std::vector<char> bytes = original.toBinary();
+    ChatMessage decoded = ChatMessage::fromBinary(bytes.data(), bytes.size());
+
+    EXPECT_EQ(decoded.message_id, original.message_id);
+    EXPECT_EQ(decoded.sender_id, "alice");
+    EXPECT_EQ(decoded.recipient_id.value_or(""), "bob");
+    EXPECT_FALSE(decoded.room_id.has_value());
+    EXPECT_EQ(decoded.content, "hi bob");
+    EXPECT_EQ(decoded.message_type, 3);
+    EXPECT_EQ(decoded.toJson()["timestamp"], original.toJson()["timestamp"]);
+
+    // Truncated input is rejected
+    EXPECT_THROW(ChatMessage::fromBinary(bytes.data(), bytes.size() - 1), std::runtime_error);
+}
+
+// Test that a conversation sequence survives both encodings
+TEST_F(EncodedMessageTest, SequenceRoundTrip) {
+    ChatMessage original("bob", "alice", "hi alice", 3);
+    EXPECT_EQ(original.conversationId(), "dm:5:alice:bob");
+    std::vector<char> unsequenced = original.toBinary();
+    EXPECT_FALSE(original.toJson().contains("seq"));
+
+    original.sequence = (uint64_t(1) << 40) + 7;
+    std::vector<char> bytes = original.toBinary();
+    EXPECT_EQ(bytes.size(), unsequenced.size() + 8);
+    EXPECT_EQ(ChatMessage::fromBinary(bytes.data(), bytes.size()).sequence, original.sequence);
+    EXPECT_EQ(ChatMessage::fromJson(original.toJson()).sequence, original.sequence);
+    EXPECT_EQ(ChatMessage::fromBinary(unsequenced.data(), unsequenced.size()).sequence, 0u);
+}
+
+// Test that each encoding is computed once and shared afterwards
+TEST_F(EncodedMessageTest, EncodesOnce) {
+    EncodedMessage message(makeRoomMessage());
+
+    auto first = message.binary();
+    auto second = message.binary();
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(message.encodeCount(), 1u);
+
+    message.json();
+    message.json();
+    EXPECT_EQ(message.encodeCount(), 2u);
+}
+
+// Test that every encoding decodes back to the same message
+TEST_F(EncodedMessageTest, DecodeAllEncodings) {
+    EncodedMessage message(makeRoomMessage());
+
+    for (auto encoding : {MessageEncoding::JSON, MessageEncoding::BINARY, MessageEncoding::COMPRESSED}) {
+        ChatMessage decoded = EncodedMessage::decode(*message.encoded(encoding),
+                                                     EncodedMessage::flagsFor(encoding));
+        EXPECT_EQ(decoded.message_id, message.message().message_id);
+        EXPECT_EQ(decoded.room_id.value_or(""), "lobby");
+        EXPECT_EQ(decoded.content, "hello everyone");
+    }
+}
+
+// Test that modifying the message invalidates cached encodings
+TEST_F(EncodedMessageTest, ModifyInvalidatesCache) {
+    EncodedMessage message(makeRoomMessage());
+    auto before = message.json();
+
+    message.modify([](ChatMessage& msg) { msg.content = "edited"; });
+
+    auto after = message.json();
+    EXPECT_NE(before.get(), after.get());
+    EXPECT_EQ(EncodedMessage::decode(*after, MessageFlags::JSON).content, "edited");
+    // Previously handed out bytes stay valid and unchanged
+    EXPECT_EQ(EncodedMessage::decode(*before, MessageFlags::JSON).content, "hello everyone");
+}
+
+// Test concurrent first use from many threads
+TEST_F(EncodedMessageTest, ConcurrentConsumers) {
+    auto message = makeEncodedMessage(makeRoomMessage());
+
+    std::vector<std::thread> threads;
+    std::vector<EncodedMessage::Body> results(8);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        threads.emplace_back([&, i]() { results[i] = message->binary(); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& result : results) {
+        EXPECT_EQ(result.get(), results.front().get());
+    }
+    EXPECT_EQ(message->encodeCount(), 1u);
+}
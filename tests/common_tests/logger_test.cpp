@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "common/logger.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace chat;
+
+// Test fixture
+class LoggerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::remove("test_logger.log");
+        Logger::Options options;
+        options.file_path = "test_logger.log";
+        options.console = false;
+        options.level = LogLevel::DEBUG;
+        options.ring_slots = 8192;
+        ASSERT_TRUE(Logger::instance().start(options));
+    }
+
+    void TearDown() override {
+        Logger::instance().stop();
+        std::remove("test_logger.log");
+    }
+
+    std::vector<std::string> readLines() {
+        Logger::instance().flush();
+        std::ifstream file("test_logger.log");
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+};
+
+// Arguments are captured and formatted by the flusher
+TEST_F(LoggerTest, FormatsDeferredArguments) {
+    std::string user = "alice";
+    CHAT_LOG_INFO("user {} joined room {} ({} members, ratio {}, ok={}) {{literal}}",
+                  user, "general", 42u, 0.5, true);
+
+    auto lines = readLines();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_NE(lines[0].find("INFO"), std::string::npos);
+    EXPECT_NE(lines[0].find("logger_test.cpp:"), std::string::npos);
+    EXPECT_NE(lines[0].find("user alice joined room general (42 members, ratio 0.5, ok=true) {literal}"),
+              std::string::npos);
+}
+
+// Records below the runtime level are not written
+TEST_F(LoggerTest, RuntimeLevelFilters) {
+    Logger::setLevel(LogLevel::WARN);
+    CHAT_LOG_DEBUG("hidden {}", 1);
+    CHAT_LOG_INFO("hidden {}", 2);
+    CHAT_LOG_WARN("shown {}", 3);
+    Logger::setLevel(LogLevel::TRACE);
+    CHAT_LOG_TRACE("shown {}", 4);
+
+    auto lines = readLines();
+    ASSERT_EQ(lines.size(), 2u);
+    EXPECT_NE(lines[0].find("shown 3"), std::string::npos);
+    EXPECT_NE(lines[1].find("shown 4"), std::string::npos);
+}
+
+// Long strings are cut to the record size instead of overflowing it
+TEST_F(LoggerTest, TruncatesLongArguments) {
+    std::string long_value(1000, 'x');
+    CHAT_LOG_ERROR("value {} after", long_value);
+
+    auto lines = readLines();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_NE(lines[0].find("[truncated]"), std::string::npos);
+    EXPECT_LT(lines[0].size(), 400u);
+}
+
+// Records from many threads all arrive
+TEST_F(LoggerTest, CollectsFromManyThreads) {
+    const int thread_count = 4;
+    const int per_thread = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                CHAT_LOG_DEBUG("thread {} record {}", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto lines = readLines();
+    auto stats = Logger::instance().stats();
+    EXPECT_EQ(lines.size() + stats.dropped, static_cast<size_t>(thread_count * per_thread));
+    EXPECT_EQ(stats.dropped, 0u);
+}
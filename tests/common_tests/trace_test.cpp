@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+#include "common/trace.h"
+#include "common/tcp_connection.h"
+#include <atomic>
+#include <future>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <thread>
+
+using namespace chat;
+namespace MessageFlags = chat_app::MessageFlags;
+
+namespace {
+
+Tracer::Options sampling(uint32_t rate, std::size_t slots = 1024) {
+    Tracer::Options options;
+    options.sample_rate = rate;
+    options.ring_slots = slots;
+    return options;
+}
+
+std::vector<Tracer::Span> spansOf(uint64_t trace_id) {
+    std::vector<Tracer::Span> result;
+    for (const auto& span : Tracer::instance().spans()) {
+        if (span.trace_id == trace_id) {
+            result.push_back(span);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+class TraceTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        Tracer::instance().stop();
+    }
+};
+
+// One frame in N is sampled, plus every frame the client flags
+TEST_F(TraceTest, SamplesEveryNthAndFlaggedFrames) {
+    Tracer& tracer = Tracer::instance();
+    tracer.start(sampling(0));
+    EXPECT_FALSE(Tracer::active());
+
+    tracer.start(sampling(4));
+    EXPECT_TRUE(Tracer::active());
+    std::thread([&tracer]() {
+        int sampled = 0;
+        for (int i = 0; i < 40; ++i) {
+            sampled += tracer.sample(0) != 0 ? 1 : 0;
+        }
+        EXPECT_EQ(sampled, 10);
+        EXPECT_NE(tracer.sample(MessageFlags::TRACED), 0u);
+    }).join();
+    EXPECT_EQ(tracer.stats().traces, 11u);
+
+    tracer.stop();
+    EXPECT_FALSE(Tracer::active());
+}
+
+// Spans attach to the trace made current on the thread, and nothing is
+// recorded outside a trace
+TEST_F(TraceTest, SpansFollowTheCurrentTrace) {
+    Tracer& tracer = Tracer::instance();
+    tracer.start(sampling(1));
+    {
+        TraceSpan untraced(TraceStage::DECODE);
+    }
+    EXPECT_TRUE(tracer.spans().empty());
+
+    uint64_t trace_id = tracer.sample(0);
+    {
+        TraceContext context(trace_id);
+        EXPECT_EQ(Tracer::current(), trace_id);
+        TraceSpan route(TraceStage::ROUTE);
+        TraceSpan decode(TraceStage::DECODE);
+    }
+    EXPECT_EQ(Tracer::current(), 0u);
+
+    auto spans = spansOf(trace_id);
+    ASSERT_EQ(spans.size(), 2u);
+    EXPECT_EQ(spans[0].stage, TraceStage::ROUTE);  // Started first
+    EXPECT_EQ(spans[1].stage, TraceStage::DECODE);
+    EXPECT_LE(spans[0].start_ns, spans[1].start_ns);
+    EXPECT_GE(spans[0].end_ns, spans[1].end_ns);
+}
+
+TEST_F(TraceTest, RingKeepsTheNewestSpans) {
+    Tracer& tracer = Tracer::instance();
+    tracer.start(sampling(1, 6));  // Rounded up to 8
+    for (uint64_t i = 1; i <= 20; ++i) {
+        tracer.record(i, TraceStage::STORE, i * 100, i * 100 + 10);
+    }
+    auto spans = tracer.spans();
+    ASSERT_EQ(spans.size(), 8u);
+    EXPECT_EQ(spans.front().trace_id, 13u);
+    EXPECT_EQ(spans.back().trace_id, 20u);
+    EXPECT_EQ(tracer.stats().overwritten, 12u);
+}
+
+// Restarting swaps in a new ring under writers that are still recording
+TEST_F(TraceTest, RestartsWhileRecording) {
+    Tracer& tracer = Tracer::instance();
+    tracer.start(sampling(1, 64));
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&tracer, &done]() {
+            for (uint64_t i = 1; !done.load(); ++i) {
+                tracer.record(i, TraceStage::ROUTE, i, i + 1);
+            }
+        });
+    }
+    for (int i = 0; i < 200; ++i) {
+        tracer.start(sampling(1, 64));
+    }
+    done = true;
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    tracer.start(sampling(1, 64));
+    tracer.record(9, TraceStage::STORE, 100, 200);
+    auto spans = tracer.spans();
+    ASSERT_EQ(spans.size(), 1u);
+    EXPECT_EQ(spans[0].trace_id, 9u);
+}
+
+TEST_F(TraceTest, ExportsChromeTraceJson) {
+    Tracer& tracer = Tracer::instance();
+    tracer.start(sampling(1));
+    tracer.record(7, TraceStage::ROUTE, 1500, 4250);
+
+    std::ostringstream out;
+    tracer.exportChromeTrace(out);
+    auto json = nlohmann::json::parse(out.str());
+    ASSERT_EQ(json["traceEvents"].size(), 1u);
+    const auto& event = json["traceEvents"][0];
+    EXPECT_EQ(event["name"], "route");
+    EXPECT_EQ(event["ph"], "X");
+    EXPECT_DOUBLE_EQ(event["ts"].get<double>(), 1.5);
+    EXPECT_DOUBLE_EQ(event["dur"].get<double>(), 2.75);
+    EXPECT_EQ(event["args"]["trace"], 7);
+}
+
+// A flagged frame echoed by the receiving connection is traced from its
+// read to the write of the reply
+TEST_F(TraceTest, TracesFramesThroughTcpConnection) {
+    using boost::asio::ip::tcp;
+    Tracer::instance().start(sampling(1u << 30));  // Only flagged frames
+
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    auto server = std::make_shared<chat_app::TcpConnection>(io_context);
+    auto client = std::make_shared<chat_app::TcpConnection>(io_context);
+
+    uint64_t trace_id = 0;
+    server->setMessageCallback([&server, &trace_id](const std::vector<char>& body, uint16_t type, uint16_t) {
+        trace_id = Tracer::current();
+        TraceSpan route(TraceStage::ROUTE);
+        server->send(body, type);
+    });
+    std::promise<std::vector<char>> reply;
+    client->setMessageCallback([&reply](const std::vector<char>& body, uint16_t, uint16_t) {
+        reply.set_value(body);
+    });
+
+    acceptor.async_accept(server->socket(), [&server](const boost::system::error_code& ec) {
+        ASSERT_FALSE(ec);
+        server->start();
+    });
+    client->socket().connect(acceptor.local_endpoint());
+    client->start();
+    ASSERT_TRUE(client->send(std::vector<char>{'h', 'i'}, 1, MessageFlags::TRACED));
+
+    auto received = reply.get_future();
+    while (received.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (io_context.run_one_for(std::chrono::seconds(5)) == 0) {
+            FAIL() << "no reply";
+        }
+    }
+    EXPECT_EQ(received.get(), (std::vector<char>{'h', 'i'}));
+    // Let the server's write completion run
+    io_context.poll();
+
+    ASSERT_NE(trace_id, 0u);
+    std::vector<TraceStage> stages;
+    for (const auto& span : spansOf(trace_id)) {
+        stages.push_back(span.stage);
+    }
+    EXPECT_EQ(stages, (std::vector<TraceStage>{TraceStage::READ, TraceStage::DISPATCH, TraceStage::ROUTE,
+                                               TraceStage::ENQUEUE, TraceStage::WRITE}));
+    client->stop();
+    server->stop();
+}
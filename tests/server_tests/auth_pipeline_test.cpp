@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include "server/auth_pipeline.h"
+#include <future>
+#include <thread>
+
+using namespace chat;
+
+namespace {
+
+// Cheap parameters; the defaults cost tens of milliseconds per hash
+PasswordHasher::Params testParams() {
+    PasswordHasher::Params params;
+    params.n = 1024;
+    return params;
+}
+
+AuthPipeline::Options testOptions() {
+    AuthPipeline::Options options;
+    options.workers = 2;
+    options.max_queued = 16;
+    return options;
+}
+
+// Submit and run the io_context until the completion has run
+AuthPipeline::Result authenticate(AuthPipeline& pipeline, boost::asio::io_context& io_context,
+                                  AuthPipeline::Request request, std::thread::id* completed_on = nullptr) {
+    AuthPipeline::Result result;
+    bool done = false;
+    // Keeps run_one() waiting while the worker has the request
+    auto guard = boost::asio::make_work_guard(io_context);
+    pipeline.submit(io_context.get_executor(), std::move(request), [&](const AuthPipeline::Result& r) {
+        result = r;
+        done = true;
+        if (completed_on) {
+            *completed_on = std::this_thread::get_id();
+        }
+    });
+    io_context.restart();
+    while (!done) {
+        io_context.run_one();
+    }
+    return result;
+}
+
+} // namespace
+
+// Hashes verify against their own password only, and are salted
+TEST(PasswordHasherTest, VerifiesOwnHashes) {
+    auto first = PasswordHasher::hash("correct horse", testParams());
+    auto second = PasswordHasher::hash("correct horse", testParams());
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    EXPECT_NE(*first, *second);
+    EXPECT_EQ(first->rfind("scrypt$1024$8$1$", 0), 0u);
+
+    EXPECT_TRUE(PasswordHasher::verify("correct horse", *first));
+    EXPECT_TRUE(PasswordHasher::verify("correct horse", *second));
+    EXPECT_FALSE(PasswordHasher::verify("correct horse!", *first));
+    EXPECT_FALSE(PasswordHasher::verify("correct horse", "scrypt$1024$8$1$zz$00"));
+    EXPECT_FALSE(PasswordHasher::verify("correct horse", "plaintext"));
+}
+
+// The least recently used token goes first, and tokens expire
+TEST(SessionTokenCacheTest, EvictsLeastRecentlyUsed) {
+    SessionTokenCache cache(2, std::chrono::seconds(60));
+    auto alice = cache.issue("u-alice");
+    auto bob = cache.issue("u-bob");
+    EXPECT_EQ(cache.lookup(alice), "u-alice");
+
+    auto carol = cache.issue("u-carol");
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_FALSE(cache.lookup(bob).has_value());
+    EXPECT_EQ(cache.lookup(alice), "u-alice");
+    EXPECT_EQ(cache.lookup(carol), "u-carol");
+
+    cache.revoke(alice);
+    EXPECT_FALSE(cache.lookup(alice).has_value());
+
+    SessionTokenCache expired(2, std::chrono::seconds(0));
+    EXPECT_FALSE(expired.lookup(expired.issue("u-alice")).has_value());
+    EXPECT_EQ(expired.size(), 0u);
+}
+
+// Passwords are checked on the workers, the result comes back on the
+// caller's executor, and the issued token skips the KDF on reconnect
+TEST(AuthPipelineTest, VerifiesOffThreadAndCachesTokens) {
+    auto hash = PasswordHasher::hash("secret", testParams());
+    ASSERT_TRUE(hash.has_value());
+    std::atomic<int> lookups{0};
+    std::thread::id test_thread = std::this_thread::get_id();
+    std::atomic<bool> lookup_on_test_thread{false};
+    AuthPipeline pipeline(testOptions(), [&](const std::string& username) -> std::optional<AuthPipeline::Credential> {
+        ++lookups;
+        if (std::this_thread::get_id() == test_thread) {
+            lookup_on_test_thread = true;
+        }
+        if (username != "alice") {
+            return std::nullopt;
+        }
+        return AuthPipeline::Credential{"u-alice", *hash};
+    });
+    pipeline.start();
+    boost::asio::io_context io_context;
+
+    std::thread::id completed_on;
+    auto login = authenticate(pipeline, io_context, {"alice", "secret", ""}, &completed_on);
+    EXPECT_EQ(login.status, AuthPipeline::Status::OK);
+    EXPECT_EQ(login.user_id, "u-alice");
+    EXPECT_FALSE(login.token.empty());
+    EXPECT_FALSE(login.from_cache);
+    EXPECT_EQ(completed_on, test_thread);
+    EXPECT_FALSE(lookup_on_test_thread.load());
+
+    EXPECT_EQ(authenticate(pipeline, io_context, {"alice", "wrong", ""}).status, AuthPipeline::Status::INVALID);
+    EXPECT_EQ(authenticate(pipeline, io_context, {"mallory", "secret", ""}).status, AuthPipeline::Status::INVALID);
+
+    auto reconnect = authenticate(pipeline, io_context, {"alice", "", login.token});
+    EXPECT_EQ(reconnect.status, AuthPipeline::Status::OK);
+    EXPECT_EQ(reconnect.user_id, "u-alice");
+    EXPECT_TRUE(reconnect.from_cache);
+    EXPECT_EQ(lookups.load(), 3);
+
+    pipeline.revoke(login.token);
+    EXPECT_EQ(authenticate(pipeline, io_context, {"alice", "", login.token}).status, AuthPipeline::Status::INVALID);
+
+    auto stats = pipeline.stats();
+    EXPECT_EQ(stats.submitted, 5u);
+    EXPECT_EQ(stats.verified, 3u);
+    EXPECT_EQ(stats.cache_hits, 1u);
+    EXPECT_EQ(stats.succeeded, 2u);
+    EXPECT_EQ(stats.failed, 3u);
+}
+
+// With every worker busy and the queue full, requests are refused at once
+TEST(AuthPipelineTest, RefusesWhenQueueIsFull) {
+    auto options = testOptions();
+    options.workers = 1;
+    options.max_queued = 1;
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+    std::promise<void> entered;
+    std::atomic<bool> first{true};
+    AuthPipeline pipeline(options, [&](const std::string&) -> std::optional<AuthPipeline::Credential> {
+        if (first.exchange(false)) {
+            entered.set_value();
+            gate.wait();
+        }
+        return std::nullopt;
+    });
+    pipeline.start();
+    boost::asio::io_context io_context;
+    auto guard = boost::asio::make_work_guard(io_context);
+
+    std::vector<AuthPipeline::Status> statuses;
+    auto record = [&](const AuthPipeline::Result& result) { statuses.push_back(result.status); };
+    pipeline.submit(io_context.get_executor(), {"a", "x", ""}, record);
+    entered.get_future().wait();
+    pipeline.submit(io_context.get_executor(), {"b", "x", ""}, record);
+    pipeline.submit(io_context.get_executor(), {"c", "x", ""}, record);
+
+    io_context.run_one();
+    ASSERT_EQ(statuses.size(), 1u);
+    EXPECT_EQ(statuses[0], AuthPipeline::Status::BUSY);
+    EXPECT_EQ(pipeline.stats().rejected_busy, 1u);
+    EXPECT_EQ(pipeline.stats().peak_queued, 1u);
+
+    release.set_value();
+    while (statuses.size() < 3) {
+        io_context.run_one();
+    }
+    EXPECT_EQ(statuses[1], AuthPipeline::Status::INVALID);
+    EXPECT_EQ(statuses[2], AuthPipeline::Status::INVALID);
+}
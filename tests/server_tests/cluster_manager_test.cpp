@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include "server/cluster_manager.h"
+#include "common/message.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace chat;
+using chat_app::ChatMessage;
+using chat_app::MessageType;
+
+namespace {
+
+// Run the loop on this thread until the predicate holds or the deadline
+// passes; every handler runs here, so no locking is needed
+template <typename Predicate>
+bool runUntil(boost::asio::io_context& io_context, Predicate predicate,
+              std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate() && std::chrono::steady_clock::now() < deadline) {
+        if (io_context.stopped()) {
+            io_context.restart();
+        }
+        io_context.run_one_for(std::chrono::milliseconds(10));
+    }
+    return predicate();
+}
+
+struct Node {
+    std::unique_ptr<ClusterManager> cluster;
+    std::vector<std::string> delivered;   // "from:content"
+
+    Node(boost::asio::io_context& io_context, const std::string& node_id) {
+        ClusterManager::Options options;
+        options.node_id = node_id;
+        options.listen_address = "127.0.0.1";
+        options.reconnect_interval = std::chrono::milliseconds(50);
+        cluster = std::make_unique<ClusterManager>(
+            io_context, options,
+            [this](const chat_app::SharedEncodedMessage& message, const std::string& from_node) {
+                delivered.push_back(from_node + ":" + message->message().content);
+            });
+    }
+};
+
+class ClusterManagerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (const char* node_id : {"a", "b", "c"}) {
+            nodes_.push_back(std::make_unique<Node>(io_context_, node_id));
+            ASSERT_TRUE(nodes_.back()->cluster->start());
+        }
+        for (auto& from : nodes_) {
+            for (auto& to : nodes_) {
+                if (from != to) {
+                    from->cluster->addPeer({to->cluster->nodeId(), "127.0.0.1", to->cluster->listenPort()});
+                }
+            }
+        }
+    }
+
+    void TearDown() override {
+        for (auto& node : nodes_) {
+            node->cluster->stop();
+        }
+        io_context_.run_for(std::chrono::milliseconds(50));
+    }
+
+    ClusterManager& cluster(std::size_t index) { return *nodes_[index]->cluster; }
+    std::vector<std::string>& delivered(std::size_t index) { return nodes_[index]->delivered; }
+
+    boost::asio::io_context io_context_;
+    std::vector<std::unique_ptr<Node>> nodes_;
+};
+
+} // namespace
+
+// Presence and room interest reach every peer, and leave with the node
+TEST_F(ClusterManagerTest, PropagatesDirectory) {
+    cluster(1).userOnline("bob");
+    cluster(2).userOnline("carol");
+    cluster(1).roomMemberJoined("general");
+    cluster(2).roomMemberJoined("general");
+
+    ASSERT_TRUE(runUntil(io_context_, [&] {
+        return cluster(0).directory().nodeForUser("bob") == std::optional<std::string>("b") &&
+               cluster(1).directory().nodeForUser("carol") == std::optional<std::string>("c") &&
+               cluster(0).directory().nodesForRoom("general").size() == 2;
+    }));
+
+    cluster(1).userOffline("bob");
+    ASSERT_TRUE(runUntil(io_context_, [&] {
+        return !cluster(0).directory().nodeForUser("bob") && !cluster(2).directory().nodeForUser("bob");
+    }));
+
+    cluster(2).stop();
+    ASSERT_TRUE(runUntil(io_context_, [&] {
+        return !cluster(0).directory().nodeForUser("carol") &&
+               cluster(0).directory().nodesForRoom("general") == std::vector<std::string>{"b"};
+    }));
+}
+
+TEST_F(ClusterManagerTest, ForwardsDirectMessages) {
+    cluster(1).userOnline("bob");
+    cluster(0).userOnline("alice");
+    ASSERT_TRUE(runUntil(io_context_, [&] { return cluster(0).directory().nodeForUser("bob").has_value(); }));
+
+    auto to_bob = chat_app::makeEncodedMessage(
+        ChatMessage("alice", "bob", "hi", static_cast<uint8_t>(MessageType::TEXT_MESSAGE)));
+    auto to_alice = chat_app::makeEncodedMessage(
+        ChatMessage("bob", "alice", "hi", static_cast<uint8_t>(MessageType::TEXT_MESSAGE)));
+    auto to_nobody = chat_app::makeEncodedMessage(
+        ChatMessage("alice", "nobody", "hi", static_cast<uint8_t>(MessageType::TEXT_MESSAGE)));
+    EXPECT_TRUE(cluster(0).forwardDirect(to_bob));
+    EXPECT_FALSE(cluster(0).forwardDirect(to_alice));   // Local
+    EXPECT_FALSE(cluster(0).forwardDirect(to_nobody));  // Unknown
+
+    ASSERT_TRUE(runUntil(io_context_, [&] { return !delivered(1).empty(); }));
+    EXPECT_EQ(delivered(1), std::vector<std::string>{"a:hi"});
+    EXPECT_TRUE(delivered(2).empty());
+}
+
+// A room message crosses to each node with members once, however many
+// members the node has
+TEST_F(ClusterManagerTest, ForwardsOneCopyPerRemoteNode) {
+    for (int i = 0; i < 3; ++i) {
+        cluster(1).roomMemberJoined("general");
+    }
+    cluster(2).roomMemberJoined("general");
+    cluster(0).roomMemberJoined("general");
+    ASSERT_TRUE(runUntil(io_context_, [&] { return cluster(0).directory().nodesForRoom("general").size() == 3; }));
+
+    auto message = chat_app::makeEncodedMessage(
+        ChatMessage::forRoom("alice", "general", "yo", static_cast<uint8_t>(MessageType::GROUP_MESSAGE)));
+    EXPECT_EQ(cluster(0).forwardToRoom(message), 2u);
+
+    ASSERT_TRUE(runUntil(io_context_, [&] { return !delivered(1).empty() && !delivered(2).empty(); }));
+    // Anything extra would arrive within the same loop turns
+    io_context_.run_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(delivered(1), std::vector<std::string>{"a:yo"});
+    EXPECT_EQ(delivered(2), std::vector<std::string>{"a:yo"});
+    EXPECT_TRUE(delivered(0).empty());
+    EXPECT_EQ(cluster(0).stats().forwarded, 2u);
+    EXPECT_EQ(cluster(1).stats().received, 1u);
+}
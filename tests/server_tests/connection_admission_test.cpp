@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include "server/connection_admission.h"
+#include "common/message.h"
+#include "common/protocol.h"
+#include <future>
+#include <mutex>
+#include <thread>
+
+using namespace chat;
+using boost::asio::ip::tcp;
+
+namespace {
+
+constexpr uint16_t AUTH_RESPONSE = static_cast<uint16_t>(chat_app::MessageType::AUTH_RESPONSE);
+
+// Acceptor and sockets on one io_context running in the background
+class AdmissionFixture {
+public:
+    explicit AdmissionFixture(ConnectionAdmission::Options options)
+        : guard_(boost::asio::make_work_guard(io_context_)),
+          admission_(io_context_, io_context_, options,
+                     [this](tcp::socket socket, ConnectionAdmission::TicketPtr ticket) {
+                         std::lock_guard<std::mutex> lock(mutex_);
+                         if (on_admit_) {
+                             on_admit_(ticket);
+                         }
+                         admitted_.push_back({std::move(socket), std::move(ticket)});
+                     }) {
+        EXPECT_TRUE(admission_.start(tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)));
+        thread_ = std::thread([this] { io_context_.run(); });
+    }
+
+    ~AdmissionFixture() {
+        boost::asio::post(io_context_, [this] {
+            admission_.stop();
+            admitted_.clear();
+        });
+        guard_.reset();
+        thread_.join();
+    }
+
+    tcp::socket connect() {
+        tcp::socket socket(client_context_);
+        socket.connect(admission_.localEndpoint());
+        return socket;
+    }
+
+    // Run on the io_context and wait for it
+    void sync(std::function<void()> task) {
+        std::promise<void> done;
+        boost::asio::post(io_context_, [&] {
+            task();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    bool waitFor(std::function<bool(const ConnectionAdmission::Stats&)> condition) {
+        for (int i = 0; i < 500; ++i) {
+            if (condition(admission_.stats())) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+    ConnectionAdmission& admission() { return admission_; }
+    std::mutex& mutex() { return mutex_; }
+    std::vector<std::pair<tcp::socket, ConnectionAdmission::TicketPtr>>& admitted() { return admitted_; }
+    void onAdmit(std::function<void(const ConnectionAdmission::TicketPtr&)> handler) { on_admit_ = std::move(handler); }
+
+private:
+    boost::asio::io_context io_context_;
+    boost::asio::io_context client_context_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> guard_;
+    std::mutex mutex_;
+    std::vector<std::pair<tcp::socket, ConnectionAdmission::TicketPtr>> admitted_;
+    std::function<void(const ConnectionAdmission::TicketPtr&)> on_admit_;
+    ConnectionAdmission admission_;
+    std::thread thread_;
+};
+
+// Read the single refusal frame, then expect the server to close
+std::vector<char> readRefusal(tcp::socket& socket) {
+    std::array<char, chat_app::HEADER_SIZE> buffer;
+    boost::asio::read(socket, boost::asio::buffer(buffer));
+    chat_app::MessageHeader header;
+    header.decodeFromBuffer(buffer);
+    EXPECT_EQ(header.getMessageType(), AUTH_RESPONSE);
+    EXPECT_EQ(header.getFlags() & chat_app::MessageFlags::JSON, chat_app::MessageFlags::JSON);
+    std::vector<char> body(header.getBodySize());
+    boost::asio::read(socket, boost::asio::buffer(body));
+
+    boost::system::error_code ec;
+    char extra;
+    boost::asio::read(socket, boost::asio::buffer(&extra, 1), ec);
+    EXPECT_EQ(ec, boost::asio::error::eof);
+    return body;
+}
+
+ConnectionAdmission::Options smallOptions() {
+    ConnectionAdmission::Options options;
+    options.max_connections = 2;
+    options.max_pending_auth = 2;
+    options.auth_timeout = std::chrono::milliseconds(0);
+    options.retry_after = std::chrono::milliseconds(400);
+    return options;
+}
+
+} // namespace
+
+// The busy reply round-trips its hint
+TEST(ConnectionAdmissionTest, BusyResponseCarriesRetryAfter) {
+    auto body = ConnectionAdmission::busyResponse(std::chrono::milliseconds(1500));
+    auto retry = ConnectionAdmission::retryAfter(body);
+    ASSERT_TRUE(retry.has_value());
+    EXPECT_EQ(retry->count(), 1500);
+
+    std::string success = R"({"success":true,"user_id":"u-1"})";
+    EXPECT_FALSE(ConnectionAdmission::retryAfter(std::vector<char>(success.begin(), success.end())).has_value());
+    EXPECT_FALSE(ConnectionAdmission::retryAfter(std::vector<char>{'{', 'x'}).has_value());
+}
+
+// Past MAX_CONNECTIONS clients are refused with a retry hint until a slot frees up
+TEST(ConnectionAdmissionTest, RefusesOverMaxConnections) {
+    AdmissionFixture fixture(smallOptions());
+    auto first = fixture.connect();
+    auto second = fixture.connect();
+    ASSERT_TRUE(fixture.waitFor([](const auto& stats) { return stats.admitted == 2; }));
+    fixture.sync([&] {
+        for (auto& entry : fixture.admitted()) {
+            entry.second->authenticated();
+        }
+    });
+    EXPECT_EQ(fixture.admission().stats().active, 2u);
+    EXPECT_EQ(fixture.admission().stats().pending, 0u);
+
+    auto third = fixture.connect();
+    auto retry = ConnectionAdmission::retryAfter(readRefusal(third));
+    ASSERT_TRUE(retry.has_value());
+    // Refused for being full: twice the base, with jitter
+    EXPECT_GE(retry->count(), 400);
+    EXPECT_LE(retry->count(), 1200);
+    EXPECT_EQ(fixture.admission().stats().rejected_full, 1u);
+
+    // Dropping a session's ticket frees its slot
+    fixture.sync([&] { fixture.admitted().erase(fixture.admitted().begin()); });
+    EXPECT_EQ(fixture.admission().stats().active, 1u);
+    auto fourth = fixture.connect();
+    EXPECT_TRUE(fixture.waitFor([](const auto& stats) { return stats.admitted == 3; }));
+}
+
+// The pending-auth queue is bounded on its own
+TEST(ConnectionAdmissionTest, BoundsPendingAuthentication) {
+    auto options = smallOptions();
+    options.max_connections = 10;
+    AdmissionFixture fixture(options);
+    auto first = fixture.connect();
+    auto second = fixture.connect();
+    ASSERT_TRUE(fixture.waitFor([](const auto& stats) { return stats.pending == 2; }));
+
+    auto third = fixture.connect();
+    EXPECT_TRUE(ConnectionAdmission::retryAfter(readRefusal(third)).has_value());
+    auto stats = fixture.admission().stats();
+    EXPECT_EQ(stats.rejected_pending, 1u);
+    EXPECT_EQ(stats.rejected_full, 0u);
+
+    // Authenticating one makes room in the queue
+    fixture.sync([&] { fixture.admitted().front().second->authenticated(); });
+    auto fourth = fixture.connect();
+    ASSERT_TRUE(fixture.waitFor([](const auto& stats) { return stats.admitted == 3; }));
+    stats = fixture.admission().stats();
+    EXPECT_EQ(stats.active, 1u);
+    EXPECT_EQ(stats.pending, 2u);
+    EXPECT_EQ(stats.accepted, 4u);
+}
+
+// A ticket left unauthenticated fires its timeout handler, an authenticated one does not
+TEST(ConnectionAdmissionTest, TimesOutAuthentication) {
+    auto options = smallOptions();
+    options.auth_timeout = std::chrono::milliseconds(50);
+    AdmissionFixture fixture(options);
+    std::atomic<int> timeouts{0};
+    fixture.onAdmit([&](const ConnectionAdmission::TicketPtr& ticket) {
+        ticket->onAuthTimeout([&] { ++timeouts; });
+    });
+
+    auto first = fixture.connect();
+    auto second = fixture.connect();
+    ASSERT_TRUE(fixture.waitFor([](const auto& stats) { return stats.admitted == 2; }));
+    fixture.sync([&] { fixture.admitted().back().second->authenticated(); });
+
+    ASSERT_TRUE(fixture.waitFor([](const auto& stats) { return stats.auth_timeouts == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(timeouts.load(), 1);
+    EXPECT_EQ(fixture.admission().stats().authenticated, 1u);
+}
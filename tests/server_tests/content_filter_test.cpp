@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "server/content_filter.h"
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat;
+
+namespace {
+
+// Matched text, in the order reported
+std::vector<std::string> matches(const PatternMatcher& matcher, const std::string& text) {
+    std::vector<std::string> result;
+    matcher.scan(text, [&](const PatternMatcher::Match& match) {
+        result.push_back(text.substr(match.offset, match.length));
+        return true;
+    });
+    return result;
+}
+
+chat_app::ChatMessage message(const std::string& content) {
+    return chat_app::ChatMessage::forRoom("alice", "general", content);
+}
+
+} // namespace
+
+// Overlapping terms and terms that are suffixes of others are all found
+TEST(PatternMatcherTest, FindsOverlappingTerms) {
+    auto matcher = PatternMatcher::compile({"he", "she", "his", "hers", "", "HE"}, false);
+    EXPECT_EQ(matcher->terms().size(), 4u);  // Empty and case duplicate dropped
+    EXPECT_EQ(matches(*matcher, "ushers"), (std::vector<std::string>{"she", "he", "hers"}));
+    EXPECT_EQ(matches(*matcher, "HiS"), (std::vector<std::string>{"HiS"}));
+    EXPECT_TRUE(matches(*matcher, "nothing to see").empty());
+    EXPECT_FALSE(PatternMatcher::compile({}, false)->contains("anything"));
+}
+
+TEST(PatternMatcherTest, WholeWords) {
+    auto matcher = PatternMatcher::compile({"ass", "$$$"}, true);
+    EXPECT_TRUE(matcher->contains("you ass!"));
+    EXPECT_TRUE(matcher->contains("Ass"));
+    EXPECT_FALSE(matcher->contains("classic assassin"));
+    EXPECT_FALSE(matcher->contains("ass\xc3\xa9"));  // Followed by a UTF-8 letter
+    EXPECT_TRUE(matcher->contains("pay$$$now"));  // Boundaries only apply at word characters
+    EXPECT_TRUE(PatternMatcher::compile({"ass"}, false)->contains("classic"));
+}
+
+// Same answers as a find() per term over random text
+TEST(PatternMatcherTest, AgreesWithNaiveSearch) {
+    std::mt19937 random(7);
+    auto word = [&random](std::size_t length) {
+        std::string text;
+        for (std::size_t i = 0; i < length; ++i) {
+            text.push_back(static_cast<char>('a' + random() % 4));
+        }
+        return text;
+    };
+    std::vector<std::string> terms;
+    for (int i = 0; i < 50; ++i) {
+        terms.push_back(word(1 + random() % 5));
+    }
+    auto matcher = PatternMatcher::compile(terms, false);
+
+    for (int round = 0; round < 200; ++round) {
+        std::string text = word(random() % 40);
+        std::size_t expected = 0;
+        for (const auto& term : matcher->terms()) {
+            for (auto at = text.find(term); at != std::string::npos; at = text.find(term, at + 1)) {
+                ++expected;
+            }
+        }
+        EXPECT_EQ(matches(*matcher, text).size(), expected) << text;
+    }
+}
+
+TEST(ContentFilterTest, RejectsOrMasks) {
+    std::string path = "content_filter_test_" + std::to_string(::getpid()) + ".txt";
+    std::ofstream(path) << "# comment\n  badword \r\n\nworse phrase\n";
+
+    ContentFilter::Options options;
+    options.blocklist_path = path;
+    ContentFilter reject(options);
+    auto unloaded = message("a badword");
+    EXPECT_EQ(reject.filter(unloaded), ContentFilter::Verdict::PASS);  // Nothing loaded yet
+    ASSERT_TRUE(reject.load());
+    EXPECT_EQ(reject.termCount(), 2u);
+
+    auto clean = message("all good");
+    EXPECT_EQ(reject.filter(clean), ContentFilter::Verdict::PASS);
+    auto bad = message("a BadWord here");
+    EXPECT_EQ(reject.filter(bad), ContentFilter::Verdict::REJECTED);
+    EXPECT_EQ(bad.content, "a BadWord here");
+
+    options.action = ContentFilter::Action::MASK;
+    ContentFilter mask(options);
+    ASSERT_TRUE(mask.load());
+    auto masked = message("badword and a worse phrase");
+    EXPECT_EQ(mask.filter(masked), ContentFilter::Verdict::MASKED);
+    EXPECT_EQ(masked.content, "******* and a ************");
+
+    EXPECT_EQ(reject.stats().rejected, 1u);
+    EXPECT_EQ(mask.stats().masked, 1u);
+
+    // A missing file keeps the loaded terms
+    std::remove(path.c_str());
+    EXPECT_FALSE(mask.load());
+    EXPECT_EQ(mask.termCount(), 2u);
+    EXPECT_EQ(mask.stats().reload_failures, 1u);
+}
+
+TEST(ContentFilterTest, ReloadsWhenTheFileChanges) {
+    std::string path = "content_filter_watch_" + std::to_string(::getpid()) + ".txt";
+    std::ofstream(path) << "first\n";
+
+    ContentFilter::Options options;
+    options.blocklist_path = path;
+    ContentFilter filter(options);
+    ASSERT_TRUE(filter.load());
+    if (!filter.watch()) {
+        std::remove(path.c_str());
+        GTEST_SKIP() << "inotify not available";
+    }
+
+    // Write a new list and rename it over the old one, as editors do
+    std::ofstream(path + ".tmp") << "first\nsecond\n";
+    std::rename((path + ".tmp").c_str(), path.c_str());
+
+    for (int i = 0; i < 200 && filter.termCount() != 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(filter.termCount(), 2u);
+    auto hit = message("the second one");
+    EXPECT_EQ(filter.filter(hit), ContentFilter::Verdict::REJECTED);
+
+    filter.stop();
+    std::remove(path.c_str());
+}
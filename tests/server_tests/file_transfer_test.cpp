@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include "server/file_transfer.h"
+#include "common/message.h"
+#include <filesystem>
+#include <future>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+using namespace chat;
+using boost::asio::ip::tcp;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint16_t FILE_TRANSFER = static_cast<uint16_t>(chat_app::MessageType::FILE_TRANSFER);
+// SHA-256 of "hello world"
+const std::string HELLO_ID = "b94d27b9934d3e08a52e52d7da7dabfac484efe37a5380ee9088f7ace2efcde9";
+
+class TempDir {
+public:
+    TempDir() : path_(fs::temp_directory_path() / ("file_transfer_test_" + std::to_string(::getpid()))) {
+        fs::remove_all(path_);
+    }
+    ~TempDir() { fs::remove_all(path_); }
+    std::string path() const { return path_.string(); }
+
+private:
+    fs::path path_;
+};
+
+FileStore::Options storeOptions(const TempDir& dir) {
+    FileStore::Options options;
+    options.directory = dir.path();
+    options.max_file_size = 16 << 20;
+    return options;
+}
+
+bool write(FileStore& store, FileStore::Upload& upload, const std::string& data) {
+    return store.write(upload, upload.offset(), data.data(), data.size());
+}
+
+// A FileTransferService behind a TcpConnection on a background io_context,
+// with a blocking client socket
+class TransferFixture {
+public:
+    explicit TransferFixture(FileStore& store, uint32_t chunk_size)
+        : service_(store, chunk_size),
+          guard_(boost::asio::make_work_guard(io_context_)),
+          acceptor_(io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          client_(client_context_) {
+        client_.connect(acceptor_.local_endpoint());
+        connection_ = std::make_shared<chat_app::TcpConnection>(io_context_);
+        acceptor_.accept(connection_->socket());
+        connection_->setMessageCallback([this](const std::vector<char>& body, uint16_t type, uint16_t flags) {
+            if (type == FILE_TRANSFER) {
+                service_.handleFrame(*connection_, transfer_, body, flags);
+            }
+        });
+        connection_->start();
+        thread_ = std::thread([this] { io_context_.run(); });
+    }
+
+    ~TransferFixture() {
+        boost::asio::post(io_context_, [this] { connection_->stop(); });
+        guard_.reset();
+        thread_.join();
+    }
+
+    void send(const std::vector<char>& body, uint16_t flags) {
+        chat_app::MessageHeader header;
+        header.setMessageType(FILE_TRANSFER);
+        header.setFlags(flags);
+        header.setBodySize(static_cast<uint32_t>(body.size()));
+        std::array<char, chat_app::HEADER_SIZE> buffer;
+        header.encodeToBuffer(buffer);
+        std::array<boost::asio::const_buffer, 2> buffers = {boost::asio::buffer(buffer), boost::asio::buffer(body)};
+        boost::asio::write(client_, buffers);
+    }
+
+    void sendJson(const nlohmann::json& message) {
+        std::string text = message.dump();
+        send(std::vector<char>(text.begin(), text.end()), chat_app::MessageFlags::JSON);
+    }
+
+    void sendData(uint64_t offset, const std::string& data) {
+        auto body = FileTransferService::encodeDataPrefix(offset);
+        body.insert(body.end(), data.begin(), data.end());
+        send(body, chat_app::MessageFlags::BINARY | chat_app::MessageFlags::FRAGMENT);
+    }
+
+    std::pair<uint16_t, std::vector<char>> read() {
+        std::array<char, chat_app::HEADER_SIZE> buffer;
+        boost::asio::read(client_, boost::asio::buffer(buffer));
+        chat_app::MessageHeader header;
+        header.decodeFromBuffer(buffer);
+        std::vector<char> body(header.getBodySize());
+        boost::asio::read(client_, boost::asio::buffer(body));
+        return {header.getFlags(), body};
+    }
+
+    nlohmann::json readJson() {
+        auto frame = read();
+        EXPECT_TRUE(frame.first & chat_app::MessageFlags::JSON);
+        return nlohmann::json::parse(frame.second.begin(), frame.second.end());
+    }
+
+private:
+    FileTransferService service_;
+    FileTransferService::Transfer transfer_;
+    boost::asio::io_context io_context_;
+    boost::asio::io_context client_context_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> guard_;
+    tcp::acceptor acceptor_;
+    tcp::socket client_;
+    std::shared_ptr<chat_app::TcpConnection> connection_;
+    std::thread thread_;
+};
+
+} // namespace
+
+// Files are stored under their SHA-256, and a second copy is not stored
+TEST(FileStoreTest, StoresByContentHash) {
+    TempDir dir;
+    FileStore store(storeOptions(dir));
+    ASSERT_TRUE(store.open());
+
+    auto first = store.beginUpload(11);
+    ASSERT_TRUE(first);
+    EXPECT_TRUE(write(store, *first, "hello "));
+    EXPECT_FALSE(store.write(*first, 0, "x", 1));  // Not at the current offset
+    EXPECT_TRUE(write(store, *first, "world"));
+    auto info = store.finishUpload(*first);
+    ASSERT_TRUE(info.has_value());
+    EXPECT_EQ(info->file_id, HELLO_ID);
+    EXPECT_FALSE(info->deduplicated);
+
+    auto second = store.beginUpload(11);
+    EXPECT_TRUE(write(store, *second, "hello world"));
+    auto duplicate = store.finishUpload(*second);
+    ASSERT_TRUE(duplicate.has_value());
+    EXPECT_EQ(duplicate->file_id, HELLO_ID);
+    EXPECT_TRUE(duplicate->deduplicated);
+
+    EXPECT_EQ(store.find(HELLO_ID)->size, 11u);
+    EXPECT_FALSE(store.find("../../etc/passwd").has_value());
+    EXPECT_TRUE(fs::is_empty(fs::path(dir.path()) / "uploads"));
+    EXPECT_EQ(store.stats().bytes_deduplicated, 11u);
+}
+
+// An interrupted upload continues from the bytes on disk
+TEST(FileStoreTest, ResumesUploads) {
+    TempDir dir;
+    FileStore store(storeOptions(dir));
+    ASSERT_TRUE(store.open());
+
+    std::string id;
+    {
+        auto upload = store.beginUpload(11);
+        id = upload->id();
+        EXPECT_TRUE(write(store, *upload, "hello"));
+        // Held by one connection at a time
+        EXPECT_FALSE(store.resumeUpload(id, 11));
+    }
+    EXPECT_FALSE(store.resumeUpload(id, 4));  // More on disk than the claimed size
+    auto resumed = store.resumeUpload(id, 11);
+    ASSERT_TRUE(resumed);
+    EXPECT_EQ(resumed->offset(), 5u);
+    EXPECT_TRUE(write(store, *resumed, " world"));
+    EXPECT_EQ(store.finishUpload(*resumed)->file_id, HELLO_ID);
+    EXPECT_FALSE(store.beginUpload(17 << 20));
+}
+
+// Upload over the wire, skip a repeat upload by hash, then download a
+// range that spans several data frames
+TEST(FileTransferServiceTest, UploadsAndDownloadsRanges) {
+    TempDir dir;
+    FileStore store(storeOptions(dir));
+    ASSERT_TRUE(store.open());
+    TransferFixture fixture(store, 64 * 1024);
+
+    std::string content(300 * 1024, '\0');
+    for (std::size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>((i * 7919) >> 3);
+    }
+
+    fixture.sendJson({{"op", "upload"}, {"size", content.size()}});
+    auto ready = fixture.readJson();
+    ASSERT_EQ(ready["op"], "upload_ready");
+    EXPECT_EQ(ready["offset"], 0);
+    for (std::size_t offset = 0; offset < content.size(); offset += 100 * 1024) {
+        fixture.sendData(offset, content.substr(offset, 100 * 1024));
+    }
+    auto complete = fixture.readJson();
+    ASSERT_EQ(complete["op"], "upload_complete");
+    std::string file_id = complete["file_id"];
+    EXPECT_EQ(complete["size"], content.size());
+
+    fixture.sendJson({{"op", "upload"}, {"size", content.size()}, {"sha256", file_id}});
+    auto skipped = fixture.readJson();
+    EXPECT_EQ(skipped["op"], "upload_complete");
+    EXPECT_EQ(skipped["deduplicated"], true);
+
+    uint64_t offset = 1000;
+    uint64_t length = 200 * 1024;
+    fixture.sendJson({{"op", "download"}, {"file_id", file_id}, {"offset", offset}, {"length", length}});
+    auto download = fixture.readJson();
+    ASSERT_EQ(download["op"], "download_ready");
+    EXPECT_EQ(download["length"], length);
+
+    std::string received;
+    int frames = 0;
+    for (;;) {
+        auto frame = fixture.read();
+        ++frames;
+        EXPECT_EQ(FileTransferService::decodeDataPrefix(frame.second), offset + received.size());
+        received.append(frame.second.begin() + FileTransferService::DATA_PREFIX_SIZE, frame.second.end());
+        if (frame.first & chat_app::MessageFlags::LAST_FRAG) {
+            break;
+        }
+    }
+    EXPECT_EQ(frames, 4);
+    EXPECT_EQ(received, content.substr(offset, length));
+
+    fixture.sendJson({{"op", "download"}, {"file_id", std::string(64, '0')}});
+    EXPECT_EQ(fixture.readJson()["op"], "error");
+}
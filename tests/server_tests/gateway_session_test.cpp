@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+#include "server/gateway_session.h"
+#include "common/message.h"
+#include <nlohmann/json.hpp>
+
+using namespace chat;
+using chat_app::MessageType;
+using chat_app::StreamExtension;
+namespace MessageFlags = chat_app::MessageFlags;
+
+namespace {
+
+struct Sent {
+    std::vector<char> body;
+    uint16_t type;
+    uint16_t flags;
+};
+
+struct Received {
+    std::string user_id;
+    std::string body;
+    uint16_t type;
+    uint16_t flags;
+};
+
+struct Gateway {
+    std::vector<Sent> sent;
+    std::vector<Received> received;
+    std::vector<std::pair<std::string, bool>> changes;
+    std::shared_ptr<GatewaySession> session;
+
+    explicit Gateway(GatewaySession::Options options = {}) {
+        session = std::make_shared<GatewaySession>(
+            "bots", options,
+            [this](chat_app::TcpConnection::SharedBody body, uint16_t type, uint16_t flags) {
+                sent.push_back(Sent{*body, type, flags});
+                return true;
+            },
+            [this](const std::string& user_id, const std::vector<char>& body, uint16_t type, uint16_t flags) {
+                received.push_back(Received{user_id, std::string(body.begin(), body.end()), type, flags});
+            },
+            [](const std::string& user_id) { return user_id != "mallory"; },
+            [this](const std::string& user_id, bool open) { changes.emplace_back(user_id, open); });
+    }
+
+    void control(MessageType type, const nlohmann::json& json) {
+        std::string text = json.dump();
+        session->handleFrame(std::vector<char>(text.begin(), text.end()), static_cast<uint16_t>(type),
+                             MessageFlags::JSON);
+    }
+
+    void open(uint32_t stream, const std::string& user_id) {
+        control(MessageType::STREAM_OPEN, {{"stream", stream}, {"user_id", user_id}});
+    }
+
+    nlohmann::json lastReply() const {
+        return nlohmann::json::parse(sent.back().body.begin(), sent.back().body.end());
+    }
+};
+
+chat_app::TcpConnection::SharedBody text(const std::string& value) {
+    return std::make_shared<const std::vector<char>>(value.begin(), value.end());
+}
+
+// Streams named by a frame and the payload after the extension
+std::pair<std::vector<uint32_t>, std::string> unpack(const Sent& frame) {
+    StreamExtension extension;
+    auto offset = StreamExtension::decode(frame.body, extension);
+    EXPECT_TRUE(offset.has_value());
+    return {extension.streams, std::string(frame.body.begin() + static_cast<std::ptrdiff_t>(offset.value_or(0)),
+                                           frame.body.end())};
+}
+
+} // namespace
+
+TEST(GatewaySessionTest, ExtensionRoundTrips) {
+    StreamExtension extension;
+    extension.streams = {1, 70000, 0xFFFFFFFF};
+    auto body = extension.encode("hi", 2);
+    EXPECT_EQ(body.size(), 2u + 12u + 2u);
+
+    StreamExtension decoded;
+    auto offset = StreamExtension::decode(body, decoded);
+    ASSERT_TRUE(offset.has_value());
+    EXPECT_EQ(*offset, 14u);
+    EXPECT_EQ(decoded.streams, extension.streams);
+
+    body.resize(10);  // Count says three ids
+    EXPECT_FALSE(StreamExtension::decode(body, decoded).has_value());
+    EXPECT_FALSE(StreamExtension::decode(std::vector<char>{0, 0}, decoded).has_value());
+}
+
+// Streams bind logical users; the gateway cannot bind one twice or act
+// as a user it is not allowed to
+TEST(GatewaySessionTest, OpensStreamsAndDemuxesFrames) {
+    Gateway gateway;
+    gateway.open(1, "bot-a");
+    EXPECT_TRUE(gateway.lastReply()["ok"].get<bool>());
+    EXPECT_EQ(gateway.lastReply()["credit"].get<uint32_t>(), 64u);
+    gateway.open(2, "bot-a");
+    EXPECT_FALSE(gateway.lastReply()["ok"].get<bool>());
+    gateway.open(3, "mallory");
+    EXPECT_FALSE(gateway.lastReply()["ok"].get<bool>());
+    gateway.open(4, "bot-b");
+    EXPECT_EQ(gateway.session->users().size(), 2u);
+    EXPECT_EQ(gateway.changes.size(), 2u);
+
+    StreamExtension extension;
+    extension.streams = {4};
+    auto body = extension.encode("hello", 5);
+    gateway.session->handleFrame(body, 7, MessageFlags::MULTIPLEXED | MessageFlags::JSON);
+    ASSERT_EQ(gateway.received.size(), 1u);
+    EXPECT_EQ(gateway.received[0].user_id, "bot-b");
+    EXPECT_EQ(gateway.received[0].body, "hello");
+    EXPECT_EQ(gateway.received[0].flags, MessageFlags::JSON);
+
+    // Unknown stream, several streams, and an untagged data frame
+    extension.streams = {9};
+    gateway.session->handleFrame(extension.encode("x", 1), 7, MessageFlags::MULTIPLEXED);
+    extension.streams = {1, 4};
+    gateway.session->handleFrame(extension.encode("x", 1), 7, MessageFlags::MULTIPLEXED);
+    gateway.session->handleFrame(std::vector<char>{'x'}, 7, 0);
+    EXPECT_EQ(gateway.received.size(), 1u);
+
+    gateway.control(MessageType::STREAM_CLOSE, {{"stream", 1}});
+    EXPECT_FALSE(gateway.session->hasUser("bot-a"));
+    EXPECT_EQ(gateway.changes.back(), std::make_pair(std::string("bot-a"), false));
+    EXPECT_EQ(gateway.session->stats().rejected, 5u);
+}
+
+// A message for many co-located users is one frame naming every stream
+TEST(GatewaySessionTest, BatchesDeliveryIntoOneFrame) {
+    Gateway gateway;
+    std::vector<std::string> users;
+    for (uint32_t i = 1; i <= 100; ++i) {
+        users.push_back("bot-" + std::to_string(i));
+        gateway.open(i, users.back());
+    }
+    gateway.sent.clear();
+    users.push_back("alice");  // Not on this gateway
+
+    EXPECT_EQ(gateway.session->deliver(users, text("hi"), 7, MessageFlags::JSON), 100u);
+    ASSERT_EQ(gateway.sent.size(), 1u);
+    EXPECT_EQ(gateway.sent[0].flags, MessageFlags::JSON | MessageFlags::MULTIPLEXED);
+    auto [streams, payload] = unpack(gateway.sent[0]);
+    EXPECT_EQ(streams.size(), 100u);
+    EXPECT_EQ(payload, "hi");
+
+    auto stats = gateway.session->stats();
+    EXPECT_EQ(stats.frames_out, 1u);
+    EXPECT_EQ(stats.deliveries, 100u);
+}
+
+// A stream out of credit queues (bounded) without holding up the others,
+// and catches up in order when credit arrives
+TEST(GatewaySessionTest, FlowControlIsPerStream) {
+    GatewaySession::Options options;
+    options.initial_credit = 1;
+    options.max_queued = 2;
+    Gateway gateway(options);
+    gateway.open(1, "slow");
+    gateway.open(2, "fast");
+    gateway.sent.clear();
+
+    gateway.session->deliver({"slow", "fast"}, text("m1"), 7);
+    gateway.control(MessageType::STREAM_CREDIT, {{"stream", 2}, {"credit", 10}});
+    for (int i = 2; i <= 4; ++i) {
+        gateway.session->deliver({"slow", "fast"}, text("m" + std::to_string(i)), 7);
+    }
+    // m1 to both, then m2..m4 to fast alone
+    ASSERT_EQ(gateway.sent.size(), 4u);
+    EXPECT_EQ(unpack(gateway.sent[3]).first, std::vector<uint32_t>{2});
+
+    gateway.sent.clear();
+    gateway.control(MessageType::STREAM_CREDIT, {{"stream", 1}, {"credit", 5}});
+    ASSERT_EQ(gateway.sent.size(), 2u);  // m2 was dropped from the full queue
+    EXPECT_EQ(unpack(gateway.sent[0]).second, "m3");
+    EXPECT_EQ(unpack(gateway.sent[1]).second, "m4");
+
+    auto stats = gateway.session->stats();
+    EXPECT_EQ(stats.queued, 3u);
+    EXPECT_EQ(stats.dropped, 1u);
+}
+
+TEST(GatewaySessionTest, RegistryBatchesPerGateway) {
+    GatewayRegistry registry;
+    Gateway first;
+    Gateway second;
+    auto track = [&registry](Gateway& gateway) {
+        for (const auto& user_id : gateway.session->users()) {
+            registry.streamChanged(gateway.session, user_id, true);
+        }
+    };
+    first.open(1, "bot-a");
+    first.open(2, "bot-b");
+    second.open(1, "bot-c");
+    track(first);
+    track(second);
+    first.sent.clear();
+    second.sent.clear();
+
+    auto direct = registry.fanOut({"alice", "bot-a", "bot-c", "bot-b"}, text("hi"), 7);
+    EXPECT_EQ(direct, std::vector<std::string>{"alice"});
+    ASSERT_EQ(first.sent.size(), 1u);
+    EXPECT_EQ(unpack(first.sent[0]).first.size(), 2u);
+    EXPECT_EQ(second.sent.size(), 1u);
+
+    // A stream that closed before the registry heard of it is delivered normally
+    second.control(MessageType::STREAM_CLOSE, {{"stream", 1}});
+    EXPECT_EQ(registry.fanOut({"bot-a", "bot-c"}, text("again"), 7), std::vector<std::string>{"bot-c"});
+
+    registry.remove(first.session);
+    EXPECT_EQ(registry.find("bot-a"), nullptr);
+    EXPECT_EQ(registry.find("bot-c"), second.session);
+}
@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+#include "server/incremental_autosave.h"
+#include "server/sqlite_state_store.h"
+#include <filesystem>
+#include <unistd.h>
+
+using namespace chat;
+namespace fs = std::filesystem;
+
+// Test fixture
+class IncrementalAutosaveTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (int i = 0; i < 1000; ++i) {
+            std::string id = "u-" + std::to_string(i);
+            users_.emplace(id, chat_app::User(id, "user" + std::to_string(i)));
+        }
+    }
+
+    IncrementalAutosave::UserResolver resolver() {
+        return [this](const std::string& user_id) -> std::optional<chat_app::User> {
+            auto it = users_.find(user_id);
+            if (it == users_.end()) {
+                return std::nullopt;
+            }
+            return it->second;
+        };
+    }
+
+    boost::asio::io_context io_context_;
+    std::unordered_map<std::string, chat_app::User> users_;
+    std::vector<ChangeBatch> batches_;
+};
+
+// Only the users that changed are read and written
+TEST_F(IncrementalAutosaveTest, SavesOnlyChangedUsers) {
+    IncrementalAutosave autosave(io_context_, IncrementalAutosave::Options{}, resolver(),
+                                 [this](const ChangeBatch& batch) { batches_.push_back(batch); return true; });
+
+    auto& alice = users_.at("u-1");
+    alice.setStatus(chat_app::UserStatus::ONLINE);
+    alice.setDisplayName(std::string("Alice"));
+    autosave.userChanged(alice);
+    EXPECT_FALSE(alice.isDirty());
+
+    auto& bob = users_.at("u-2");
+    bob.setStatus(chat_app::UserStatus::OFFLINE);  // Unchanged value stays clean
+    autosave.userChanged(bob);
+    bob.addToRoom("general");
+    autosave.userChanged(bob);
+    EXPECT_EQ(autosave.pendingChanges(), 2u);
+
+    ASSERT_TRUE(autosave.saveNow());
+    ASSERT_EQ(batches_.size(), 1u);
+    const auto& batch = batches_[0];
+    ASSERT_EQ(batch.users.size(), 2u);
+    for (const auto& change : batch.users) {
+        if (change.user.user_id == "u-1") {
+            EXPECT_EQ(change.fields, chat_app::UserFields::STATUS | chat_app::UserFields::PROFILE);
+            EXPECT_EQ(change.user.display_name, std::optional<std::string>("Alice"));
+        } else {
+            EXPECT_EQ(change.user.user_id, "u-2");
+            EXPECT_EQ(change.fields, chat_app::UserFields::ROOMS);
+        }
+    }
+
+    // Nothing changed since: no write at all
+    EXPECT_TRUE(autosave.saveNow());
+    EXPECT_EQ(batches_.size(), 1u);
+    EXPECT_EQ(autosave.stats().saves, 1u);
+}
+
+// Repeated changes collapse to the latest state per record
+TEST_F(IncrementalAutosaveTest, CollapsesRepeatedChanges) {
+    IncrementalAutosave autosave(io_context_, IncrementalAutosave::Options{}, resolver(),
+                                 [this](const ChangeBatch& batch) { batches_.push_back(batch); return true; });
+
+    autosave.membershipChanged("general", "u-1", true);
+    autosave.membershipChanged("general", "u-1", false);
+    autosave.membershipChanged("random", "u-1", true);
+    autosave.userChanged("u-3", chat_app::UserFields::STATUS);
+    autosave.userRemoved("u-3");
+    autosave.userChanged("u-4", chat_app::UserFields::STATUS);
+    users_.erase("u-4");  // Gone by the time of the save
+
+    ASSERT_TRUE(autosave.saveNow());
+    ASSERT_EQ(batches_.size(), 1u);
+    const auto& batch = batches_[0];
+    EXPECT_TRUE(batch.users.empty());
+    EXPECT_EQ(batch.removed_users.size(), 2u);
+    ASSERT_EQ(batch.memberships.size(), 2u);
+    EXPECT_EQ(batch.memberships[0].room_id, "general");
+    EXPECT_FALSE(batch.memberships[0].joined);
+    EXPECT_EQ(batch.memberships[1].room_id, "random");
+    EXPECT_TRUE(batch.memberships[1].joined);
+}
+
+// A failed save keeps its changes for the next attempt
+TEST_F(IncrementalAutosaveTest, FailedSaveIsRetried) {
+    bool fail = true;
+    IncrementalAutosave autosave(io_context_, IncrementalAutosave::Options{}, resolver(),
+                                 [&](const ChangeBatch& batch) {
+                                     if (fail) {
+                                         return false;
+                                     }
+                                     batches_.push_back(batch);
+                                     return true;
+                                 });
+
+    autosave.userChanged("u-1", chat_app::UserFields::STATUS);
+    EXPECT_FALSE(autosave.saveNow());
+    EXPECT_EQ(autosave.pendingChanges(), 1u);
+
+    autosave.userChanged("u-1", chat_app::UserFields::PROFILE);
+    fail = false;
+    ASSERT_TRUE(autosave.saveNow());
+    ASSERT_EQ(batches_.size(), 1u);
+    ASSERT_EQ(batches_[0].users.size(), 1u);
+    EXPECT_EQ(batches_[0].users[0].fields, chat_app::UserFields::STATUS | chat_app::UserFields::PROFILE);
+    EXPECT_EQ(autosave.stats().failures, 1u);
+    EXPECT_EQ(autosave.pendingChanges(), 0u);
+}
+
+// The interval timer drives saves on the background thread
+TEST_F(IncrementalAutosaveTest, SavesOnInterval) {
+    auto work = boost::asio::make_work_guard(io_context_);
+    std::thread io_thread([&]() { io_context_.run(); });
+
+    std::mutex mutex;
+    std::size_t saved = 0;
+    IncrementalAutosave::Options options;
+    options.interval = std::chrono::milliseconds(10);
+    IncrementalAutosave autosave(io_context_, options, resolver(), [&](const ChangeBatch& batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        saved += batch.users.size();
+        return true;
+    });
+    autosave.start();
+
+    autosave.userChanged("u-1", chat_app::UserFields::STATUS);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (autosave.stats().saves < 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    autosave.userChanged("u-2", chat_app::UserFields::STATUS);
+    autosave.stop();  // Flushes u-2
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(saved, 2u);
+    }
+
+    work.reset();
+    io_context_.stop();
+    io_thread.join();
+}
+
+// Batches land in SQLite and read back field for field
+TEST_F(IncrementalAutosaveTest, SqliteStoreAppliesBatches) {
+    std::string path = (fs::temp_directory_path() / ("autosave_test_" + std::to_string(::getpid()) + ".db")).string();
+    fs::remove(path);
+
+    {
+        SqliteStateStore store;
+        ASSERT_TRUE(store.open(path));
+        IncrementalAutosave autosave(io_context_, IncrementalAutosave::Options{}, resolver(),
+                                     [&](const ChangeBatch& batch) { return store.apply(batch); });
+
+        // Initial load writes everyone once
+        for (auto& entry : users_) {
+            autosave.userChanged(entry.first, chat_app::UserFields::ALL);
+        }
+        ASSERT_TRUE(autosave.saveNow());
+        EXPECT_EQ(store.userCount(), users_.size());
+
+        auto& alice = users_.at("u-7");
+        alice.setEmail(std::string("alice@example.com"));
+        alice.setLastSeen(std::chrono::system_clock::time_point(std::chrono::milliseconds(1700000000123)));
+        alice.addToRoom("general");
+        alice.addToRoom("random");
+        autosave.userChanged(alice);
+        autosave.membershipChanged("lobby", "u-7", true);
+        autosave.userRemoved("u-8");
+        users_.erase("u-8");
+        ASSERT_TRUE(autosave.saveNow());
+        EXPECT_EQ(autosave.stats().last_batch, 3u);
+
+        auto loaded = store.loadUser("u-7");
+        ASSERT_TRUE(loaded.has_value());
+        EXPECT_EQ(loaded->username, "user7");
+        EXPECT_EQ(loaded->email, alice.email);
+        EXPECT_FALSE(loaded->display_name.has_value());
+        EXPECT_EQ(loaded->last_seen, alice.last_seen);
+        EXPECT_EQ(loaded->room_ids, (std::vector<std::string>{"general", "lobby", "random"}));
+        EXPECT_FALSE(store.loadUser("u-8").has_value());
+        EXPECT_EQ(store.userCount(), users_.size());
+    }
+
+    fs::remove(path);
+    fs::remove(path + "-wal");
+    fs::remove(path + "-shm");
+}
+
+// Mentions are dropped once a read position passes them, and what is
+// left loads back at startup
+TEST_F(IncrementalAutosaveTest, SqliteStoreKeepsUnreadMentions) {
+    std::string path = (fs::temp_directory_path() / ("autosave_notify_" + std::to_string(::getpid()) + ".db")).string();
+    fs::remove(path);
+
+    {
+        SqliteStateStore store;
+        ASSERT_TRUE(store.open(path));
+        IncrementalAutosave autosave(io_context_, IncrementalAutosave::Options{}, resolver(),
+                                     [&](const ChangeBatch& batch) { return store.apply(batch); });
+
+        autosave.mentionAdded(Mention{"general", "u-1", "m-1", "u-2", 1000});
+        autosave.mentionAdded(Mention{"general", "u-1", "m-2", "u-2", 2000});
+        autosave.mentionAdded(Mention{"random", "u-1", "m-3", "u-2", 500});
+        autosave.readPositionChanged("general", "u-1", 1500);
+        autosave.readPositionChanged("general", "u-1", 1200);  // Older; the later one wins
+        EXPECT_EQ(autosave.pendingChanges(), 4u);
+        ASSERT_TRUE(autosave.saveNow());
+
+        autosave.mentionAdded(Mention{"general", "u-5", "m-4", "u-2", 3000});
+        autosave.userRemoved("u-5");
+        ASSERT_TRUE(autosave.saveNow());
+
+        std::vector<ReadPositionChange> positions;
+        std::vector<Mention> mentions;
+        ASSERT_TRUE(store.loadNotifications([&](const ReadPositionChange& change) { positions.push_back(change); },
+                                            [&](const Mention& mention) { mentions.push_back(mention); }));
+        ASSERT_EQ(positions.size(), 1u);
+        EXPECT_EQ(positions[0].room_id, "general");
+        EXPECT_EQ(positions[0].user_id, "u-1");
+        EXPECT_EQ(positions[0].position, 1500u);
+        ASSERT_EQ(mentions.size(), 2u);
+        EXPECT_EQ(mentions[0].message_id, "m-3");
+        EXPECT_EQ(mentions[1].message_id, "m-2");
+        EXPECT_EQ(mentions[1].sender_id, "u-2");
+    }
+
+    fs::remove(path);
+    fs::remove(path + "-wal");
+    fs::remove(path + "-shm");
+}
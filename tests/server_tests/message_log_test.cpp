@@ -0,0 +1,338 @@
+#include <gtest/gtest.h>
+#include "server/message_log.h"
+#include "server/cluster_manager.h"
+#include "common/message.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat;
+namespace fs = std::filesystem;
+
+namespace {
+
+chat_app::SharedEncodedMessage roomMessage(int index) {
+    return chat_app::makeEncodedMessage(chat_app::ChatMessage::forRoom(
+        "alice", "general", "message " + std::to_string(index),
+        static_cast<uint8_t>(chat_app::MessageType::GROUP_MESSAGE)));
+}
+
+template <typename Predicate>
+bool waitFor(Predicate predicate, std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (predicate()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return predicate();
+}
+
+ClusterManager::Options clusterOptions(const std::string& node_id) {
+    ClusterManager::Options options;
+    options.node_id = node_id;
+    options.listen_address = "127.0.0.1";
+    options.reconnect_interval = std::chrono::milliseconds(50);
+    return options;
+}
+
+// Leader and follower nodes on one io thread. The nodes are stopped
+// after the thread has finished, so stop() never races their handlers;
+// declare it after the logs attached to it.
+struct ClusterPair {
+    boost::asio::io_context io_context;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{io_context.get_executor()};
+    ClusterManager leader{io_context, clusterOptions("leader"), nullptr};
+    ClusterManager follower{io_context, clusterOptions("follower"), nullptr};
+    std::thread io_thread;
+
+    bool start() {
+        if (!leader.start() || !follower.start()) {
+            return false;
+        }
+        io_thread = std::thread([this]() { io_context.run(); });
+        return true;
+    }
+
+    void link() {
+        leader.addPeer(NodeInfo{"follower", "127.0.0.1", follower.listenPort()});
+        follower.addPeer(NodeInfo{"leader", "127.0.0.1", leader.listenPort()});
+    }
+
+    ~ClusterPair() {
+        work.reset();
+        io_context.stop();
+        if (io_thread.joinable()) {
+            io_thread.join();
+        }
+        leader.stop();
+        follower.stop();
+    }
+};
+
+} // namespace
+
+// Test fixture
+class MessageLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        directory_ = fs::temp_directory_path() /
+                     ("message_log_test_" + std::to_string(::getpid()) + "_" +
+                      ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        fs::remove_all(directory_);
+    }
+
+    void TearDown() override {
+        fs::remove_all(directory_);
+    }
+
+    MessageLog::Options options(const std::string& suffix = "") const {
+        MessageLog::Options options;
+        options.directory = (suffix.empty() ? directory_ : directory_ / suffix).string();
+        options.segment_bytes = 64 * 1024;
+        return options;
+    }
+
+    // Reads every record and decodes its content
+    static std::vector<std::string> contents(const MessageLog& log, uint64_t from = 1) {
+        std::vector<std::string> result;
+        log.read(from, SIZE_MAX, [&](uint64_t, const char* data, std::size_t size) {
+            result.push_back(chat_app::ChatMessage::fromBinary(data, size).content);
+            return true;
+        });
+        return result;
+    }
+
+    fs::path directory_;
+};
+
+// Concurrent appenders share syncs and every record is acknowledged
+TEST_F(MessageLogTest, GroupCommitsConcurrentAppends) {
+    MessageLog log(options());
+    ASSERT_TRUE(log.open());
+
+    std::atomic<int> acknowledged{0};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < 250; ++i) {
+                log.append(roomMessage(t * 250 + i), [&](uint64_t, bool durable) {
+                    acknowledged += durable ? 1 : 0;
+                });
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    ASSERT_TRUE(waitFor([&]() { return acknowledged == 1000; }));
+    EXPECT_EQ(log.durableSequence(), 1000u);
+    EXPECT_EQ(log.stats().appended, 1000u);
+    EXPECT_LT(log.stats().batches, 1000u);
+    EXPECT_EQ(contents(log).size(), 1000u);
+}
+
+// Records survive a restart, across segment boundaries
+TEST_F(MessageLogTest, RecoversAcrossSegments) {
+    {
+        MessageLog log(options());
+        ASSERT_TRUE(log.open());
+        for (int i = 0; i < 2000; ++i) {
+            log.append(roomMessage(i));
+        }
+        log.close();
+        EXPECT_EQ(log.durableSequence(), 2000u);
+    }
+
+    std::size_t segments = std::distance(fs::directory_iterator(directory_), fs::directory_iterator());
+    EXPECT_GT(segments, 1u);
+
+    MessageLog log(options());
+    ASSERT_TRUE(log.open());
+    EXPECT_EQ(log.lastSequence(), 2000u);
+
+    auto tail = contents(log, 1501);
+    ASSERT_EQ(tail.size(), 500u);
+    EXPECT_EQ(tail.front(), "message 1500");
+    EXPECT_EQ(tail.back(), "message 1999");
+
+    // Appends continue the sequence
+    EXPECT_EQ(log.append(roomMessage(2000)), 2001u);
+    log.close();
+    EXPECT_EQ(log.durableSequence(), 2001u);
+
+    // Released segments are deleted, the rest stays readable
+    MessageLog reopened(options());
+    ASSERT_TRUE(reopened.open());
+    reopened.releaseBefore(1500);
+    EXPECT_GT(reopened.firstSequence(), 1u);
+    EXPECT_LE(reopened.firstSequence(), 1500u);
+    EXPECT_EQ(contents(reopened, 1501).size(), 501u);
+}
+
+// A torn write at the tail is dropped on recovery, and cleared on disk
+TEST_F(MessageLogTest, DiscardsTornTail) {
+    std::size_t end = 0;
+    std::size_t recovered_end = 0;
+    {
+        MessageLog log(options());
+        ASSERT_TRUE(log.open());
+        for (int i = 0; i < 10; ++i) {
+            auto message = roomMessage(i);
+            recovered_end = end;
+            end += 16 + message->binary()->size();
+            log.append(message);
+        }
+        log.close();
+    }
+
+    // Damage the last byte of the last record
+    fs::path segment = *fs::directory_iterator(directory_);
+    {
+        std::fstream file(segment, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(end - 1));
+        char byte = static_cast<char>(file.get());
+        file.seekp(static_cast<std::streamoff>(end - 1));
+        file.put(static_cast<char>(byte ^ 0x5A));
+    }
+
+    MessageLog log(options());
+    ASSERT_TRUE(log.open());
+    EXPECT_EQ(log.durableSequence(), 9u);
+    EXPECT_EQ(contents(log).size(), 9u);
+    {
+        std::ifstream file(segment, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(recovered_end));
+        std::vector<char> rest((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(rest.size(), fs::file_size(segment) - recovered_end);
+        EXPECT_TRUE(std::all_of(rest.begin(), rest.end(), [](char byte) { return byte == 0; }));
+    }
+
+    // The next record overwrites the damaged one
+    EXPECT_EQ(log.append(roomMessage(10)), 10u);
+    log.close();
+
+    MessageLog reopened(options());
+    ASSERT_TRUE(reopened.open());
+    auto all = contents(reopened);
+    ASSERT_EQ(all.size(), 10u);
+    EXPECT_EQ(all.back(), "message 10");
+}
+
+// With a follower, a message is acknowledged only after the follower has it
+TEST_F(MessageLogTest, ReplicatesToFollowerBeforeAck) {
+    auto leader_options = options("leader");
+    leader_options.follower_node = "follower";
+    MessageLog leader(leader_options);
+    MessageLog follower(options("follower"));
+    ClusterPair cluster;
+    leader.attachCluster(cluster.leader);
+    follower.attachCluster(cluster.follower);
+    ASSERT_TRUE(leader.open());
+    ASSERT_TRUE(follower.open());
+
+    ASSERT_TRUE(cluster.start());
+    cluster.link();
+
+    std::atomic<int> acknowledged{0};
+    for (int i = 0; i < 300; ++i) {
+        leader.append(roomMessage(i), [&](uint64_t sequence, bool durable) {
+            // The follower already holds everything acknowledged
+            if (durable && follower.durableSequence() >= sequence) {
+                ++acknowledged;
+            }
+        });
+    }
+
+    EXPECT_TRUE(waitFor([&]() { return acknowledged == 300; }));
+    EXPECT_EQ(leader.stats().replicated, 300u);
+    EXPECT_EQ(contents(follower), contents(leader));
+
+    leader.close();
+    follower.close();
+}
+
+// Records the follower never received are resent from the leader's log
+// once it is reachable; until then they are reported unreplicated
+TEST_F(MessageLogTest, ResendsMissedRecordsToFollower) {
+    auto leader_options = options("leader");
+    leader_options.follower_node = "follower";
+    leader_options.replica_retry = std::chrono::milliseconds(50);
+    leader_options.replica_timeout = std::chrono::milliseconds(200);
+    MessageLog leader(leader_options);
+    MessageLog follower(options("follower"));
+    ClusterPair cluster;
+    leader.attachCluster(cluster.leader);
+    follower.attachCluster(cluster.follower);
+    ASSERT_TRUE(leader.open());
+    ASSERT_TRUE(follower.open());
+    ASSERT_TRUE(cluster.start());
+
+    // The follower is not reachable yet
+    std::atomic<int> failed{0};
+    for (int i = 0; i < 50; ++i) {
+        leader.append(roomMessage(i), [&](uint64_t, bool durable) {
+            failed += durable ? 0 : 1;
+        });
+    }
+    ASSERT_TRUE(waitFor([&]() { return failed == 50; }));
+    EXPECT_EQ(leader.stats().unreplicated, 50u);
+    EXPECT_EQ(follower.durableSequence(), 0u);
+
+    // Once linked, the leader resends without waiting for new appends
+    cluster.link();
+    ASSERT_TRUE(waitFor([&]() { return follower.durableSequence() == 50; }));
+    EXPECT_GT(leader.stats().resends, 0u);
+
+    std::atomic<int> acknowledged{0};
+    for (int i = 50; i < 100; ++i) {
+        leader.append(roomMessage(i), [&](uint64_t, bool durable) {
+            acknowledged += durable ? 1 : 0;
+        });
+    }
+    EXPECT_TRUE(waitFor([&]() { return acknowledged == 50; }));
+    EXPECT_EQ(contents(follower), contents(leader));
+
+    leader.close();
+    follower.close();
+}
+
+// A follower applies records strictly in sequence and asks for the gap
+TEST_F(MessageLogTest, FollowerRejectsGaps) {
+    // The leader already holds records the follower never saw
+    {
+        MessageLog earlier(options("leader"));
+        ASSERT_TRUE(earlier.open());
+        for (int i = 0; i < 20; ++i) {
+            earlier.append(roomMessage(i));
+        }
+        earlier.close();
+    }
+
+    auto leader_options = options("leader");
+    leader_options.follower_node = "follower";
+    MessageLog leader(leader_options);
+    MessageLog follower(options("follower"));
+    ClusterPair cluster;
+    leader.attachCluster(cluster.leader);
+    follower.attachCluster(cluster.follower);
+    ASSERT_TRUE(leader.open());
+    ASSERT_TRUE(follower.open());
+    ASSERT_TRUE(cluster.start());
+    cluster.link();
+
+    // Sequence 21 arrives first; the follower asks for 1 and gets 1-21
+    std::atomic<bool> acknowledged{false};
+    EXPECT_EQ(leader.append(roomMessage(20), [&](uint64_t, bool durable) { acknowledged = durable; }), 21u);
+    EXPECT_TRUE(waitFor([&]() { return acknowledged.load(); }));
+    EXPECT_EQ(follower.durableSequence(), 21u);
+    EXPECT_EQ(contents(follower), contents(leader));
+
+    leader.close();
+    follower.close();
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include "server/notification_index.h"
+#include <nlohmann/json.hpp>
+
+using namespace chat;
+using chat_app::ChatMessage;
+
+namespace {
+
+ChatMessage post(const std::string& sender, const std::string& room, const std::string& text, uint64_t sequence) {
+    ChatMessage message = ChatMessage::forRoom(sender, room, text);
+    message.sequence = sequence;
+    return message;
+}
+
+} // namespace
+
+TEST(NotificationIndexTest, ParsesMentions) {
+    EXPECT_EQ(NotificationIndex::parseMentions("hi @bob and @carol.smith, ask @bob."),
+              (std::vector<std::string>{"bob", "carol.smith"}));
+    EXPECT_TRUE(NotificationIndex::parseMentions("mail alice@example.com or @ nobody").empty());
+    EXPECT_EQ(NotificationIndex::parseMentions("(@dave)"), std::vector<std::string>{"dave"});
+}
+
+// Unread counts follow new messages and read positions; the sender's own
+// messages are never unread for them
+TEST(NotificationIndexTest, CountsUnreadPerRoom) {
+    NotificationIndex index(NotificationIndex::Options{}, nullptr);
+    for (int i = 1; i <= 5; ++i) {
+        index.record(post("alice", "general", "msg", i));
+    }
+    index.record(post("bob", "random", "hello", 1));
+
+    EXPECT_EQ(index.unread("general", "bob"), 5u);
+    EXPECT_EQ(index.unread("general", "alice"), 0u);
+    EXPECT_EQ(index.unread("random", "bob"), 0u);
+
+    index.markRead("general", "bob", 3);
+    EXPECT_EQ(index.unread("general", "bob"), 2u);
+    index.markRead("general", "bob", 1);  // Older positions are ignored
+    EXPECT_EQ(index.unread("general", "bob"), 2u);
+    EXPECT_EQ(index.stats().read_receipts, 1u);
+    EXPECT_EQ(index.unread("lobby", "bob"), 0u);
+}
+
+// Positions are sequences: messages stamped in the same millisecond are
+// counted apart, repeats once, and a receipt without a position reads all
+TEST(NotificationIndexTest, CountsBySequence) {
+    NotificationIndex index(NotificationIndex::Options{}, nullptr);
+    auto sent = std::chrono::system_clock::now();
+    for (uint64_t sequence : {1, 2, 4, 3, 4}) {
+        ChatMessage message = post("alice", "general", "msg", sequence);
+        message.timestamp = sent;
+        index.record(message);
+    }
+    EXPECT_EQ(index.unread("general", "bob"), 4u);
+    index.markRead("general", "bob", 2);
+    EXPECT_EQ(index.unread("general", "bob"), 2u);
+
+    // Without a sequence a message goes after the newest
+    index.record(post("alice", "general", "msg", 0));
+    EXPECT_EQ(index.unread("general", "bob"), 3u);
+
+    index.markRead("general", "bob", 0);
+    EXPECT_EQ(index.unread("general", "bob"), 0u);
+    index.record(post("alice", "general", "msg", 6));
+    EXPECT_EQ(index.unread("general", "bob"), 1u);
+}
+
+TEST(NotificationIndexTest, CapsUnreadCounts) {
+    NotificationIndex::Options options;
+    options.max_unread = 10;
+    NotificationIndex index(options, nullptr);
+    for (int i = 1; i <= 50; ++i) {
+        index.record(post("alice", "general", "msg", i));
+    }
+    EXPECT_EQ(index.unread("general", "bob"), 10u);
+    index.markRead("general", "bob", 45);
+    EXPECT_EQ(index.unread("general", "bob"), 5u);
+}
+
+// Mentions of members are kept until the user reads past them, and the
+// login summary only covers the user's rooms
+TEST(NotificationIndexTest, SummarizesMentions) {
+    std::unordered_map<std::string, std::string> ids = {{"bob", "u-bob"}, {"carol", "u-carol"}};
+    NotificationIndex index(NotificationIndex::Options{}, nullptr,
+        [&ids](std::string_view name) -> std::optional<std::string> {
+            auto it = ids.find(std::string(name));
+            return it == ids.end() ? std::nullopt : std::optional<std::string>(it->second);
+        },
+        [](const std::string& room, const std::string& user) { return room != "staff" || user == "u-carol"; });
+
+    EXPECT_EQ(index.record(post("u-alice", "general", "@bob @carol @nobody look", 1)),
+              (std::vector<std::string>{"u-bob", "u-carol"}));
+    EXPECT_TRUE(index.record(post("u-alice", "staff", "@bob is not here", 1)).empty());
+    index.record(post("u-alice", "general", "later @bob", 2));
+    index.record(post("u-alice", "random", "hey @bob", 1));
+
+    auto summary = index.summary("u-bob", {"general", "random"});
+    ASSERT_EQ(summary.rooms.size(), 2u);
+    EXPECT_EQ(summary.rooms[0].room_id, "general");
+    EXPECT_EQ(summary.rooms[0].unread, 2u);
+    EXPECT_EQ(summary.rooms[0].mentions, 2u);
+    EXPECT_EQ(summary.rooms[1].mentions, 1u);
+    ASSERT_EQ(summary.mentions.size(), 3u);
+    EXPECT_EQ(summary.mentions[0].position, 1u);
+
+    index.markRead("general", "u-bob", 1);
+    summary = index.summary("u-bob", {"general"});
+    ASSERT_EQ(summary.rooms.size(), 1u);
+    EXPECT_EQ(summary.rooms[0].unread, 1u);
+    EXPECT_EQ(summary.rooms[0].mentions, 1u);
+
+    auto json = summary.toJson();
+    EXPECT_EQ(json["rooms"][0]["room_id"], "general");
+    EXPECT_EQ(json["mentions"][0]["sequence"], 2);
+
+    index.markRead("general", "u-bob", 2);
+    EXPECT_TRUE(index.summary("u-bob", {"general"}).rooms.empty());
+}
+
+// Watermarks and mentions are journaled for the autosave, and a fresh
+// index restored from them gives the same counts
+TEST(NotificationIndexTest, PersistsThroughAutosave) {
+    boost::asio::io_context io_context;
+    std::vector<ChangeBatch> batches;
+    IncrementalAutosave autosave(io_context, IncrementalAutosave::Options{},
+                                 [](const std::string&) { return std::nullopt; },
+                                 [&batches](const ChangeBatch& batch) { batches.push_back(batch); return true; });
+
+    std::vector<ChatMessage> history = {post("alice", "general", "hi @bob", 1),
+                                        post("alice", "general", "again @bob", 2),
+                                        post("alice", "general", "bye", 3)};
+    {
+        NotificationIndex index(NotificationIndex::Options{}, &autosave);
+        for (const auto& message : history) {
+            index.record(message);
+        }
+        index.markRead("general", "bob", 1);
+    }
+    ASSERT_TRUE(autosave.saveNow());
+    ASSERT_EQ(batches.size(), 1u);
+    EXPECT_EQ(batches[0].mentions.size(), 2u);
+    ASSERT_EQ(batches[0].read_positions.size(), 2u);  // alice (sender) and bob
+
+    NotificationIndex restored(NotificationIndex::Options{}, nullptr);
+    for (const auto& message : history) {
+        restored.restoreMessage(message);
+    }
+    for (const auto& change : batches[0].read_positions) {
+        restored.restoreReadPosition(change);
+    }
+    for (const auto& mention : batches[0].mentions) {
+        if (mention.position > 1) {  // What the store keeps after the read
+            restored.restoreMention(mention);
+        }
+    }
+    EXPECT_EQ(restored.unread("general", "bob"), 2u);
+    EXPECT_EQ(restored.unread("general", "alice"), 0u);
+    EXPECT_EQ(restored.summary("bob", {"general"}).rooms[0].mentions, 1u);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include "server/presence_aggregator.h"
+#include "common/message.h"
+#include <map>
+#include <nlohmann/json.hpp>
+
+using namespace chat;
+using chat_app::ChatMessage;
+using chat_app::MessageType;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Summaries {
+    std::vector<std::pair<std::string, nlohmann::json>> sent;
+
+    PresenceAggregator::SummarySink sink() {
+        return [this](const std::string& room_id, const chat_app::SharedEncodedMessage& summary) {
+            EXPECT_EQ(summary->message().message_type, static_cast<uint8_t>(MessageType::PRESENCE_SUMMARY));
+            sent.emplace_back(room_id, nlohmann::json::parse(summary->message().content));
+        };
+    }
+};
+
+PresenceAggregator::Options interval(std::chrono::milliseconds flush, std::chrono::milliseconds timeout) {
+    PresenceAggregator::Options options;
+    options.flush_interval = flush;
+    options.typing_timeout = timeout;
+    return options;
+}
+
+} // namespace
+
+// Typing on/off flapping within one interval, and "still typing"
+// refreshes, produce a single summary with the final state
+TEST(PresenceAggregatorTest, DebouncesFlappingTyping) {
+    boost::asio::io_context io_context;
+    Summaries summaries;
+    PresenceAggregator aggregator(io_context, interval(250ms, 5000ms), summaries.sink());
+    auto now = PresenceAggregator::Clock::now();
+
+    for (int i = 0; i < 10; ++i) {
+        aggregator.setTyping("general", "alice", i % 2 == 0, now);
+    }
+    aggregator.setTyping("general", "alice", true, now);
+    aggregator.setTyping("general", "bob", true, now);
+    EXPECT_EQ(aggregator.flush(now), 1u);
+    ASSERT_EQ(summaries.sent.size(), 1u);
+    EXPECT_EQ(summaries.sent[0].second["typing"], (std::vector<std::string>{"alice", "bob"}));
+
+    // Refreshes only extend the expiry
+    for (int i = 0; i < 5; ++i) {
+        aggregator.setTyping("general", "alice", true, now + 100ms);
+    }
+    EXPECT_EQ(aggregator.flush(now + 250ms), 0u);
+    EXPECT_EQ(aggregator.stats().typing_signals, 17u);
+}
+
+TEST(PresenceAggregatorTest, ExpiresSilentTypists) {
+    boost::asio::io_context io_context;
+    Summaries summaries;
+    PresenceAggregator aggregator(io_context, interval(250ms, 5000ms), summaries.sink());
+    auto now = PresenceAggregator::Clock::now();
+
+    aggregator.setTyping("general", "alice", true, now);
+    aggregator.setTyping("general", "bob", true, now);
+    aggregator.flush(now);
+    aggregator.setTyping("general", "alice", true, now + 3s);
+
+    EXPECT_EQ(aggregator.flush(now + 4s), 0u);
+    EXPECT_EQ(aggregator.flush(now + 5s), 1u);  // Bob's expiry
+    EXPECT_EQ(summaries.sent.back().second["typing"], std::vector<std::string>{"alice"});
+    EXPECT_EQ(aggregator.flush(now + 8s), 1u);
+    EXPECT_TRUE(summaries.sent.back().second["typing"].empty());
+    EXPECT_EQ(aggregator.flush(now + 20s), 0u);
+}
+
+// Watermarks never move backwards, and only advanced ones are reported
+TEST(PresenceAggregatorTest, WatermarksOnlyAdvance) {
+    boost::asio::io_context io_context;
+    Summaries summaries;
+    PresenceAggregator aggregator(io_context, interval(250ms, 5000ms), summaries.sink());
+
+    aggregator.markRead("general", "alice", 100);
+    aggregator.markRead("general", "alice", 50);
+    aggregator.markRead("general", "carol", 70);
+    EXPECT_EQ(aggregator.readPosition("general", "alice"), 100u);
+    aggregator.flush();
+    ASSERT_EQ(summaries.sent.size(), 1u);
+    EXPECT_EQ(summaries.sent[0].second["read"], (nlohmann::json{{"alice", 100}, {"carol", 70}}));
+    EXPECT_FALSE(summaries.sent[0].second.contains("typing"));
+
+    aggregator.markRead("general", "alice", 100);
+    aggregator.markRead("general", "carol", 60);
+    EXPECT_EQ(aggregator.flush(), 0u);
+
+    ChatMessage receipt = ChatMessage::forRoom("carol", "general", "120",
+                                               static_cast<uint8_t>(MessageType::READ_RECEIPT));
+    EXPECT_TRUE(aggregator.ingest(receipt));
+    EXPECT_FALSE(aggregator.ingest(ChatMessage::forRoom("carol", "general", "hi")));
+    aggregator.flush();
+    EXPECT_EQ(summaries.sent.back().second["read"], (nlohmann::json{{"carol", 120}}));
+    EXPECT_EQ(aggregator.readPosition("general", "carol"), 120u);
+}
+
+// However many signals arrive, a tick sends one summary per changed room
+TEST(PresenceAggregatorTest, OneSummaryPerRoomPerTick) {
+    boost::asio::io_context io_context;
+    Summaries summaries;
+    PresenceAggregator aggregator(io_context, interval(20ms, 5000ms), summaries.sink());
+
+    for (int room = 0; room < 40; ++room) {
+        for (int user = 0; user < 25; ++user) {
+            std::string room_id = "room-" + std::to_string(room);
+            std::string user_id = "user-" + std::to_string(user);
+            aggregator.setTyping(room_id, user_id, true);
+            aggregator.markRead(room_id, user_id, static_cast<uint64_t>(user + 1));
+        }
+    }
+    aggregator.start();
+    io_context.run_for(50ms);
+    aggregator.stop();
+
+    std::map<std::string, int> per_room;
+    for (const auto& [room_id, summary] : summaries.sent) {
+        ++per_room[room_id];
+        EXPECT_EQ(summary["typing"].size(), 25u);
+        EXPECT_EQ(summary["read"].size(), 25u);
+    }
+    EXPECT_EQ(per_room.size(), 40u);
+    for (const auto& [room_id, count] : per_room) {
+        EXPECT_EQ(count, 1) << room_id;
+    }
+    EXPECT_EQ(aggregator.stats().summaries, 40u);
+}
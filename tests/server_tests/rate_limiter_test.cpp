@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include "server/rate_limiter.h"
+#include "common/message.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace chat;
+
+namespace {
+
+constexpr uint16_t GROUP = static_cast<uint16_t>(chat_app::MessageType::GROUP_MESSAGE);
+constexpr uint16_t TEXT = static_cast<uint16_t>(chat_app::MessageType::TEXT_MESSAGE);
+
+RateLimiter::Options groupLimit(double rate, uint32_t burst) {
+    RateLimiter::Options options;
+    options.limits[GROUP] = TokenBucket::Limit{rate, burst};
+    options.address_scale = 100;
+    return options;
+}
+
+} // namespace
+
+// A bucket allows its burst, then refills at its rate
+TEST(RateLimiterTest, TokenBucketRefills) {
+    TokenBucket bucket;
+    TokenBucket::Limit limit{10, 3};  // One token every 100 ms
+    int64_t now = 1000000000;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(bucket.acquire(limit, now, false), 0);
+    }
+    EXPECT_EQ(bucket.acquire(limit, now, false), 100000000);
+    EXPECT_EQ(bucket.acquire(limit, now + 50000000, false), 50000000);
+    EXPECT_EQ(bucket.acquire(limit, now + 100000000, false), 0);
+    EXPECT_GT(bucket.acquire(limit, now + 100000000, false), 0);
+
+    // Idle long enough and the bucket is full again, never more
+    now += 10000000000;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(bucket.acquire(limit, now, false), 0);
+    }
+    EXPECT_GT(bucket.acquire(limit, now, false), 0);
+}
+
+// Over-limit frames are rejected per connection and per user
+TEST(RateLimiterTest, RejectsOverLimitFrames) {
+    RateLimiter limiter(groupLimit(1, 5));
+    auto now = RateLimiter::Clock::now();
+    auto first = limiter.connect("10.0.0.1");
+    auto second = limiter.connect("10.0.0.2");
+
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(limiter.check(*first, GROUP, now).action, chat_app::FrameVerdict::ACCEPT);
+    }
+    auto verdict = limiter.check(*first, GROUP, now);
+    EXPECT_EQ(verdict.action, chat_app::FrameVerdict::REJECT);
+    EXPECT_EQ(verdict.delay, std::chrono::milliseconds(1000));
+    EXPECT_EQ(limiter.check(*first, TEXT, now).action, chat_app::FrameVerdict::ACCEPT);  // Unlimited type
+
+    // Another connection has its own budget until both belong to one user
+    EXPECT_EQ(limiter.check(*second, GROUP, now).action, chat_app::FrameVerdict::ACCEPT);
+    limiter.bindUser(*first, "u-1");
+    limiter.bindUser(*second, "u-1");
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(limiter.check(*second, GROUP, now).action, chat_app::FrameVerdict::ACCEPT);
+    }
+    EXPECT_EQ(limiter.check(*second, GROUP, now).action, chat_app::FrameVerdict::REJECT);
+
+    auto stats = limiter.stats();
+    EXPECT_EQ(stats.throttled, 2u);
+    EXPECT_EQ(stats.rejected, 2u);
+    EXPECT_EQ(stats.throttled_by_type[GROUP], 2u);
+}
+
+// Connections sharing an address share a scaled allowance
+TEST(RateLimiterTest, LimitsByAddress) {
+    auto options = groupLimit(1, 2);
+    options.address_scale = 2;
+    RateLimiter limiter(options);
+    auto now = RateLimiter::Clock::now();
+
+    int accepted = 0;
+    for (int c = 0; c < 4; ++c) {
+        auto limits = limiter.connect("192.0.2.7");
+        for (int i = 0; i < 2; ++i) {
+            accepted += limiter.check(*limits, GROUP, now).action == chat_app::FrameVerdict::ACCEPT;
+        }
+    }
+    EXPECT_EQ(accepted, 4);
+}
+
+// Pause mode delays frames instead of dropping them, up to a bound
+TEST(RateLimiterTest, PausesWithinBound) {
+    auto options = groupLimit(10, 1);
+    options.action = RateLimiter::Action::PAUSE;
+    options.max_pause = std::chrono::milliseconds(250);
+    RateLimiter limiter(options);
+    auto limits = limiter.connect("");
+    auto now = RateLimiter::Clock::now();
+
+    EXPECT_EQ(limiter.check(*limits, GROUP, now).action, chat_app::FrameVerdict::ACCEPT);
+    auto verdict = limiter.check(*limits, GROUP, now);
+    EXPECT_EQ(verdict.action, chat_app::FrameVerdict::DELAY);
+    EXPECT_EQ(verdict.delay, std::chrono::milliseconds(100));
+    EXPECT_EQ(limiter.check(*limits, GROUP, now).delay, std::chrono::milliseconds(200));
+    EXPECT_EQ(limiter.check(*limits, GROUP, now).action, chat_app::FrameVerdict::REJECT);
+    EXPECT_EQ(limiter.stats().paused, 2u);
+
+    // A connection that cannot pause reads (io_uring) is rejected instead
+    auto uring = limiter.connect("");
+    EXPECT_EQ(limiter.check(*uring, GROUP, now, false).action, chat_app::FrameVerdict::ACCEPT);
+    EXPECT_EQ(limiter.check(*uring, GROUP, now, false).action, chat_app::FrameVerdict::REJECT);
+    EXPECT_EQ(limiter.stats().paused, 2u);
+    EXPECT_EQ(limiter.stats().rejected, 2u);
+}
+
+// Limits come from RATE_LIMIT_<TYPE>=rate/burst keys
+TEST(RateLimiterTest, ReadsConfig) {
+    auto path = std::filesystem::temp_directory_path() / ("rate_limiter_test_" + std::to_string(::getpid()) + ".env");
+    {
+        std::ofstream file(path);
+        file << "RATE_LIMIT_GROUP_MESSAGE=2.5/8\n"
+             << "RATE_LIMIT_TEXT_MESSAGE=0\n"
+             << "RATE_LIMIT_ACTION=pause\n"
+             << "RATE_LIMIT_MAX_PAUSE_MS=500\n";
+    }
+    ConfigLoader config(path.string());
+    auto options = RateLimiter::Options::fromConfig(config);
+    std::filesystem::remove(path);
+
+    EXPECT_DOUBLE_EQ(options.limits[GROUP].rate, 2.5);
+    EXPECT_EQ(options.limits[GROUP].burst, 8u);
+    EXPECT_FALSE(options.limits[TEXT].enabled());
+    EXPECT_TRUE(options.limits[static_cast<std::size_t>(chat_app::MessageType::JOIN_ROOM)].enabled());
+    EXPECT_EQ(options.action, RateLimiter::Action::PAUSE);
+    EXPECT_EQ(options.max_pause, std::chrono::milliseconds(500));
+}
+
+// A flooding client gets ERROR replies; its other frames still arrive
+TEST(RateLimiterTest, RejectsOnTheReadPath) {
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    auto server = std::make_shared<chat_app::TcpConnection>(io_context);
+    auto client = std::make_shared<chat_app::TcpConnection>(io_context);
+    client->socket().connect(acceptor.local_endpoint());
+    acceptor.accept(server->socket());
+
+    RateLimiter limiter(groupLimit(0.001, 3));
+    std::atomic<int> delivered{0};
+    std::atomic<int> errors{0};
+    server->setMessageCallback([&](const std::vector<char>&, uint16_t type, uint16_t) {
+        delivered += type == GROUP || type == TEXT;
+    });
+    client->setMessageCallback([&](const std::vector<char>& body, uint16_t type, uint16_t) {
+        if (type == static_cast<uint16_t>(chat_app::MessageType::ERROR)) {
+            auto json = nlohmann::json::parse(body.begin(), body.end());
+            errors += json["error"] == "rate_limited";
+        }
+    });
+    limiter.attach(*server, limiter.connect("127.0.0.1"));
+    server->start();
+    client->start();
+
+    for (int i = 0; i < 10; ++i) {
+        client->send(std::vector<char>(16, 'x'), GROUP, chat_app::MessageFlags::BINARY);
+    }
+    client->send(std::vector<char>(4, 'y'), TEXT);
+
+    std::thread io_thread([&]() { io_context.run_for(std::chrono::seconds(5)); });
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((delivered < 4 || errors < 1) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(delivered, 4);  // Three group messages plus the text message
+    EXPECT_EQ(errors, 1);     // Replies are themselves rate limited
+    EXPECT_EQ(limiter.stats().rejected, 7u);
+    EXPECT_TRUE(server->isConnected());
+
+    io_context.stop();
+    io_thread.join();
+    server->stop();
+    client->stop();
+}
+
+// In pause mode every frame arrives, paced by the limit
+TEST(RateLimiterTest, PausesTheReadPath) {
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    auto server = std::make_shared<chat_app::TcpConnection>(io_context);
+    auto client = std::make_shared<chat_app::TcpConnection>(io_context);
+    client->socket().connect(acceptor.local_endpoint());
+    acceptor.accept(server->socket());
+
+    auto options = groupLimit(20, 1);
+    options.action = RateLimiter::Action::PAUSE;
+    RateLimiter limiter(options);
+    std::atomic<int> delivered{0};
+    server->setMessageCallback([&](const std::vector<char>&, uint16_t, uint16_t) { ++delivered; });
+    limiter.attach(*server, limiter.connect("127.0.0.1"));
+    server->start();
+    client->start();
+
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < 5; ++i) {
+        client->send(std::vector<char>(8, 'x'), GROUP);
+    }
+    std::thread io_thread([&]() { io_context.run_for(std::chrono::seconds(5)); });
+    auto deadline = started + std::chrono::seconds(5);
+    while (delivered < 5 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    EXPECT_EQ(delivered, 5);
+    EXPECT_GE(elapsed, std::chrono::milliseconds(190));  // Four waits of 50 ms
+    EXPECT_EQ(limiter.stats().paused, 4u);
+
+    io_context.stop();
+    io_thread.join();
+    server->stop();
+    client->stop();
+}
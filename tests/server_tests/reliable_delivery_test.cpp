@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include "server/reliable_delivery.h"
+#include <map>
+
+using namespace chat;
+using chat_app::ChatMessage;
+using chat_app::SharedEncodedMessage;
+
+namespace {
+
+SharedEncodedMessage roomMessage(const std::string& room, const std::string& text) {
+    return chat_app::makeEncodedMessage(ChatMessage::forRoom("alice", room, text));
+}
+
+ReliableDelivery::Options smallWindow(std::size_t window) {
+    ReliableDelivery::Options options;
+    options.replay_window = window;
+    return options;
+}
+
+std::vector<uint64_t> sequences(const ReliableDelivery::Replay& replay) {
+    std::vector<uint64_t> result;
+    for (const auto& message : replay.messages) {
+        result.push_back(message->message().sequence);
+    }
+    return result;
+}
+
+} // namespace
+
+// Each conversation counts on its own, and both sides of a direct
+// conversation share one counter
+TEST(ReliableDeliveryTest, SequencesPerConversation) {
+    ReliableDelivery delivery(smallWindow(16));
+
+    auto first = roomMessage("general", "a");
+    auto cached = first->binary();
+    EXPECT_EQ(delivery.assign(first), 1u);
+    EXPECT_EQ(first->message().sequence, 1u);
+    EXPECT_NE(first->binary(), cached);  // Re-encoded with the sequence
+
+    EXPECT_EQ(delivery.assign(roomMessage("general", "b")), 2u);
+    EXPECT_EQ(delivery.assign(roomMessage("random", "c")), 1u);
+
+    auto to_bob = chat_app::makeEncodedMessage(ChatMessage("alice", "bob", "hi"));
+    auto to_alice = chat_app::makeEncodedMessage(ChatMessage("bob", "alice", "hey"));
+    EXPECT_EQ(delivery.assign(to_bob), 1u);
+    EXPECT_EQ(delivery.assign(to_alice), 2u);
+    EXPECT_EQ(delivery.lastSequence("dm:5:alice:bob"), 2u);
+    EXPECT_EQ(delivery.stats().assigned, 5u);
+}
+
+// Only the messages after the client's cursor are replayed, and
+// conversations it leaves out resume from its last ack
+TEST(ReliableDeliveryTest, ReplaysOnlyTheGap) {
+    ReliableDelivery delivery(smallWindow(16));
+    for (int i = 0; i < 10; ++i) {
+        delivery.assign(roomMessage("general", std::to_string(i)));
+        delivery.assign(roomMessage("random", std::to_string(i)));
+    }
+
+    delivery.acknowledge("bob", {{"general", 4}, {"random", 8}});
+    delivery.acknowledge("bob", {{"general", 2}, {"missing", 3}, {"random", 11}});
+    EXPECT_EQ(delivery.acknowledged("bob", "general"), 4u);  // Cumulative
+    EXPECT_EQ(delivery.acknowledged("bob", "random"), 8u);
+    EXPECT_EQ(delivery.acknowledged("bob", "missing"), 0u);
+
+    // The client saw up to 7 in general before the connection dropped
+    auto replay = delivery.resume("bob", {{"general", 7}});
+    EXPECT_EQ(sequences(replay), (std::vector<uint64_t>{8, 9, 10, 9, 10}));
+    EXPECT_TRUE(replay.truncated.empty());
+    EXPECT_EQ(replay.messages[0]->message().room_id, "general");
+    EXPECT_EQ(replay.messages[3]->message().room_id, "random");
+
+    EXPECT_TRUE(delivery.resume("bob", {{"general", 10}, {"random", 10}}).messages.empty());
+    EXPECT_EQ(delivery.stats().replayed, 5u);
+}
+
+// Gaps older than the window come from storage; a gap storage cannot
+// fill is reported instead of replayed with a hole
+TEST(ReliableDeliveryTest, FallsBackToStorage) {
+    std::map<uint64_t, SharedEncodedMessage> stored;
+    std::size_t loads = 0;
+    auto loader = [&](const std::string& conversation, uint64_t after, std::size_t max) {
+        ++loads;
+        std::vector<SharedEncodedMessage> result;
+        EXPECT_EQ(conversation, "general");
+        for (auto it = stored.upper_bound(after); it != stored.end() && result.size() < max; ++it) {
+            result.push_back(it->second);
+        }
+        return result;
+    };
+    ReliableDelivery delivery(smallWindow(4), loader);
+    for (int i = 0; i < 20; ++i) {
+        auto message = roomMessage("general", std::to_string(i));
+        delivery.assign(message);
+        stored[message->message().sequence] = message;
+    }
+
+    auto in_window = delivery.resume("bob", {{"general", 17}});
+    EXPECT_EQ(sequences(in_window), (std::vector<uint64_t>{18, 19, 20}));
+    EXPECT_EQ(loads, 0u);
+
+    auto from_storage = delivery.resume("bob", {{"general", 12}});
+    EXPECT_EQ(sequences(from_storage), (std::vector<uint64_t>{13, 14, 15, 16, 17, 18, 19, 20}));
+    EXPECT_EQ(delivery.stats().replayed_from_storage, 4u);
+
+    stored.erase(stored.begin(), stored.find(15));  // 1-14 expired from storage
+    auto partial = delivery.resume("bob", {{"general", 12}});
+    EXPECT_TRUE(partial.messages.empty());
+    EXPECT_EQ(partial.truncated, std::vector<std::string>{"general"});
+
+    // Budget per resume
+    ReliableDelivery::Options limited = smallWindow(4);
+    limited.max_replay = 3;
+    ReliableDelivery capped(limited);
+    for (int i = 0; i < 4; ++i) {
+        capped.assign(roomMessage("general", std::to_string(i)));
+    }
+    auto capped_replay = capped.resume("bob", {{"general", 0}});
+    EXPECT_EQ(sequences(capped_replay), (std::vector<uint64_t>{1, 2, 3}));
+    EXPECT_EQ(capped_replay.truncated, std::vector<std::string>{"general"});
+}
+
+// Users only get conversations they can read
+TEST(ReliableDeliveryTest, ChecksAccess) {
+    ReliableDelivery delivery(smallWindow(16), nullptr,
+        [](const std::string& user, const std::string& room) { return user == "bob" || room != "staff"; });
+    delivery.assign(roomMessage("staff", "secret"));
+    delivery.assign(chat_app::makeEncodedMessage(ChatMessage("alice", "bob", "hi")));
+
+    EXPECT_EQ(delivery.resume("bob", {{"staff", 0}, {"dm:5:alice:bob", 0}}).messages.size(), 2u);
+    EXPECT_TRUE(delivery.resume("carol", {{"staff", 0}, {"dm:5:alice:bob", 0}}).messages.empty());
+    EXPECT_TRUE(delivery.resume("ali", {{"dm:5:alice:bob", 0}}).messages.empty());
+
+    // An id containing ':' does not make its prefix a participant
+    delivery.assign(chat_app::makeEncodedMessage(ChatMessage("a:b", "c", "hi")));
+    EXPECT_EQ(delivery.resume("a:b", {{"dm:3:a:b:c", 0}}).messages.size(), 1u);
+    EXPECT_EQ(delivery.resume("c", {{"dm:3:a:b:c", 0}}).messages.size(), 1u);
+    EXPECT_TRUE(delivery.resume("a", {{"dm:3:a:b:c", 0}}).messages.empty());
+    EXPECT_TRUE(delivery.resume("b:c", {{"dm:3:a:b:c", 0}}).messages.empty());
+}
+
+TEST(ReliableDeliveryTest, CursorBodies) {
+    ReliableDelivery::Cursors cursors = {{"general", 42}, {"dm:5:alice:bob", 7}};
+    auto parsed = ReliableDelivery::parseCursors(ReliableDelivery::encodeCursors(cursors));
+    ASSERT_TRUE(parsed.has_value());
+    EXPECT_EQ(*parsed, cursors);
+
+    auto body = [](const std::string& text) { return std::vector<char>(text.begin(), text.end()); };
+    EXPECT_FALSE(ReliableDelivery::parseCursors(body("{\"general\": -1}")).has_value());
+    EXPECT_FALSE(ReliableDelivery::parseCursors(body("[1, 2]")).has_value());
+    EXPECT_FALSE(ReliableDelivery::parseCursors(body("{")).has_value());
+}
+
+// Startup rebuilds counters from stored messages
+TEST(ReliableDeliveryTest, RestoresFromStorage) {
+    ReliableDelivery delivery(smallWindow(16));
+    for (uint64_t sequence : {1, 2, 3, 5, 6}) {
+        auto message = roomMessage("general", "x");
+        message->modify([sequence](ChatMessage& m) { m.sequence = sequence; });
+        delivery.restore(message);
+    }
+    EXPECT_EQ(delivery.lastSequence("general"), 6u);
+    EXPECT_EQ(delivery.assign(roomMessage("general", "next")), 7u);
+
+    // 4 is missing, so only 5 onwards is in the window
+    auto replay = delivery.resume("bob", {{"general", 2}});
+    EXPECT_TRUE(replay.messages.empty());
+    EXPECT_EQ(replay.truncated, std::vector<std::string>{"general"});
+    EXPECT_EQ(sequences(delivery.resume("bob", {{"general", 4}})), (std::vector<uint64_t>{5, 6, 7}));
+}
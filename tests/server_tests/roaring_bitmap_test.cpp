@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "server/roaring_bitmap.h"
+#include <random>
+#include <set>
+
+using namespace chat;
+
+namespace {
+
+RoaringBitmap fromSet(const std::set<uint32_t>& values) {
+    RoaringBitmap bitmap;
+    for (uint32_t value : values) {
+        bitmap.add(value);
+    }
+    return bitmap;
+}
+
+std::vector<uint32_t> toVector(const std::set<uint32_t>& values) {
+    return std::vector<uint32_t>(values.begin(), values.end());
+}
+
+} // namespace
+
+// Adds, removes and lookups across container boundaries
+TEST(RoaringBitmapTest, AddRemoveContains) {
+    RoaringBitmap bitmap;
+    EXPECT_TRUE(bitmap.empty());
+    EXPECT_TRUE(bitmap.add(7));
+    EXPECT_FALSE(bitmap.add(7));
+    EXPECT_TRUE(bitmap.add(70000));
+    EXPECT_TRUE(bitmap.add(0xFFFFFFFF));
+    EXPECT_EQ(bitmap.cardinality(), 3u);
+    EXPECT_TRUE(bitmap.contains(70000));
+    EXPECT_FALSE(bitmap.contains(70001));
+
+    EXPECT_TRUE(bitmap.remove(70000));
+    EXPECT_FALSE(bitmap.remove(70000));
+    EXPECT_FALSE(bitmap.contains(70000));
+    EXPECT_EQ(bitmap.toVector(), (std::vector<uint32_t>{7, 0xFFFFFFFF}));
+}
+
+// Dense containers switch to bitmaps and back without losing values
+TEST(RoaringBitmapTest, ConvertsBetweenArrayAndBitmap) {
+    RoaringBitmap bitmap;
+    for (uint32_t i = 0; i < 10000; ++i) {
+        bitmap.add(i * 3);
+    }
+    EXPECT_EQ(bitmap.cardinality(), 10000u);
+    EXPECT_TRUE(bitmap.contains(29997));
+    EXPECT_FALSE(bitmap.contains(29998));
+    EXPECT_LT(bitmap.bytes(), 10000u * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < 9000; ++i) {
+        bitmap.remove(i * 3);
+    }
+    EXPECT_EQ(bitmap.cardinality(), 1000u);
+    EXPECT_TRUE(bitmap.contains(27000));
+    EXPECT_FALSE(bitmap.contains(26997));
+}
+
+// Set operations agree with std::set for every container pairing
+TEST(RoaringBitmapTest, SetOperationsMatchReference) {
+    std::mt19937 rng(11);
+    auto randomSet = [&](std::size_t count, uint32_t range) {
+        std::set<uint32_t> values;
+        while (values.size() < count) {
+            values.insert(rng() % range);
+        }
+        return values;
+    };
+
+    // Sparse/dense combinations within and across containers
+    std::vector<std::set<uint32_t>> sets = {
+        randomSet(100, 200000),
+        randomSet(3000, 65536),
+        randomSet(30000, 65536),
+        randomSet(50000, 300000),
+        {},
+    };
+    for (const auto& a : sets) {
+        for (const auto& b : sets) {
+            std::set<uint32_t> both;
+            std::set<uint32_t> either = a;
+            for (uint32_t value : b) {
+                if (a.count(value)) {
+                    both.insert(value);
+                }
+                either.insert(value);
+            }
+            RoaringBitmap left = fromSet(a);
+            RoaringBitmap right = fromSet(b);
+            EXPECT_EQ((left & right).toVector(), toVector(both));
+            EXPECT_EQ((left | right).toVector(), toVector(either));
+            EXPECT_EQ(RoaringBitmap::intersectionCardinality(left, right), both.size());
+            EXPECT_TRUE((left & right) == fromSet(both));
+        }
+    }
+}
@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+#include "server/hash_ring.h"
+#include "server/room_ownership.h"
+#include "common/message.h"
+#include <chrono>
+#include <map>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace chat;
+
+namespace {
+
+constexpr int ROOM_COUNT = 60;
+constexpr int MESSAGES_PER_ROOM = 5;
+
+std::string roomName(int index) {
+    return "room-" + std::to_string(index);
+}
+
+// Run the loop on this thread until the predicate holds or the deadline
+// passes; it is checked after every handler, so it sees each change as
+// soon as it happens
+template <typename Predicate>
+bool runUntil(boost::asio::io_context& io_context, Predicate predicate,
+              std::chrono::seconds timeout = std::chrono::seconds(10)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate() && std::chrono::steady_clock::now() < deadline) {
+        if (io_context.stopped()) {
+            io_context.restart();
+        }
+        io_context.run_one_for(std::chrono::milliseconds(10));
+    }
+    return predicate();
+}
+
+ClusterManager::Options clusterOptions(const std::string& node_id) {
+    ClusterManager::Options options;
+    options.node_id = node_id;
+    options.listen_address = "127.0.0.1";
+    options.reconnect_interval = std::chrono::milliseconds(50);
+    return options;
+}
+
+// Rooms a two-node ring assigns to a node
+int expectedRooms(const std::string& node_id) {
+    HashRing ring;
+    ring.addNode("node-a");
+    ring.addNode("node-b");
+    int count = 0;
+    for (int i = 0; i < ROOM_COUNT; ++i) {
+        count += ring.ownerOf(roomName(i)) == node_id ? 1 : 0;
+    }
+    return count;
+}
+
+// Joining node, run in a child process. Reports its port through
+// port_pipe, reads node-a's port from peer_pipe, and exits 0 once it
+// owns every room the ring gives it with complete state.
+int runJoiningNode(int port_pipe, int peer_pipe) {
+    boost::asio::io_context io_context;
+
+    ClusterManager cluster(io_context, clusterOptions("node-b"), nullptr);
+    RoomOwnership ownership(cluster, RoomOwnership::Options());
+    ownership.start();
+    if (!cluster.start()) {
+        return 2;
+    }
+
+    uint16_t port = cluster.listenPort();
+    uint16_t peer_port = 0;
+    if (write(port_pipe, &port, sizeof(port)) != sizeof(port) ||
+        read(peer_pipe, &peer_port, sizeof(peer_port)) != sizeof(peer_port)) {
+        return 3;
+    }
+    cluster.addPeer(NodeInfo{"node-a", "127.0.0.1", peer_port});
+
+    const int expected = expectedRooms("node-b");
+    bool complete = runUntil(io_context, [&]() {
+        if (static_cast<int>(ownership.roomCount()) != expected) {
+            return false;
+        }
+        for (int i = 0; i < ROOM_COUNT; ++i) {
+            std::string room = roomName(i);
+            if (ownership.isLocalOwner(room) &&
+                (ownership.history(room).size() != MESSAGES_PER_ROOM + 1 || ownership.members(room).size() != 2)) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    // Stay in the cluster, still sending acks, until the parent has seen them
+    boost::asio::posix::stream_descriptor parent(io_context, peer_pipe);
+    char done = 0;
+    bool released = false;
+    boost::asio::async_read(parent, boost::asio::buffer(&done, 1),
+                            [&](const boost::system::error_code& error, std::size_t) {
+                                complete = complete && !error;
+                                released = true;
+                            });
+    if (!runUntil(io_context, [&]() { return released; }, std::chrono::seconds(30))) {
+        complete = false;
+    }
+
+    cluster.stop();
+    parent.close();
+    io_context.run_for(std::chrono::milliseconds(50));
+    return complete ? 0 : 1;
+}
+
+} // namespace
+
+// Virtual nodes spread keys evenly
+TEST(HashRingTest, BalancedAcrossNodes) {
+    HashRing ring(128);
+    for (const char* node : {"node-a", "node-b", "node-c", "node-d"}) {
+        ring.addNode(node);
+    }
+
+    std::map<std::string, int> counts;
+    const int keys = 20000;
+    for (int i = 0; i < keys; ++i) {
+        counts[ring.ownerOf(roomName(i))]++;
+    }
+
+    ASSERT_EQ(counts.size(), 4u);
+    for (const auto& entry : counts) {
+        EXPECT_NEAR(entry.second, keys / 4, keys / 4 * 0.2) << entry.first;
+    }
+}
+
+// A joining node only takes keys; nothing moves between existing nodes
+TEST(HashRingTest, AddingNodeMovesOnlyItsShare) {
+    HashRing ring;
+    ring.addNode("node-a");
+    ring.addNode("node-b");
+    ring.addNode("node-c");
+
+    const int keys = 10000;
+    std::vector<std::string> before;
+    for (int i = 0; i < keys; ++i) {
+        before.push_back(ring.ownerOf(roomName(i)));
+    }
+
+    ring.addNode("node-d");
+    int moved = 0;
+    for (int i = 0; i < keys; ++i) {
+        const std::string& owner = ring.ownerOf(roomName(i));
+        if (owner != before[i]) {
+            EXPECT_EQ(owner, "node-d");
+            ++moved;
+        }
+    }
+    EXPECT_NEAR(moved, keys / 4, keys / 4 * 0.25);
+
+    ring.removeNode("node-d");
+    for (int i = 0; i < keys; ++i) {
+        EXPECT_EQ(ring.ownerOf(roomName(i)), before[i]);
+    }
+}
+
+// A second server process joins; rooms it now owns are handed over with
+// their members and history, including messages sent during the move
+TEST(RoomOwnershipTest, HandsOffRoomsToJoiningProcess) {
+    int to_parent[2];
+    int to_child[2];
+    ASSERT_EQ(pipe(to_parent), 0);
+    ASSERT_EQ(pipe(to_child), 0);
+
+    // Fork before any threads exist in this process
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        close(to_parent[0]);
+        close(to_child[1]);
+        _exit(runJoiningNode(to_parent[1], to_child[0]));
+    }
+    close(to_parent[1]);
+    close(to_child[0]);
+
+    boost::asio::io_context io_context;
+    ClusterManager cluster(io_context, clusterOptions("node-a"), nullptr);
+    RoomOwnership ownership(cluster, RoomOwnership::Options());
+    ownership.start();
+    ASSERT_TRUE(cluster.start());
+
+    // Alone in the ring, node-a owns every room
+    for (int i = 0; i < ROOM_COUNT; ++i) {
+        std::string room = roomName(i);
+        ownership.addMember(room, "alice");
+        ownership.addMember(room, "bob");
+        for (int m = 0; m < MESSAGES_PER_ROOM; ++m) {
+            ownership.append(chat_app::makeEncodedMessage(chat_app::ChatMessage::forRoom(
+                "alice", room, "message " + std::to_string(m),
+                static_cast<uint8_t>(chat_app::MessageType::GROUP_MESSAGE))));
+        }
+    }
+    EXPECT_EQ(ownership.roomCount(), static_cast<size_t>(ROOM_COUNT));
+
+    uint16_t port = cluster.listenPort();
+    uint16_t child_port = 0;
+    ASSERT_EQ(read(to_parent[0], &child_port, sizeof(child_port)), static_cast<ssize_t>(sizeof(child_port)));
+    ASSERT_EQ(write(to_child[1], &port, sizeof(port)), static_cast<ssize_t>(sizeof(port)));
+    cluster.addPeer(NodeInfo{"node-b", "127.0.0.1", child_port});
+
+    // Keep writing while the ring changes; every message must survive
+    for (int i = 0; i < ROOM_COUNT; ++i) {
+        ownership.append(chat_app::makeEncodedMessage(chat_app::ChatMessage::forRoom(
+            "bob", roomName(i), "during rebalance", static_cast<uint8_t>(chat_app::MessageType::GROUP_MESSAGE))));
+    }
+
+    const int expected = expectedRooms("node-a");
+    EXPECT_TRUE(runUntil(io_context, [&]() {
+        return ownership.ringNodes().size() == 2 && ownership.pendingHandoffs() == 0 &&
+               static_cast<int>(ownership.roomCount()) == expected;
+    })) << "pending " << ownership.pendingHandoffs() << " rooms " << ownership.roomCount() << " expected " << expected;
+    for (int i = 0; i < ROOM_COUNT; ++i) {
+        std::string room = roomName(i);
+        if (ownership.isLocalOwner(room)) {
+            EXPECT_EQ(ownership.history(room).size(), static_cast<size_t>(MESSAGES_PER_ROOM + 1)) << room;
+        }
+    }
+    EXPECT_EQ(ownership.stats().handoffs_sent, static_cast<uint64_t>(ROOM_COUNT - expected));
+
+    char done = 1;
+    ASSERT_EQ(write(to_child[1], &done, 1), 1);
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    cluster.stop();
+    io_context.run_for(std::chrono::milliseconds(50));
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include "server/state_snapshot.h"
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+using namespace chat;
+namespace fs = std::filesystem;
+
+// Test fixture
+class StateSnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = (fs::temp_directory_path() / ("state_snapshot_test_" + std::to_string(::getpid()) + ".snapshot")).string();
+        std::remove(path_.c_str());
+    }
+
+    void TearDown() override {
+        std::remove(path_.c_str());
+    }
+
+    std::string path_;
+};
+
+// Tables come back field for field, with memberships resolved
+TEST_F(StateSnapshotTest, RoundTripsUsersAndRooms) {
+    chat_app::User alice("u-alice", "alice", chat_app::UserStatus::ONLINE);
+    alice.display_name = "Alice";
+    alice.email = "alice@example.com";
+    alice.last_seen = std::chrono::system_clock::time_point(std::chrono::milliseconds(1700000000123));
+    alice.addToRoom("general");
+    alice.addToRoom("random");
+    chat_app::User bob("u-bob", "bob");
+    bob.addToRoom("general");
+
+    StateSnapshotWriter writer;
+    writer.addUser(bob);
+    writer.addUser(alice);
+    writer.addRoom(SnapshotRoom{"random", "Random", "u-alice", {"u-alice"}});
+    writer.addRoom(SnapshotRoom{"general", "General", "u-bob", {"u-alice", "u-bob", "u-gone"}});
+    ASSERT_TRUE(writer.write(path_, 42));
+
+    StateSnapshot snapshot;
+    ASSERT_TRUE(snapshot.open(path_));
+    EXPECT_EQ(snapshot.sequence(), 42u);
+    EXPECT_EQ(snapshot.userCount(), 2u);
+    EXPECT_EQ(snapshot.roomCount(), 2u);
+    EXPECT_FALSE(snapshot.findUser("u-carol").has_value());
+
+    auto index = snapshot.findUser("u-alice");
+    ASSERT_TRUE(index.has_value());
+    chat_app::User loaded = snapshot.loadUser(*index);
+    EXPECT_EQ(loaded.username, "alice");
+    EXPECT_EQ(loaded.status, chat_app::UserStatus::ONLINE);
+    EXPECT_EQ(loaded.display_name, alice.display_name);
+    EXPECT_EQ(loaded.email, alice.email);
+    EXPECT_FALSE(loaded.avatar_url.has_value());
+    EXPECT_EQ(loaded.last_seen, alice.last_seen);
+    EXPECT_EQ(loaded.room_ids, alice.room_ids);
+
+    auto room_index = snapshot.findRoom("general");
+    ASSERT_TRUE(room_index.has_value());
+    auto room = snapshot.room(*room_index);
+    EXPECT_EQ(room.name, "General");
+    ASSERT_EQ(room.member_count, 2u);  // Unknown users are dropped
+    EXPECT_EQ(snapshot.user(room.members[0]).user_id, "u-alice");
+    EXPECT_EQ(snapshot.user(room.members[1]).user_id, "u-bob");
+}
+
+// A damaged snapshot is refused rather than half loaded
+TEST_F(StateSnapshotTest, RejectsDamagedFile) {
+    StateSnapshotWriter writer;
+    for (int i = 0; i < 100; ++i) {
+        writer.addUser(chat_app::User("u-" + std::to_string(i), "user" + std::to_string(i)));
+    }
+    ASSERT_TRUE(writer.write(path_, 1));
+
+    {
+        std::fstream file(path_, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(200);
+        file.put('\x7f');
+    }
+    StateSnapshot snapshot;
+    EXPECT_FALSE(snapshot.open(path_));
+
+    // Truncation fails the size check even without the checksum
+    fs::resize_file(path_, fs::file_size(path_) - 1);
+    EXPECT_FALSE(snapshot.open(path_, false));
+}
+
+// Lookups work in place on a large mapped snapshot
+TEST_F(StateSnapshotTest, MapsLargeSnapshot) {
+    const int users = 200000;
+    const int rooms = 1000;
+    StateSnapshotWriter writer;
+    for (int i = 0; i < users; ++i) {
+        chat_app::User user("user-" + std::to_string(i), "name" + std::to_string(i));
+        user.addToRoom("room-" + std::to_string(i % rooms));
+        writer.addUser(user);
+    }
+    for (int r = 0; r < rooms; ++r) {
+        writer.addRoom(SnapshotRoom{"room-" + std::to_string(r), "Room", "user-0", {}});
+    }
+    ASSERT_TRUE(writer.write(path_, 7));
+
+    StateSnapshot snapshot;
+    auto started = std::chrono::steady_clock::now();
+    ASSERT_TRUE(snapshot.open(path_));
+    auto index = snapshot.findUser("user-123456");
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    ASSERT_TRUE(index.has_value());
+    auto user = snapshot.user(*index);
+    ASSERT_EQ(user.room_count, 1u);
+    EXPECT_EQ(snapshot.room(user.rooms[0]).room_id, "room-456");
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+}
+
+// The scheduler writes on its interval and once more when asked at stop
+TEST_F(StateSnapshotTest, SchedulerWritesPeriodically) {
+    boost::asio::io_context io_context;
+    auto work = boost::asio::make_work_guard(io_context);
+    std::thread io_thread([&]() { io_context.run(); });
+
+    std::atomic<uint64_t> sequence{0};
+    SnapshotScheduler::Options options;
+    options.path = path_;
+    options.interval = std::chrono::milliseconds(20);
+    SnapshotScheduler scheduler(io_context, options, [&](StateSnapshotWriter& writer) {
+        writer.addUser(chat_app::User("u-1", "one"));
+        return ++sequence;
+    });
+    scheduler.start();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (scheduler.stats().snapshots < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    scheduler.requestSnapshot();
+    scheduler.stop();
+    EXPECT_GE(scheduler.stats().snapshots, 3u);
+
+    StateSnapshot snapshot;
+    ASSERT_TRUE(snapshot.open(path_));
+    EXPECT_EQ(snapshot.sequence(), sequence.load());
+    EXPECT_EQ(snapshot.userCount(), 1u);
+
+    work.reset();
+    io_context.stop();
+    io_thread.join();
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "server/user_directory.h"
+#include <random>
+
+using namespace chat;
+using chat_app::UserStatus;
+
+// Users round-trip through the columnar layout
+TEST(UserDirectoryTest, StoresAndMaterializesUsers) {
+    UserDirectory directory;
+    chat_app::User alice("u-alice", "alice", UserStatus::AWAY);
+    alice.display_name = "Alice";
+    alice.last_seen = std::chrono::system_clock::time_point(std::chrono::seconds(1700000000));
+    alice.addToRoom("general");
+    alice.addToRoom("random");
+    ASSERT_TRUE(directory.upsert(alice).has_value());
+    ASSERT_TRUE(directory.upsert(chat_app::User("u-bob", "bob")).has_value());
+
+    auto view = directory.lookup("u-alice");
+    ASSERT_TRUE(view.has_value());
+    EXPECT_EQ(view->username, "alice");
+    EXPECT_EQ(view->displayName(), "Alice");
+    EXPECT_EQ(view->status, UserStatus::AWAY);
+    EXPECT_EQ(view->last_seen, alice.last_seen);
+    EXPECT_EQ(directory.lookup("u-bob")->displayName(), "bob");
+    EXPECT_FALSE(directory.lookup("u-carol").has_value());
+
+    auto user = directory.toUser("u-alice");
+    ASSERT_TRUE(user.has_value());
+    EXPECT_EQ(user->display_name, alice.display_name);
+    EXPECT_EQ(user->room_ids, alice.room_ids);
+
+    // Replacing a user updates its rooms
+    alice.removeFromRoom("general");
+    directory.upsert(alice);
+    EXPECT_EQ(directory.toUser("u-alice")->room_ids, std::vector<std::string>{"random"});
+    EXPECT_EQ(directory.size(), 2u);
+}
+
+// Removed slots drop out of every scan and are reused
+TEST(UserDirectoryTest, RemovesAndReusesSlots) {
+    UserDirectory directory;
+    auto first = directory.upsert(chat_app::User("u-1", "one", UserStatus::ONLINE));
+    directory.upsert(chat_app::User("u-2", "two", UserStatus::ONLINE));
+    directory.setLastSeen("u-1", std::chrono::system_clock::now());
+    directory.joinRoom("general", "u-1");
+
+    ASSERT_TRUE(directory.remove("u-1"));
+    EXPECT_FALSE(directory.remove("u-1"));
+    EXPECT_EQ(directory.countWithStatus(UserStatus::ONLINE), 1u);
+    EXPECT_EQ(directory.countByStatus().total(), 1u);
+    EXPECT_EQ(directory.countSeenSince(std::chrono::system_clock::time_point()), 0u);
+    EXPECT_EQ(directory.countInRoom("general", UserStatus::ONLINE), 0u);
+
+    auto reused = directory.upsert(chat_app::User("u-3", "three"));
+    EXPECT_EQ(reused, first);
+    EXPECT_EQ(directory.countWithStatus(UserStatus::OFFLINE), 1u);
+}
+
+// Vector scans agree with a plain loop over the same data
+TEST(UserDirectoryTest, ScansMatchReference) {
+    UserDirectory directory;
+    std::mt19937 rng(7);
+    const int users = 10007;  // Not a multiple of the block size
+    std::vector<UserStatus> statuses;
+    std::vector<int64_t> seen;
+    for (int i = 0; i < users; ++i) {
+        chat_app::User user("u-" + std::to_string(i), "name" + std::to_string(i),
+                            static_cast<UserStatus>(rng() % 4));
+        int64_t seconds = 1700000000 + static_cast<int64_t>(rng() % 1000);
+        user.last_seen = std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+        if (i % 3 == 0) {
+            user.addToRoom("general");
+        }
+        statuses.push_back(user.status);
+        seen.push_back(seconds);
+        directory.upsert(user);
+    }
+
+    auto counts = directory.countByStatus();
+    EXPECT_EQ(counts.online, static_cast<std::size_t>(std::count(statuses.begin(), statuses.end(), UserStatus::ONLINE)));
+    EXPECT_EQ(counts.away, static_cast<std::size_t>(std::count(statuses.begin(), statuses.end(), UserStatus::AWAY)));
+    EXPECT_EQ(counts.total(), static_cast<std::size_t>(users));
+    EXPECT_EQ(directory.countWithStatus(UserStatus::DO_NOT_DISTURB), counts.do_not_disturb);
+
+    auto since = std::chrono::system_clock::time_point(std::chrono::seconds(1700000500));
+    EXPECT_EQ(directory.countSeenSince(since),
+              static_cast<std::size_t>(std::count_if(seen.begin(), seen.end(), [](int64_t s) { return s >= 1700000500; })));
+
+    std::vector<std::string> listed;
+    directory.forEachWithStatus(UserStatus::ONLINE, [&](const UserDirectory::UserView& view) {
+        listed.emplace_back(view.user_id);
+        return true;
+    });
+    ASSERT_EQ(listed.size(), counts.online);
+    std::size_t next = 0;
+    for (int i = 0; i < users; ++i) {
+        if (statuses[i] == UserStatus::ONLINE) {
+            EXPECT_EQ(listed[next++], "u-" + std::to_string(i));
+        }
+    }
+
+    std::size_t in_room = 0;
+    for (int i = 0; i < users; i += 3) {
+        in_room += statuses[i] == UserStatus::ONLINE;
+    }
+    EXPECT_EQ(directory.countInRoom("general", UserStatus::ONLINE), in_room);
+    EXPECT_EQ(directory.listInRoom("general", UserStatus::ONLINE).size(), in_room);
+}
+
+// Membership sets answer fan-out and overlap queries
+TEST(UserDirectoryTest, IntersectsRoomMembership) {
+    UserDirectory directory;
+    for (int i = 0; i < 200000; ++i) {
+        chat_app::User user("u-" + std::to_string(i), "name", i % 4 == 0 ? UserStatus::ONLINE : UserStatus::AWAY);
+        user.addToRoom("broadcast");
+        if (i % 5 == 0) {
+            user.addToRoom("team");
+        }
+        directory.upsert(user);
+    }
+
+    EXPECT_EQ(directory.memberCount("broadcast"), 200000u);
+    EXPECT_TRUE(directory.isMember("team", "u-10"));
+    EXPECT_FALSE(directory.isMember("team", "u-11"));
+    EXPECT_FALSE(directory.isMember("nowhere", "u-10"));
+
+    EXPECT_EQ(directory.onlineMembers("broadcast").cardinality(), 50000u);
+    EXPECT_EQ(directory.countInRoom("team", UserStatus::ONLINE), 10000u);  // Multiples of 20
+    EXPECT_EQ(directory.commonMembers("broadcast", "team").cardinality(), 40000u);
+
+    directory.setStatus("u-20", UserStatus::OFFLINE);
+    directory.leaveRoom("team", "u-40");
+    std::vector<std::string> targets;
+    directory.forEachOnlineMember("team", [&](const UserDirectory::UserView& view) {
+        targets.emplace_back(view.user_id);
+        return targets.size() < 2;
+    });
+    EXPECT_EQ(targets, (std::vector<std::string>{"u-0", "u-60"}));
+    EXPECT_EQ(directory.countInRoom("team", UserStatus::ONLINE), 9998u);
+}
+
+// Presence stats over a large directory take milliseconds
+TEST(UserDirectoryTest, CountsLargeDirectoryQuickly) {
+    UserDirectory directory;
+    const int users = 500000;
+    for (int i = 0; i < users; ++i) {
+        directory.upsert(chat_app::User("u" + std::to_string(i), "n" + std::to_string(i),
+                                        i % 10 == 0 ? UserStatus::ONLINE : UserStatus::OFFLINE));
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    auto counts = directory.countByStatus();
+    std::size_t listed = 0;
+    directory.forEachWithStatus(UserStatus::ONLINE, [&](const UserDirectory::UserView&) {
+        ++listed;
+        return true;
+    });
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    EXPECT_EQ(counts.online, 50000u);
+    EXPECT_EQ(listed, 50000u);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(100));
+}